@@ -0,0 +1,30 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_ALIGNMENT 16
+
+/* a chunk of memory of an arena */
+struct arena_chunk {
+  struct arena_chunk* next;
+  size_t size;
+  size_t used;
+  char* data;
+};
+
+/* an arena allocates records one after the other in large chunks of memory, and frees them all together;
+   records are never moved, so pointers to them remain valid until the arena is freed */
+struct arena {
+  struct arena_chunk* chunks; // the chunk where records are allocated is the first one
+  size_t chunk_size;
+  size_t allocated;
+};
+
+struct arena* arena_initialize(size_t chunk_size);
+
+void* arena_alloc(struct arena* arena, size_t size);
+
+void arena_free(struct arena* arena);
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef ATTEMPT_LOG_H
+#define ATTEMPT_LOG_H
+
+#include <stdint.h>
+#include "network.h"
+#include "payments.h"
+
+#define ATTEMPT_LOG_BLOCK_SIZE 4096 // attempts (and hop snapshots) per block of the log
+
+/* an attempt of a payment (or its split into shards); the attempts of a payment are linked from the last one (`payment->last_attempt`) */
+struct attempt {
+  long payment_id;
+  long previous; // the index of the previous attempt of the payment, -1 for the first one
+  uint64_t end_time;
+  long error_edge_id;
+  long shard1_id; // shard ids if the attempt is a split
+  long shard2_id;
+  long first_hop; // the index of the snapshot of the first hop of the route
+  uint32_t n_hops;
+  int attempts;
+  uint8_t error_type; // `enum payment_error_type`
+  uint8_t is_succeeded;
+  uint8_t is_split;
+};
+
+/* the attempts of all the payments, appended one after the other in blocks of fixed-size records, and the snapshots of their hops
+   (each attempt has a range of consecutive snapshots, in a single block). A block is freed when all its records belong to payments
+   that were retired (see payment_writer.c) */
+struct attempt_log {
+  enum attempt_log_level level;
+  struct attempt** attempt_blocks;
+  struct edge_snapshot** hop_blocks;
+  long* n_live_attempts; // per block, the attempts of payments that are not released
+  long* n_live_hops;
+  long n_blocks; // the size of the tables of blocks
+  long n_attempts;
+  long n_hops; // the index of the next hop snapshot
+};
+
+void initialize_attempt_log(enum attempt_log_level level);
+
+enum attempt_log_level get_attempt_log_level();
+
+struct attempt* new_attempt(struct payment* payment, long n_hops);
+
+struct attempt* get_attempt(long index);
+
+struct edge_snapshot* get_attempt_hop(struct attempt* attempt, long i);
+
+void add_attempt_history(struct payment* pmt, struct network* network, uint64_t time, short is_succeeded);
+
+void add_split_history(struct payment* pmt, uint64_t time, long shard1_id, long shard2_id);
+
+void release_attempts(struct payment* payment);
+
+void free_attempt_log();
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef AVAILABILITY_H
+#define AVAILABILITY_H
+
+#include <stdint.h>
+#include "array.h"
+#include "cloth.h"
+#include "network.h"
+
+void initialize_availability(struct network* network, struct network_params net_params, uint64_t last_payment_time);
+
+int is_node_offline(struct node* node, uint64_t time);
+
+#endif
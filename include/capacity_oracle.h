@@ -0,0 +1,33 @@
+#ifndef CAPACITY_ORACLE_H
+#define CAPACITY_ORACLE_H
+
+#include <stdint.h>
+#include "network.h"
+
+/* the maximum capacity of a path between two nodes (the largest minimum channel capacity of the paths connecting them),
+   computed on the Kruskal tree of the open channels: its leaves are the nodes, and each internal node joins two components
+   by the channel with the largest capacity. The maximum capacity of a path between two nodes is the capacity of their lowest
+   common ancestor, which is found on a heavy-path decomposition of the tree */
+struct capacity_oracle {
+  long n_nodes;
+  long* component; // the component of each node
+  uint32_t* parent; // UINT32_MAX for the roots; the ids of the internal nodes follow the ones of the nodes
+  uint32_t* depth;
+  uint32_t* head; // the first node of the heavy path of each node
+  uint64_t* capacity; // the capacity of each internal node
+  unsigned int is_stale; // if true, channels were opened after the oracle was built
+};
+
+struct capacity_oracle* new_capacity_oracle(struct network* network);
+
+void invalidate_capacity_oracle(struct network* network);
+
+void refresh_capacity_oracle(struct network* network);
+
+uint64_t get_max_path_capacity(struct capacity_oracle* oracle, long source, long target);
+
+int has_capacity_path(struct network* network, long source, long target, uint64_t amount);
+
+void free_capacity_oracle(struct capacity_oracle* oracle);
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdint.h>
+#include "array.h"
+#include "list.h"
+#include "cloth.h"
+#include "network.h"
+#include "payments.h"
+
+#define CHECKPOINT_MAGIC "CLOTHCKP"
+#define CHECKPOINT_VERSION 5
+
+/* a checkpoint contains the complete dynamic state of a simulation: simulation time and random generator, event queue,
+   balances/policies/channel updates of the edges, groups with their histories, the results of the payments observed by the nodes (mission control),
+   payments with their shard tree, routes and attempt histories, the initial paths of the payments not yet attempted, the group_add_queue
+   and, if payments are streamed, the position of the payment source.
+   The static topology is not stored: it is rebuilt from the input parameters and checked against the checkpoint;
+   the channels opened and closed during the simulation are stored and applied to it */
+
+void write_checkpoint(char filename[], struct simulation* simulation, struct network* network, struct array* payments, struct payment_source* payment_source, struct element* group_add_queue);
+
+/* restore the state saved in `filename` into `simulation` and `network` (which must have been initialized with the same input parameters);
+   it allocates the events, the payments and the `paths` of routing.c, moves `payment_source` (NULL if payments are not streamed) to its saved position,
+   and returns the restored group_add_queue */
+struct element* read_checkpoint(char filename[], struct simulation* simulation, struct network* network, struct array** payments, struct payment_source* payment_source);
+
+#endif
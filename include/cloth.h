@@ -14,6 +14,18 @@ enum routing_method {
     GROUP_ROUTING_CUL
 };
 
+enum network_ordering {
+    ORIGINAL_ORDERING,
+    RCM_ORDERING,
+    HUB_BFS_ORDERING
+};
+
+enum attempt_log_level {
+    ATTEMPT_LOG_OFF, // attempts are recorded without hops, only for path finding, and are not written in the output
+    ATTEMPT_LOG_SUMMARY, // attempts are recorded without hops
+    ATTEMPT_LOG_FULL // attempts are recorded with a snapshot of the edges of their route
+};
+
 struct network_params {
     long n_nodes;
     long n_channels;
@@ -44,6 +56,59 @@ struct network_params {
      */
     char edges_filename[256];
 
+    /**
+     * In case generate_network_from_file=true, the name of a binary network snapshot (see network_snapshot.h) to load instead of the csv files.
+     * A snapshot is created from the csv files with the tool cloth_network_snapshot. If empty, the csv files are used.
+     */
+    char network_snapshot_filename[256];
+
+    /**
+     * Possible values: none, rcm, hub_bfs.
+     * How nodes, channels and edges are renumbered after the network is loaded, so that neighbouring nodes and their edges are close in memory:
+     * rcm is the reverse Cuthill-McKee ordering, hub_bfs a breadth-first visit starting from the nodes with most edges. With none, the ids of the input are kept.
+     * The output files always use the ids of the input.
+     */
+    enum network_ordering network_ordering;
+
+    /**
+     * The name of a csv file with channels to open and close during the simulation (see topology_changes_template.csv); if empty, no change is read.
+     * Each row is `time,channel_id` to close a channel or `time,-1,node1_id,node2_id,capacity` to open a channel funded by node1 (capacity in satoshis).
+     */
+    char topology_changes_filename[256];
+
+    /**
+     * The average number of channels opened (between two random nodes) and closed (at random) per second of simulation time; 0 to disable.
+     * Random changes occur until the start time of the last payment.
+     */
+    double channel_open_rate;
+    double channel_close_rate;
+
+    /**
+     * The name of a csv file with the intervals in which nodes are offline (see node_availability_template.csv); if empty, no interval is read.
+     * Each row is `node_id,offline_start,offline_end` (times in milliseconds).
+     */
+    char node_availability_filename[256];
+
+    /**
+     * The average times in seconds that a node stays online and offline; if both are positive, the offline intervals of each node are generated
+     * with exponential online and offline times. With offline intervals, faulty_node_probability is not used.
+     */
+    double average_node_online_time;
+    double average_node_offline_time;
+
+    /**
+     * Possible values: true or false.
+     * If true, path finding does not use the nodes that are offline at the time the path is searched (only with offline intervals).
+     */
+    unsigned int routing_skip_offline_nodes;
+
+    /**
+     * Possible values: true or false.
+     * If true, path finding does not expand the nodes of the trees attached to the 2-core of the network, unless the source or the target
+     * of the path is in their subtree (see network_core.c).
+     */
+    unsigned int routing_prune_leaf_trees;
+
     /**
      * ネットワークからの送金を行う際のタイムアウト時間 [ms]
      * -1を設定すると送金タイムアウトを無効化する
@@ -130,8 +195,109 @@ struct payments_params {
     char payments_filename[256];
     unsigned int mpp;
     int max_shard_count; // maximum number of shards for MPP (default: 16)
+    unsigned int mpp_path_handoff; // if true, the shards of a GCB split keep the paths found by the split (see find_path)
     double max_fee_limit_mu; // average_max_fee_limit [satoshi]
     double max_fee_limit_sigma; // variance_max_fee_limit [satoshi]
+    unsigned int stream_payments; // if true, payments are created when the simulation reaches their start time (see payments.c)
+    unsigned int retire_payments; // if true, payments are written and freed when they and their shards are final (see payment_writer.c)
+    /* random payments of a workload family other than "uniform" (see workload.c) */
+    char workload[32];
+    double workload_zipf_exponent; // merchants: exponent of the Zipf law of the receivers
+    double workload_locality_hops; // local: average hops between sender and receiver
+    double workload_amount_sigma; // standard deviation of the logarithm of the log-normal amounts
+    double workload_pareto_alpha; // heavy_tailed: shape of the Pareto amounts (> 1)
+    double workload_burst_factor; // bursty: payment rate during a burst, relative to the calm periods
+    double workload_burst_duration; // bursty: average duration of a burst [s]
+    double workload_diurnal_period; // diurnal: period of the payment rate [s]
+    double workload_repeat_probability; // repeat: probability that a payment repeats the pair of a previous payment
+    /* load ramp: stages of random payments at increasing rates, to find the highest sustainable rate (see ramp.c) */
+    unsigned int ramp_mode;
+    double ramp_initial_rate; // payments per second of the first stage
+    double ramp_rate_factor; // the rate after a sustainable stage, relative to it (before the first unsustainable stage)
+    double ramp_stage_duration; // duration of the arrivals of a stage [s]
+    double ramp_min_success_rate; // minimum success rate of a sustainable stage
+    uint64_t ramp_max_latency; // maximum average latency of the succeeded payments of a sustainable stage [ms], 0 for no limit
+    double ramp_tolerance; // the ramp ends when the unsustainable and the sustainable rates are within this fraction
+    int ramp_max_stages;
+};
+
+struct simulation_params {
+    /**
+     * telemetry.binの最小フラッシュ間隔 [ms]
+     * 0を設定するとtelemetry.binを作成しない
+     */
+    uint64_t telemetry_flush_interval;
+
+    /**
+     * イベント種別ごとの処理時間を計測し、event_profile.jsonに出力するか否か
+     * CLOTH_PROFILERを有効にしてビルドした場合のみ有効
+     */
+    unsigned int event_profiler;
+
+    /**
+     * payments_output.csvのattempts_historyに出力する試行の詳細度 (off, summary, full)
+     * fullでは各試行の経路のエッジのスナップショットも記録する (see attempt_log.h)
+     */
+    enum attempt_log_level attempts_history;
+
+    /**
+     * チェックポイントの出力先ファイル名
+     * 空の場合、チェックポイントを作成しない
+     */
+    char checkpoint_filename[256];
+
+    /**
+     * この時刻 [ms] までのイベントを処理した時点でチェックポイントを作成する
+     * 0を設定すると無効
+     */
+    uint64_t checkpoint_time;
+
+    /**
+     * チェックポイントを定期的に作成する間隔 [ms]（シミュレーション時刻）
+     * 同じファイルを上書きするため、常に最新のチェックポイントのみが残る
+     * 0を設定すると無効
+     */
+    uint64_t checkpoint_interval;
+
+    /**
+     * 指定した場合、ネットワークを入力パラメータから再構築したのち、このチェックポイントから状態を復元してシミュレーションを再開する
+     * ネットワークの生成に関するパラメータはチェックポイント作成時と同じでなければならない
+     */
+    char restore_filename[256];
+
+    /**
+     * 分岐時刻 [ms]
+     * この時刻までのイベントを処理した時点で、branch_variants_filenameの各行についてfork()で子プロセスを作成する
+     * 子プロセスは親プロセスのメモリをcopy-on-writeで共有し、行に記述されたパラメータで残りのシミュレーションを実行する
+     * 親プロセスは自身のパラメータでシミュレーションを続行し、終了時に子プロセスを待つ
+     * 0を設定すると無効
+     */
+    uint64_t branch_time;
+
+    /**
+     * 分岐のパラメータを記述したファイル名
+     * 各行の形式: <output_dir> <key>=<value> <key>=<value> ...
+     * output_dirが相対パスの場合、親プロセスの出力ディレクトリからの相対パスとなる
+     * keyにはcloth_input.txtのパラメータ（ネットワークと送金の生成に関するものを除く）とseedを指定できる
+     */
+    char branch_variants_filename[256];
+
+    /**
+     * 処理したイベントを記録するバイナリトレースのファイル名（出力ディレクトリからの相対パス）
+     * 空の場合、トレースを作成しない
+     * フォーマットはinclude/trace.hを参照
+     */
+    char event_trace_filename[256];
+};
+
+#define MAX_BRANCH_OVERRIDES 32
+
+/* a variant of a branched simulation: the output directory and the parameters that are overridden in the branch */
+struct branch_variant {
+    char output_dir_name[256];
+    int n_overrides;
+    char parameters[MAX_BRANCH_OVERRIDES][64];
+    char values[MAX_BRANCH_OVERRIDES][256];
 };
 
 struct simulation {
@@ -0,0 +1,35 @@
+#ifndef CSV_H
+#define CSV_H
+
+#include <stdint.h>
+
+#define CSV_MAX_THREADS 16
+#define CSV_MIN_CHUNK_SIZE (256*1024) // files smaller than this are parsed by a single thread
+
+/* the value of a field: `integer` for the columns of type 'i', `real` for the columns of type 'f'.
+   Integers are read as signed 64-bit values; a negative value stored in an unsigned field wraps around (e.g., -1 is UINT64_MAX), as with scanf */
+union csv_value {
+  int64_t integer;
+  double real;
+};
+
+/* the rows of a csv file (header excluded): the value of column `j` of row `i` is `values[i*n_columns + j]` */
+struct csv_table {
+  long n_rows;
+  long n_columns;
+  union csv_value* values;
+};
+
+/* read a csv file with one header line and a column per character of `column_types` ('i' integer, 'f' floating point);
+   the columns after the first `n_required_columns` may be missing, in which case they take the value in `default_values` (indexed by column).
+   Empty lines are skipped; a malformed row terminates the simulation with an error that reports its line and column */
+struct csv_table* csv_read(char filename[], char column_types[], long n_required_columns, union csv_value* default_values);
+
+/* parse a row from `p` to `end` (its end of line excluded) into `values`, with the same rules as csv_read; it returns NULL, or the error of a malformed row
+   with its column in `error_column`. It is used to read a csv file one row at a time */
+const char* csv_parse_row(const char* p, const char* end, char column_types[], long n_columns, long n_required_columns, union csv_value* default_values,
+                          union csv_value* values, long* error_column);
+
+void csv_free(struct csv_table* table);
+
+#endif
@@ -20,19 +20,27 @@ enum event_type {
   CHANNELUPDATESUCCESS,
   UPDATEGROUP,
   CONSTRUCTGROUPS,
+  CLOSECHANNEL,
 };
 
+#define N_EVENT_TYPES (CLOSECHANNEL + 1)
+
 struct event {
   uint64_t time;
   enum event_type type;
-  long node_id;
+  long node_id; // for OPENCHANNEL and CLOSECHANNEL, the index of the change in the schedule (see topology.c)
+  long hop_index; // for the HTLC events of a route, the position of the node in the route (0 for the sender); -1 otherwise
   struct payment *payment;
 };
 
-struct event* new_event(uint64_t time, enum event_type type, long node_id, struct payment* payment);
+struct event* new_event(uint64_t time, enum event_type type, long node_id, long hop_index, struct payment* payment);
+
+void free_event(struct event* e);
 
 int compare_event(struct event* e1, struct event *e2);
 
+char* get_event_type_name(enum event_type type);
+
 struct heap* initialize_events(struct array* payments);
 
 #endif
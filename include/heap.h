@@ -17,6 +17,8 @@ struct heap* heap_insert_or_update(struct heap *h, void* data, int(*compare)(),
 
 void* heap_pop(struct heap* h, int(*compare)());
 
+void* heap_peek(struct heap* h);
+
 long heap_len(struct heap*h);
 
 void heap_free(struct heap* h);
@@ -11,6 +11,12 @@
 
 #define OFFLINELATENCY 3000 //3 seconds waiting for a node not responding (tcp default retransmission time)
 
+/* consistency checks of the HTLC events, chosen at build time: 0 none, 1 constant-time checks (default),
+   2 also the linear scans of the route that cross-check the hop index of the events */
+#ifndef CLOTH_VALIDATION_LEVEL
+#define CLOTH_VALIDATION_LEVEL 1
+#endif
+
 /* a node pair result registers the most recent result of a payment (fail or success, with the corresponding amount and time)
    that occurred when the payment traversed an edge connecting the two nodes of the node pair */
 struct node_pair_result{
@@ -47,6 +53,9 @@ void channel_update_success(struct event* event, struct simulation* simulation,
 // return `struct element* group_add_queue`
 struct element* request_group_update(struct event* event, struct simulation* simulation, struct network* network, struct network_params net_params, struct element* group_add_queue);
 
+// return `struct element* group_add_queue`
+struct element* initialize_groups(struct simulation* simulation, struct network* network, struct network_params net_params);
+
 // return `struct element* group_add_queue`
 struct element* construct_groups(struct simulation* simulation, struct element* group_add_queue, struct network *network, struct network_params net_params);
 
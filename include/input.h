@@ -0,0 +1,16 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include "cloth.h"
+
+void initialize_input_parameters(struct network_params *net_params, struct payments_params *pay_params, struct simulation_params *sim_params);
+
+void set_input_parameter(struct network_params* net_params, struct payments_params* pay_params, struct simulation_params* sim_params, char* parameter, char* value, char input_filename[]);
+
+void check_input_parameters(struct network_params* net_params, struct payments_params* pay_params, struct simulation_params* sim_params);
+
+void read_input(struct network_params* net_params, struct payments_params* pay_params, struct simulation_params* sim_params);
+
+void resolve_output_filename(char filename[256], char output_dir_name[]);
+
+#endif
@@ -5,6 +5,7 @@
 #include <stdint.h>
 #include "cloth.h"
 #include "list.h"
+#include "arena.h"
 
 #define MAXMSATOSHI 5E17 //5 millions  bitcoin
 #define MAXTIMELOCK 100
@@ -27,10 +28,18 @@ struct policy {
   double cul_threshold;
 };
 
+/* the entry of a closed edge in the open edges of a node (tombstone): it is skipped without reading the edge */
+#define CLOSED_EDGE UINT32_MAX
+
 /* a node of the payment-channel network */
 struct node {
   long id;
-  struct array* open_edges;
+  uint32_t* open_edges; // ids of the edges leaving the node, CLOSED_EDGE for the edges closed since the last compaction
+  uint32_t n_open_edges; // including the CLOSED_EDGE entries
+  uint32_t open_edges_size;
+  uint32_t n_closed_edges;
+  uint64_t* offline_intervals; // start and end times of the intervals in which the node is offline, sorted (see availability.c)
+  uint32_t n_offline_intervals;
   struct element **results;
   unsigned int explored;
 };
@@ -65,11 +74,11 @@ struct edge {
 struct edge_snapshot {
   long id;
   uint64_t balance;
-  short is_in_group;
   uint64_t group_cap;
-  short does_channel_update_exist;
   uint64_t last_channle_update_value;
   uint64_t sent_amt;
+  short is_in_group;
+  short does_channel_update_exist;
 };
 
 
@@ -114,31 +123,78 @@ struct graph_channel {
 };
 
 
+/* the ids of a renumbered network (see network_ordering.c) and the ids of the input files */
+struct id_map {
+  long n;
+  long* original_ids; // the input id of each id
+  long* ids; // the id of each input id
+};
+
+
+/* nodes, channels and edges are allocated in arenas, one per type, so that the records of a type are contiguous in memory;
+   `nodes`, `channels` and `edges` index them by id. The arenas are freed all at once by `free_network` */
 struct network {
   struct array* nodes;
   struct array* channels;
   struct array* edges;
   struct array* groups;
   gsl_ran_discrete_t* faulty_node_prob; //the probability that a nodes in the network has a fault and goes offline
+  unsigned int has_availability; // if true, nodes are offline in their offline intervals instead of with faulty_node_prob
+  unsigned int skip_offline_nodes; // if true, path finding does not use the nodes that are offline
+  struct arena* node_arena;
+  struct arena* channel_arena;
+  struct arena* edge_arena;
+  struct arena* data_arena; // open edges of the nodes, channel updates, results of the nodes, group updates, and the elements of their lists
+  struct id_map* node_map; // NULL if the network is not renumbered, as the channel and edge maps
+  struct id_map* channel_map;
+  struct id_map* edge_map;
+  struct network_core* core; // 2-core of the network and its trees, used to prune path finding (see network_core.h)
+  struct capacity_oracle* capacity_oracle; // maximum capacity of the paths between two nodes (see capacity_oracle.h)
 };
 
 
-struct node* new_node(long id);
+struct network* new_network(long n_nodes, long n_channels);
+
+struct node* new_node(struct network* network, long id);
+
+struct channel* new_channel(struct network* network, long id, long direction1, long direction2, long node1, long node2, uint64_t capacity);
+
+struct edge* new_edge(struct network* network, long id, long channel_id, long counter_edge_id, long from_node_id, long to_node_id, uint64_t balance, struct policy policy, uint64_t channel_capacity);
+
+struct channel_update* new_channel_update(struct network* network, long edge_id, uint64_t time, uint64_t htlc_maximum_msat);
+
+struct element* push_network_list(struct network* network, struct element* head, void* data);
+
+void add_open_edge(struct network* network, struct node* node, long edge_id);
+
+int has_open_edge(struct node* node, long edge_id);
+
+long get_original_id(struct id_map* map, long id);
+
+long get_renumbered_id(struct id_map* map, long original_id);
+
+void close_open_edge(struct node* node, long edge_id);
+
+struct channel* add_channel(struct network* network, long node1, long node2, uint64_t capacity, uint64_t edge1_balance, struct policy edge1_policy, struct policy edge2_policy);
+
+void mark_channel_closed(struct network* network, long channel_id);
+
+struct policy generate_random_policy(gsl_rng* random_generator, double cul_threshold_dist_alpha, double cul_threshold_dist_beta);
 
-struct channel* new_channel(long id, long direction1, long direction2, long node1, long node2, uint64_t capacity);
+long sample_node_by_channels(uint64_t* tree, long n, long n_candidates, gsl_rng* random_generator);
 
-struct edge* new_edge(long id, long channel_id, long counter_edge_id, long from_node_id, long to_node_id, uint64_t balance, struct policy policy, uint64_t channel_capacity);
+struct network* generate_random_network(struct network_params net_params, gsl_rng* random_generator);
 
-void open_channel(struct network* network, gsl_rng* random_generator, struct network_params net_params);
+struct network* generate_network_from_files(char nodes_filename[256], char channels_filename[256], char edges_filename[256]);
 
 struct network* initialize_network(struct network_params net_params, gsl_rng* random_generator);
 
-int update_group(struct group* group, struct network_params net_params, uint64_t current_time, gsl_rng* random_generator, int enable_fake_balance_update, struct edge* triggered_edge);
+int update_group(struct network* network, struct group* group, struct network_params net_params, uint64_t current_time, gsl_rng* random_generator, int enable_fake_balance_update, struct edge* triggered_edge);
 
 long get_edge_balance(struct edge* e);
 
 void free_network(struct network* network);
 
-struct edge_snapshot* take_edge_snapshot(struct edge* e, uint64_t sent_amt, short is_in_group, uint64_t group_cap);
+void take_edge_snapshot(struct edge_snapshot* snapshot, struct edge* e, uint64_t sent_amt, short is_in_group, uint64_t group_cap);
 
 #endif
@@ -0,0 +1,39 @@
+#ifndef NETWORK_CORE_H
+#define NETWORK_CORE_H
+
+#include <stdint.h>
+#include "network.h"
+
+/* the 2-core of a network and the trees attached to it. A node outside the 2-core can be a transit hop only of the paths
+   that start or end in its subtree: the trees are numbered by depth-first visits (starting from the core nodes they are attached to),
+   so that node `a` is an ancestor of node `b` if `tree_in[a] <= tree_in[b] <= tree_out[a]`. Core nodes have `tree_in` UINT32_MAX */
+struct network_core {
+  uint8_t* is_core;
+  uint32_t* tree_in;
+  uint32_t* tree_out;
+  long n_core_nodes;
+  unsigned int is_stale; // if true, channels were opened or closed after the core was computed
+};
+
+struct network_core* new_network_core(struct network* network);
+
+void update_network_core(struct network* network);
+
+void invalidate_network_core(struct network* network, long node1_id, long node2_id);
+
+void refresh_network_core(struct network* network);
+
+struct network_core* get_network_core(struct network* network);
+
+void free_network_core(struct network_core* core);
+
+/* whether `node_id` can be a hop of a path between `source` and `target` (see above) */
+static inline int is_transit_node(struct network_core* core, long node_id, long source, long target) {
+  uint32_t in, out;
+  if(core->is_core[node_id]) return 1;
+  in = core->tree_in[node_id];
+  out = core->tree_out[node_id];
+  return (in <= core->tree_in[source] && core->tree_in[source] <= out) || (in <= core->tree_in[target] && core->tree_in[target] <= out);
+}
+
+#endif
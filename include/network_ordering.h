@@ -0,0 +1,11 @@
+#ifndef NETWORK_ORDERING_H
+#define NETWORK_ORDERING_H
+
+#include "cloth.h"
+#include "network.h"
+
+struct network* renumber_network(struct network* network, enum network_ordering ordering);
+
+void free_id_map(struct id_map* map);
+
+#endif
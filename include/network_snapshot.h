@@ -0,0 +1,56 @@
+#ifndef NETWORK_SNAPSHOT_H
+#define NETWORK_SNAPSHOT_H
+
+#include <stdint.h>
+#include "network.h"
+
+#define NETWORK_SNAPSHOT_MAGIC "CLTHNETW"
+#define NETWORK_SNAPSHOT_VERSION 1
+
+/* a network snapshot is the binary equivalent of the three csv files of a network (nodes, channels, edges).
+   It is a header followed by these sections, in this order, each aligned to 8 bytes:
+   - n_nodes node records, n_channels channel records and n_edges edge records, where the record of id `i` is the i-th record;
+   - the adjacency of the nodes in compressed form: n_nodes+1 offsets into n_edges edge ids, so that the edges leaving node `i`
+     are the ids from `adjacency_offsets[i]` to `adjacency_offsets[i+1]` (in the order of the edges file);
+   - n_edges cul thresholds, one per edge */
+struct network_snapshot_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t header_size;
+  uint64_t n_nodes;
+  uint64_t n_channels;
+  uint64_t n_edges;
+};
+
+struct network_snapshot_node {
+  int64_t id;
+};
+
+struct network_snapshot_channel {
+  int64_t id;
+  int64_t edge1;
+  int64_t edge2;
+  int64_t node1;
+  int64_t node2;
+  uint64_t capacity;
+};
+
+struct network_snapshot_edge {
+  int64_t id;
+  int64_t channel_id;
+  int64_t counter_edge_id;
+  int64_t from_node_id;
+  int64_t to_node_id;
+  uint64_t balance;
+  uint64_t fee_base;
+  uint64_t fee_proportional;
+  uint64_t min_htlc;
+  uint32_t timelock;
+  uint32_t padding;
+};
+
+void write_network_snapshot(char filename[], struct network* network);
+
+struct network* generate_network_from_snapshot(char filename[]);
+
+#endif
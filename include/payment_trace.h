@@ -0,0 +1,49 @@
+#ifndef PAYMENT_TRACE_H
+#define PAYMENT_TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "payments.h"
+
+#define PAYMENT_TRACE_MAGIC "CLTHPAYT"
+#define PAYMENT_TRACE_VERSION 1
+
+/* a payment trace is the binary equivalent of a payments file (`id,sender_id,receiver_id,amount,start_time[,max_fee_limit]`),
+   sorted by start time. It is a header followed by one record per payment, where the payment of id `i` is the i-th record.
+   A record is a sequence of unsigned LEB128 varints (7 bits per byte, least significant first, high bit set on all bytes but the last):
+   the start time minus the start time of the previous payment (of `first_start_time` for the first one), the sender, the receiver,
+   the amount and the maximum fee plus one (0 if the payment has no maximum fee) */
+struct payment_trace_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t header_size;
+  uint64_t n_payments;
+  uint64_t first_start_time;
+  uint64_t last_start_time;
+  uint64_t records_size; // the size in bytes of the records, which follow the header
+};
+
+/* a cursor over a payment trace mapped in memory */
+struct payment_trace {
+  char filename[256];
+  char* mapping;
+  size_t mapping_size;
+  struct payment_trace_header* header;
+  size_t offset; // the position of the next record from the start of the file
+  uint64_t start_time; // the start time of the last payment read
+  long n_read;
+};
+
+unsigned int is_payment_trace(char filename[]);
+
+void write_payment_trace(char filename[], struct payment_arrival* arrivals, long n_payments);
+
+struct payment_trace* open_payment_trace(char filename[]);
+
+int read_payment_trace(struct payment_trace* trace, struct payment_arrival* arrival);
+
+void seek_payment_trace(struct payment_trace* trace, size_t offset, uint64_t start_time, long n_read);
+
+void close_payment_trace(struct payment_trace* trace);
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef PAYMENT_WRITER_H
+#define PAYMENT_WRITER_H
+
+#include <stdio.h>
+#include <pthread.h>
+#include "array.h"
+#include "heap.h"
+#include "network.h"
+#include "payments.h"
+
+/* a row of `payments_output.csv` */
+struct payment_row {
+  long id;
+  char* text;
+  size_t length;
+  struct payment_row* next;
+};
+
+/* with `retire_payments`, a payment is written in `payments_output.csv` and freed as soon as it and its shards are final.
+   The rows are written by a background thread in order of payment id: the rows of the payments retired before a lower id
+   wait in `retired_rows` */
+struct payment_writer {
+  FILE* file;
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t has_rows;
+  struct payment_row* first_row; // the rows to be written by the thread
+  struct payment_row* last_row;
+  unsigned int is_closed;
+  struct heap* retired_rows;
+  long next_id; // the id of the next row to be written
+};
+
+void write_payments_header(FILE* file);
+
+void write_payment(FILE* file, struct payment* payment, struct array* payments, struct network* network);
+
+struct payment_writer* open_payment_writer(char output_dir_name[]);
+
+unsigned int is_payment_final(struct array* payments, struct payment* payment);
+
+void retire_payment(struct payment_writer* writer, struct array* payments, struct payment* payment, struct network* network);
+
+void close_payment_writer(struct payment_writer* writer);
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef PAYMENTS_H
 #define PAYMENTS_H
 
+#include <stdio.h>
 #include <stdint.h>
 #include <gsl/gsl_rng.h>
 #include "array.h"
@@ -21,6 +22,8 @@ struct payment_error{
   struct route_hop* hop;
 };
 
+/* the fields read by every event of the payment come first, then the shard tree and the stats, which are read only when
+   the payment is split or completed */
 struct payment {
   long id;
   long sender;
@@ -28,15 +31,21 @@ struct payment {
   uint64_t amount; //millisatoshis
   uint64_t max_fee_limit; //millisatoshis
   struct route* route;
+  struct path* reserved_path; // a path found for the shard by the split of its parent (see `mpp_path_handoff`), used by its first FINDPATH
   uint64_t start_time;
   uint64_t end_time;
   int attempts;
+  int n_events; // events of the payment in the event queue (see event.c)
   struct payment_error error;
-  /* attributes for multi-path-payment (mpp)*/
+  long last_attempt; // the index of the last attempt of the payment in the attempt log (see attempt_log.h), -1 if none
+  /* attributes for multi-path-payment (mpp): the shards of a payment are its children in the shard tree, linked from the first one */
   unsigned int is_shard;
-  long shards_id[2];
   long parent_id;           // parent payment/shard id (-1 if root payment)
   long root_payment_id;     // original payment id (for shard tree tracking)
+  long first_shard_id;      // first child shard (-1 if the payment was not split)
+  long last_shard_id;       // last child shard
+  long next_shard_id;       // next child shard of the parent (-1 if last)
+  int n_shards;             // number of child shards
   int shard_count;          // number of shards created from this payment (for root tracking)
   int completed_shard_count; // number of shards completed (success or final fail)
   int successful_shard_count; // number of successfully completed shards
@@ -46,24 +55,58 @@ struct payment {
   int offline_node_count;
   int no_balance_count;
   unsigned int is_timeout;
-  struct element* history; // list of `struct attempt`
 };
 
-struct attempt {
-  int attempts;
-  uint64_t end_time;
-  long error_edge_id;
-  enum payment_error_type error_type;
-  struct array* route; // array of `struct edge_snapshot`
-  short is_succeeded;
-  short is_split;           // 1 if this attempt resulted in a split
-  long shard1_id;           // shard 1 id if split occurred
-  long shard2_id;           // shard 2 id if split occurred
+/* a payment that is not created yet: a row of the payments file or a random payment */
+struct payment_arrival {
+  long sender;
+  long receiver;
+  uint64_t amount;
+  uint64_t start_time;
+  uint64_t max_fee_limit;
+};
+
+struct payment_trace;
+struct ramp;
+
+/* the payments of a simulation with `stream_payments`: a cursor over the payments file (sorted by start time), or the generator
+   of the random payments, from which a payment is created when the simulation reaches its start time */
+struct payment_source {
+  FILE* file; // NULL for random payments and payment traces
+  struct payment_trace* trace; // the payments file, if it is a payment trace (see payment_trace.h)
+  char filename[256];
+  long line; // the last line read from the file
+  char* row; // the buffer of the lines read from the file, grown by getline
+  size_t row_size;
+  gsl_rng* random_generator; // a copy of the generator of the simulation, taken before the random payments are drawn
+  struct payments_params pay_params;
+  long n_nodes;
+  uint64_t payment_time; // the start time of the last random payment drawn
+  long n_payments;
+  long n_drawn; // payments read or drawn so far, `next` included
+  uint64_t last_start_time;
+  unsigned int has_next;
+  struct payment_arrival next;
+  unsigned int resample_max_fee_limit; // if true, the maximum fee is drawn again when the payment is created (see apply_branch_variant)
+  struct ramp* ramp; // with `ramp_mode`, the random payments arrive in the stages of the ramp (see ramp.c)
 };
 
 struct payment* new_payment(long id, long sender, long receiver, uint64_t amount, uint64_t start_time, uint64_t max_fee_limit);
+uint64_t generate_max_fee_limit(struct payments_params pay_params, gsl_rng* random_generator);
+
 struct array* initialize_payments(struct payments_params pay_params, long n_nodes, gsl_rng* random_generator);
-void add_attempt_history(struct payment* pmt, struct network* network, uint64_t time, short is_succeeded);
-void add_split_history(struct payment* pmt, uint64_t time, long shard1_id, long shard2_id);
+
+struct payment_source* new_payment_source(struct payments_params pay_params, long n_nodes, gsl_rng* random_generator);
+uint64_t get_next_arrival_time(struct payment_source* source);
+long get_payment_source_offset(struct payment_source* source);
+void reopen_payment_source(struct payment_source* source, long offset);
+void resume_payment_source(struct payment_source* source, uint64_t time, double rate);
+void schedule_payment_arrivals(struct payment_source* source, struct simulation* simulation, struct network* network, struct array** payments, uint64_t time);
+uint64_t get_last_payment_time(struct array* payments, struct payment_source* source);
+void free_payment_source(struct payment_source* source);
+void free_payment(struct payment* payment);
+unsigned int has_shards(struct payment* payment);
+void add_shard(struct array* payments, struct payment* payment, struct payment* shard);
+void aggregate_shard_stats(struct array* payments, struct payment* payment);
 
 #endif
@@ -0,0 +1,44 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+#include <time.h>
+#include "event.h"
+
+#define PROFILER_N_BUCKETS 40 // bucket i counts the events which lasted [2^i, 2^(i+1)) nanoseconds
+#define PROFILER_FILENAME "event_profile.json"
+
+/* statistics of the executions of one event type */
+struct event_profile {
+  uint64_t count;
+  uint64_t total_ns;
+  uint64_t max_ns;
+  uint64_t histogram[PROFILER_N_BUCKETS];
+};
+
+extern unsigned int profiler_enabled;
+
+void profiler_initialize(unsigned int enabled);
+
+void profiler_record(enum event_type type, uint64_t elapsed_ns);
+
+void profiler_set_initial_dijkstra_time(uint64_t elapsed_ns);
+
+void profiler_write(char output_dir_name[]);
+
+static inline uint64_t profiler_get_time() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec*1000000000ULL + ts.tv_nsec;
+}
+
+/* the profiler is compiled only if CLOTH_PROFILER is defined (cmake option CLOTH_PROFILER), and it runs only if `event_profiler=true` in cloth_input.txt */
+#ifdef CLOTH_PROFILER
+#define PROFILER_EVENT_BEGIN(start) uint64_t start = profiler_enabled ? profiler_get_time() : 0
+#define PROFILER_EVENT_END(start, type) if(profiler_enabled) profiler_record(type, profiler_get_time() - (start))
+#else
+#define PROFILER_EVENT_BEGIN(start)
+#define PROFILER_EVENT_END(start, type)
+#endif
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef RAMP_H
+#define RAMP_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "cloth.h"
+#include "payments.h"
+
+/* a stage of the ramp: random payments arrive at `rate` from `start_time` to `end_time`, then no payment arrives until all the
+   payments of the stage (with their shards) are final, and the stage is evaluated */
+struct ramp_stage {
+  int index;
+  double rate; // payments per second
+  uint64_t start_time;
+  uint64_t end_time;
+  uint64_t drained_time; // the time when the last payment of the stage became final
+  long n_payments;
+  long n_final;
+  long n_succeeded;
+  uint64_t total_latency; // of the succeeded payments [ms]
+  uint64_t max_latency;
+};
+
+/* with `ramp_mode`, the payment rate is raised by `ramp_rate_factor` after each sustainable stage, until a stage is not sustainable;
+   then the rate is bisected between the highest sustainable rate and the lowest unsustainable one */
+struct ramp {
+  struct payments_params pay_params;
+  struct ramp_stage stage;
+  double sustainable_rate; // the highest sustainable rate so far, 0 if none
+  double unsustainable_rate; // the lowest unsustainable rate so far, 0 if none
+  unsigned int is_arriving; // the payments of the stage are still arriving
+  unsigned int is_finished;
+  FILE* output;
+};
+
+struct ramp* new_ramp(struct payments_params pay_params, char output_dir_name[]);
+
+void start_ramp_stage(struct ramp* ramp, struct payment_source* source, uint64_t time);
+
+void end_ramp_arrivals(struct ramp* ramp, struct payment_source* source);
+
+void add_ramp_payment(struct ramp* ramp);
+
+void record_ramp_payment(struct ramp* ramp, struct payment_source* source, struct payment* payment, uint64_t time);
+
+void free_ramp(struct ramp* ramp);
+
+#endif
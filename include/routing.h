@@ -14,7 +14,7 @@
 
 extern pthread_mutex_t data_mutex;
 extern pthread_mutex_t jobs_mutex;
-extern struct array** paths;
+extern struct path** paths;
 extern struct element* jobs;
 
 struct thread_args{
@@ -47,6 +47,12 @@ struct path_hop{
   long edge;
 };
 
+/* paths and routes are single allocations, with their hops after the header (see path_initialize and route_initialize) */
+struct path {
+  long n_hops;
+  struct path_hop hops[];
+};
+
 struct route_hop {
   long from_node_id;
   long to_node_id;
@@ -63,7 +69,8 @@ struct route {
   uint64_t total_amount;
   uint64_t total_fee;
   uint64_t total_timelock;
-  struct array *route_hops;
+  long n_hops;
+  struct route_hop hops[];
 };
 
 enum pathfind_error{
@@ -77,13 +84,25 @@ uint64_t estimate_capacity(struct edge* edge, struct network* network, enum rout
 
 void run_dijkstra_threads(struct network* network, struct array* payments, uint64_t current_time, enum routing_method routing_method);
 
-struct array* dijkstra(long source, long destination, uint64_t amount, struct network* network, uint64_t current_time, long p, enum pathfind_error *error, enum routing_method routing_method, struct element* exclude_edges, uint64_t max_fee_limit);
+void run_dijkstra_jobs(struct network* network, struct array* payments, uint64_t current_time, enum routing_method routing_method);
+
+struct path* dijkstra(long source, long destination, uint64_t amount, struct network* network, uint64_t current_time, long p, enum pathfind_error *error, enum routing_method routing_method, struct element* exclude_edges, uint64_t max_fee_limit);
+
+struct route* transform_path_into_route(struct path* path, uint64_t amount_to_send, struct network* network, uint64_t time);
 
-struct route* transform_path_into_route(struct array* path_hops, uint64_t amount_to_send, struct network* network, uint64_t time);
+void compute_route_totals(struct path* path, uint64_t amount_to_send, struct network* network, uint64_t* total_fee, uint64_t* total_timelock);
 
 int compare_distance(struct distance* a, struct distance* b);
 
+struct path* path_initialize(long n_hops);
+
+struct route* route_initialize(long n_hops);
+
+void free_path(struct path* path);
+
 void free_route(struct route* route);
 
+void free_routing_pool();
+
 
 #endif
@@ -0,0 +1,52 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+
+#define TELEMETRY_MAGIC 0x4D4C455448544C43ULL // "CLTHTELM" in little-endian byte order
+#define TELEMETRY_VERSION 2
+#define TELEMETRY_FILENAME "telemetry.bin"
+#define TELEMETRY_CHECK_PERIOD 1024 // number of events between two checks of the wall clock
+
+enum telemetry_state {
+  TELEMETRY_INITIALIZING,
+  TELEMETRY_RUNNING,
+  TELEMETRY_FINISHED
+};
+
+/* status block of a running simulation; it is memory-mapped on `<output_dir>/telemetry.bin` so that external readers (see `scripts/read_telemetry.py`) can poll it.
+   The layout is fixed: every field is 8 bytes wide and new fields must only be appended (incrementing TELEMETRY_VERSION) */
+struct telemetry_block {
+  uint64_t magic;
+  uint64_t version;
+  uint64_t state;
+  uint64_t pid;
+  uint64_t flush_sequence;      // incremented at every flush
+  uint64_t wall_time;           // milliseconds since the start of the simulator
+  uint64_t total_payments;
+  uint64_t completed_payments;
+  uint64_t processed_events;
+  uint64_t heap_depth;
+  uint64_t current_time;        // simulation time [ms]
+  double events_per_second;     // computed over the last flush interval
+  uint64_t rss_bytes;           // resident set size estimated from /proc/self/statm
+  uint64_t dijkstra_calls;
+  uint64_t mpp_splits;
+  uint64_t group_constructions;
+  uint64_t max_heap_depth;      // the peak of heap_depth: with `stream_payments`, it stays far below the number of payments
+};
+
+/* always valid: it points to a private block when the telemetry file is not available, so that counters can be updated without checks */
+extern struct telemetry_block* telemetry;
+
+void telemetry_open(char output_dir_name[], uint64_t flush_interval);
+
+void telemetry_tick(uint64_t current_time, long heap_depth);
+
+void telemetry_flush();
+
+void telemetry_fork(char output_dir_name[], uint64_t flush_interval);
+
+void telemetry_close();
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <stdint.h>
+#include "array.h"
+#include "list.h"
+#include "cloth.h"
+#include "network.h"
+#include "event.h"
+
+/* a channel open or close of the schedule read from `topology_changes_filename` */
+struct topology_change {
+  uint64_t time;
+  long channel_id; // channel to close, -1 to open a channel
+  long node1_id; // funder of the channel to open
+  long node2_id;
+  uint64_t capacity;
+};
+
+void initialize_topology(struct network* network, struct network_params net_params);
+
+void set_topology_horizon(uint64_t last_payment_time);
+
+void schedule_topology_changes(struct simulation* simulation, uint64_t last_payment_time, struct network_params net_params);
+
+struct element* open_channel(struct event* event, struct simulation* simulation, struct network* network, struct network_params net_params, struct element* group_add_queue);
+
+struct element* close_channel(struct event* event, struct simulation* simulation, struct network* network, struct network_params net_params, struct element* group_add_queue);
+
+void free_topology();
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "network.h"
+#include "payments.h"
+#include "event.h"
+
+#define TRACE_MAGIC "CLTHTRCE"
+#define TRACE_VERSION 1
+#define TRACE_ROUTE_HOP 0xFF // type of the records describing the hops of a new route
+
+/* flags of a trace record, describing the state of the payment after the event */
+#define TRACE_PAYMENT_COMPLETED 0x1
+#define TRACE_PAYMENT_SUCCESS 0x2
+#define TRACE_PAYMENT_TIMEOUT 0x4
+#define TRACE_PAYMENT_SHARD 0x8
+
+/* an event trace is a header followed by fixed-size records, one per executed event, in order of execution.
+   The record of an event is written after the event is executed, so it contains its outcome:
+   - `edge_id`, `edge_balance`: the edge whose balance was changed by the event and its new balance (-1 if no balance was changed);
+   - `error_type`, `attempts`, `flags`: the state of the payment after the event.
+   When an event assigns a new route to a payment, the route is written before the record of the event as `n_hops` records of type TRACE_ROUTE_HOP,
+   where `attempts` is the index of the hop, `error_type` the number of hops, `node_id` the sender of the hop, `edge_balance` the amount to forward */
+struct trace_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t record_size;
+  uint64_t n_nodes;
+  uint64_t n_edges;
+};
+
+struct trace_record {
+  uint64_t time;
+  uint64_t edge_balance;
+  uint32_t payment_id;
+  uint32_t node_id;
+  int32_t edge_id;
+  uint8_t type;
+  uint8_t error_type;
+  uint8_t flags;
+  uint8_t attempts;
+};
+
+/* a trace file mapped in memory (see `trace_map`) */
+struct trace {
+  struct trace_header* header;
+  struct trace_record* records;
+  long n_records;
+  size_t size;
+};
+
+void trace_open(char filename[], struct network* network);
+
+void trace_edge_update(struct edge* edge);
+
+void trace_route(struct payment* payment);
+
+void trace_event(struct event* event);
+
+void trace_fork(char output_dir_name[]);
+
+void trace_close();
+
+struct trace* trace_map(char filename[]);
+
+void trace_unmap(struct trace* trace);
+
+char* get_trace_record_type_name(uint8_t type);
+
+#endif
@@ -17,4 +17,12 @@ int is_present(long element, struct array* long_array);
 
 int is_key_equal(struct distance* a, struct distance* b);
 
+void fenwick_add(uint64_t* tree, long n, long index, uint64_t value);
+
+uint64_t fenwick_prefix_sum(uint64_t* tree, long n_elements);
+
+long fenwick_find(uint64_t* tree, long n, uint64_t target);
+
+gsl_rng* new_substream(unsigned long seed, uint64_t stream);
+
 #endif
@@ -0,0 +1,44 @@
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include <stdint.h>
+#include "cloth.h"
+#include "network.h"
+
+#define WORKLOAD_BLOCK_SIZE 4096 // payments drawn from the same substream
+#define WORKLOAD_DIURNAL_AMPLITUDE 0.8 // relative amplitude of the payment rate of the diurnal arrivals
+#define WORKLOAD_CALM_TO_BURST_RATIO 9 // average duration of the calm periods of the bursty arrivals, relative to the bursts
+
+enum workload_pairs {
+  UNIFORM_PAIRS, // sender and receiver drawn uniformly
+  ZIPF_PAIRS, // receivers (merchants) drawn with a Zipf law over a random ranking of the nodes
+  LOCAL_PAIRS, // the receiver is the end of a random walk from the sender on the channels of the network
+  REPEAT_PAIRS // a pair of a previous payment is repeated with probability `workload_repeat_probability`
+};
+
+enum workload_amounts {
+  GAUSSIAN_AMOUNTS,
+  LOGNORMAL_AMOUNTS,
+  PARETO_AMOUNTS
+};
+
+enum workload_arrivals {
+  POISSON_ARRIVALS,
+  BURSTY_ARRIVALS, // a Poisson process whose rate is multiplied by `workload_burst_factor` during bursts
+  DIURNAL_ARRIVALS // a Poisson process whose rate follows a sinusoid of period `workload_diurnal_period`
+};
+
+/* a named generator of payments; its version changes whenever the payments it generates for the same parameters and seed change */
+struct workload_family {
+  const char* name;
+  int version;
+  enum workload_pairs pairs;
+  enum workload_amounts amounts;
+  enum workload_arrivals arrivals;
+};
+
+const struct workload_family* get_workload_family(char name[]);
+
+void generate_workload(struct payments_params pay_params, struct network* network, char filename[]);
+
+#endif
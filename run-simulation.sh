@@ -5,22 +5,28 @@ then
 fi
 
 seed="$1"
-environment_dir="$2/environment"
-result_dir="$2"
+# the repository is copied from the directory of this script; the paths are absolute, as the simulation is built and run in the copy
+source_dir="$(cd "$(dirname "$0")" && pwd)"
+mkdir -p "$2/environment"
+mkdir -p "$2/log"
+result_dir="$(cd "$2" && pwd)"
+environment_dir="$result_dir/environment"
 
-mkdir -p "$environment_dir"
-mkdir -p "$result_dir"
-mkdir -p "$result_dir/log"
+# the exit status of the simulation is written when this script exits, also if the build or the simulation fails,
+# so that the sweep scripts count the run as done (see scripts/read_telemetry.py)
+done_file="$result_dir/simulation.done"
+status=1
+trap 'echo "$status" > "$done_file"' EXIT
 
-rsync -av -q --exclude='result' --exclude='cmake-build-debug' --exclude='cloth.dSYM' --exclude='.idea' --exclude='.git' --exclude='.cmake' "." "$environment_dir"
+rsync -av -q --exclude='result' --exclude='cmake-build-debug' --exclude='cloth.dSYM' --exclude='.idea' --exclude='.git' --exclude='.cmake' --exclude='telemetry.bin' --exclude='simulation.done' "$source_dir/" "$environment_dir"
 
 for arg in "${@:3}"; do
     key="${arg%=*}"
     value="${arg#*=}"
-    sed -i -e "s/$key=.*/$key=$value/" "$environment_dir/cloth_input.txt"
+    sed -i -e "s|$key=.*|$key=$value|" "$environment_dir/cloth_input.txt"
 done
 
-cp "$environment_dir/cloth_input.txt" "$2"
+cp "$environment_dir/cloth_input.txt" "$result_dir"
 cd "$environment_dir"
 cmake . > "$result_dir/log/cmake.log" 2>&1
 make > "$result_dir/log/make.log" 2>&1
@@ -28,9 +34,9 @@ make > "$result_dir/log/make.log" 2>&1
 # save all logging for debug
 #GSL_RNG_SEED="$seed"  strace -o "$result_dir/log/strace.log" ./CLoTH_Gossip "$result_dir/" > "$result_dir/log/cloth.log" 2>&1
 GSL_RNG_SEED="$seed"  ./CLoTH_Gossip "$result_dir/" > "$result_dir/log/cloth.log" 2>&1
+status=$?
 
 cat "$result_dir/output.log"
 echo "seed=$seed" >> "$result_dir/cloth_input.txt"
-echo "1" > "$result_dir/progress.tmp"
 
 rm -Rf "$environment_dir"
@@ -6,6 +6,8 @@ if [[ "$#" -lt 1 ]]; then
 fi
 
 seed="$1"
+# the scripts of the repository are found from the directory of this script, wherever it is launched from
+script_dir="$(cd "$(dirname "$0")" && pwd)"
 
 output_dir="$2/$(date "+%Y%m%d%H%M%S")"
 mkdir "$output_dir"
@@ -41,22 +43,10 @@ function display_progress() {
     done_simulations=0
 
     while [ "$done_simulations" -lt "$total_simulations" ]; do
-        progress_summary=""
-        total_progress=0
-
         # read each simulation progresses
-        IFS=$'\n' read -r -d '' -a simulation_progress_files <<< $(find "$output_dir" -type f -name "progress.tmp")
-        done_simulations=0
-        for file in "${simulation_progress_files[@]}"; do
-            progress=$(cat "$file")
-            if [ "$progress" = "1" ]; then
-              done_simulations=$((done_simulations + 1))
-            elif [ "$progress" = "" ]; then
-              progress="0"
-            fi
-            total_progress=$(printf "%.5f" "$(echo "scale=4; $total_progress + $progress / $total_simulations" | bc)")
-            progress_summary="$progress_summary$(printf "%3d%% %s" "$(printf "%.0f" "$(echo "$progress*100" | bc)")" "$file")\n"
-        done
+        telemetry_summary=$(python3 "$script_dir/scripts/read_telemetry.py" "$output_dir" "$total_simulations")
+        read -r _ total_progress done_simulations _ <<< "$(echo "$telemetry_summary" | tail -n 1)"
+        progress_summary="$(echo "$telemetry_summary" | head -n -1)\n"
 
         # build progress bar
         progress_bar_len=$(printf "%0.s#" $(seq 1 $(printf "%.0f" "$(echo "$total_progress * 100 / 2" | bc)")))
@@ -78,9 +68,9 @@ function display_progress() {
 
 for i in $(seq 2 1 20); do
     for j in $(seq 0 0.05 1.0); do
-        enqueue_simulation "./run-simulation.sh $seed $output_dir/routing_method=group_routing/avg_pmt_amt=1000/group_size=$i/group_limit_rate=$j      n_payments=5000 mpp=0 payment_timeout=-1 routing_method=group_routing group_cap_update=true average_payment_amount=1000    variance_payment_amount=100    group_size=$i  group_limit_rate=$j"
-        enqueue_simulation "./run-simulation.sh $seed $output_dir/routing_method=group_routing/avg_pmt_amt=10000/group_size=$i/group_limit_rate=$j     n_payments=5000 mpp=0 payment_timeout=-1 routing_method=group_routing group_cap_update=true average_payment_amount=10000   variance_payment_amount=1000   group_size=$i  group_limit_rate=$j"
-        enqueue_simulation "./run-simulation.sh $seed $output_dir/routing_method=group_routing/avg_pmt_amt=100000/group_size=$i/group_limit_rate=$j    n_payments=5000 mpp=0 payment_timeout=-1 routing_method=group_routing group_cap_update=true average_payment_amount=100000  variance_payment_amount=10000  group_size=$i  group_limit_rate=$j"
+        enqueue_simulation "$script_dir/run-simulation.sh $seed $output_dir/routing_method=group_routing/avg_pmt_amt=1000/group_size=$i/group_limit_rate=$j      n_payments=5000 mpp=0 payment_timeout=-1 routing_method=group_routing group_cap_update=true average_payment_amount=1000    variance_payment_amount=100    group_size=$i  group_limit_rate=$j"
+        enqueue_simulation "$script_dir/run-simulation.sh $seed $output_dir/routing_method=group_routing/avg_pmt_amt=10000/group_size=$i/group_limit_rate=$j     n_payments=5000 mpp=0 payment_timeout=-1 routing_method=group_routing group_cap_update=true average_payment_amount=10000   variance_payment_amount=1000   group_size=$i  group_limit_rate=$j"
+        enqueue_simulation "$script_dir/run-simulation.sh $seed $output_dir/routing_method=group_routing/avg_pmt_amt=100000/group_size=$i/group_limit_rate=$j    n_payments=5000 mpp=0 payment_timeout=-1 routing_method=group_routing group_cap_update=true average_payment_amount=100000  variance_payment_amount=10000  group_size=$i  group_limit_rate=$j"
     done
 done
 # Process the queue
@@ -91,7 +81,7 @@ while [ "${#queue[@]}" -gt 0 ] || [ "$running_processes" -gt 0 ]; do
 done
 wait
 echo -e "\nAll simulations have completed. \nOutputs saved at $output_dir"
-python3 scripts/analyze_output.py "$output_dir"
+python3 "$script_dir/scripts/analyze_output.py" "$output_dir"
 end_time=$(date +%s)
 echo "START : $(date --date @"$start_time")"
 echo "  END : $(date --date @"$end_time")"
@@ -0,0 +1,138 @@
+import os
+import struct
+import sys
+
+# Reader of the status blocks (`telemetry.bin`) published by running simulations (see include/telemetry.h).
+# A simulation is done when its block is FINISHED, when its process is gone, or when run-simulation.sh wrote the exit status of the run
+# in `simulation.done` (also for runs that failed before creating their block, e.g. because of a build error or a wrong input).
+# It prints one line per simulation found under <output_dir> and a last line
+#   TOTAL <total_progress> <done_simulations> <n_simulations>
+# which is parsed by the run_all_simulations_*.sh scripts.
+# With --max-heap-depth=<n>, it exits with status 2 if the peak depth of the event heap of a simulation exceeded <n>
+# (e.g., to check that a run with stream_payments=true does not hold all its payments in the heap).
+
+TELEMETRY_MAGIC = b"CLTHTELM"
+TELEMETRY_VERSION = 2
+TELEMETRY_FILENAME = "telemetry.bin"
+DONE_FILENAME = "simulation.done"
+TELEMETRY_FIELDS = [
+    ("magic", "8s"),
+    ("version", "Q"),
+    ("state", "Q"),
+    ("pid", "Q"),
+    ("flush_sequence", "Q"),
+    ("wall_time", "Q"),
+    ("total_payments", "Q"),
+    ("completed_payments", "Q"),
+    ("processed_events", "Q"),
+    ("heap_depth", "Q"),
+    ("current_time", "Q"),
+    ("events_per_second", "d"),
+    ("rss_bytes", "Q"),
+    ("dijkstra_calls", "Q"),
+    ("mpp_splits", "Q"),
+    ("group_constructions", "Q"),
+    ("max_heap_depth", "Q"),
+]
+TELEMETRY_FORMAT = "<" + "".join(f for _, f in TELEMETRY_FIELDS)
+TELEMETRY_STATES = ["INITIALIZING", "RUNNING", "FINISHED"]
+TELEMETRY_FINISHED = 2
+
+
+def read_telemetry(filename):
+    with open(filename, "rb") as f:
+        data = f.read(struct.calcsize(TELEMETRY_FORMAT))
+    if len(data) < struct.calcsize(TELEMETRY_FORMAT):
+        return None
+    block = dict(zip([name for name, _ in TELEMETRY_FIELDS], struct.unpack(TELEMETRY_FORMAT, data)))
+    if block["magic"] != TELEMETRY_MAGIC or block["version"] != TELEMETRY_VERSION:
+        return None
+    return block
+
+
+def is_process_alive(pid):
+    try:
+        os.kill(pid, 0)
+    except ProcessLookupError:
+        return False
+    except PermissionError:
+        return True
+    return True
+
+
+def get_progress(block):
+    # a simulation whose process is gone is considered done, so that a crashed run does not block the sweep
+    if block["state"] == TELEMETRY_FINISHED or not is_process_alive(block["pid"]):
+        return 1.0, True
+    if block["total_payments"] == 0:
+        return 0.0, False
+    return min(block["completed_payments"] / block["total_payments"], 1.0), False
+
+
+def read_exit_status(filename):
+    try:
+        with open(filename) as f:
+            return int(f.read().strip() or -1)
+    except (OSError, ValueError):
+        return None
+
+
+def find_simulation_dirs(output_dir):
+    for root, _, files in os.walk(output_dir):
+        if TELEMETRY_FILENAME in files or DONE_FILENAME in files:
+            yield root
+
+
+if __name__ == "__main__":
+    max_heap_depth = None
+    args = []
+    for arg in sys.argv[1:]:
+        if arg.startswith("--max-heap-depth="):
+            max_heap_depth = int(arg.split("=", 1)[1])
+        else:
+            args.append(arg)
+    if len(args) < 1:
+        print("python3 read_telemetry.py <output_dir> [n_simulations] [--max-heap-depth=<n>]")
+        exit(1)
+    output_dir = args[0]
+
+    simulations = []
+    for simulation_dir in sorted(find_simulation_dirs(output_dir)):
+        block = read_telemetry(os.path.join(simulation_dir, TELEMETRY_FILENAME)) if os.path.exists(os.path.join(simulation_dir, TELEMETRY_FILENAME)) else None
+        exit_status = read_exit_status(os.path.join(simulation_dir, DONE_FILENAME))
+        if block is not None or exit_status is not None:
+            simulations.append((simulation_dir, block, exit_status))
+
+    n_simulations = int(args[1]) if len(args) > 1 else len(simulations)
+    total_progress = 0.0
+    done_simulations = 0
+    exceeded_heap_depth = []
+    for simulation_dir, block, exit_status in simulations:
+        if block is None:
+            # the run ended before publishing its block
+            progress, done = 1.0, True
+        else:
+            progress, done = get_progress(block)
+            if exit_status is not None:
+                progress, done = 1.0, True
+        if done:
+            done_simulations += 1
+        if n_simulations > 0:
+            total_progress += progress / n_simulations
+        if block is None:
+            print("%3d%% %-12s exit_status=%d %s" % (progress * 100, "FAILED", exit_status, simulation_dir))
+            continue
+        state = TELEMETRY_STATES[block["state"]] if block["state"] < len(TELEMETRY_STATES) else "UNKNOWN"
+        if exit_status is not None and exit_status != 0:
+            state = "FAILED"
+        if max_heap_depth is not None and block["max_heap_depth"] > max_heap_depth:
+            exceeded_heap_depth.append((simulation_dir, block["max_heap_depth"]))
+        print("%3d%% %-12s events/s=%-10.0f heap=%-8d max_heap=%-8d sim_time=%-10d rss=%dMB dijkstra=%d mpp_splits=%d group_constructions=%d %s" % (
+            progress * 100, state, block["events_per_second"], block["heap_depth"], block["max_heap_depth"], block["current_time"],
+            block["rss_bytes"] // (1024 * 1024), block["dijkstra_calls"], block["mpp_splits"],
+            block["group_constructions"], simulation_dir))
+    print("TOTAL %.5f %d %d" % (total_progress, done_simulations, n_simulations))
+    for simulation_dir, depth in exceeded_heap_depth:
+        print("ERROR: peak heap depth %d exceeds %d in %s" % (depth, max_heap_depth, simulation_dir), file=sys.stderr)
+    if exceeded_heap_depth:
+        exit(2)
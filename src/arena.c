@@ -0,0 +1,69 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/arena.h"
+
+/* Functions in this file implement the arenas where the entities of a network are allocated (see network.c) */
+
+
+static struct arena_chunk* new_arena_chunk(size_t size, struct arena_chunk* next) {
+  struct arena_chunk* chunk;
+  chunk = malloc(sizeof(struct arena_chunk));
+  if(chunk != NULL) chunk->data = malloc(size);
+  if(chunk == NULL || chunk->data == NULL) {
+    fprintf(stderr, "ERROR: malloc failed for an arena chunk of %zu bytes\n", size);
+    exit(-1);
+  }
+  chunk->size = size;
+  chunk->used = 0;
+  chunk->next = next;
+  return chunk;
+}
+
+
+struct arena* arena_initialize(size_t chunk_size) {
+  struct arena* arena;
+  arena = malloc(sizeof(struct arena));
+  arena->chunk_size = chunk_size;
+  arena->chunks = NULL;
+  arena->allocated = 0;
+  return arena;
+}
+
+
+/* allocate `size` bytes (uninitialized), aligned to ARENA_ALIGNMENT */
+void* arena_alloc(struct arena* arena, size_t size) {
+  struct arena_chunk* chunk;
+  void* record;
+
+  size = (size + ARENA_ALIGNMENT - 1) & ~((size_t)ARENA_ALIGNMENT - 1);
+  chunk = arena->chunks;
+  if(chunk == NULL || chunk->used + size > chunk->size) {
+    // a record larger than a quarter of a chunk gets a chunk of its own, placed after the current one so that the latter is still filled
+    if(size > arena->chunk_size/4 && chunk != NULL) {
+      chunk->next = new_arena_chunk(size, chunk->next);
+      chunk = chunk->next;
+    }
+    else {
+      arena->chunks = new_arena_chunk(size > arena->chunk_size ? size : arena->chunk_size, arena->chunks);
+      chunk = arena->chunks;
+    }
+  }
+  record = chunk->data + chunk->used;
+  chunk->used += size;
+  arena->allocated += size;
+  return record;
+}
+
+
+/* free all the records of the arena at once */
+void arena_free(struct arena* arena) {
+  struct arena_chunk* chunk, *next;
+  for(chunk = arena->chunks; chunk != NULL; chunk = next) {
+    next = chunk->next;
+    free(chunk->data);
+    free(chunk);
+  }
+  free(arena);
+}
@@ -0,0 +1,201 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "../include/array.h"
+#include "../include/network.h"
+#include "../include/payments.h"
+#include "../include/routing.h"
+#include "../include/telemetry.h"
+#include "../include/attempt_log.h"
+
+/* Functions in this file record the attempts of the payments in the attempt log (see attempt_log.h), which replaces a list of
+   allocated attempts per payment, each with an allocated snapshot per hop. The log is a single one for the simulation */
+
+static struct attempt_log attempt_log;
+
+
+void initialize_attempt_log(enum attempt_log_level level) {
+  memset(&attempt_log, 0, sizeof(struct attempt_log));
+  attempt_log.level = level;
+}
+
+
+enum attempt_log_level get_attempt_log_level() {
+  return attempt_log.level;
+}
+
+
+static void grow_block_tables(long block) {
+  long n_blocks;
+  if(block < attempt_log.n_blocks) return;
+  n_blocks = attempt_log.n_blocks > 0 ? 2*attempt_log.n_blocks : 64;
+  while(n_blocks <= block) n_blocks *= 2;
+  attempt_log.attempt_blocks = realloc(attempt_log.attempt_blocks, sizeof(struct attempt*)*n_blocks);
+  attempt_log.hop_blocks = realloc(attempt_log.hop_blocks, sizeof(struct edge_snapshot*)*n_blocks);
+  attempt_log.n_live_attempts = realloc(attempt_log.n_live_attempts, sizeof(long)*n_blocks);
+  attempt_log.n_live_hops = realloc(attempt_log.n_live_hops, sizeof(long)*n_blocks);
+  memset(attempt_log.attempt_blocks + attempt_log.n_blocks, 0, sizeof(struct attempt*)*(n_blocks - attempt_log.n_blocks));
+  memset(attempt_log.hop_blocks + attempt_log.n_blocks, 0, sizeof(struct edge_snapshot*)*(n_blocks - attempt_log.n_blocks));
+  memset(attempt_log.n_live_attempts + attempt_log.n_blocks, 0, sizeof(long)*(n_blocks - attempt_log.n_blocks));
+  memset(attempt_log.n_live_hops + attempt_log.n_blocks, 0, sizeof(long)*(n_blocks - attempt_log.n_blocks));
+  attempt_log.n_blocks = n_blocks;
+}
+
+
+/* the blocks before the one being filled are freed when they have no live record */
+static void free_attempt_block(long block) {
+  if(block < attempt_log.n_attempts/ATTEMPT_LOG_BLOCK_SIZE && attempt_log.n_live_attempts[block] == 0) {
+    free(attempt_log.attempt_blocks[block]);
+    attempt_log.attempt_blocks[block] = NULL;
+  }
+}
+
+
+static void free_hop_block(long block) {
+  if(block < attempt_log.n_hops/ATTEMPT_LOG_BLOCK_SIZE && attempt_log.n_live_hops[block] == 0) {
+    free(attempt_log.hop_blocks[block]);
+    attempt_log.hop_blocks[block] = NULL;
+  }
+}
+
+
+/* the hops of an attempt are not split between two blocks: if they do not fit in the rest of the current block, they start the next one */
+static long new_hops(long n_hops) {
+  long block, first_hop;
+
+  if(n_hops > ATTEMPT_LOG_BLOCK_SIZE) {
+    fprintf(stderr, "ERROR: a route of %ld hops does not fit in a block of the attempt log\n", n_hops);
+    exit(-1);
+  }
+  if(attempt_log.n_hops%ATTEMPT_LOG_BLOCK_SIZE + n_hops > ATTEMPT_LOG_BLOCK_SIZE)
+    attempt_log.n_hops = (attempt_log.n_hops/ATTEMPT_LOG_BLOCK_SIZE + 1)*ATTEMPT_LOG_BLOCK_SIZE;
+  block = attempt_log.n_hops/ATTEMPT_LOG_BLOCK_SIZE;
+  grow_block_tables(block);
+  if(attempt_log.hop_blocks[block] == NULL) {
+    attempt_log.hop_blocks[block] = malloc(sizeof(struct edge_snapshot)*ATTEMPT_LOG_BLOCK_SIZE);
+    if(block > 0 && attempt_log.hop_blocks[block - 1] != NULL) free_hop_block(block - 1);
+  }
+  first_hop = attempt_log.n_hops;
+  attempt_log.n_hops += n_hops;
+  attempt_log.n_live_hops[block] += n_hops;
+  return first_hop;
+}
+
+
+/* append an attempt as the last one of `payment`, with room for the snapshots of `n_hops` hops (none below ATTEMPT_LOG_FULL);
+   the fields are set by the caller */
+struct attempt* new_attempt(struct payment* payment, long n_hops) {
+  struct attempt* attempt;
+  long index, block;
+
+  index = attempt_log.n_attempts;
+  block = index/ATTEMPT_LOG_BLOCK_SIZE;
+  grow_block_tables(block);
+  if(attempt_log.attempt_blocks[block] == NULL) {
+    attempt_log.attempt_blocks[block] = malloc(sizeof(struct attempt)*ATTEMPT_LOG_BLOCK_SIZE);
+    if(block > 0 && attempt_log.attempt_blocks[block - 1] != NULL) free_attempt_block(block - 1);
+  }
+  attempt_log.n_attempts++;
+  attempt_log.n_live_attempts[block]++;
+
+  attempt = attempt_log.attempt_blocks[block] + index%ATTEMPT_LOG_BLOCK_SIZE;
+  attempt->payment_id = payment->id;
+  attempt->previous = payment->last_attempt;
+  payment->last_attempt = index;
+  attempt->n_hops = attempt_log.level == ATTEMPT_LOG_FULL ? n_hops : 0;
+  attempt->first_hop = attempt->n_hops > 0 ? new_hops(attempt->n_hops) : -1;
+  return attempt;
+}
+
+
+struct attempt* get_attempt(long index) {
+  return attempt_log.attempt_blocks[index/ATTEMPT_LOG_BLOCK_SIZE] + index%ATTEMPT_LOG_BLOCK_SIZE;
+}
+
+
+struct edge_snapshot* get_attempt_hop(struct attempt* attempt, long i) {
+  long index = attempt->first_hop + i;
+  return attempt_log.hop_blocks[index/ATTEMPT_LOG_BLOCK_SIZE] + index%ATTEMPT_LOG_BLOCK_SIZE;
+}
+
+
+void add_attempt_history(struct payment* pmt, struct network* network, uint64_t time, short is_succeeded){
+  struct attempt* attempt;
+  struct route_hop* route_hop;
+  struct edge* edge;
+  long i, route_len;
+
+  route_len = pmt->route->n_hops;
+  attempt = new_attempt(pmt, route_len);
+  attempt->attempts = pmt->attempts;
+  attempt->end_time = time;
+  if(is_succeeded){
+    attempt->error_edge_id = 0;
+    attempt->error_type = NOERROR;
+  }else{
+    attempt->error_edge_id = pmt->error.hop->edge_id;
+    attempt->error_type = pmt->error.type;
+  }
+  attempt->is_succeeded = is_succeeded;
+  attempt->is_split = 0;
+  attempt->shard1_id = -1;
+  attempt->shard2_id = -1;
+
+  for(i = 0; i < attempt->n_hops; i++){
+    route_hop = &(pmt->route->hops[i]);
+    edge = array_get(network->edges, route_hop->edge_id);
+    take_edge_snapshot(get_attempt_hop(attempt, i), edge, route_hop->amount_to_forward, edge->group != NULL, route_hop->group_cap);
+  }
+}
+
+
+void add_split_history(struct payment* pmt, uint64_t time, long shard1_id, long shard2_id){
+  struct attempt* attempt;
+  telemetry->mpp_splits++;
+  attempt = new_attempt(pmt, 0);
+  attempt->attempts = pmt->attempts;
+  attempt->end_time = time;
+  attempt->error_edge_id = 0;
+  attempt->error_type = NOERROR;
+  attempt->is_succeeded = 0;
+  attempt->is_split = 1;
+  attempt->shard1_id = shard1_id;
+  attempt->shard2_id = shard2_id;
+}
+
+
+/* called when a payment is freed: the blocks whose records are all released are freed */
+void release_attempts(struct payment* payment) {
+  struct attempt* attempt;
+  long index, previous, block;
+
+  for(index = payment->last_attempt; index != -1; index = previous) {
+    attempt = get_attempt(index);
+    previous = attempt->previous;
+    if(attempt->n_hops > 0) {
+      block = attempt->first_hop/ATTEMPT_LOG_BLOCK_SIZE;
+      attempt_log.n_live_hops[block] -= attempt->n_hops;
+      free_hop_block(block);
+    }
+    block = index/ATTEMPT_LOG_BLOCK_SIZE;
+    attempt_log.n_live_attempts[block]--;
+    free_attempt_block(block);
+  }
+  payment->last_attempt = -1;
+}
+
+
+void free_attempt_log() {
+  long i;
+  for(i = 0; i < attempt_log.n_blocks; i++) {
+    free(attempt_log.attempt_blocks[i]);
+    free(attempt_log.hop_blocks[i]);
+  }
+  free(attempt_log.attempt_blocks);
+  free(attempt_log.hop_blocks);
+  free(attempt_log.n_live_attempts);
+  free(attempt_log.n_live_hops);
+  memset(&attempt_log, 0, sizeof(struct attempt_log));
+}
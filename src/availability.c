@@ -0,0 +1,168 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <gsl/gsl_rng.h>
+#include <gsl/gsl_randist.h>
+
+#include "../include/availability.h"
+#include "../include/arena.h"
+#include "../include/csv.h"
+#include "../include/utils.h"
+
+/* Functions in this file build the availability schedules of the nodes: the intervals in which a node is offline are read from a csv file
+   (`node_availability_filename`) and/or generated by alternating exponential online and offline times (`average_node_online_time`,
+   `average_node_offline_time`). A node that is offline when an HTLC should be forwarded to it fails the payment as with `faulty_node_probability`,
+   which is not used when the schedules are enabled: no random draw is made per hop, so the availability of the nodes does not depend on the routes.
+   The schedules are generated from substreams of the seed of the simulation indexed by the input node id, so they are the same for any
+   routing method and network ordering */
+
+
+struct offline_interval {
+  long node_id;
+  uint64_t start;
+  uint64_t end;
+};
+
+struct interval_buffer {
+  struct offline_interval* intervals;
+  long n;
+  long size;
+};
+
+
+static void add_interval(struct interval_buffer* buffer, long node_id, uint64_t start, uint64_t end) {
+  if(buffer->n == buffer->size) {
+    buffer->size = buffer->size > 0 ? 2*buffer->size : 1024;
+    buffer->intervals = realloc(buffer->intervals, sizeof(struct offline_interval)*buffer->size);
+  }
+  buffer->intervals[buffer->n].node_id = node_id;
+  buffer->intervals[buffer->n].start = start;
+  buffer->intervals[buffer->n].end = end;
+  buffer->n++;
+}
+
+
+static int compare_interval(const void* a, const void* b) {
+  const struct offline_interval* x = a, *y = b;
+  if(x->node_id != y->node_id) return x->node_id < y->node_id ? -1 : 1;
+  return (x->start > y->start) - (x->start < y->start);
+}
+
+
+/* rows `node_id,offline_start,offline_end` (milliseconds), with ids of the input network */
+static void read_offline_intervals(char filename[], struct network* network, struct interval_buffer* buffer) {
+  struct csv_table* table;
+  union csv_value* row;
+  long i, n_nodes;
+
+  table = csv_read(filename, "iii", 3, NULL);
+  n_nodes = array_len(network->nodes);
+  for(i = 0; i < table->n_rows; i++) {
+    row = table->values + i*table->n_columns;
+    if(row[0].integer < 0 || row[0].integer >= n_nodes || row[1].integer < 0 || row[2].integer <= row[1].integer) {
+      fprintf(stderr, "ERROR: wrong offline interval in row %ld of <%s>: a node of the network and an end time greater than the start time are required\n", i + 1, filename);
+      exit(-1);
+    }
+    add_interval(buffer, get_renumbered_id(network->node_map, row[0].integer), row[1].integer, row[2].integer);
+  }
+  csv_free(table);
+}
+
+
+/* alternate online and offline times with exponential durations up to `horizon`; at time 0 a node is offline with the stationary probability */
+static void generate_offline_intervals(struct network* network, double average_online_time, double average_offline_time, uint64_t horizon, struct interval_buffer* buffer) {
+  long i, n_nodes, node_id;
+  gsl_rng* random_generator;
+  uint64_t time, offline_time;
+  unsigned int is_offline;
+
+  n_nodes = array_len(network->nodes);
+  for(i = 0; i < n_nodes; i++) {
+    node_id = get_renumbered_id(network->node_map, i);
+    random_generator = new_substream(gsl_rng_default_seed, i);
+    is_offline = gsl_rng_uniform(random_generator) < average_offline_time/(average_online_time + average_offline_time);
+    time = 0;
+    while(time <= horizon) {
+      if(is_offline) {
+        offline_time = 1000*gsl_ran_exponential(random_generator, average_offline_time);
+        if(offline_time > 0) add_interval(buffer, node_id, time, time + offline_time);
+        time += offline_time;
+      }
+      else
+        time += 1000*gsl_ran_exponential(random_generator, average_online_time);
+      is_offline = !is_offline;
+    }
+    gsl_rng_free(random_generator);
+  }
+}
+
+
+/* the intervals of each node are stored in the data arena, merging the ones that overlap */
+static void set_offline_intervals(struct network* network, struct interval_buffer* buffer) {
+  long i, j, k, n;
+  struct node* node;
+  uint64_t* intervals;
+
+  qsort(buffer->intervals, buffer->n, sizeof(struct offline_interval), compare_interval);
+  for(i = 0; i < buffer->n; i = j) {
+    for(j = i; j < buffer->n && buffer->intervals[j].node_id == buffer->intervals[i].node_id; j++);
+    node = array_get(network->nodes, buffer->intervals[i].node_id);
+    intervals = arena_alloc(network->data_arena, 2*(j - i)*sizeof(uint64_t));
+    n = 0;
+    intervals[0] = buffer->intervals[i].start;
+    intervals[1] = buffer->intervals[i].end;
+    for(k = i + 1; k < j; k++) {
+      if(buffer->intervals[k].start <= intervals[2*n + 1]) {
+        if(buffer->intervals[k].end > intervals[2*n + 1]) intervals[2*n + 1] = buffer->intervals[k].end;
+        continue;
+      }
+      n++;
+      intervals[2*n] = buffer->intervals[k].start;
+      intervals[2*n + 1] = buffer->intervals[k].end;
+    }
+    node->offline_intervals = intervals;
+    node->n_offline_intervals = n + 1;
+  }
+}
+
+
+/* the schedules are generated up to the start of the last payment plus the payment timeout (or one hour if there is no timeout);
+   after that, nodes are online */
+void initialize_availability(struct network* network, struct network_params net_params, uint64_t last_payment_time) {
+  struct interval_buffer buffer;
+  uint64_t horizon;
+  unsigned int is_generated;
+
+  is_generated = net_params.average_node_online_time > 0 && net_params.average_node_offline_time > 0;
+  if(strcmp(net_params.node_availability_filename, "") == 0 && !is_generated) return;
+
+  memset(&buffer, 0, sizeof(struct interval_buffer));
+  if(strcmp(net_params.node_availability_filename, "") != 0)
+    read_offline_intervals(net_params.node_availability_filename, network, &buffer);
+  if(is_generated) {
+    horizon = last_payment_time + (net_params.payment_timeout != (unsigned int)-1 ? net_params.payment_timeout : 3600000U);
+    generate_offline_intervals(network, net_params.average_node_online_time, net_params.average_node_offline_time, horizon, &buffer);
+  }
+  set_offline_intervals(network, &buffer);
+  free(buffer.intervals);
+
+  network->has_availability = 1;
+  network->skip_offline_nodes = net_params.routing_skip_offline_nodes;
+}
+
+
+/* binary search of the last interval starting not after `time` */
+int is_node_offline(struct node* node, uint64_t time) {
+  uint32_t low, high, middle;
+  low = 0;
+  high = node->n_offline_intervals;
+  while(low < high) {
+    middle = (low + high)/2;
+    if(node->offline_intervals[2*middle] <= time)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+  return low > 0 && time < node->offline_intervals[2*(low - 1) + 1];
+}
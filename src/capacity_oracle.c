@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "../include/array.h"
+#include "../include/network.h"
+#include "../include/capacity_oracle.h"
+
+/* Functions in this file answer whether a path exists whose channels have at least a given capacity (see capacity_oracle.h).
+   With CLOTH_ORIGINAL (and IDEAL) routing, a hop needs a channel capacity of at least the amount to send, so a payment
+   between nodes whose maximum path capacity is lower than its amount fails with NOPATH without running dijkstra */
+
+#define NO_PARENT UINT32_MAX
+
+
+struct capacity_item {
+  uint64_t capacity;
+  long channel_id;
+};
+
+
+static int compare_capacity_item(const void* a, const void* b) {
+  const struct capacity_item* x = a, *y = b;
+  if(x->capacity != y->capacity) return x->capacity > y->capacity ? -1 : 1;
+  return (x->channel_id > y->channel_id) - (x->channel_id < y->channel_id);
+}
+
+
+static long find_component(long* component, long node_id) {
+  long root, next;
+  for(root = node_id; component[root] != root; root = component[root]);
+  for(; node_id != root; node_id = next) {
+    next = component[node_id];
+    component[node_id] = root;
+  }
+  return root;
+}
+
+
+/* the open channels are joined in decreasing order of capacity (Kruskal): each join of two components adds an internal node
+   that is the parent of the tops of the two components */
+static long build_kruskal_tree(struct network* network, struct capacity_oracle* oracle) {
+  long n_nodes, n_channels, n_items, i, n_tree_nodes, component1, component2, *top;
+  struct capacity_item* items;
+  struct channel* channel;
+
+  n_nodes = oracle->n_nodes;
+  n_channels = array_len(network->channels);
+  items = malloc(sizeof(struct capacity_item)*(n_channels > 0 ? n_channels : 1));
+  n_items = 0;
+  for(i = 0; i < n_channels; i++) {
+    channel = array_get(network->channels, i);
+    if(channel->is_closed || channel->node1 == channel->node2) continue;
+    items[n_items].capacity = channel->capacity;
+    items[n_items].channel_id = i;
+    n_items++;
+  }
+  qsort(items, n_items, sizeof(struct capacity_item), compare_capacity_item);
+
+  top = malloc(sizeof(long)*(n_nodes > 0 ? n_nodes : 1));
+  for(i = 0; i < n_nodes; i++) {
+    oracle->component[i] = i;
+    top[i] = i;
+  }
+  for(i = 0; i < 2*n_nodes; i++)
+    oracle->parent[i] = NO_PARENT;
+
+  n_tree_nodes = n_nodes;
+  for(i = 0; i < n_items && n_tree_nodes < 2*n_nodes - 1; i++) {
+    channel = array_get(network->channels, items[i].channel_id);
+    component1 = find_component(oracle->component, channel->node1);
+    component2 = find_component(oracle->component, channel->node2);
+    if(component1 == component2) continue;
+    oracle->parent[top[component1]] = n_tree_nodes;
+    oracle->parent[top[component2]] = n_tree_nodes;
+    oracle->capacity[n_tree_nodes - n_nodes] = items[i].capacity;
+    oracle->component[component2] = component1;
+    top[component1] = n_tree_nodes;
+    n_tree_nodes++;
+  }
+  for(i = 0; i < n_nodes; i++)
+    find_component(oracle->component, i);
+
+  free(items);
+  free(top);
+  return n_tree_nodes;
+}
+
+
+/* the parent of a tree node has a greater id, so sizes are summed in increasing order of id and depths and heads are set in decreasing order */
+static void decompose_kruskal_tree(struct capacity_oracle* oracle, long n_tree_nodes) {
+  long i;
+  uint32_t *size, *heavy;
+
+  size = malloc(sizeof(uint32_t)*n_tree_nodes);
+  heavy = malloc(sizeof(uint32_t)*n_tree_nodes);
+  for(i = 0; i < n_tree_nodes; i++) {
+    size[i] = 1;
+    heavy[i] = NO_PARENT;
+  }
+  for(i = 0; i < n_tree_nodes; i++) {
+    if(oracle->parent[i] == NO_PARENT) continue;
+    size[oracle->parent[i]] += size[i];
+    if(heavy[oracle->parent[i]] == NO_PARENT || size[heavy[oracle->parent[i]]] < size[i])
+      heavy[oracle->parent[i]] = i;
+  }
+  for(i = n_tree_nodes - 1; i >= 0; i--) {
+    if(oracle->parent[i] == NO_PARENT) {
+      oracle->depth[i] = 0;
+      oracle->head[i] = i;
+      continue;
+    }
+    oracle->depth[i] = oracle->depth[oracle->parent[i]] + 1;
+    oracle->head[i] = heavy[oracle->parent[i]] == i ? oracle->head[oracle->parent[i]] : i;
+  }
+
+  free(size);
+  free(heavy);
+}
+
+
+struct capacity_oracle* new_capacity_oracle(struct network* network) {
+  struct capacity_oracle* oracle;
+  long n_nodes, n_tree_nodes;
+
+  n_nodes = array_len(network->nodes);
+  oracle = malloc(sizeof(struct capacity_oracle));
+  oracle->n_nodes = n_nodes;
+  oracle->component = malloc(sizeof(long)*(n_nodes > 0 ? n_nodes : 1));
+  oracle->parent = malloc(sizeof(uint32_t)*(n_nodes > 0 ? 2*n_nodes : 1));
+  oracle->depth = malloc(sizeof(uint32_t)*(n_nodes > 0 ? 2*n_nodes : 1));
+  oracle->head = malloc(sizeof(uint32_t)*(n_nodes > 0 ? 2*n_nodes : 1));
+  oracle->capacity = malloc(sizeof(uint64_t)*(n_nodes > 0 ? n_nodes : 1));
+  oracle->is_stale = 0;
+  n_tree_nodes = build_kruskal_tree(network, oracle);
+  decompose_kruskal_tree(oracle, n_tree_nodes);
+  return oracle;
+}
+
+
+/* called when channels are opened during the simulation: the maximum capacity of a path can grow, so the oracle must be rebuilt
+   before it rejects a payment. Closed channels do not invalidate it, as the capacities it
+   returns are still upper bounds */
+void invalidate_capacity_oracle(struct network* network) {
+  network->capacity_oracle->is_stale = 1;
+}
+
+
+/* UINT64_MAX if source and target are the same node, 0 if they are not connected */
+uint64_t get_max_path_capacity(struct capacity_oracle* oracle, long source, long target) {
+  uint32_t u, v;
+
+  if(source == target) return UINT64_MAX;
+  if(oracle->component[source] != oracle->component[target]) return 0;
+  u = source;
+  v = target;
+  while(oracle->head[u] != oracle->head[v]) {
+    if(oracle->depth[oracle->head[u]] > oracle->depth[oracle->head[v]])
+      u = oracle->parent[oracle->head[u]];
+    else
+      v = oracle->parent[oracle->head[v]];
+  }
+  if(oracle->depth[v] < oracle->depth[u]) u = v;
+  return oracle->capacity[u - oracle->n_nodes];
+}
+
+
+/* rebuild the oracle if it is stale; it is called by run_dijkstra_jobs before its threads start, so that the oracle is never stale
+   (and never rebuilt by has_capacity_path) while path finding runs in multiple threads */
+void refresh_capacity_oracle(struct network* network) {
+  if(!network->capacity_oracle->is_stale) return;
+  free_capacity_oracle(network->capacity_oracle);
+  network->capacity_oracle = new_capacity_oracle(network);
+}
+
+
+/* whether the capacity of a path between source and target can be at least `amount`; a stale oracle is rebuilt only when it
+   would return false, which is rare, instead of after each channel opened. The oracle can be stale only on the single-threaded
+   path of the events (see refresh_capacity_oracle) */
+int has_capacity_path(struct network* network, long source, long target, uint64_t amount) {
+  if(get_max_path_capacity(network->capacity_oracle, source, target) >= amount) return 1;
+  if(!network->capacity_oracle->is_stale) return 0;
+  refresh_capacity_oracle(network);
+  return get_max_path_capacity(network->capacity_oracle, source, target) >= amount;
+}
+
+
+void free_capacity_oracle(struct capacity_oracle* oracle) {
+  if(oracle == NULL) return;
+  free(oracle->component);
+  free(oracle->parent);
+  free(oracle->depth);
+  free(oracle->head);
+  free(oracle->capacity);
+  free(oracle);
+}
@@ -0,0 +1,871 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <gsl/gsl_rng.h>
+
+#include "../include/checkpoint.h"
+#include "../include/array.h"
+#include "../include/heap.h"
+#include "../include/list.h"
+#include "../include/network.h"
+#include "../include/network_core.h"
+#include "../include/capacity_oracle.h"
+#include "../include/payments.h"
+#include "../include/payment_trace.h"
+#include "../include/attempt_log.h"
+#include "../include/routing.h"
+#include "../include/htlc.h"
+#include "../include/event.h"
+#include "../include/telemetry.h"
+
+/* Functions in this file save the state of a simulation in a binary checkpoint and restore a simulation from it.
+   Values are written with fixed widths in the byte order of the machine; lists are written from head to tail and rebuilt in the same order;
+   pointers are replaced by the ids of the pointed elements (payments, edges, groups) or by the index of the pointed route hop */
+
+
+static char* checkpoint_filename;
+
+
+static void write_value(FILE* file, const void* value, size_t size) {
+  if(fwrite(value, size, 1, file) != 1) {
+    fprintf(stderr, "ERROR: cannot write checkpoint <%s>\n", checkpoint_filename);
+    exit(-1);
+  }
+}
+
+static void read_value(FILE* file, void* value, size_t size) {
+  if(fread(value, size, 1, file) != 1) {
+    fprintf(stderr, "ERROR: checkpoint <%s> is truncated\n", checkpoint_filename);
+    exit(-1);
+  }
+}
+
+static void write_u64(FILE* file, uint64_t value) { write_value(file, &value, sizeof(value)); }
+static void write_i64(FILE* file, int64_t value) { write_value(file, &value, sizeof(value)); }
+static void write_u32(FILE* file, uint32_t value) { write_value(file, &value, sizeof(value)); }
+static void write_f64(FILE* file, double value) { write_value(file, &value, sizeof(value)); }
+
+static uint64_t read_u64(FILE* file) { uint64_t value; read_value(file, &value, sizeof(value)); return value; }
+static int64_t read_i64(FILE* file) { int64_t value; read_value(file, &value, sizeof(value)); return value; }
+static uint32_t read_u32(FILE* file) { uint32_t value; read_value(file, &value, sizeof(value)); return value; }
+static double read_f64(FILE* file) { double value; read_value(file, &value, sizeof(value)); return value; }
+
+
+/* rebuild a list whose elements were read in head-to-tail order */
+static struct element* array_to_list(struct array* elements) {
+  struct element* head = NULL;
+  long i;
+  for(i = array_len(elements) - 1; i >= 0; i--)
+    head = push(head, array_get(elements, i));
+  array_free(elements);
+  return head;
+}
+
+
+/* same as `array_to_list`, for the lists that live as long as the network (see `push_network_list`) */
+static struct element* array_to_network_list(struct network* network, struct array* elements) {
+  struct element* head = NULL;
+  long i;
+  for(i = array_len(elements) - 1; i >= 0; i--)
+    head = push_network_list(network, head, array_get(elements, i));
+  array_free(elements);
+  return head;
+}
+
+
+static void check_count(const char* what, long saved, long current) {
+  if(saved != current) {
+    fprintf(stderr, "ERROR: checkpoint <%s> has %ld %s, the network built from <cloth_input.txt> has %ld\n", checkpoint_filename, saved, what, current);
+    exit(-1);
+  }
+}
+
+
+/* WRITE */
+
+static void write_policy(FILE* file, struct policy policy) {
+  write_u64(file, policy.fee_base);
+  write_u64(file, policy.fee_proportional);
+  write_u64(file, policy.min_htlc);
+  write_u32(file, policy.timelock);
+  write_f64(file, policy.cul_threshold);
+}
+
+
+/* the nodes and capacities are written for all channels, so that the channels opened during the simulation can be rebuilt */
+static void write_channels(FILE* file, struct network* network) {
+  long i;
+  struct channel* channel;
+
+  for(i = 0; i < array_len(network->channels); i++) {
+    channel = array_get(network->channels, i);
+    write_u32(file, channel->is_closed);
+    write_i64(file, channel->node1);
+    write_i64(file, channel->node2);
+    write_u64(file, channel->capacity);
+  }
+}
+
+
+static void write_edges(FILE* file, struct network* network) {
+  long i;
+  struct edge* edge;
+  struct channel_update* channel_update;
+  struct element* iterator;
+
+  for(i = 0; i < array_len(network->edges); i++) {
+    edge = array_get(network->edges, i);
+    write_policy(file, edge->policy);
+    write_u64(file, edge->balance);
+    write_u32(file, edge->is_closed);
+    write_u64(file, edge->tot_flows);
+    write_i64(file, edge->group != NULL ? edge->group->id : -1);
+    write_i64(file, list_len(edge->channel_updates));
+    for(iterator = edge->channel_updates; iterator != NULL; iterator = iterator->next) {
+      channel_update = iterator->data;
+      write_i64(file, channel_update->edge_id);
+      write_u64(file, channel_update->time);
+      write_u64(file, channel_update->htlc_maximum_msat);
+    }
+  }
+}
+
+
+static void write_groups(FILE* file, struct network* network) {
+  long i, j;
+  struct group* group;
+  struct group_update* group_update;
+  struct element* iterator;
+
+  write_i64(file, array_len(network->groups));
+  for(i = 0; i < array_len(network->groups); i++) {
+    group = array_get(network->groups, i);
+    write_i64(file, group->id);
+    write_u64(file, group->max_cap_limit);
+    write_u64(file, group->min_cap_limit);
+    write_u64(file, group->group_cap);
+    write_u64(file, group->is_closed);
+    write_u64(file, group->constructed_time);
+    write_i64(file, array_len(group->edges));
+    for(j = 0; j < array_len(group->edges); j++)
+      write_i64(file, ((struct edge*) array_get(group->edges, j))->id);
+    write_i64(file, list_len(group->history));
+    for(iterator = group->history; iterator != NULL; iterator = iterator->next) {
+      group_update = iterator->data;
+      write_u64(file, group_update->time);
+      write_u64(file, group_update->group_cap);
+      for(j = 0; j < array_len(group->edges); j++)
+        write_u64(file, group_update->edge_balances[j]);
+      write_i64(file, group_update->fake_balance_updated_edge_id);
+      write_u64(file, group_update->fake_balance_updated_edge_actual_balance);
+      write_i64(file, group_update->triggered_edge_id);
+    }
+  }
+}
+
+
+/* only the non-empty result lists are written, as (from_node_id, results) */
+static void write_results(FILE* file, struct network* network) {
+  long i, j, n_nodes, n_lists;
+  struct node* node;
+  struct node_pair_result* result;
+  struct element* iterator;
+
+  n_nodes = array_len(network->nodes);
+  for(i = 0; i < n_nodes; i++) {
+    node = array_get(network->nodes, i);
+    n_lists = 0;
+    for(j = 0; j < n_nodes; j++)
+      if(node->results[j] != NULL) n_lists++;
+    write_i64(file, n_lists);
+    for(j = 0; j < n_nodes; j++) {
+      if(node->results[j] == NULL) continue;
+      write_i64(file, j);
+      write_i64(file, list_len(node->results[j]));
+      for(iterator = node->results[j]; iterator != NULL; iterator = iterator->next) {
+        result = iterator->data;
+        write_i64(file, result->to_node_id);
+        write_u64(file, result->fail_time);
+        write_u64(file, result->fail_amount);
+        write_u64(file, result->success_time);
+        write_u64(file, result->success_amount);
+      }
+    }
+  }
+}
+
+
+static void write_route(FILE* file, struct route* route) {
+  long i;
+  struct route_hop* hop;
+
+  write_u64(file, route->total_amount);
+  write_u64(file, route->total_fee);
+  write_u64(file, route->total_timelock);
+  write_i64(file, route->n_hops);
+  for(i = 0; i < route->n_hops; i++) {
+    hop = &(route->hops[i]);
+    write_i64(file, hop->from_node_id);
+    write_i64(file, hop->to_node_id);
+    write_i64(file, hop->edge_id);
+    write_u64(file, hop->amount_to_forward);
+    write_u32(file, hop->timelock);
+    write_u64(file, hop->edges_lock_start_time);
+    write_u64(file, hop->edges_lock_end_time);
+    write_u64(file, hop->group_cap);
+  }
+}
+
+
+/* `error.hop` points to a hop of the current route: it is stored as the index of the hop (-1 if not set or no longer in the route) */
+static long get_error_hop_index(struct payment* payment) {
+  long i;
+  if(payment->error.hop == NULL || payment->route == NULL) return -1;
+  for(i = 0; i < payment->route->n_hops; i++)
+    if(&(payment->route->hops[i]) == payment->error.hop) return i;
+  return -1;
+}
+
+
+/* the hops of an attempt are written only if they are in the attempt log (see attempt_log.h) */
+static void write_attempt(FILE* file, struct attempt* attempt) {
+  long i;
+  struct edge_snapshot* snapshot;
+
+  write_u32(file, attempt->attempts);
+  write_u64(file, attempt->end_time);
+  write_i64(file, attempt->error_edge_id);
+  write_u32(file, attempt->error_type);
+  write_u32(file, attempt->is_succeeded);
+  write_u32(file, attempt->is_split);
+  write_i64(file, attempt->shard1_id);
+  write_i64(file, attempt->shard2_id);
+  write_i64(file, attempt->is_split ? -1 : (long) attempt->n_hops);
+  for(i = 0; i < attempt->n_hops; i++) {
+    snapshot = get_attempt_hop(attempt, i);
+    write_i64(file, snapshot->id);
+    write_u64(file, snapshot->balance);
+    write_u32(file, snapshot->is_in_group);
+    write_u64(file, snapshot->group_cap);
+    write_u32(file, snapshot->does_channel_update_exist);
+    write_u64(file, snapshot->last_channle_update_value);
+    write_u64(file, snapshot->sent_amt);
+  }
+}
+
+
+static void write_payments(FILE* file, struct array* payments) {
+  long i, index, n_attempts;
+  struct payment* payment;
+
+  write_i64(file, array_len(payments));
+  for(i = 0; i < array_len(payments); i++) {
+    payment = array_get(payments, i);
+    write_i64(file, payment->id);
+    write_i64(file, payment->sender);
+    write_i64(file, payment->receiver);
+    write_u64(file, payment->amount);
+    write_u64(file, payment->max_fee_limit);
+    write_u64(file, payment->start_time);
+    write_u64(file, payment->end_time);
+    write_u32(file, payment->attempts);
+    write_u32(file, payment->error.type);
+    write_i64(file, get_error_hop_index(payment));
+    write_u32(file, payment->is_shard);
+    write_i64(file, payment->parent_id);
+    write_i64(file, payment->first_shard_id);
+    write_i64(file, payment->last_shard_id);
+    write_i64(file, payment->next_shard_id);
+    write_u32(file, payment->n_shards);
+    write_i64(file, payment->root_payment_id);
+    write_u32(file, payment->shard_count);
+    write_u32(file, payment->completed_shard_count);
+    write_u32(file, payment->successful_shard_count);
+    write_u32(file, payment->mpp_triggered);
+    write_u32(file, payment->is_success);
+    write_u32(file, payment->offline_node_count);
+    write_u32(file, payment->no_balance_count);
+    write_u32(file, payment->is_timeout);
+    write_u32(file, payment->route != NULL);
+    if(payment->route != NULL)
+      write_route(file, payment->route);
+    // the attempts are written from the last one
+    n_attempts = 0;
+    for(index = payment->last_attempt; index != -1; index = get_attempt(index)->previous)
+      n_attempts++;
+    write_i64(file, n_attempts);
+    for(index = payment->last_attempt; index != -1; index = get_attempt(index)->previous)
+      write_attempt(file, get_attempt(index));
+  }
+}
+
+
+/* the initial paths computed at time 0 are still valid only for the root payments that have not been attempted yet */
+static void write_paths(FILE* file, struct array* payments) {
+  long i, j, n_paths;
+  struct payment* payment;
+  struct path_hop* hop;
+
+  n_paths = 0;
+  for(i = 0; paths != NULL && i < array_len(payments); i++) {
+    payment = array_get(payments, i);
+    if(payment->is_shard) continue;
+    n_paths = i + 1;
+  }
+  write_i64(file, n_paths);
+  for(i = 0; i < n_paths; i++) {
+    payment = array_get(payments, i);
+    if(payment->is_shard || payment->attempts != 0 || paths[i] == NULL) {
+      write_i64(file, -1);
+      continue;
+    }
+    write_i64(file, paths[i]->n_hops);
+    for(j = 0; j < paths[i]->n_hops; j++) {
+      hop = &(paths[i]->hops[j]);
+      write_i64(file, hop->sender);
+      write_i64(file, hop->receiver);
+      write_i64(file, hop->edge);
+    }
+  }
+}
+
+
+/* the payments not created yet are not stored: only the position of the source in the payments file (or trace), or the state of its random generator */
+static void write_payment_source(FILE* file, struct payment_source* source) {
+  write_u32(file, source != NULL);
+  if(source == NULL) return;
+  write_i64(file, source->n_drawn);
+  write_u32(file, source->has_next);
+  write_i64(file, source->next.sender);
+  write_i64(file, source->next.receiver);
+  write_u64(file, source->next.amount);
+  write_u64(file, source->next.start_time);
+  write_u64(file, source->next.max_fee_limit);
+  write_u32(file, source->resample_max_fee_limit);
+  write_f64(file, source->pay_params.max_fee_limit_mu);
+  write_f64(file, source->pay_params.max_fee_limit_sigma);
+  if(source->trace != NULL) {
+    write_i64(file, source->trace->offset);
+    write_u64(file, source->trace->start_time);
+    write_i64(file, source->trace->n_read);
+  }
+  else if(source->file != NULL) {
+    write_i64(file, ftell(source->file));
+    write_i64(file, source->line);
+  }
+  else {
+    write_u64(file, source->payment_time);
+    if(gsl_rng_fwrite(file, source->random_generator) != 0) {
+      fprintf(stderr, "ERROR: cannot write random generator state in checkpoint <%s>\n", checkpoint_filename);
+      exit(-1);
+    }
+  }
+}
+
+
+/* events are written in the order of the heap array, so that events with the same time are extracted in the same order after a restore */
+static void write_events(FILE* file, struct heap* events) {
+  long i;
+  struct event* event;
+
+  write_i64(file, heap_len(events));
+  for(i = 0; i < heap_len(events); i++) {
+    event = events->data[i];
+    write_u64(file, event->time);
+    write_u32(file, event->type);
+    write_i64(file, event->node_id);
+    write_i64(file, event->hop_index);
+    write_i64(file, event->payment != NULL ? event->payment->id : -1);
+  }
+}
+
+
+/* the checkpoint is written in a temporary file which is then renamed, so that an interrupted write never corrupts the previous checkpoint */
+void write_checkpoint(char filename[], struct simulation* simulation, struct network* network, struct array* payments, struct payment_source* payment_source, struct element* group_add_queue) {
+  FILE* file;
+  char tmp_filename[512];
+  char rng_name[64];
+  struct element* iterator;
+
+  checkpoint_filename = filename;
+  snprintf(tmp_filename, sizeof(tmp_filename), "%s.tmp", filename);
+  file = fopen(tmp_filename, "wb");
+  if(file == NULL) {
+    fprintf(stderr, "ERROR: cannot open file <%s>\n", tmp_filename);
+    exit(-1);
+  }
+
+  write_value(file, CHECKPOINT_MAGIC, strlen(CHECKPOINT_MAGIC));
+  write_u32(file, CHECKPOINT_VERSION);
+  write_i64(file, array_len(network->nodes));
+  write_i64(file, array_len(network->channels));
+  write_i64(file, array_len(network->edges));
+  write_u64(file, simulation->current_time);
+
+  memset(rng_name, 0, sizeof(rng_name));
+  strncpy(rng_name, gsl_rng_name(simulation->random_generator), sizeof(rng_name) - 1);
+  write_value(file, rng_name, sizeof(rng_name));
+  write_u64(file, gsl_rng_size(simulation->random_generator));
+  if(gsl_rng_fwrite(file, simulation->random_generator) != 0) {
+    fprintf(stderr, "ERROR: cannot write random generator state in checkpoint <%s>\n", filename);
+    exit(-1);
+  }
+
+  write_u64(file, telemetry->total_payments);
+  write_u64(file, telemetry->completed_payments);
+  write_u64(file, telemetry->processed_events);
+  write_u64(file, telemetry->dijkstra_calls);
+  write_u64(file, telemetry->mpp_splits);
+  write_u64(file, telemetry->group_constructions);
+
+  write_channels(file, network);
+  write_edges(file, network);
+  write_groups(file, network);
+  write_results(file, network);
+  write_payments(file, payments);
+  write_paths(file, payments);
+  write_payment_source(file, payment_source);
+  write_events(file, simulation->events);
+
+  write_i64(file, list_len(group_add_queue));
+  for(iterator = group_add_queue; iterator != NULL; iterator = iterator->next)
+    write_i64(file, ((struct edge*) iterator->data)->id);
+
+  if(fclose(file) != 0 || rename(tmp_filename, filename) != 0) {
+    fprintf(stderr, "ERROR: cannot write checkpoint <%s>\n", filename);
+    exit(-1);
+  }
+}
+
+
+/* READ */
+
+static struct policy read_policy(FILE* file) {
+  struct policy policy;
+  policy.fee_base = read_u64(file);
+  policy.fee_proportional = read_u64(file);
+  policy.min_htlc = read_u64(file);
+  policy.timelock = read_u32(file);
+  policy.cul_threshold = read_f64(file);
+  return policy;
+}
+
+
+/* the channels opened during the simulation are added to the network (their edges are read by `read_edges`);
+   the channels are closed after their edges are read: here the closed flags are returned in `is_closed` */
+static void read_channels(FILE* file, struct network* network, long n_channels, unsigned int* is_closed) {
+  long i, node1, node2;
+  uint64_t capacity;
+  struct policy policy;
+
+  memset(&policy, 0, sizeof(struct policy));
+  for(i = 0; i < n_channels; i++) {
+    is_closed[i] = read_u32(file);
+    node1 = read_i64(file);
+    node2 = read_i64(file);
+    capacity = read_u64(file);
+    if(i >= array_len(network->channels))
+      add_channel(network, node1, node2, capacity, 0, policy, policy);
+  }
+}
+
+
+/* edge groups are linked after the groups are read: here the group ids are returned in `group_ids` */
+static void read_edges(FILE* file, struct network* network, long* group_ids) {
+  long i, j, n_channel_updates, edge_id;
+  uint64_t time;
+  struct edge* edge;
+  struct channel_update* channel_update;
+  struct array* channel_updates;
+
+  for(i = 0; i < array_len(network->edges); i++) {
+    edge = array_get(network->edges, i);
+    edge->policy = read_policy(file);
+    edge->balance = read_u64(file);
+    edge->is_closed = read_u32(file);
+    edge->tot_flows = read_u64(file);
+    group_ids[i] = read_i64(file);
+    n_channel_updates = read_i64(file);
+    channel_updates = array_initialize(n_channel_updates > 0 ? n_channel_updates : 1);
+    for(j = 0; j < n_channel_updates; j++) {
+      edge_id = read_i64(file);
+      time = read_u64(file);
+      channel_update = new_channel_update(network, edge_id, time, read_u64(file));
+      channel_updates = array_insert(channel_updates, channel_update);
+    }
+    // the channel updates and their list are in the data arena of the network: the previous ones are left there
+    edge->channel_updates = array_to_network_list(network, channel_updates);
+  }
+}
+
+
+static void read_groups(FILE* file, struct network* network, long* group_ids) {
+  long i, j, k, n_groups, n_edges, n_updates;
+  struct group* group;
+  struct group_update* group_update;
+  struct array* history;
+  struct edge* edge;
+
+  n_groups = read_i64(file);
+  for(i = 0; i < n_groups; i++) {
+    group = malloc(sizeof(struct group));
+    group->id = read_i64(file);
+    group->max_cap_limit = read_u64(file);
+    group->min_cap_limit = read_u64(file);
+    group->group_cap = read_u64(file);
+    group->is_closed = read_u64(file);
+    group->constructed_time = read_u64(file);
+    n_edges = read_i64(file);
+    group->edges = array_initialize(n_edges > 0 ? n_edges : 1);
+    for(j = 0; j < n_edges; j++)
+      group->edges = array_insert(group->edges, array_get(network->edges, read_i64(file)));
+    n_updates = read_i64(file);
+    history = array_initialize(n_updates > 0 ? n_updates : 1);
+    for(j = 0; j < n_updates; j++) {
+      group_update = arena_alloc(network->data_arena, sizeof(struct group_update));
+      group_update->time = read_u64(file);
+      group_update->group_cap = read_u64(file);
+      group_update->edge_balances = arena_alloc(network->data_arena, sizeof(uint64_t) * (n_edges > 0 ? n_edges : 1));
+      for(k = 0; k < n_edges; k++)
+        group_update->edge_balances[k] = read_u64(file);
+      group_update->fake_balance_updated_edge_id = read_i64(file);
+      group_update->fake_balance_updated_edge_actual_balance = read_u64(file);
+      group_update->triggered_edge_id = read_i64(file);
+      history = array_insert(history, group_update);
+    }
+    group->history = array_to_network_list(network, history);
+    network->groups = array_insert(network->groups, group);
+  }
+
+  for(i = 0; i < array_len(network->edges); i++) {
+    edge = array_get(network->edges, i);
+    edge->group = group_ids[i] != -1 ? array_get(network->groups, group_ids[i]) : NULL;
+  }
+}
+
+
+static void read_results(FILE* file, struct network* network) {
+  long i, j, k, n_nodes, n_lists, from_node_id, n_results;
+  struct node* node;
+  struct node_pair_result* result;
+  struct array* results;
+
+  n_nodes = array_len(network->nodes);
+  for(i = 0; i < n_nodes; i++) {
+    node = array_get(network->nodes, i);
+    n_lists = read_i64(file);
+    for(j = 0; j < n_lists; j++) {
+      from_node_id = read_i64(file);
+      n_results = read_i64(file);
+      results = array_initialize(n_results > 0 ? n_results : 1);
+      for(k = 0; k < n_results; k++) {
+        result = arena_alloc(network->data_arena, sizeof(struct node_pair_result));
+        result->to_node_id = read_i64(file);
+        result->fail_time = read_u64(file);
+        result->fail_amount = read_u64(file);
+        result->success_time = read_u64(file);
+        result->success_amount = read_u64(file);
+        results = array_insert(results, result);
+      }
+      node->results[from_node_id] = array_to_network_list(network, results);
+    }
+  }
+}
+
+
+static struct route* read_route(FILE* file) {
+  long i, n_hops;
+  struct route* route;
+  struct route_hop* hop;
+  uint64_t total_amount, total_fee, total_timelock;
+
+  total_amount = read_u64(file);
+  total_fee = read_u64(file);
+  total_timelock = read_u64(file);
+  n_hops = read_i64(file);
+  route = route_initialize(n_hops);
+  route->total_amount = total_amount;
+  route->total_fee = total_fee;
+  route->total_timelock = total_timelock;
+  for(i = 0; i < n_hops; i++) {
+    hop = &(route->hops[i]);
+    hop->from_node_id = read_i64(file);
+    hop->to_node_id = read_i64(file);
+    hop->edge_id = read_i64(file);
+    hop->amount_to_forward = read_u64(file);
+    hop->timelock = read_u32(file);
+    hop->edges_lock_start_time = read_u64(file);
+    hop->edges_lock_end_time = read_u64(file);
+    hop->group_cap = read_u64(file);
+  }
+  return route;
+}
+
+
+/* the attempt is appended to the attempt log as the last one of the payment; its hops are dropped if the log does not keep them */
+static void read_attempt(FILE* file, struct payment* payment) {
+  long i, route_len;
+  struct attempt fields, *attempt;
+  struct edge_snapshot* snapshot, dropped_hop;
+
+  fields.attempts = read_u32(file);
+  fields.end_time = read_u64(file);
+  fields.error_edge_id = read_i64(file);
+  fields.error_type = read_u32(file);
+  fields.is_succeeded = read_u32(file);
+  fields.is_split = read_u32(file);
+  fields.shard1_id = read_i64(file);
+  fields.shard2_id = read_i64(file);
+  route_len = read_i64(file);
+
+  attempt = new_attempt(payment, route_len > 0 ? route_len : 0);
+  attempt->attempts = fields.attempts;
+  attempt->end_time = fields.end_time;
+  attempt->error_edge_id = fields.error_edge_id;
+  attempt->error_type = fields.error_type;
+  attempt->is_succeeded = fields.is_succeeded;
+  attempt->is_split = fields.is_split;
+  attempt->shard1_id = fields.shard1_id;
+  attempt->shard2_id = fields.shard2_id;
+  for(i = 0; i < route_len; i++) {
+    snapshot = i < attempt->n_hops ? get_attempt_hop(attempt, i) : &dropped_hop;
+    snapshot->id = read_i64(file);
+    snapshot->balance = read_u64(file);
+    snapshot->is_in_group = read_u32(file);
+    snapshot->group_cap = read_u64(file);
+    snapshot->does_channel_update_exist = read_u32(file);
+    snapshot->last_channle_update_value = read_u64(file);
+    snapshot->sent_amt = read_u64(file);
+  }
+}
+
+
+/* the attempts of a payment are read from the last one: the links of the log are reversed after they are appended */
+static void reverse_attempts(struct payment* payment) {
+  long index, previous, next;
+  struct attempt* attempt;
+  next = -1;
+  for(index = payment->last_attempt; index != -1; index = previous) {
+    attempt = get_attempt(index);
+    previous = attempt->previous;
+    attempt->previous = next;
+    next = index;
+  }
+  payment->last_attempt = next;
+}
+
+
+static struct array* read_payments(FILE* file) {
+  long i, j, n_payments, id, sender, receiver, error_hop_index, n_attempts;
+  uint64_t amount, max_fee_limit, start_time;
+  struct payment* payment;
+  struct array* payments;
+
+  n_payments = read_i64(file);
+  payments = array_initialize(n_payments > 0 ? n_payments : 1);
+  for(i = 0; i < n_payments; i++) {
+    id = read_i64(file);
+    sender = read_i64(file);
+    receiver = read_i64(file);
+    amount = read_u64(file);
+    max_fee_limit = read_u64(file);
+    start_time = read_u64(file);
+    payment = new_payment(id, sender, receiver, amount, start_time, max_fee_limit);
+    payment->end_time = read_u64(file);
+    payment->attempts = read_u32(file);
+    payment->error.type = read_u32(file);
+    error_hop_index = read_i64(file);
+    payment->is_shard = read_u32(file);
+    payment->parent_id = read_i64(file);
+    payment->first_shard_id = read_i64(file);
+    payment->last_shard_id = read_i64(file);
+    payment->next_shard_id = read_i64(file);
+    payment->n_shards = read_u32(file);
+    payment->root_payment_id = read_i64(file);
+    payment->shard_count = read_u32(file);
+    payment->completed_shard_count = read_u32(file);
+    payment->successful_shard_count = read_u32(file);
+    payment->mpp_triggered = read_u32(file);
+    payment->is_success = read_u32(file);
+    payment->offline_node_count = read_u32(file);
+    payment->no_balance_count = read_u32(file);
+    payment->is_timeout = read_u32(file);
+    if(read_u32(file))
+      payment->route = read_route(file);
+    if(error_hop_index != -1 && payment->route != NULL)
+      payment->error.hop = &(payment->route->hops[error_hop_index]);
+    n_attempts = read_i64(file);
+    for(j = 0; j < n_attempts; j++)
+      read_attempt(file, payment);
+    reverse_attempts(payment);
+    payments = array_insert(payments, payment);
+  }
+  return payments;
+}
+
+
+static void read_paths(FILE* file) {
+  long i, j, n_paths, path_len;
+  struct path_hop* hop;
+
+  n_paths = read_i64(file);
+  if(n_paths == 0) return;
+  paths = malloc(sizeof(struct path*) * n_paths);
+  for(i = 0; i < n_paths; i++) {
+    path_len = read_i64(file);
+    if(path_len == -1) {
+      paths[i] = NULL;
+      continue;
+    }
+    paths[i] = path_initialize(path_len);
+    for(j = 0; j < path_len; j++) {
+      hop = &(paths[i]->hops[j]);
+      hop->sender = read_i64(file);
+      hop->receiver = read_i64(file);
+      hop->edge = read_i64(file);
+    }
+  }
+}
+
+
+static void read_payment_source(FILE* file, struct payment_source* source) {
+  long offset;
+  uint64_t trace_start_time;
+  if(read_u32(file) != (source != NULL)) {
+    fprintf(stderr, "ERROR: checkpoint <%s> was written with stream_payments=%s\n", checkpoint_filename, source != NULL ? "false" : "true");
+    exit(-1);
+  }
+  if(source == NULL) return;
+  source->n_drawn = read_i64(file);
+  source->has_next = read_u32(file);
+  source->next.sender = read_i64(file);
+  source->next.receiver = read_i64(file);
+  source->next.amount = read_u64(file);
+  source->next.start_time = read_u64(file);
+  source->next.max_fee_limit = read_u64(file);
+  source->resample_max_fee_limit = read_u32(file);
+  source->pay_params.max_fee_limit_mu = read_f64(file);
+  source->pay_params.max_fee_limit_sigma = read_f64(file);
+  if(source->trace != NULL) {
+    offset = read_i64(file);
+    trace_start_time = read_u64(file);
+    seek_payment_trace(source->trace, offset, trace_start_time, read_i64(file));
+  }
+  else if(source->file != NULL) {
+    offset = read_i64(file);
+    source->line = read_i64(file);
+    if(fseek(source->file, offset, SEEK_SET) != 0) {
+      fprintf(stderr, "ERROR: cannot restore the position of checkpoint <%s> in <%s>\n", checkpoint_filename, source->filename);
+      exit(-1);
+    }
+  }
+  else {
+    source->payment_time = read_u64(file);
+    if(gsl_rng_fread(file, source->random_generator) != 0) {
+      fprintf(stderr, "ERROR: cannot read random generator state from checkpoint <%s>\n", checkpoint_filename);
+      exit(-1);
+    }
+  }
+}
+
+
+static struct heap* read_events(FILE* file, struct array* payments) {
+  long i, n_events, payment_id;
+  struct heap* events;
+  struct event* event;
+  uint64_t time;
+  enum event_type type;
+  long node_id, hop_index;
+
+  n_events = read_i64(file);
+  events = heap_initialize(n_events > 0 ? n_events * 2 : 1);
+  for(i = 0; i < n_events; i++) {
+    time = read_u64(file);
+    type = read_u32(file);
+    node_id = read_i64(file);
+    hop_index = read_i64(file);
+    payment_id = read_i64(file);
+    event = new_event(time, type, node_id, hop_index, payment_id != -1 ? array_get(payments, payment_id) : NULL);
+    events->data[i] = event;
+  }
+  events->index = n_events;
+  return events;
+}
+
+
+struct element* read_checkpoint(char filename[], struct simulation* simulation, struct network* network, struct array** payments, struct payment_source* payment_source) {
+  FILE* file;
+  char magic[sizeof(CHECKPOINT_MAGIC)];
+  char rng_name[64];
+  uint32_t version;
+  long i, n_queue, n_channels, n_edges, *group_ids;
+  unsigned int* is_closed;
+  struct array* group_add_queue;
+
+  checkpoint_filename = filename;
+  file = fopen(filename, "rb");
+  if(file == NULL) {
+    fprintf(stderr, "ERROR: cannot open file <%s>\n", filename);
+    exit(-1);
+  }
+
+  memset(magic, 0, sizeof(magic));
+  read_value(file, magic, strlen(CHECKPOINT_MAGIC));
+  version = read_u32(file);
+  if(strcmp(magic, CHECKPOINT_MAGIC) != 0 || version != CHECKPOINT_VERSION) {
+    fprintf(stderr, "ERROR: <%s> is not a checkpoint of version %d\n", filename, CHECKPOINT_VERSION);
+    exit(-1);
+  }
+  check_count("nodes", read_i64(file), array_len(network->nodes));
+  // the checkpoint may have more channels than the network built from the input: the ones opened during the simulation
+  n_channels = read_i64(file);
+  n_edges = read_i64(file);
+  if(n_channels < array_len(network->channels) || n_edges - array_len(network->edges) != 2*(n_channels - array_len(network->channels))) {
+    fprintf(stderr, "ERROR: checkpoint <%s> has %ld channels and %ld edges, the network built from <cloth_input.txt> has %ld and %ld\n", checkpoint_filename, n_channels, n_edges, array_len(network->channels), array_len(network->edges));
+    exit(-1);
+  }
+  simulation->current_time = read_u64(file);
+
+  read_value(file, rng_name, sizeof(rng_name));
+  if(strncmp(rng_name, gsl_rng_name(simulation->random_generator), sizeof(rng_name)) != 0 || read_u64(file) != gsl_rng_size(simulation->random_generator)) {
+    fprintf(stderr, "ERROR: checkpoint <%s> was written with random generator <%s>, current random generator is <%s> (see GSL_RNG_TYPE)\n", filename, rng_name, gsl_rng_name(simulation->random_generator));
+    exit(-1);
+  }
+  if(gsl_rng_fread(file, simulation->random_generator) != 0) {
+    fprintf(stderr, "ERROR: cannot read random generator state from checkpoint <%s>\n", filename);
+    exit(-1);
+  }
+
+  telemetry->total_payments = read_u64(file);
+  telemetry->completed_payments = read_u64(file);
+  telemetry->processed_events = read_u64(file);
+  telemetry->dijkstra_calls = read_u64(file);
+  telemetry->mpp_splits = read_u64(file);
+  telemetry->group_constructions = read_u64(file);
+
+  is_closed = malloc(sizeof(unsigned int) * (n_channels > 0 ? n_channels : 1));
+  read_channels(file, network, n_channels, is_closed);
+  group_ids = malloc(sizeof(long) * (n_edges > 0 ? n_edges : 1));
+  read_edges(file, network, group_ids);
+  for(i = 0; i < n_channels; i++)
+    if(is_closed[i]) mark_channel_closed(network, i);
+  free(is_closed);
+  update_network_core(network);
+  invalidate_capacity_oracle(network);
+  read_groups(file, network, group_ids);
+  free(group_ids);
+  read_results(file, network);
+  *payments = read_payments(file);
+  read_paths(file);
+  read_payment_source(file, payment_source);
+  simulation->events = read_events(file, *payments);
+
+  n_queue = read_i64(file);
+  group_add_queue = array_initialize(n_queue > 0 ? n_queue : 1);
+  for(i = 0; i < n_queue; i++)
+    group_add_queue = array_insert(group_add_queue, array_get(network->edges, read_i64(file)));
+
+  fclose(file);
+  return array_to_list(group_add_queue);
+}
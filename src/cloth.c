@@ -6,6 +6,11 @@
 #include <stdint.h>
 #include <inttypes.h>
 #include <dirent.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
 
 #include <gsl/gsl_rng.h>
 #include <gsl/gsl_cdf.h>
@@ -19,23 +24,32 @@
 #include "../include/cloth.h"
 #include "../include/network.h"
 #include "../include/event.h"
+#include "../include/telemetry.h"
+#include "../include/profiler.h"
+#include "../include/checkpoint.h"
+#include "../include/input.h"
+#include "../include/trace.h"
+#include "../include/topology.h"
+#include "../include/availability.h"
+#include "../include/payment_writer.h"
+#include "../include/attempt_log.h"
+#include "../include/workload.h"
+#include "../include/ramp.h"
 
 /* This file contains the main, where the simulation logic is executed;
    additionally, it contains the the initialization functions,
    a function that reads the input and a function that writes the output values in csv files */
 
 
-/* write the final values of nodes, channels, edges and payments in csv files */
+/* write the final values of nodes, channels, edges and payments in csv files (payments are not written if `payments` is NULL);
+   if the network is renumbered (see network_ordering.c), nodes, channels and edges are written in the order and with the ids of the input */
 void write_output(struct network* network, struct array* payments, char output_dir_name[]) {
   FILE* csv_channel_output, *csv_group_output, *csv_edge_output, *csv_payment_output, *csv_node_output;
-  long i,j, *id;
+  long i,j,n_printed;
+  struct id_map* node_map = network->node_map, *channel_map = network->channel_map, *edge_map = network->edge_map;
   struct channel* channel;
   struct edge* edge;
-  struct payment* payment;
   struct node* node;
-  struct route* route;
-  struct array* hops;
-  struct route_hop* hop;
   DIR* results_dir;
   char output_filename[512];
 
@@ -54,8 +68,9 @@ void write_output(struct network* network, struct array* payments, char output_d
   }
   fprintf(csv_channel_output, "id,edge1,edge2,node1,node2,capacity,is_closed\n");
   for(i=0; i<array_len(network->channels); i++) {
-    channel = array_get(network->channels, i);
-    fprintf(csv_channel_output, "%ld,%ld,%ld,%ld,%ld,%ld,%d\n", channel->id, channel->edge1, channel->edge2, channel->node1, channel->node2, channel->capacity, channel->is_closed);
+    channel = array_get(network->channels, get_renumbered_id(channel_map, i));
+    fprintf(csv_channel_output, "%ld,%ld,%ld,%ld,%ld,%ld,%d\n", get_original_id(channel_map, channel->id), get_original_id(edge_map, channel->edge1), get_original_id(edge_map, channel->edge2),
+            get_original_id(node_map, channel->node1), get_original_id(node_map, channel->node2), channel->capacity, channel->is_closed);
   }
   fclose(csv_channel_output);
 
@@ -73,7 +88,7 @@ void write_output(struct network* network, struct array* payments, char output_d
     long n_members = array_len(group->edges);
     for(j=0; j< n_members; j++){
         struct edge* edge_snapshot = array_get(group->edges, j);
-        fprintf(csv_group_output, "%ld", edge_snapshot->id);
+        fprintf(csv_group_output, "%ld", get_original_id(edge_map, edge_snapshot->id));
         if(j < n_members -1){
             fprintf(csv_group_output, "-");
         }else{
@@ -92,9 +107,9 @@ void write_output(struct network* network, struct array* payments, char output_d
             float cul = (1.0f - ((float)group_update->group_cap / (float)group_update->edge_balances[j]));
             sum_cul += cul;
             if(group_update->fake_balance_updated_edge_id == e->id){
-                fprintf(csv_group_output, "{\"\"edge_id\"\":%ld,\"\"balance\"\":%ld,\"\"cul\"\":%f,\"\"fake_balance_update\"\":%s,\"\"actual_balance\"\":%ld}", e->id, group_update->edge_balances[j], cul, "true", group_update->fake_balance_updated_edge_actual_balance);
+                fprintf(csv_group_output, "{\"\"edge_id\"\":%ld,\"\"balance\"\":%ld,\"\"cul\"\":%f,\"\"fake_balance_update\"\":%s,\"\"actual_balance\"\":%ld}", get_original_id(edge_map, e->id), group_update->edge_balances[j], cul, "true", group_update->fake_balance_updated_edge_actual_balance);
             }else{
-                fprintf(csv_group_output, "{\"\"edge_id\"\":%ld,\"\"balance\"\":%ld,\"\"cul\"\":%f,\"\"fake_balance_update\"\":%s}", e->id, group_update->edge_balances[j], cul, "false");
+                fprintf(csv_group_output, "{\"\"edge_id\"\":%ld,\"\"balance\"\":%ld,\"\"cul\"\":%f,\"\"fake_balance_update\"\":%s}", get_original_id(edge_map, e->id), group_update->edge_balances[j], cul, "false");
             }
             if(j < n_members - 1) {
                 fprintf(csv_group_output, ",");
@@ -102,7 +117,7 @@ void write_output(struct network* network, struct array* payments, char output_d
         }
         float cul = sum_cul / (float)n_members;
         cul_avg += cul / (float) list_len(group->history);
-        fprintf(csv_group_output, "],\"\"time\"\":%lu,\"\"group_cap\"\":%lu,\"\"cul_avg\"\":%f,\"\"triggered_edge_id\"\":%ld}", group_update->time, group_update->group_cap, cul, group_update->fake_balance_updated_edge_id, group_update->fake_balance_updated_edge_actual_balance, group_update->triggered_edge_id);
+        fprintf(csv_group_output, "],\"\"time\"\":%lu,\"\"group_cap\"\":%lu,\"\"cul_avg\"\":%f,\"\"triggered_edge_id\"\":%ld}", group_update->time, group_update->group_cap, cul, get_original_id(edge_map, group_update->fake_balance_updated_edge_id), group_update->fake_balance_updated_edge_actual_balance, get_original_id(edge_map, group_update->triggered_edge_id));
         if(iterator->next != NULL) {
             fprintf(csv_group_output, ",");
         }
@@ -120,8 +135,9 @@ void write_output(struct network* network, struct array* payments, char output_d
   }
   fprintf(csv_edge_output, "id,channel_id,counter_edge_id,from_node_id,to_node_id,balance,fee_base,fee_proportional,min_htlc,timelock,is_closed,tot_flows,cul_threshold,channel_updates,group\n");
   for(i=0; i<array_len(network->edges); i++) {
-    edge = array_get(network->edges, i);
-    fprintf(csv_edge_output, "%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%d,%d,%ld,%lf,", edge->id, edge->channel_id, edge->counter_edge_id, edge->from_node_id, edge->to_node_id, edge->balance, edge->policy.fee_base, edge->policy.fee_proportional, edge->policy.min_htlc, edge->policy.timelock, edge->is_closed, edge->tot_flows, edge->policy.cul_threshold);
+    edge = array_get(network->edges, get_renumbered_id(edge_map, i));
+    fprintf(csv_edge_output, "%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%d,%d,%ld,%lf,", get_original_id(edge_map, edge->id), get_original_id(channel_map, edge->channel_id), get_original_id(edge_map, edge->counter_edge_id),
+            get_original_id(node_map, edge->from_node_id), get_original_id(node_map, edge->to_node_id), edge->balance, edge->policy.fee_base, edge->policy.fee_proportional, edge->policy.min_htlc, edge->policy.timelock, edge->is_closed, edge->tot_flows, edge->policy.cul_threshold);
     char channel_updates_text[1000000] = "";
     for (struct element *iterator = edge->channel_updates; iterator != NULL; iterator = iterator->next) {
         struct channel_update *channel_update = iterator->data;
@@ -148,94 +164,20 @@ void write_output(struct network* network, struct array* payments, char output_d
   }
   fclose(csv_edge_output);
 
-  strcpy(output_filename, output_dir_name);
-  strcat(output_filename, "payments_output.csv");
-  csv_payment_output = fopen(output_filename, "w");
-  if(csv_payment_output  == NULL) {
-    printf("ERROR cannot open payment_output.csv\n");
-    exit(-1);
-  }
-  fprintf(csv_payment_output, "id,sender_id,receiver_id,amount,start_time,max_fee_limit,end_time,mpp,is_shard,parent_payment_id,shards,is_success,no_balance_count,offline_node_count,timeout_exp,attempts,route,total_fee,attempts_history\n");
-  for(i=0; i<array_len(payments); i++)  {
-    payment = array_get(payments, i);
-    // Output all payments including shards
-    fprintf(csv_payment_output, "%ld,%ld,%ld,%ld,%ld,%ld,%ld,%u,%u,%ld,", 
-            payment->id, payment->sender, payment->receiver, payment->amount, 
-            payment->start_time, payment->max_fee_limit, payment->end_time, 
-            payment->mpp_triggered, payment->is_shard, payment->parent_id);
-    // Output shards array - find all direct child shards by scanning
-    if(payment->shards_id[0] != -1) {
-      // Find all child shards by checking payments with parent_id == this payment's id
-      int first_shard = 1;
-      for(long j = 0; j < array_len(payments); j++) {
-        struct payment* child = array_get(payments, j);
-        if(child->parent_id == payment->id) {
-          if(first_shard) {
-            fprintf(csv_payment_output, "%ld", child->id);
-            first_shard = 0;
-          } else {
-            fprintf(csv_payment_output, "-%ld", child->id);
-          }
-        }
-      }
-      fprintf(csv_payment_output, ",");
-    } else {
-      fprintf(csv_payment_output, ",");
-    }
-    fprintf(csv_payment_output, "%u,%d,%d,%u,%d,", 
-            payment->is_success, payment->no_balance_count, payment->offline_node_count, 
-            payment->is_timeout, payment->attempts);
-    route = payment->route;
-    if(route==NULL)
-      fprintf(csv_payment_output, ",,");
-    else {
-      hops = route->route_hops;
-      for(j=0; j<array_len(hops); j++) {
-        hop = array_get(hops, j);
-        if(j==array_len(hops)-1)
-          fprintf(csv_payment_output,"%ld,",hop->edge_id);
-        else
-          fprintf(csv_payment_output,"%ld-",hop->edge_id);
-      }
-      fprintf(csv_payment_output, "%ld,",route->total_fee);
-    }
-    // build attempts history json
-    if(payment->history != NULL) {
-        fprintf(csv_payment_output, "\"[");
-        for (struct element *iterator = payment->history; iterator != NULL; iterator = iterator->next) {
-            struct attempt *attempt = iterator->data;
-            if(attempt->is_split) {
-                // Split event
-                fprintf(csv_payment_output, "{\"\"attempts\"\":%d,\"\"is_split\"\":true,\"\"end_time\"\":%llu,\"\"shard1_id\"\":%ld,\"\"shard2_id\"\":%ld}", 
-                        attempt->attempts, attempt->end_time, attempt->shard1_id, attempt->shard2_id);
-            } else {
-                // Normal attempt (success or failure)
-                fprintf(csv_payment_output, "{\"\"attempts\"\":%d,\"\"is_succeeded\"\":%d,\"\"end_time\"\":%llu,\"\"error_edge\"\":%ld,\"\"error_type\"\":%d,\"\"route\"\":[", 
-                        attempt->attempts, attempt->is_succeeded, attempt->end_time, attempt->error_edge_id, attempt->error_type);
-                if(attempt->route != NULL) {
-                    for (j = 0; j < array_len(attempt->route); j++) {
-                        struct edge_snapshot* edge_snapshot = array_get(attempt->route, j);
-                        edge = array_get(network->edges, edge_snapshot->id);
-                        channel = array_get(network->channels, edge->channel_id);
-                        fprintf(csv_payment_output,"{\"\"edge_id\"\":%ld,\"\"from_node_id\"\":%ld,\"\"to_node_id\"\":%ld,\"\"sent_amt\"\":%llu,\"\"edge_cap\"\":%llu,\"\"channel_cap\"\":%llu,", 
-                                edge_snapshot->id, edge->from_node_id, edge->to_node_id, edge_snapshot->sent_amt, edge_snapshot->balance, channel->capacity);
-                        if(edge_snapshot->is_in_group) fprintf(csv_payment_output, "\"\"group_cap\"\":%llu,", edge_snapshot->group_cap);
-                        else fprintf(csv_payment_output,"\"\"group_cap\"\":null,");
-                        if(edge_snapshot->does_channel_update_exist) fprintf(csv_payment_output,"\"\"channel_update\"\":%llu}", edge_snapshot->last_channle_update_value);
-                        else fprintf(csv_payment_output,"\"\"channel_update\"\":null}");
-                        if (j != array_len(attempt->route) - 1) fprintf(csv_payment_output, ",");
-                    }
-                }
-                fprintf(csv_payment_output, "]}");
-            }
-            if (iterator->next != NULL) fprintf(csv_payment_output, ",");
-            else fprintf(csv_payment_output, "]");
-        }
-        fprintf(csv_payment_output, "\"");
+  /* with `retire_payments`, payments_output.csv is written during the simulation (see payment_writer.c) */
+  if(payments != NULL) {
+    strcpy(output_filename, output_dir_name);
+    strcat(output_filename, "payments_output.csv");
+    csv_payment_output = fopen(output_filename, "w");
+    if(csv_payment_output  == NULL) {
+      printf("ERROR cannot open payment_output.csv\n");
+      exit(-1);
     }
-    fprintf(csv_payment_output, "\n");
+    write_payments_header(csv_payment_output);
+    for(i=0; i<array_len(payments); i++)
+      write_payment(csv_payment_output, array_get(payments, i), payments, network);
+    fclose(csv_payment_output);
   }
-  fclose(csv_payment_output);
 
   strcpy(output_filename, output_dir_name);
   strcat(output_filename, "nodes_output.csv");
@@ -246,17 +188,16 @@ void write_output(struct network* network, struct array* payments, char output_d
   }
   fprintf(csv_node_output, "id,open_edges\n");
   for(i=0; i<array_len(network->nodes); i++) {
-    node = array_get(network->nodes, i);
-    fprintf(csv_node_output, "%ld,", node->id);
-    if(array_len(node->open_edges)==0)
+    node = array_get(network->nodes, get_renumbered_id(node_map, i));
+    fprintf(csv_node_output, "%ld,", get_original_id(node_map, node->id));
+    if(node->n_open_edges==node->n_closed_edges)
       fprintf(csv_node_output, "-1");
     else {
-      for(j=0; j<array_len(node->open_edges); j++) {
-        id = array_get(node->open_edges, j);
-        if(j==array_len(node->open_edges)-1)
-          fprintf(csv_node_output,"%ld",*id);
-        else
-          fprintf(csv_node_output,"%ld-",*id);
+      n_printed = 0;
+      for(j=0; j<node->n_open_edges; j++) {
+        if(node->open_edges[j] == CLOSED_EDGE) continue;
+        fprintf(csv_node_output, n_printed==0 ? "%ld" : "-%ld", get_original_id(edge_map, node->open_edges[j]));
+        n_printed++;
       }
     }
     fprintf(csv_node_output,"\n");
@@ -265,303 +206,269 @@ void write_output(struct network* network, struct array* payments, char output_d
 }
 
 
-void initialize_input_parameters(struct network_params *net_params, struct payments_params *pay_params) {
-  net_params->n_nodes = net_params->n_channels = net_params->capacity_per_channel = 0;
-  net_params->faulty_node_prob = 0.0;
-  net_params->network_from_file = 0;
-  strcpy(net_params->nodes_filename, "\0");
-  strcpy(net_params->channels_filename, "\0");
-  strcpy(net_params->edges_filename, "\0");
-  pay_params->inverse_payment_rate = pay_params->amount_mu = 0.0;
-  pay_params->n_payments = 0;
-  pay_params->payments_from_file = 0;
-  strcpy(pay_params->payments_filename, "\0");
-  pay_params->mpp = 0;
-  pay_params->max_shard_count = 16; // default max shard count
+/* the parameters that determine the network and the payments are shared by all the branches of a simulation and cannot be overridden by a variant */
+static const char* structural_parameters[] = {
+  "generate_network_from_file", "nodes_filename", "channels_filename", "edges_filename", "network_snapshot_filename", "network_ordering",
+  "topology_changes_filename", "channel_open_rate", "channel_close_rate",
+  "node_availability_filename", "average_node_online_time", "average_node_offline_time", "routing_skip_offline_nodes",
+  "routing_prune_leaf_trees", "n_additional_nodes", "n_channels_per_node", "capacity_per_channel", "faulty_node_probability",
+  "cul_threshold_dist_alpha", "cul_threshold_dist_beta", "routing_method",
+  "generate_payments_from_file", "payments_filename", "payment_rate", "n_payments",
+  "average_payment_amount", "variance_payment_amount", "stream_payments", "retire_payments",
+  "payment_workload", "workload_zipf_exponent", "workload_locality_hops", "workload_amount_sigma", "workload_pareto_alpha",
+  "workload_burst_factor", "workload_burst_duration", "workload_diurnal_period", "workload_repeat_probability",
+  "ramp_mode", "ramp_initial_rate", "ramp_rate_factor", "ramp_stage_duration", "ramp_min_success_rate", "ramp_max_latency",
+  "ramp_tolerance", "ramp_max_stages",
+  "restore_filename", "branch_time", "branch_variants_filename", "event_trace_filename",
+};
+
+
+unsigned int is_structural_parameter(char* parameter){
+  long i;
+  for(i = 0; i < (long)(sizeof(structural_parameters)/sizeof(structural_parameters[0])); i++)
+    if(strcmp(parameter, structural_parameters[i])==0) return 1;
+  return 0;
 }
 
 
-/* parse the input parameters in "cloth_input.txt" */
-void read_input(struct network_params* net_params, struct payments_params* pay_params){
-  FILE* input_file;
-  char *parameter, *value, line[1024];
-
-  initialize_input_parameters(net_params, pay_params);
-
-  input_file = fopen("cloth_input.txt","r");
-
-  if(input_file==NULL){
-    fprintf(stderr, "ERROR: cannot open file <cloth_input.txt> in current directory.\n");
+/* read the variants of a branched simulation, one per line: `<output_dir> <key>=<value> ...`;
+   the overrides are checked on a copy of the input parameters, so that a wrong variant is detected before the simulation starts */
+struct array* read_branch_variants(char branch_variants_filename[], char output_dir_name[], struct network_params net_params, struct payments_params pay_params, struct simulation_params sim_params){
+  FILE* variants_file;
+  char line[4096], *token, *separator;
+  struct array* variants;
+  struct branch_variant* variant;
+  struct network_params variant_net_params;
+  struct payments_params variant_pay_params;
+  struct simulation_params variant_sim_params;
+  long line_number = 0;
+  int written;
+
+  variants_file = fopen(branch_variants_filename, "r");
+  if(variants_file == NULL) {
+    fprintf(stderr, "ERROR: cannot open file <%s>\n", branch_variants_filename);
     exit(-1);
   }
 
-  while(fgets(line, 1024, input_file)){
-
-    parameter = strtok(line, "=");
-    value = strtok(NULL, "=");
-    if(parameter==NULL || value==NULL){
-      fprintf(stderr, "ERROR: wrong format in file <cloth_input.txt>\n");
-      fclose(input_file);
+  variants = array_initialize(10);
+  while(fgets(line, sizeof(line), variants_file)) {
+    line_number++;
+    line[strcspn(line, "\r\n")] = '\0';
+    token = strtok(line, " \t");
+    if(token == NULL || token[0] == '#') continue;
+
+    variant = malloc(sizeof(struct branch_variant));
+    variant->n_overrides = 0;
+    if(token[0] == '/')
+      written = snprintf(variant->output_dir_name, sizeof(variant->output_dir_name), "%s%s", token, token[strlen(token)-1] == '/' ? "" : "/");
+    else
+      written = snprintf(variant->output_dir_name, sizeof(variant->output_dir_name), "%s%s%s", output_dir_name, token, token[strlen(token)-1] == '/' ? "" : "/");
+    if(written >= (int)sizeof(variant->output_dir_name)) {
+      fprintf(stderr, "ERROR: output directory too long at line %ld of <%s>\n", line_number, branch_variants_filename);
       exit(-1);
     }
-
-    if(value[0]==' ' || parameter[strlen(parameter)-1]==' '){
-      fprintf(stderr, "ERROR: no space allowed after/before <=> character in <cloth_input.txt>. Space detected in parameter <%s>\n", parameter);
-      fclose(input_file);
+    if(mkdir(variant->output_dir_name, 0755) != 0 && errno != EEXIST) {
+      fprintf(stderr, "ERROR: cannot create directory <%s>\n", variant->output_dir_name);
       exit(-1);
     }
 
-    value[strlen(value)-1] = '\0';
-
-    if(strcmp(parameter, "generate_network_from_file")==0){
-      if(strcmp(value, "true")==0)
-        net_params->network_from_file=1;
-      else if(strcmp(value, "false")==0)
-        net_params->network_from_file=0;
-      else{
-        fprintf(stderr, "ERROR: wrong value of parameter <%s> in <cloth_input.txt>. Possible values are <true> or <false>\n", parameter);
-        fclose(input_file);
+    variant_net_params = net_params;
+    variant_pay_params = pay_params;
+    variant_sim_params = sim_params;
+    while((token = strtok(NULL, " \t")) != NULL) {
+      separator = strchr(token, '=');
+      if(separator == NULL || separator == token) {
+        fprintf(stderr, "ERROR: wrong format of override <%s> at line %ld of <%s>\n", token, line_number, branch_variants_filename);
         exit(-1);
       }
-    }
-    else if(strcmp(parameter, "nodes_filename")==0){
-      strcpy(net_params->nodes_filename, value);
-    }
-    else if(strcmp(parameter, "channels_filename")==0){
-      strcpy(net_params->channels_filename, value);
-    }
-    else if(strcmp(parameter, "edges_filename")==0){
-      strcpy(net_params->edges_filename, value);
-    }
-    else if(strcmp(parameter, "n_additional_nodes")==0){
-      net_params->n_nodes = strtol(value, NULL, 10);
-    }
-    else if(strcmp(parameter, "n_channels_per_node")==0){
-      net_params->n_channels = strtol(value, NULL, 10);
-    }
-    else if(strcmp(parameter, "capacity_per_channel")==0){
-      net_params->capacity_per_channel = strtol(value, NULL, 10);
-    }
-    else if(strcmp(parameter, "faulty_node_probability")==0){
-      net_params->faulty_node_prob = strtod(value, NULL);
-    }
-    else if(strcmp(parameter, "generate_payments_from_file")==0){
-      if(strcmp(value, "true")==0)
-        pay_params->payments_from_file=1;
-      else if(strcmp(value, "false")==0)
-        pay_params->payments_from_file=0;
-      else{
-        fprintf(stderr, "ERROR: wrong value of parameter <%s> in <cloth_input.txt>. Possible values are <true> or <false>\n", parameter);
-        fclose(input_file);
+      *separator = '\0';
+      if(is_structural_parameter(token)) {
+        fprintf(stderr, "ERROR: parameter <%s> cannot be changed in a branch (line %ld of <%s>)\n", token, line_number, branch_variants_filename);
         exit(-1);
       }
-    }
-    else if(strcmp(parameter, "enable_fake_balance_update")==0){
-      if(strcmp(value, "true")==0)
-        net_params->enable_fake_balance_update = 1;
-      else if(strcmp(value, "false")==0)
-        net_params->enable_fake_balance_update = 0;
-      else{
-        fprintf(stderr, "ERROR: wrong value of parameter <%s> in <cloth_input.txt>. Possible values are <true> or <false>\n", parameter);
-        fclose(input_file);
-        exit(-1);
-      }
-    }
-    else if(strcmp(parameter, "payment_timeout")==0) {
-        net_params->payment_timeout=strtol(value, NULL, 10);
-    }
-    else if(strcmp(parameter, "average_payment_forward_interval")==0) {
-        net_params->average_payment_forward_interval=strtol(value, NULL, 10);
-    }
-    else if(strcmp(parameter, "variance_payment_forward_interval")==0) {
-        net_params->variance_payment_forward_interval=strtol(value, NULL, 10);
-    }
-    else if(strcmp(parameter, "group_broadcast_delay")==0) {
-        net_params->group_broadcast_delay=strtol(value, NULL, 10);
-    }
-    else if(strcmp(parameter, "routing_method")==0){
-      if(strcmp(value, "cloth_original")==0)
-        net_params->routing_method=CLOTH_ORIGINAL;
-      else if(strcmp(value, "channel_update")==0)
-        net_params->routing_method=CHANNEL_UPDATE;
-      else if(strcmp(value, "group_routing_cul")==0)
-        net_params->routing_method=GROUP_ROUTING_CUL;
-      else if(strcmp(value, "group_routing")==0)
-        net_params->routing_method=GROUP_ROUTING;
-      else if(strcmp(value, "ideal")==0)
-        net_params->routing_method=IDEAL;
-      else{
-        fprintf(stderr, "ERROR: wrong value of parameter <%s> in <cloth_input.txt>. Possible values are [\"cloth_original\", \"channel_update\", \"group_routing\", \"ideal\"]\n", parameter);
-        fclose(input_file);
+      if(variant->n_overrides == MAX_BRANCH_OVERRIDES || strlen(token) >= sizeof(variant->parameters[0]) || strlen(separator+1) >= sizeof(variant->values[0])) {
+        fprintf(stderr, "ERROR: too many or too long overrides at line %ld of <%s>\n", line_number, branch_variants_filename);
         exit(-1);
       }
-    }
-    else if(strcmp(parameter, "group_cap_update")==0){
-      if(strcmp(value, "true")==0)
-        net_params->group_cap_update=1;
-      else if(strcmp(value, "false")==0)
-        net_params->group_cap_update=0;
-      else
-        net_params->group_cap_update=-1;
-    }
-    else if(strcmp(parameter, "group_size")==0){
-        if(strcmp(value, "")==0) net_params->group_size = -1;
-        else net_params->group_size = strtol(value, NULL, 10);
-    }
-    else if(strcmp(parameter, "group_limit_rate")==0){
-        if(strcmp(value, "")==0) net_params->group_limit_rate = -1;
-        else net_params->group_limit_rate = strtof(value, NULL);
-    }
-    else if(strcmp(parameter, "cul_threshold_dist_alpha")==0){
-        if(strcmp(value, "")==0) net_params->cul_threshold_dist_alpha = -1;
-        else net_params->cul_threshold_dist_alpha = strtof(value, NULL);
-    }
-    else if(strcmp(parameter, "cul_threshold_dist_beta")==0){
-        if(strcmp(value, "")==0) net_params->cul_threshold_dist_beta = -1;
-        else net_params->cul_threshold_dist_beta = strtof(value, NULL);
-    }
-    else if(strcmp(parameter, "payments_filename")==0){
-      strcpy(pay_params->payments_filename, value);
-    }
-    else if(strcmp(parameter, "payment_rate")==0){
-      pay_params->inverse_payment_rate = 1.0/strtod(value, NULL);
-    }
-    else if(strcmp(parameter, "n_payments")==0){
-      pay_params->n_payments = strtol(value, NULL, 10);
-    }
-    else if(strcmp(parameter, "average_payment_amount")==0){
-      pay_params->amount_mu = strtod(value, NULL);
-    }
-    else if(strcmp(parameter, "variance_payment_amount")==0){
-      pay_params->amount_sigma = strtod(value, NULL);
-    }
-    else if(strcmp(parameter, "mpp")==0){
-      pay_params->mpp = strtoul(value, NULL, 10);
-    }
-    else if(strcmp(parameter, "average_max_fee_limit")==0){
-        pay_params->max_fee_limit_mu = strtod(value, NULL);
-    }
-    else if(strcmp(parameter, "variance_max_fee_limit")==0){
-        pay_params->max_fee_limit_sigma = strtod(value, NULL);
-    }
-    else if(strcmp(parameter, "max_shard_count")==0){
-        pay_params->max_shard_count = strtol(value, NULL, 10);
-    }
-    else{
-      fprintf(stderr, "ERROR: unknown parameter <%s>\n", parameter);
-      fclose(input_file);
+      if(strcmp(token, "seed") != 0)
+        set_input_parameter(&variant_net_params, &variant_pay_params, &variant_sim_params, token, separator+1, branch_variants_filename);
+      strcpy(variant->parameters[variant->n_overrides], token);
+      strcpy(variant->values[variant->n_overrides], separator+1);
+      variant->n_overrides++;
+    }
+    check_input_parameters(&variant_net_params, &variant_pay_params, &variant_sim_params);
+    variants = array_insert(variants, variant);
+  }
+  fclose(variants_file);
+
+  return variants;
+}
+
+
+/* create a child process for each variant; it returns the variant to be executed by the calling process, NULL in the parent */
+struct branch_variant* fork_branches(struct array* variants, pid_t* branch_pids){
+  long i;
+  pid_t pid;
+
+  fflush(NULL);
+  for(i = 0; i < array_len(variants); i++) {
+    pid = fork();
+    if(pid == -1) {
+      fprintf(stderr, "ERROR: cannot fork branch <%s>\n", ((struct branch_variant*) array_get(variants, i))->output_dir_name);
       exit(-1);
     }
+    if(pid == 0) return array_get(variants, i);
+    branch_pids[i] = pid;
   }
-  // check invalid group settings
-  if(net_params->routing_method == GROUP_ROUTING){
-      if(net_params->group_limit_rate < 0 || net_params->group_limit_rate > 1){
-          fprintf(stderr, "ERROR: wrong value of parameter <group_limit_rate> in <cloth_input.txt>.\n");
-          exit(-1);
-      }
-      if(net_params->group_size < 0){
-          fprintf(stderr, "ERROR: wrong value of parameter <group_size> in <cloth_input.txt>.\n");
-          exit(-1);
-      }
-      if(net_params->group_cap_update == -1){
-          fprintf(stderr, "ERROR: wrong value of parameter <group_cap_update> in <cloth_input.txt>.\n");
-          exit(-1);
-      }
-  }
-  fclose(input_file);
+  return NULL;
 }
 
 
-unsigned int has_shards(struct payment* payment){
-  return (payment->shards_id[0] != -1 && payment->shards_id[1] != -1);
+/* executed by the child process of a branch: it redirects the output to the directory of the variant and applies the overrides;
+   payments not started yet get a new maximum fee (and a new initial path) if the fee limit distribution is overridden,
+   as the streamed payments created after the branch */
+void apply_branch_variant(struct branch_variant* variant, char output_dir_name[], struct network_params* net_params, struct payments_params* pay_params, struct simulation_params* sim_params,
+                          struct simulation* simulation, struct network* network, struct array* payments, struct payment_source* payment_source){
+  char log_filename[512], checkpoint_filename[256];
+  double max_fee_limit_mu, max_fee_limit_sigma;
+  struct payment* payment;
+  long i, n_resampled;
+
+  strcpy(output_dir_name, variant->output_dir_name);
+  snprintf(log_filename, sizeof(log_filename), "%scloth.log", output_dir_name);
+  if(freopen(log_filename, "w", stdout) == NULL) {
+    fprintf(stderr, "ERROR: cannot open file <%s>\n", log_filename);
+    exit(-1);
+  }
+  dup2(fileno(stdout), STDERR_FILENO);
+  printf("BRANCH <%s> AT TIME %"PRIu64" ms\n", output_dir_name, simulation->current_time);
+
+  max_fee_limit_mu = pay_params->max_fee_limit_mu;
+  max_fee_limit_sigma = pay_params->max_fee_limit_sigma;
+  strcpy(checkpoint_filename, sim_params->checkpoint_filename);
+  for(i = 0; i < variant->n_overrides; i++) {
+    printf("%s=%s\n", variant->parameters[i], variant->values[i]);
+    if(strcmp(variant->parameters[i], "seed")==0)
+      gsl_rng_set(simulation->random_generator, strtoul(variant->values[i], NULL, 10));
+    else
+      set_input_parameter(net_params, pay_params, sim_params, variant->parameters[i], variant->values[i], "branch variant");
+  }
+  if(strcmp(checkpoint_filename, sim_params->checkpoint_filename) != 0)
+    resolve_output_filename(sim_params->checkpoint_filename, output_dir_name);
+
+  telemetry_fork(output_dir_name, sim_params->telemetry_flush_interval);
+  trace_fork(output_dir_name);
+  profiler_initialize(sim_params->event_profiler);
+
+  if(max_fee_limit_mu == pay_params->max_fee_limit_mu && max_fee_limit_sigma == pay_params->max_fee_limit_sigma) return;
+  n_resampled = 0;
+  for(i = 0; i < array_len(payments); i++) {
+    payment = array_get(payments, i);
+    if(payment->is_shard || payment->attempts != 0 || payment->start_time <= simulation->current_time) continue;
+    payment->max_fee_limit = generate_max_fee_limit(*pay_params, simulation->random_generator);
+    n_resampled++;
+    if(paths == NULL) continue;
+    free_path(paths[payment->id]);
+    paths[payment->id] = NULL;
+    jobs = push(jobs, &(payment->id));
+  }
+  if(payment_source != NULL) {
+    payment_source->pay_params = *pay_params;
+    payment_source->resample_max_fee_limit = 1;
+  }
+  run_dijkstra_jobs(network, payments, simulation->current_time, net_params->routing_method);
+  printf("Maximum fee and initial path recomputed for %ld payments\n", n_resampled);
 }
 
 
-/* Recursively collect stats from a shard and its children */
-static void collect_shard_stats(struct array* payments, struct payment* shard, 
-                                uint64_t* max_end_time, int* all_success, 
-                                int* no_balance_count, int* offline_node_count,
-                                int* any_timeout, int* total_attempts, uint64_t* total_fee) {
-  if(shard == NULL) return;
-  
-  // If this shard has children, process them recursively
-  if(has_shards(shard)) {
-    struct payment* child1 = array_get(payments, shard->shards_id[0]);
-    struct payment* child2 = array_get(payments, shard->shards_id[1]);
-    collect_shard_stats(payments, child1, max_end_time, all_success, no_balance_count, 
-                        offline_node_count, any_timeout, total_attempts, total_fee);
-    collect_shard_stats(payments, child2, max_end_time, all_success, no_balance_count,
-                        offline_node_count, any_timeout, total_attempts, total_fee);
-  } else {
-    // Leaf shard - collect stats
-    if(shard->end_time > *max_end_time) *max_end_time = shard->end_time;
-    if(!shard->is_success) *all_success = 0;
-    *no_balance_count += shard->no_balance_count;
-    *offline_node_count += shard->offline_node_count;
-    if(shard->is_timeout) *any_timeout = 1;
-    *total_attempts += shard->attempts;
-    if(shard->route != NULL) *total_fee += shard->route->total_fee;
+/* wait for the child processes of the branches; it returns the number of branches that failed */
+int wait_branches(struct array* variants, pid_t* branch_pids){
+  long i;
+  int status, n_failed = 0;
+
+  for(i = 0; i < array_len(variants); i++) {
+    if(waitpid(branch_pids[i], &status, 0) == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      fprintf(stderr, "ERROR: branch <%s> failed\n", ((struct branch_variant*) array_get(variants, i))->output_dir_name);
+      n_failed++;
+    }
   }
+  return n_failed;
 }
 
-/* process stats of payments that were split (mpp payments) */
+
+/* process stats of payments that were split (mpp payments): each shard is visited once, from the shard tree of its root */
 void post_process_payment_stats(struct array* payments){
   long i;
-  struct payment* payment, *shard1, *shard2;
+  struct payment* payment;
   for(i = 0; i < array_len(payments); i++){
     payment = array_get(payments, i);
-    if(!has_shards(payment)) continue;
-    
     // For root payments with shards, collect stats from all descendants
-    if(payment->parent_id == -1 || payment->root_payment_id == payment->id) {
-      uint64_t max_end_time = 0;
-      int all_success = 1;
-      int no_balance_count = 0;
-      int offline_node_count = 0;
-      int any_timeout = 0;
-      int total_attempts = 0;
-      uint64_t total_fee = 0;
-      
-      shard1 = array_get(payments, payment->shards_id[0]);
-      shard2 = array_get(payments, payment->shards_id[1]);
-      
-      collect_shard_stats(payments, shard1, &max_end_time, &all_success, &no_balance_count,
-                          &offline_node_count, &any_timeout, &total_attempts, &total_fee);
-      collect_shard_stats(payments, shard2, &max_end_time, &all_success, &no_balance_count,
-                          &offline_node_count, &any_timeout, &total_attempts, &total_fee);
-      
-      payment->end_time = max_end_time;
-      payment->is_success = all_success;
-      payment->no_balance_count = no_balance_count;
-      payment->offline_node_count = offline_node_count;
-      payment->is_timeout = any_timeout;
-      payment->attempts = total_attempts;
-      
-      // Note: We don't set a route on the parent for MPP payments
-      // Each shard has its own route in the output
-    }
+    if(payment->parent_id == -1 && has_shards(payment))
+      aggregate_shard_stats(payments, payment);
   }
 }
 
 
+/* MPP summary statistics (only root payments that triggered MPP are counted) */
+struct mpp_summary {
+  int n_payments;
+  int n_success;
+  int n_shards;
+};
+
+
+static void add_mpp_summary(struct mpp_summary* summary, struct payment* payment){
+  if(payment->parent_id != -1 || (!payment->mpp_triggered && payment->shard_count == 0)) return;
+  summary->n_payments++;
+  if(payment->is_success) summary->n_success++;
+  summary->n_shards += payment->shard_count;
+}
+
+
 gsl_rng* initialize_random_generator(){
   gsl_rng_env_setup();
   return gsl_rng_alloc (gsl_rng_default);
 }
 
 
+/* return the simulation time after which the next checkpoint is written (UINT64_MAX if no checkpoint is due) */
+uint64_t get_next_checkpoint_time(struct simulation_params sim_params, uint64_t current_time) {
+  uint64_t next_checkpoint_time = UINT64_MAX;
+  if(strcmp(sim_params.checkpoint_filename, "")==0) return next_checkpoint_time;
+  if(sim_params.checkpoint_time > current_time)
+    next_checkpoint_time = sim_params.checkpoint_time;
+  if(sim_params.checkpoint_interval != 0 && (current_time/sim_params.checkpoint_interval + 1)*sim_params.checkpoint_interval < next_checkpoint_time)
+    next_checkpoint_time = (current_time/sim_params.checkpoint_interval + 1)*sim_params.checkpoint_interval;
+  return next_checkpoint_time;
+}
+
+
 int main(int argc, char *argv[]) {
   struct event* event;
   clock_t  begin, end;
   double time_spent=0.0;
-  long time_spent_thread = 0;
+  uint64_t time_spent_thread = 0;
   struct network_params net_params;
   struct payments_params pay_params;
+  struct simulation_params sim_params;
   struct timespec start, finish;
   struct network *network;
-  long n_nodes, n_edges;
+  long n_nodes, n_edges, i;
   struct array* payments;
+  struct payment* payment;
+  struct payment_source* payment_source = NULL;
+  struct payment_writer* payment_writer = NULL;
+  struct ramp* ramp = NULL;
+  struct mpp_summary mpp_summary = {0, 0, 0};
   struct simulation* simulation;
+  struct element* group_add_queue = NULL;
+  unsigned int is_restored;
+  uint64_t next_checkpoint_time, next_branch_time, last_payment_time;
+  struct array* branch_variants = NULL;
+  struct branch_variant* branch_variant;
+  long payment_source_offset;
+  pid_t* branch_pids = NULL;
+  int n_failed_branches = 0;
   char output_dir_name[256];
 
   if(argc != 2) {
@@ -570,7 +477,16 @@ int main(int argc, char *argv[]) {
   }
   strcpy(output_dir_name, argv[1]);
 
-  read_input(&net_params, &pay_params);
+  read_input(&net_params, &pay_params, &sim_params);
+  resolve_output_filename(sim_params.checkpoint_filename, output_dir_name);
+  resolve_output_filename(sim_params.event_trace_filename, output_dir_name);
+  if(sim_params.branch_time != 0) {
+    branch_variants = read_branch_variants(sim_params.branch_variants_filename, output_dir_name, net_params, pay_params, sim_params);
+    branch_pids = malloc(sizeof(pid_t)*(array_len(branch_variants) + 1));
+  }
+  telemetry_open(output_dir_name, sim_params.telemetry_flush_interval);
+  profiler_initialize(sim_params.event_profiler);
+  initialize_attempt_log(sim_params.attempts_history);
 
   simulation = malloc(sizeof(struct simulation));
   simulation->current_time = 0;
@@ -578,43 +494,127 @@ int main(int argc, char *argv[]) {
   simulation->random_generator = initialize_random_generator();
   printf("NETWORK INITIALIZATION\n");
   network = initialize_network(net_params, simulation->random_generator);
+  initialize_topology(network, net_params);
   n_nodes = array_len(network->nodes);
   n_edges = array_len(network->edges);
 
-    // add edge which is not a member of any group to group_add_queue
-    struct element* group_add_queue = NULL;
-    if(net_params.routing_method == GROUP_ROUTING || net_params.routing_method == GROUP_ROUTING_CUL) {
-        for (int i = 0; i < n_edges; i++) {
-            group_add_queue = list_insert_sorted_position(group_add_queue, array_get(network->edges, i), (long (*)(void *)) get_edge_balance);
-        }
-        group_add_queue = construct_groups(simulation, group_add_queue, network, net_params);
-    }
+  /* the payments of a workload are generated in a payment trace, which is then read as a payments file */
+  if(!pay_params.payments_from_file && strcmp(pay_params.workload, "uniform") != 0) {
+    generate_workload(pay_params, network, "payments.cpay");
+    pay_params.payments_from_file = 1;
+    strcpy(pay_params.payments_filename, "payments.cpay");
+  }
+
+  /* streamed payments are created when the simulation reaches their start time, in the main loop */
+  if(pay_params.stream_payments)
+    payment_source = new_payment_source(pay_params, n_nodes, simulation->random_generator);
+  /* with the load ramp, the payments arrive in stages from the start of the simulation */
+  if(pay_params.ramp_mode) {
+    ramp = new_ramp(pay_params, output_dir_name);
+    payment_source->ramp = ramp;
+    start_ramp_stage(ramp, payment_source, 1);
+  }
+
+  is_restored = strcmp(sim_params.restore_filename, "") != 0;
+  if(is_restored) {
+    /* groups, payments, events and initial paths are taken from the checkpoint */
+    printf("RESTORE FROM CHECKPOINT <%s>\n", sim_params.restore_filename);
+    group_add_queue = read_checkpoint(sim_params.restore_filename, simulation, network, &payments, payment_source);
+    last_payment_time = get_last_payment_time(payments, payment_source);
+    set_topology_horizon(last_payment_time);
+    initialize_availability(network, net_params, last_payment_time);
+    initialize_dijkstra(n_nodes, n_edges, payment_source == NULL ? payments : NULL);
+    printf("Simulation restored at time %"PRIu64" ms\n", simulation->current_time);
+  }
+  else {
+    group_add_queue = initialize_groups(simulation, network, net_params);
     printf("group_cover_rate on init : %f\n", (float)(array_len(network->edges) - list_len(group_add_queue)) / (float)(array_len(network->edges)));
 
-  printf("PAYMENTS INITIALIZATION\n");
-  payments = initialize_payments(pay_params,  n_nodes, simulation->random_generator);
+    printf("PAYMENTS INITIALIZATION\n");
+    if(payment_source != NULL) {
+      payments = array_initialize(1000);
+      telemetry->total_payments = payment_source->n_payments;
+    }
+    else {
+      payments = initialize_payments(pay_params,  n_nodes, simulation->random_generator);
+      // senders and receivers of the payments are ids of the input network
+      for(i = 0; network->node_map != NULL && i < array_len(payments); i++) {
+        payment = array_get(payments, i);
+        payment->sender = get_renumbered_id(network->node_map, payment->sender);
+        payment->receiver = get_renumbered_id(network->node_map, payment->receiver);
+      }
+      telemetry->total_payments = array_len(payments);
+    }
+    last_payment_time = get_last_payment_time(payments, payment_source);
+    initialize_availability(network, net_params, last_payment_time);
 
-  printf("EVENTS INITIALIZATION\n");
-  simulation->events = initialize_events(payments);
-  initialize_dijkstra(n_nodes, n_edges, payments);
+    printf("EVENTS INITIALIZATION\n");
+    simulation->events = initialize_events(payments);
+    schedule_topology_changes(simulation, last_payment_time, net_params);
 
-  printf("INITIAL DIJKSTRA THREADS EXECUTION\n");
-  clock_gettime(CLOCK_MONOTONIC, &start);
-  run_dijkstra_threads(network, payments, 0, net_params.routing_method);
-  clock_gettime(CLOCK_MONOTONIC, &finish);
-  time_spent_thread = finish.tv_sec - start.tv_sec;
-  printf("Time consumed by initial dijkstra executions: %ld s\n", time_spent_thread);
+    // streamed payments have no initial path: it is searched when they start
+    if(payment_source != NULL)
+      initialize_dijkstra(n_nodes, n_edges, NULL);
+    else {
+      initialize_dijkstra(n_nodes, n_edges, payments);
+
+      printf("INITIAL DIJKSTRA THREADS EXECUTION\n");
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      run_dijkstra_threads(network, payments, 0, net_params.routing_method);
+      clock_gettime(CLOCK_MONOTONIC, &finish);
+      time_spent_thread = (finish.tv_sec - start.tv_sec)*1000000000ULL + finish.tv_nsec - start.tv_nsec;
+      profiler_set_initial_dijkstra_time(time_spent_thread);
+      printf("Time consumed by initial dijkstra executions: %lf s\n", (double)time_spent_thread/1E9);
+    }
+  }
 
   printf("EXECUTION OF THE SIMULATION\n");
 
   /* core of the discrete-event simulation: extract next event, advance simulation time, execute the event */
   begin = clock();
-  simulation->current_time = 1;
-  long completed_payments = 0;
-  while(heap_len(simulation->events) != 0) {
+  if(strcmp(sim_params.event_trace_filename, "")!=0)
+    trace_open(sim_params.event_trace_filename, network);
+  if(!is_restored)
+    simulation->current_time = 1;
+  next_checkpoint_time = get_next_checkpoint_time(sim_params, simulation->current_time);
+  next_branch_time = sim_params.branch_time != 0 ? sim_params.branch_time : UINT64_MAX;
+  if(pay_params.retire_payments)
+    payment_writer = open_payment_writer(output_dir_name);
+  telemetry->state = TELEMETRY_RUNNING;
+  telemetry_flush();
+  while(heap_len(simulation->events) != 0 || get_next_arrival_time(payment_source) != UINT64_MAX) {
+    /* streamed payments starting before the next event are created first; with no event left, only the next arrival is created */
+    schedule_payment_arrivals(payment_source, simulation, network, &payments, heap_len(simulation->events) != 0 ? ((struct event*) heap_peek(simulation->events))->time : get_next_arrival_time(payment_source));
+    /* the checkpoint at time T contains the state after all the events with time <= T have been executed */
+    event = heap_peek(simulation->events);
+    if(event->time > next_checkpoint_time) {
+      simulation->current_time = next_checkpoint_time;
+      write_checkpoint(sim_params.checkpoint_filename, simulation, network, payments, payment_source, group_add_queue);
+      printf("Checkpoint written at time %"PRIu64" ms in <%s>\n", simulation->current_time, sim_params.checkpoint_filename);
+      // the state does not change until the next event: skip the checkpoints that would be identical to this one
+      next_checkpoint_time = get_next_checkpoint_time(sim_params, event->time - 1);
+    }
+    if(event->time > next_branch_time) {
+      simulation->current_time = next_branch_time;
+      next_branch_time = UINT64_MAX;
+      payment_source_offset = get_payment_source_offset(payment_source);
+      branch_variant = fork_branches(branch_variants, branch_pids);
+      reopen_payment_source(payment_source, payment_source_offset);
+      if(branch_variant != NULL) {
+        free(branch_pids);
+        branch_pids = NULL;
+        apply_branch_variant(branch_variant, output_dir_name, &net_params, &pay_params, &sim_params, simulation, network, payments, payment_source);
+        begin = clock(); // the processor time of the child starts from zero
+        next_checkpoint_time = get_next_checkpoint_time(sim_params, simulation->current_time);
+      }
+      else
+        printf("Simulation branched at time %"PRIu64" ms into %ld variants\n", simulation->current_time, array_len(branch_variants));
+    }
+
     event = heap_pop(simulation->events, compare_event);
 
     simulation->current_time = event->time;
+    PROFILER_EVENT_BEGIN(event_start);
     switch(event->type){
     case FINDPATH:
       find_path(event, simulation, network, &payments, pay_params, net_params);
@@ -641,7 +641,10 @@ int main(int argc, char *argv[]) {
       receive_fail(event, simulation, network, net_params);
       break;
     case OPENCHANNEL:
-      open_channel(network, simulation->random_generator, net_params);
+      group_add_queue = open_channel(event, simulation, network, net_params, group_add_queue);
+      break;
+    case CLOSECHANNEL:
+      group_add_queue = close_channel(event, simulation, network, net_params, group_add_queue);
       break;
     case CHANNELUPDATEFAIL:
       channel_update_fail(event, simulation, network);
@@ -657,52 +660,66 @@ int main(int argc, char *argv[]) {
       printf("ERROR wrong event type\n");
       exit(-1);
     }
-
-    struct payment* p = array_get(payments, event->payment->id);
-    if(p->end_time != 0 && event->type != UPDATEGROUP && event->type != CONSTRUCTGROUPS && event->type != CHANNELUPDATEFAIL && event->type != CHANNELUPDATESUCCESS){
-        completed_payments++;
-        char progress_filename[512];
-        strcpy(progress_filename, output_dir_name);
-        strcat(progress_filename, "progress.tmp");
-        FILE* progress_file = fopen(progress_filename, "w");
-        if(progress_file != NULL){
-            fprintf(progress_file, "%f", (float)completed_payments / (float)array_len(payments));
+    PROFILER_EVENT_END(event_start, event->type);
+    trace_event(event);
+
+    struct payment* p = event->payment != NULL ? array_get(payments, event->payment->id) : NULL;
+    if(p != NULL && p->end_time != 0 && event->type != UPDATEGROUP && event->type != CONSTRUCTGROUPS && event->type != CHANNELUPDATEFAIL && event->type != CHANNELUPDATESUCCESS){
+        telemetry->completed_payments++;
+    }
+    telemetry_tick(simulation->current_time, heap_len(simulation->events));
+
+    payment = event->payment;
+    free_event(event);
+    /* a root payment is final after the last event of its shards: it is counted in its stage of the ramp, and retired */
+    if((payment_writer != NULL || ramp != NULL) && payment != NULL && payment->n_events == 0) {
+      payment = array_get(payments, payment->root_payment_id);
+      if(is_payment_final(payments, payment)) {
+        if(pay_params.mpp && has_shards(payment))
+          aggregate_shard_stats(payments, payment);
+        if(ramp != NULL)
+          record_ramp_payment(ramp, payment_source, payment, simulation->current_time);
+        if(payment_writer != NULL) {
+          if(pay_params.mpp) add_mpp_summary(&mpp_summary, payment);
+          retire_payment(payment_writer, payments, payment, network);
         }
-        fclose(progress_file);
+      }
     }
-
-    free(event);
   }
   printf("\n");
   end = clock();
 
   if(pay_params.mpp) {
-    post_process_payment_stats(payments);
-    
-    // MPP summary statistics (only count root payments, not shards)
-    int mpp_payments = 0, mpp_success = 0, total_shards = 0;
-    for(long i = 0; i < array_len(payments); i++) {
-      struct payment* p = array_get(payments, i);
-      // Only count root payments that triggered MPP
-      if(p->parent_id == -1 && (p->mpp_triggered || p->shard_count > 0)) {
-        mpp_payments++;
-        if(p->is_success) mpp_success++;
-        total_shards += p->shard_count;
-      }
+    // retired payments were counted when they were retired
+    if(!pay_params.retire_payments) {
+      post_process_payment_stats(payments);
+      for(i = 0; i < array_len(payments); i++)
+        add_mpp_summary(&mpp_summary, array_get(payments, i));
     }
     printf("[MPP DEBUG] SUMMARY: mpp_payments=%d, mpp_success=%d, total_shards_created=%d\n",
-           mpp_payments, mpp_success, total_shards);
+           mpp_summary.n_payments, mpp_summary.n_success, mpp_summary.n_shards);
   }
 
   time_spent = (double) (end - begin)/CLOCKS_PER_SEC;
   printf("Time consumed by simulation events: %lf s\n", time_spent);
 
-  write_output(network, payments, output_dir_name);
+  trace_close();
+  close_payment_writer(payment_writer);
+  write_output(network, pay_params.retire_payments ? NULL : payments, output_dir_name);
+  profiler_write(output_dir_name);
 
-  // Free payment routes and history
+  telemetry->state = TELEMETRY_FINISHED;
+  telemetry_close();
+
+  if(branch_pids != NULL && next_branch_time == UINT64_MAX)
+    n_failed_branches = wait_branches(branch_variants, branch_pids);
+  else if(branch_pids != NULL)
+    fprintf(stderr, "WARNING: the simulation ended before <branch_time>, no branch was executed\n");
+
+  // Free payment routes (the attempts are freed with the attempt log)
   for(long i = 0; i < array_len(payments); i++) {
     struct payment* p = array_get(payments, i);
-    if(p->route != NULL) {
+    if(p != NULL && p->route != NULL) {
       free_route(p->route);
       p->route = NULL;
     }
@@ -713,7 +730,12 @@ int main(int argc, char *argv[]) {
     heap_free(simulation->events);
   free(simulation);
 
-//    free_network(network);
+  free_network(network);
+  free_topology();
+  free_ramp(ramp);
+  free_payment_source(payment_source);
+  free_attempt_log();
+  free_routing_pool();
 
-  return 0;
+  return n_failed_branches == 0 ? 0 : -1;
 }
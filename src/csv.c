@@ -0,0 +1,309 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../include/csv.h"
+
+/* Functions in this file read the csv input files of the simulation (network and payments).
+   A file is mapped in memory and split in line-aligned chunks, one per thread: each thread first counts the rows of its chunk,
+   then, once the position of the first row of every chunk is known, parses its rows directly into the table */
+
+
+struct csv_chunk {
+  const char* begin;
+  const char* end;
+  long n_lines;
+  long n_rows;
+  long first_line;
+  long first_row;
+  struct csv_table* table;
+  char* column_types;
+  long n_required_columns;
+  union csv_value* default_values;
+  const char* error;
+  long error_line;
+  long error_column;
+};
+
+static const double powers_of_ten[] = {1E0, 1E1, 1E2, 1E3, 1E4, 1E5, 1E6, 1E7, 1E8, 1E9, 1E10, 1E11, 1E12, 1E13, 1E14, 1E15, 1E16, 1E17, 1E18, 1E19, 1E20, 1E21, 1E22};
+
+
+static int is_digit(char c) {
+  return (unsigned char)(c - '0') < 10;
+}
+
+
+/* parse an integer ending at `end` or at the first non-digit character; return the first character after it, or NULL if there is no integer */
+static const char* parse_integer(const char* p, const char* end, int64_t* value) {
+  const char* digits;
+  uint64_t v = 0, digit;
+  int is_negative = 0;
+
+  if(p < end && (*p == '-' || *p == '+')) {
+    is_negative = *p == '-';
+    p++;
+  }
+  digits = p;
+  // up to 19 digits cannot overflow
+  while(p < end && p - digits < 19 && is_digit(*p)) {
+    v = v*10 + (*p - '0');
+    p++;
+  }
+  if(p == digits) return NULL;
+  if(p < end && is_digit(*p)) {
+    digit = *p - '0';
+    if(v > (UINT64_MAX - digit)/10) return NULL;
+    v = v*10 + digit;
+    p++;
+    if(p < end && is_digit(*p)) return NULL;
+  }
+  *value = is_negative ? (int64_t)(0 - v) : (int64_t)v;
+  return p;
+}
+
+
+/* parse a floating point number; plain decimals with at most 15 significant digits are computed as an exact integer divided by an exact power of ten,
+   which gives the correctly rounded value (the same as strtod); other numbers (exponents, long mantissas, nan, inf) are parsed by strtod */
+static const char* parse_double(const char* p, const char* end, double* value) {
+  const char* start, *field_end;
+  char buffer[64], *parsed;
+  uint64_t mantissa = 0;
+  long n_digits = 0, n_fraction_digits = 0;
+  int is_negative = 0;
+  size_t length;
+
+  start = p;
+  if(p < end && (*p == '-' || *p == '+')) {
+    is_negative = *p == '-';
+    p++;
+  }
+  while(p < end && is_digit(*p)) {
+    mantissa = mantissa*10 + (*p - '0');
+    n_digits++;
+    p++;
+  }
+  if(p < end && *p == '.') {
+    p++;
+    while(p < end && is_digit(*p)) {
+      mantissa = mantissa*10 + (*p - '0');
+      n_digits++;
+      n_fraction_digits++;
+      p++;
+    }
+  }
+  if(n_digits > 0 && n_digits <= 15 && n_fraction_digits <= 22 && !(p < end && (*p == 'e' || *p == 'E'))) {
+    *value = (double)mantissa / powers_of_ten[n_fraction_digits];
+    if(is_negative) *value = -*value;
+    return p;
+  }
+
+  for(field_end = start; field_end < end && *field_end != ','; field_end++);
+  length = field_end - start;
+  if(length == 0 || length >= sizeof(buffer)) return NULL;
+  memcpy(buffer, start, length);
+  buffer[length] = '\0';
+  *value = strtod(buffer, &parsed);
+  if(parsed != buffer + length) return NULL;
+  return field_end;
+}
+
+
+/* count the lines and the non-empty lines (rows) of a chunk */
+static void* count_chunk_rows(void* arg) {
+  struct csv_chunk* chunk;
+  const char* p, *eol;
+
+  chunk = (struct csv_chunk*) arg;
+  chunk->n_lines = chunk->n_rows = 0;
+  for(p = chunk->begin; p < chunk->end; p = eol + 1) {
+    eol = memchr(p, '\n', chunk->end - p);
+    if(eol == NULL) eol = chunk->end;
+    chunk->n_lines++;
+    if(eol > p && !(eol - p == 1 && *p == '\r')) chunk->n_rows++;
+  }
+  return NULL;
+}
+
+
+static void set_chunk_error(struct csv_chunk* chunk, const char* error, long line, long column) {
+  chunk->error = error;
+  chunk->error_line = line;
+  chunk->error_column = column;
+}
+
+
+const char* csv_parse_row(const char* p, const char* end, char column_types[], long n_columns, long n_required_columns, union csv_value* default_values,
+                          union csv_value* values, long* error_column) {
+  long j;
+
+  for(j = 0; j < n_columns; j++) {
+    if(column_types[j] == 'i')
+      p = parse_integer(p, end, &(values[j].integer));
+    else
+      p = parse_double(p, end, &(values[j].real));
+    if(p == NULL) {
+      *error_column = j + 1;
+      return column_types[j] == 'i' ? "invalid integer" : "invalid number";
+    }
+    if(p == end) {
+      if(j + 1 < n_required_columns) {
+        *error_column = j + 2;
+        return "missing column";
+      }
+      for(j = j + 1; j < n_columns; j++)
+        values[j] = default_values[j];
+      return NULL;
+    }
+    if(*p != ',') {
+      *error_column = j + 1;
+      return column_types[j] == 'i' ? "invalid integer" : "invalid number";
+    }
+    if(j + 1 == n_columns) {
+      *error_column = j + 2;
+      return "too many columns";
+    }
+    p++;
+  }
+  return NULL;
+}
+
+
+/* parse the rows of a chunk; it stops at the first malformed row */
+static void* parse_chunk_rows(void* arg) {
+  struct csv_chunk* chunk;
+  const char* p, *eol, *line_end, *error;
+  long line, row, n_columns, error_column;
+
+  chunk = (struct csv_chunk*) arg;
+  n_columns = chunk->table->n_columns;
+  line = chunk->first_line;
+  row = chunk->first_row;
+  for(p = chunk->begin; p < chunk->end; p = eol + 1, line++) {
+    eol = memchr(p, '\n', chunk->end - p);
+    if(eol == NULL) eol = chunk->end;
+    line_end = (eol > p && eol[-1] == '\r') ? eol - 1 : eol;
+    if(line_end == p) continue;
+
+    error = csv_parse_row(p, line_end, chunk->column_types, n_columns, chunk->n_required_columns, chunk->default_values,
+                          chunk->table->values + row*n_columns, &error_column);
+    if(error != NULL) {
+      set_chunk_error(chunk, error, line, error_column);
+      return NULL;
+    }
+    row++;
+  }
+  return NULL;
+}
+
+
+/* execute `function` on every chunk, the first one in the calling thread and the others in new threads */
+static void run_chunks(void* (*function)(void*), struct csv_chunk* chunks, long n_chunks) {
+  pthread_t tid[CSV_MAX_THREADS];
+  long i;
+
+  for(i = 1; i < n_chunks; i++)
+    pthread_create(&(tid[i]), NULL, function, &(chunks[i]));
+  function(&(chunks[0]));
+  for(i = 1; i < n_chunks; i++)
+    pthread_join(tid[i], NULL);
+}
+
+
+struct csv_table* csv_read(char filename[], char column_types[], long n_required_columns, union csv_value* default_values) {
+  int fd;
+  struct stat file_stat;
+  char* data;
+  const char* body, *end, *boundary;
+  struct csv_table* table;
+  struct csv_chunk chunks[CSV_MAX_THREADS];
+  long i, n_chunks, n_cpus, n_rows, n_lines;
+  size_t size;
+
+  fd = open(filename, O_RDONLY);
+  if(fd == -1 || fstat(fd, &file_stat) != 0) {
+    fprintf(stderr, "ERROR: cannot open file <%s>\n", filename);
+    exit(-1);
+  }
+  size = file_stat.st_size;
+  data = NULL;
+  if(size > 0) {
+    data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(data == MAP_FAILED) {
+      fprintf(stderr, "ERROR: cannot map file <%s>\n", filename);
+      exit(-1);
+    }
+  }
+  close(fd);
+
+  table = malloc(sizeof(struct csv_table));
+  table->n_columns = strlen(column_types);
+  table->n_rows = 0;
+  table->values = NULL;
+
+  // skip the header
+  end = data + size;
+  body = size > 0 ? memchr(data, '\n', size) : NULL;
+  body = body == NULL ? end : body + 1;
+
+  n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  n_chunks = (end - body) / CSV_MIN_CHUNK_SIZE;
+  if(n_chunks > n_cpus) n_chunks = n_cpus;
+  if(n_chunks > CSV_MAX_THREADS) n_chunks = CSV_MAX_THREADS;
+  if(n_chunks < 1) n_chunks = 1;
+
+  for(i = 0; i < n_chunks; i++) {
+    memset(&(chunks[i]), 0, sizeof(struct csv_chunk));
+    chunks[i].table = table;
+    chunks[i].column_types = column_types;
+    chunks[i].n_required_columns = n_required_columns;
+    chunks[i].default_values = default_values;
+    if(i == 0)
+      chunks[i].begin = body;
+    else {
+      boundary = body + (end - body)*i/n_chunks;
+      if(boundary < chunks[i-1].begin) boundary = chunks[i-1].begin;
+      boundary = memchr(boundary, '\n', end - boundary);
+      chunks[i].begin = boundary == NULL ? end : boundary + 1;
+      chunks[i-1].end = chunks[i].begin;
+    }
+  }
+  chunks[n_chunks-1].end = end;
+
+  run_chunks(count_chunk_rows, chunks, n_chunks);
+  n_rows = 0;
+  n_lines = 2; // the header is line 1
+  for(i = 0; i < n_chunks; i++) {
+    chunks[i].first_row = n_rows;
+    chunks[i].first_line = n_lines;
+    n_rows += chunks[i].n_rows;
+    n_lines += chunks[i].n_lines;
+  }
+
+  table->n_rows = n_rows;
+  table->values = malloc((n_rows*table->n_columns > 0 ? n_rows*table->n_columns : 1)*sizeof(union csv_value));
+  run_chunks(parse_chunk_rows, chunks, n_chunks);
+
+  if(size > 0)
+    munmap(data, size);
+
+  for(i = 0; i < n_chunks; i++) {
+    if(chunks[i].error != NULL) {
+      fprintf(stderr, "ERROR: malformed row in <%s> at line %ld, column %ld: %s (expected %ld columns)\n", filename, chunks[i].error_line, chunks[i].error_column, chunks[i].error, table->n_columns);
+      exit(-1);
+    }
+  }
+
+  return table;
+}
+
+
+void csv_free(struct csv_table* table) {
+  free(table->values);
+  free(table);
+}
@@ -7,17 +7,25 @@
 
 /* Functions in this file manage events of the simulation; */
 
-struct event* new_event(uint64_t time, enum event_type type, long node_id, struct payment* payment) {
+struct event* new_event(uint64_t time, enum event_type type, long node_id, long hop_index, struct payment* payment) {
   struct event* e;
   e = malloc(sizeof(struct event));
   e->time = time;
   e->type = type;
   e->node_id = node_id;
+  e->hop_index = hop_index;
   e->payment = payment;
+  if(payment != NULL) payment->n_events++;
   return e;
 }
 
 
+void free_event(struct event* e) {
+  if(e->payment != NULL) e->payment->n_events--;
+  free(e);
+}
+
+
 int compare_event(struct event *e1, struct event *e2) {
   uint64_t time1, time2;
   time1=e1->time;
@@ -30,24 +38,39 @@ int compare_event(struct event *e1, struct event *e2) {
     return 1;
 }
 
-/* initialize events by creating an event for each payment for which a route has to be found */
+char* get_event_type_name(enum event_type type) {
+  switch(type) {
+  case FINDPATH: return "FINDPATH";
+  case SENDPAYMENT: return "SENDPAYMENT";
+  case FORWARDPAYMENT: return "FORWARDPAYMENT";
+  case RECEIVEPAYMENT: return "RECEIVEPAYMENT";
+  case FORWARDSUCCESS: return "FORWARDSUCCESS";
+  case FORWARDFAIL: return "FORWARDFAIL";
+  case RECEIVESUCCESS: return "RECEIVESUCCESS";
+  case RECEIVEFAIL: return "RECEIVEFAIL";
+  case OPENCHANNEL: return "OPENCHANNEL";
+  case CHANNELUPDATEFAIL: return "CHANNELUPDATEFAIL";
+  case CHANNELUPDATESUCCESS: return "CHANNELUPDATESUCCESS";
+  case UPDATEGROUP: return "UPDATEGROUP";
+  case CONSTRUCTGROUPS: return "CONSTRUCTGROUPS";
+  case CLOSECHANNEL: return "CLOSECHANNEL";
+  default: return "UNKNOWN";
+  }
+}
+
+/* initialize events by creating an event for each payment for which a route has to be found
+   (there is none if payments are streamed: their events are scheduled in payments.c) */
 struct heap* initialize_events(struct array* payments){
   struct heap* events;
   long i;
   struct event* event;
   struct payment* payment;
-  events = heap_initialize(array_len(payments)*10);
+  events = heap_initialize(array_len(payments) > 0 ? array_len(payments)*10 : 1024);
   for(i=0; i<array_len(payments); i++){
     payment = array_get(payments, i);
-    event = new_event(payment->start_time, FINDPATH, payment->sender, payment);
+    event = new_event(payment->start_time, FINDPATH, payment->sender, -1, payment);
     events = heap_insert(events, event, compare_event);
   }
-  /* events that open new channels during a simulation; currently NOT USED */
-  /* payment = array_get(payments, array_len(payments)-1); */
-  /* last_payment_time = payment->start_time; */
-  /* for(open_channel_time=100; open_channel_time<last_payment_time; open_channel_time+=100){ */
-  /*   event = new_event(open_channel_time, OPENCHANNEL, -1, NULL); */
-  /*   events = heap_insert(events, event, compare_event); */
-  /* } */
+  /* the events that open and close channels are scheduled in topology.c */
   return events;
 }
@@ -141,6 +141,11 @@ void* heap_pop(struct heap* h, int(*compare)()) {
   return min;
 }
 
+void* heap_peek(struct heap* h) {
+  if(h->index==0) return NULL;
+  return h->data[0];
+}
+
 long heap_len(struct heap*h){
   return h->index;
 }
@@ -13,18 +13,20 @@
 #include "../include/array.h"
 #include "../include/heap.h"
 #include "../include/payments.h"
+#include "../include/attempt_log.h"
 #include "../include/routing.h"
 #include "../include/network.h"
 #include "../include/event.h"
 #include "../include/utils.h"
+#include "../include/telemetry.h"
+#include "../include/trace.h"
+#include "../include/availability.h"
+#include "../include/network_core.h"
 
 /* Functions in this file simulate the HTLC mechanism for exchanging payments, as implemented in the Lightning Network.
    They are a (high-level) copy of functions in lnd-v0.9.1-beta (see files `routing/missioncontrol.go`, `htlcswitch/switch.go`, `htlcswitch/link.go`) */
 
 
-/* Forward declarations */
-static void free_path(struct array* path);
-
 /* AUXILIARY FUNCTIONS */
 
 /* compute the fees to be paid to a hop for forwarding the payment */
@@ -41,6 +43,7 @@ unsigned int check_balance_and_policy(struct edge* edge, struct edge* prev_edge,
   if(next_hop->amount_to_forward > edge->balance)
     return 0;
 
+#if CLOTH_VALIDATION_LEVEL >= 1
   if(next_hop->amount_to_forward < edge->policy.min_htlc){
     fprintf(stderr, "ERROR: policy.min_htlc not respected\n");
     exit(-1);
@@ -56,17 +59,18 @@ unsigned int check_balance_and_policy(struct edge* edge, struct edge* prev_edge,
     fprintf(stderr, "ERROR: policy.timelock not respected\n");
     exit(-1);
   }
+#endif
 
   return 1;
 }
 
 /* retrieve a hop from a payment route */
-struct route_hop *get_route_hop(long node_id, struct array *route_hops, int is_sender) {
+struct route_hop *get_route_hop(long node_id, struct route *route, int is_sender) {
   struct route_hop *route_hop;
   long i, index = -1;
 
-  for (i = 0; i < array_len(route_hops); i++) {
-    route_hop = array_get(route_hops, i);
+  for (i = 0; i < route->n_hops; i++) {
+    route_hop = &(route->hops[i]);
     if (is_sender && route_hop->from_node_id == node_id) {
       index = i;
       break;
@@ -80,7 +84,37 @@ struct route_hop *get_route_hop(long node_id, struct array *route_hops, int is_s
   if (index == -1)
     return NULL;
 
-  return array_get(route_hops, index);
+  return &(route->hops[index]);
+}
+
+/* retrieve the hop leaving (`is_sender`) or reaching the node of an HTLC event, from the position of the node in the route */
+static struct route_hop *get_event_route_hop(struct event *event, int is_sender) {
+  struct route *route;
+  struct route_hop *route_hop;
+  long index;
+
+  route = event->payment->route;
+  index = is_sender ? event->hop_index : event->hop_index - 1;
+#if CLOTH_VALIDATION_LEVEL >= 1
+  if (index < 0 || index >= route->n_hops) {
+    fprintf(stderr, "ERROR: hop %ld out of the route of payment %ld\n", index, event->payment->id);
+    exit(-1);
+  }
+#endif
+  route_hop = &(route->hops[index]);
+#if CLOTH_VALIDATION_LEVEL >= 1
+  if ((is_sender ? route_hop->from_node_id : route_hop->to_node_id) != event->node_id) {
+    fprintf(stderr, "ERROR: hop %ld of the route of payment %ld is not a hop of node %ld\n", index, event->payment->id, event->node_id);
+    exit(-1);
+  }
+#endif
+#if CLOTH_VALIDATION_LEVEL >= 2
+  if (route_hop != get_route_hop(event->node_id, route, is_sender)) {
+    fprintf(stderr, "ERROR: node %ld is not at position %ld of the route of payment %ld\n", event->node_id, event->hop_index, event->payment->id);
+    exit(-1);
+  }
+#endif
+  return route_hop;
 }
 
 
@@ -88,19 +122,19 @@ struct route_hop *get_route_hop(long node_id, struct array *route_hops, int is_s
 
 /* set the result of a node pair as success: it means that a payment was successfully forwarded in an edge connecting the two nodes of the node pair.
  This information is used by the sender node to find a route that maximizes the possibilities of successfully sending a payment */
-void set_node_pair_result_success(struct element** results, long from_node_id, long to_node_id, uint64_t success_amount, uint64_t success_time){
+void set_node_pair_result_success(struct network* network, struct element** results, long from_node_id, long to_node_id, uint64_t success_amount, uint64_t success_time){
   struct node_pair_result* result;
 
   result = get_by_key(results[from_node_id], to_node_id, is_equal_key_result);
 
   if(result == NULL){
-    result = malloc(sizeof(struct node_pair_result));
+    result = arena_alloc(network->data_arena, sizeof(struct node_pair_result));
     result->to_node_id = to_node_id;
     result->fail_time = 0;
     result->fail_amount = 0;
     result->success_time = 0;
     result->success_amount = 0;
-    results[from_node_id] = push(results[from_node_id], result);
+    results[from_node_id] = push_network_list(network, results[from_node_id], result);
   }
 
   result->success_time = success_time;
@@ -112,7 +146,7 @@ void set_node_pair_result_success(struct element** results, long from_node_id, l
 
 /* set the result of a node pair as success: it means that a payment failed when passing through  an edge connecting the two nodes of the node pair.
    This information is used by the sender node to find a route that maximizes the possibilities of successfully sending a payment */
-void set_node_pair_result_fail(struct element** results, long from_node_id, long to_node_id, uint64_t fail_amount, uint64_t fail_time){
+void set_node_pair_result_fail(struct network* network, struct element** results, long from_node_id, long to_node_id, uint64_t fail_amount, uint64_t fail_time){
   struct node_pair_result* result;
 
   result = get_by_key(results[from_node_id], to_node_id, is_equal_key_result);
@@ -122,12 +156,12 @@ void set_node_pair_result_fail(struct element** results, long from_node_id, long
       return;
 
   if(result == NULL){
-    result = malloc(sizeof(struct node_pair_result));
+    result = arena_alloc(network->data_arena, sizeof(struct node_pair_result));
     result->to_node_id = to_node_id;
     result->fail_time = 0;
     result->fail_amount = 0;
     result->success_time = 0;
-    results[from_node_id] = push(results[from_node_id], result);
+    results[from_node_id] = push_network_list(network, results[from_node_id], result);
   }
 
   result->fail_amount = fail_amount;
@@ -139,22 +173,19 @@ void set_node_pair_result_fail(struct element** results, long from_node_id, long
 }
 
 /* process a payment which succeeded */
-void process_success_result(struct node* node, struct payment *payment, uint64_t current_time){
+void process_success_result(struct network* network, struct node* node, struct payment *payment, uint64_t current_time){
   struct route_hop* hop;
   int i;
-  struct array* route_hops;
-  route_hops = payment->route->route_hops;
-  for(i=0; i<array_len(route_hops); i++){
-    hop = array_get(route_hops, i);
-    set_node_pair_result_success(node->results, hop->from_node_id, hop->to_node_id, hop->amount_to_forward, current_time);
+  for(i=0; i<payment->route->n_hops; i++){
+    hop = &(payment->route->hops[i]);
+    set_node_pair_result_success(network, node->results, hop->from_node_id, hop->to_node_id, hop->amount_to_forward, current_time);
   }
 }
 
 /* process a payment which failed (different processments depending on the error type) */
-void process_fail_result(struct node* node, struct payment *payment, uint64_t current_time){
+void process_fail_result(struct network* network, struct node* node, struct payment *payment, uint64_t current_time){
   struct route_hop* hop, *error_hop;
   int i;
-  struct array* route_hops;
 
   error_hop = payment->error.hop;
 
@@ -162,24 +193,23 @@ void process_fail_result(struct node* node, struct payment *payment, uint64_t cu
     return;
 
   if(payment->error.type == OFFLINENODE) {
-    set_node_pair_result_fail(node->results, error_hop->from_node_id, error_hop->to_node_id, 0, current_time);
-    set_node_pair_result_fail(node->results, error_hop->to_node_id, error_hop->from_node_id, 0, current_time);
+    set_node_pair_result_fail(network, node->results, error_hop->from_node_id, error_hop->to_node_id, 0, current_time);
+    set_node_pair_result_fail(network, node->results, error_hop->to_node_id, error_hop->from_node_id, 0, current_time);
   }
   else if(payment->error.type == NOBALANCE) {
-    route_hops = payment->route->route_hops;
-    for(i=0; i<array_len(route_hops); i++){
-      hop = array_get(route_hops, i);
+    for(i=0; i<payment->route->n_hops; i++){
+      hop = &(payment->route->hops[i]);
       if(hop->edge_id == error_hop->edge_id) {
-        set_node_pair_result_fail(node->results, hop->from_node_id, hop->to_node_id, hop->amount_to_forward, current_time);
+        set_node_pair_result_fail(network, node->results, hop->from_node_id, hop->to_node_id, hop->amount_to_forward, current_time);
         break;
       }
-      set_node_pair_result_success(node->results, hop->from_node_id, hop->to_node_id, hop->amount_to_forward, current_time);
+      set_node_pair_result_success(network, node->results, hop->from_node_id, hop->to_node_id, hop->amount_to_forward, current_time);
     }
   }
 }
 
 
-void generate_send_payment_event(struct payment* payment, struct array* path, struct simulation* simulation, struct network* network){
+void generate_send_payment_event(struct payment* payment, struct path* path, struct simulation* simulation, struct network* network){
   struct route* route;
   uint64_t next_event_time;
   struct event* send_payment_event;
@@ -189,9 +219,10 @@ void generate_send_payment_event(struct payment* payment, struct array* path, st
     free_route(payment->route);
   }
   payment->route = route;
+  trace_route(payment);
   // execute send_payment event immediately
   next_event_time = simulation->current_time;
-  send_payment_event = new_event(next_event_time, SENDPAYMENT, payment->sender, payment );
+  send_payment_event = new_event(next_event_time, SENDPAYMENT, payment->sender, 0, payment );
   simulation->events = heap_insert(simulation->events, send_payment_event, compare_event);
 }
 
@@ -216,9 +247,6 @@ struct payment* create_payment_shard(long shard_id, uint64_t shard_amount, struc
 
 // Helper function to get root payment and count shards
 static int count_total_shards(struct payment* root_payment) {
-  int count = 0;
-  if(root_payment->shards_id[0] != -1) count++;
-  if(root_payment->shards_id[1] != -1) count++;
   return root_payment->shard_count;
 }
 
@@ -232,21 +260,12 @@ static int can_create_more_shards(struct payment* root_payment, int max_shard_co
 
 // Structure for path with capacity and fee info (for GCB optimal N-split)
 struct path_info {
-  struct array* path;
+  struct path* path;
   uint64_t capacity;
   uint64_t fee;
   uint64_t min_htlc;  // Maximum min_htlc among all edges in the path
 };
 
-// Free a path (array of path_hop pointers)
-static void free_path(struct array* path) {
-  if(path == NULL) return;
-  for(int i = 0; i < array_len(path); i++) {
-    free(array_get(path, i));
-  }
-  array_free(path);
-}
-
 // Free path_info array
 // If free_paths is true, also free the path arrays inside each path_info.
 // Set free_paths to false only when paths have been handed off to shards.
@@ -262,10 +281,10 @@ static void free_path_infos(struct array* path_infos, int free_paths) {
 }
 
 // Calculate the minimum acceptable amount for a path (max min_htlc of all edges)
-static uint64_t calculate_path_min_htlc(struct array* path, struct network* network) {
+static uint64_t calculate_path_min_htlc(struct path* path, struct network* network) {
   uint64_t max_min_htlc = 0;
-  for(int i = 0; i < array_len(path); i++) {
-    struct path_hop* hop = array_get(path, i);
+  for(int i = 0; i < path->n_hops; i++) {
+    struct path_hop* hop = &(path->hops[i]);
     struct edge* edge = array_get(network->edges, hop->edge);
     if(edge->policy.min_htlc > max_min_htlc) {
       max_min_htlc = edge->policy.min_htlc;
@@ -284,10 +303,10 @@ static int compare_path_info_by_fee(const void* a, const void* b) {
 }
 
 // Calculate path capacity using GCB group_cap
-static uint64_t calculate_path_capacity_gcb(struct array* path, struct network* network, int first_edge_use_balance, enum routing_method routing_method) {
+static uint64_t calculate_path_capacity_gcb(struct path* path, struct network* network, int first_edge_use_balance, enum routing_method routing_method) {
   uint64_t min_cap = UINT64_MAX;
-  for(int i = 0; i < array_len(path); i++) {
-    struct path_hop* hop = array_get(path, i);
+  for(int i = 0; i < path->n_hops; i++) {
+    struct path_hop* hop = &(path->hops[i]);
     struct edge* edge = array_get(network->edges, hop->edge);
     uint64_t estimated_cap;
 
@@ -329,13 +348,14 @@ static struct array* find_multiple_paths_gcb(
   // Log sender balance info
   struct node* sender_node = array_get(network->nodes, sender);
   uint64_t max_bal = 0, total_bal = 0;
-  for(int k = 0; k < array_len(sender_node->open_edges); k++) {
-    struct edge* e = array_get(sender_node->open_edges, k);
+  for(uint32_t k = 0; k < sender_node->n_open_edges; k++) {
+    if(sender_node->open_edges[k] == CLOSED_EDGE) continue;
+    struct edge* e = array_get(network->edges, sender_node->open_edges[k]);
     total_bal += e->balance;
     if(e->balance > max_bal) max_bal = e->balance;
   }
   printf("[MPP DEBUG]   sender_node=%ld, open_edges=%ld, max_balance=%llu, total_balance=%llu\n",
-         sender, array_len(sender_node->open_edges), max_bal, total_bal);
+         sender, (long) (sender_node->n_open_edges - sender_node->n_closed_edges), max_bal, total_bal);
 
   for(int i = 0; i < max_paths && remaining > 0; i++) {
     enum pathfind_error error;
@@ -343,8 +363,8 @@ static struct array* find_multiple_paths_gcb(
     // then use the path's full capacity (from group_cap).
     // This implements "use paths to their full capacity, sorted by fee" strategy.
     uint64_t search_amount = MIN_SHARD_SIZE;
-    struct array* path = dijkstra(sender, receiver, search_amount, network, current_time, 0,
-                                   &error, routing_method, exclude_edges, max_fee_limit);
+    struct path* path = dijkstra(sender, receiver, search_amount, network, current_time, 0,
+                                  &error, routing_method, exclude_edges, max_fee_limit);
 
     if(path == NULL) {
       printf("[MPP DEBUG]   dijkstra[%d] FAILED: search_amount=%llu, error=%d\n", i, search_amount, error);
@@ -360,8 +380,8 @@ static struct array* find_multiple_paths_gcb(
     // Identify bottleneck edge for logging
     long bottleneck_edge_id = -1;
     uint64_t bottleneck_cap = UINT64_MAX;
-    for(int j = 0; j < array_len(path); j++) {
-      struct path_hop* hop = array_get(path, j);
+    for(int j = 0; j < path->n_hops; j++) {
+      struct path_hop* hop = &(path->hops[j]);
       struct edge* edge = array_get(network->edges, hop->edge);
       uint64_t est_cap;
       if(j == 0) est_cap = edge->balance;
@@ -372,9 +392,8 @@ static struct array* find_multiple_paths_gcb(
     }
 
     // Calculate fee for the full capacity amount (not search_amount)
-    struct route* route = transform_path_into_route(path, capacity, network, current_time);
-    uint64_t fee = route->total_fee;
-    free_route(route);
+    uint64_t fee, timelock;
+    compute_route_totals(path, capacity, network, &fee, &timelock);
 
     printf("[MPP DEBUG]   dijkstra[%d] SUCCESS: search_amount=%llu, path_capacity=%llu, fee=%llu, min_htlc=%llu, bottleneck_edge=%ld\n",
            i, search_amount, capacity, fee, path_min_htlc, bottleneck_edge_id);
@@ -386,7 +405,7 @@ static struct array* find_multiple_paths_gcb(
     } else {
       // Fee would consume all capacity - skip this path
       printf("[MPP DEBUG]   dijkstra[%d] SKIP: fee(%llu) >= capacity(%llu)\n", i, fee, capacity);
-      struct path_hop* first_hop = array_get(path, 0);
+      struct path_hop* first_hop = &(path->hops[0]);
       struct edge* first_edge = array_get(network->edges, first_hop->edge);
       exclude_edges = push(exclude_edges, first_edge);
       free_path(path);
@@ -429,8 +448,8 @@ static struct array* find_multiple_paths_gcb(
       // Find bottleneck edge in this path
       uint64_t min_cap = UINT64_MAX;
       long bn_id = -1;
-      for(int k = 0; k < array_len(info->path); k++) {
-        struct path_hop* hop = array_get(info->path, k);
+      for(int k = 0; k < info->path->n_hops; k++) {
+        struct path_hop* hop = &(info->path->hops[k]);
         struct edge* edge = array_get(network->edges, hop->edge);
         uint64_t est_cap;
         if(k == 0) est_cap = edge->balance;
@@ -451,8 +470,8 @@ static struct array* find_multiple_paths_gcb(
       enum pathfind_error error;
       // GCB MPP: Always search with MIN_SHARD_SIZE first to find a valid path
       uint64_t search_amount = MIN_SHARD_SIZE;
-      struct array* path = dijkstra(sender, receiver, search_amount, network, current_time, 0,
-                                     &error, routing_method, exclude_edges, max_fee_limit);
+      struct path* path = dijkstra(sender, receiver, search_amount, network, current_time, 0,
+                                    &error, routing_method, exclude_edges, max_fee_limit);
       if(path == NULL) {
         printf("[MPP DEBUG]   dijkstra_pass2[%d] FAILED: search_amount=%llu, error=%d\n", i, search_amount, error);
         break;
@@ -463,9 +482,8 @@ static struct array* find_multiple_paths_gcb(
       // Calculate minimum HTLC for the path
       uint64_t path_min_htlc = calculate_path_min_htlc(path, network);
 
-      struct route* route = transform_path_into_route(path, capacity, network, current_time);
-      uint64_t fee = route->total_fee;
-      free_route(route);
+      uint64_t fee, timelock;
+      compute_route_totals(path, capacity, network, &fee, &timelock);
 
       printf("[MPP DEBUG]   dijkstra_pass2[%d] SUCCESS: search_amount=%llu, path_capacity=%llu, fee=%llu, min_htlc=%llu\n",
              i, search_amount, capacity, fee, path_min_htlc);
@@ -475,7 +493,7 @@ static struct array* find_multiple_paths_gcb(
       } else {
         printf("[MPP DEBUG]   dijkstra_pass2[%d] SKIP: fee(%llu) >= capacity(%llu)\n", i, fee, capacity);
         // Exclude first edge and try again
-        struct path_hop* fhop = array_get(path, 0);
+        struct path_hop* fhop = &(path->hops[0]);
         struct edge* fedge = array_get(network->edges, fhop->edge);
         exclude_edges = push(exclude_edges, fedge);
         free_path(path);
@@ -490,7 +508,7 @@ static struct array* find_multiple_paths_gcb(
       path_infos = array_insert(path_infos, info);
 
       // In pass 2, exclude the first edge to find yet more diverse paths
-      struct path_hop* first_hop = array_get(path, 0);
+      struct path_hop* first_hop = &(path->hops[0]);
       struct edge* first_edge = array_get(network->edges, first_hop->edge);
       exclude_edges = push(exclude_edges, first_edge);
 
@@ -523,10 +541,32 @@ static struct array* find_multiple_paths_gcb(
 }
 
 
+/* a path found before the payment started (the initial path, or the path reserved for a shard by a GCB split) is used only if
+   the balance of its first edge and the estimated capacity of the others can still carry the payment with its fees;
+   the fees of the path are returned in `fee` */
+static int has_path_capacity(struct path* path, uint64_t amount, struct network* network, enum routing_method routing_method, uint64_t* fee) {
+  uint64_t path_cap = INT64_MAX, timelock;
+  for (int i = 0; i < path->n_hops; i++) {
+      struct path_hop *hop = &(path->hops[i]);
+      struct edge *edge = array_get(network->edges, hop->edge);
+      uint64_t estimated_cap;
+      if (i == 0) {
+          // if first edge of the path (directory connected edge to source node)
+          estimated_cap = edge->balance;
+      } else {
+          estimated_cap = estimate_capacity(edge, network, routing_method);
+      }
+      if (estimated_cap < path_cap) path_cap = estimated_cap;
+  }
+  compute_route_totals(path, amount, network, fee, &timelock);
+  return path_cap >= amount + *fee;
+}
+
+
 /* find a path for a payment (a modified version of dijkstra is used: see `routing.c`) */
 void find_path(struct event *event, struct simulation* simulation, struct network* network, struct array** payments, struct payments_params pay_params, struct network_params net_params) {
   struct payment *payment, *shard1, *shard2, *root_payment;
-  struct array *path;
+  struct path *path, *reserved_path;
   uint64_t shard1_amount, shard2_amount;
   enum pathfind_error error;
   long shard1_id, shard2_id;
@@ -540,49 +580,49 @@ void find_path(struct event *event, struct simulation* simulation, struct networ
 
   ++(payment->attempts);
 
+  // the reserved path is used at most once, by the first attempt
+  reserved_path = payment->reserved_path;
+  payment->reserved_path = NULL;
+
   if(net_params.payment_timeout != -1 && simulation->current_time > payment->start_time + net_params.payment_timeout) {
     payment->end_time = simulation->current_time;
     payment->is_timeout = 1;
     printf("[MPP DEBUG] TIMEOUT: payment_id=%ld, is_shard=%u, elapsed=%llu\n", 
            payment->id, payment->is_shard, simulation->current_time - payment->start_time);
+    free_path(reserved_path);
     return;
   }
 
+  // path finding runs in this thread: the core of the network is recomputed here if channels changed
+  refresh_network_core(network);
+
+  // a reserved path that can no longer carry the shard (or exceeds its fee limit) is dropped, and a path is searched
+  if(reserved_path != NULL) {
+    uint64_t fee;
+    if(!has_path_capacity(reserved_path, payment->amount, network, routing_method, &fee) || fee > payment->max_fee_limit) {
+      free_path(reserved_path);
+      reserved_path = NULL;
+    }
+  }
+
   // find path
-  if(routing_method == CLOTH_ORIGINAL) {
-      if (payment->attempts == 1 && !payment->is_shard) {
+  if(reserved_path != NULL) {
+      path = reserved_path;
+  } else if(routing_method == CLOTH_ORIGINAL) {
+      if (payment->attempts == 1 && !payment->is_shard && paths != NULL) {
           path = paths[payment->id];
       }else {
           path = dijkstra(payment->sender, payment->receiver, payment->amount, network, simulation->current_time, 0, &error, net_params.routing_method, NULL, payment->max_fee_limit);
       }
   } else {
 
-      if (payment->attempts == 1 && !payment->is_shard) {
+      if (payment->attempts == 1 && !payment->is_shard && paths != NULL) {
           path = paths[payment->id];
           if (path != NULL) {
 
-              // calc path capacity
-              uint64_t path_cap = INT64_MAX;
-              for (int i = 0; i < array_len(path); i++) {
-                  struct path_hop *hop = array_get(path, i);
-                  struct edge *edge = array_get(network->edges, hop->edge);
-                  uint64_t estimated_cap;
-                  if (i == 0) {
-                      // if first edge of the path (directory connected edge to source node)
-                      estimated_cap = edge->balance;
-                  } else {
-                      estimated_cap = estimate_capacity(edge, network, routing_method);
-                  }
-                  if (estimated_cap < path_cap) path_cap = estimated_cap;
-              }
-
-              // calc total fee
-              struct route *route = transform_path_into_route(path, payment->amount, network, simulation->current_time);
-              uint64_t fee = route->total_fee;
-              free_route(route);
-
               // if path capacity is not enough to send the payment, find new path
-              if (path_cap < payment->amount + fee) {
+              uint64_t fee;
+              if (!has_path_capacity(path, payment->amount, network, routing_method, &fee)) {
                   free_path(path);
                   path = dijkstra(payment->sender, payment->receiver, payment->amount, network, simulation->current_time, 0, &error, net_params.routing_method, NULL, payment->max_fee_limit);
               }
@@ -593,8 +633,8 @@ void find_path(struct event *event, struct simulation* simulation, struct networ
 
           // exclude edges from failed attempts
           struct element* exclude_edges = NULL;
-          for(struct element* iterator = payment->history; iterator != NULL; iterator = iterator->next) {
-            struct attempt* a = iterator->data;
+          for(long index = payment->last_attempt; index != -1; index = get_attempt(index)->previous) {
+            struct attempt* a = get_attempt(index);
             if(a->error_edge_id != 0) {
               struct edge* exclude_edge = array_get(network->edges, a->error_edge_id);
               exclude_edges = push(exclude_edges, exclude_edge);
@@ -715,19 +755,28 @@ void find_path(struct event *event, struct simulation* simulation, struct networ
           for(int i = 0; i < shard_count; i++) {
             uint64_t* amount_ptr = array_get(shard_amounts, i);
             uint64_t shard_amt = *amount_ptr;
-            // Note: We don't use the pre-found path directly anymore.
-            // Instead, we let each shard find its own path via FINDPATH.
-            // This ensures proper balance checking at send time.
+            // Each shard finds its own path via FINDPATH, so that balances are checked at send time.
+            // With mpp_path_handoff, the pre-found path is reserved for the shard instead, and FINDPATH
+            // searches again only if the path fails the capacity check.
             
             long shard_id = array_len(*payments);
             struct payment* shard = create_payment_shard(shard_id, shard_amt, payment, root_payment);
             *payments = array_insert(*payments, shard);
+            add_shard(*payments, payment, shard);
+            if(pay_params.mpp_path_handoff) {
+              shard->reserved_path = array_get(shard_paths, i);
+              // the path is now owned by the shard; mark as NULL to avoid double-free in free_path_infos
+              for(int pi = 0; pi < array_len(path_infos); pi++) {
+                struct path_info* pinfo = array_get(path_infos, pi);
+                if(pinfo->path == shard->reserved_path) { pinfo->path = NULL; break; }
+              }
+            }
             
             printf("[MPP DEBUG]   SHARD_GCB: shard_id=%ld, amount=%llu\n",
                    shard_id, shard_amt);
             
             // Schedule FINDPATH event (not direct send) so balance is checked at send time
-            struct event* shard_event = new_event(simulation->current_time, FINDPATH, shard->sender, shard);
+            struct event* shard_event = new_event(simulation->current_time, FINDPATH, shard->sender, -1, shard);
             simulation->events = heap_insert(simulation->events, shard_event, compare_event);
             
             free(amount_ptr);
@@ -737,28 +786,19 @@ void find_path(struct event *event, struct simulation* simulation, struct networ
           long remaining_shard_id = array_len(*payments);
           struct payment* remaining_shard = create_payment_shard(remaining_shard_id, remaining, payment, root_payment);
           *payments = array_insert(*payments, remaining_shard);
+          add_shard(*payments, payment, remaining_shard);
           
           printf("[MPP DEBUG]   SHARD_REMAINING: shard_id=%ld, amount=%llu\n",
                  remaining_shard_id, remaining);
           
           // Schedule FINDPATH for remaining shard
-          struct event* remaining_event = new_event(simulation->current_time, FINDPATH, remaining_shard->sender, remaining_shard);
+          struct event* remaining_event = new_event(simulation->current_time, FINDPATH, remaining_shard->sender, -1, remaining_shard);
           simulation->events = heap_insert(simulation->events, remaining_event, compare_event);
           
           // Update root payment shard count
           root_payment->shard_count += shard_count + 1;
           
-          // Record in parent's shards
-          // shards_id[0] = first shard from found paths
-          // shards_id[1] = second shard from found paths OR remaining shard
-          payment->shards_id[0] = first_shard_id;
-          if(shard_count >= 2) {
-            payment->shards_id[1] = first_shard_id + 1;
-          } else {
-            // Only 1 path found, so shards_id[1] is the remaining shard
-            payment->shards_id[1] = remaining_shard_id;
-          }
-          
+          // Record split in attempt history (the second shard is the remaining one if only 1 path was found)
           add_split_history(payment, simulation->current_time, 
                             first_shard_id, 
                             shard_count >= 2 ? first_shard_id + 1 : remaining_shard_id);
@@ -835,14 +875,15 @@ void find_path(struct event *event, struct simulation* simulation, struct networ
       for(int i = 0; i < shard_count; i++) {
         uint64_t* amount_ptr = array_get(shard_amounts, i);
         uint64_t shard_amount = *amount_ptr;
-        struct array* shard_path = array_get(shard_paths, i);
+        struct path* shard_path = array_get(shard_paths, i);
         
         long shard_id = array_len(*payments);
         struct payment* shard = create_payment_shard(shard_id, shard_amount, payment, root_payment);
         *payments = array_insert(*payments, shard);
+        add_shard(*payments, payment, shard);
         
         printf("[MPP DEBUG]   SHARD: shard_id=%ld, amount=%llu, path_len=%ld\n",
-               shard_id, shard_amount, array_len(shard_path));
+               shard_id, shard_amount, shard_path->n_hops);
         
         // Generate send payment event with the pre-found path
         generate_send_payment_event(shard, shard_path, simulation, network);
@@ -859,10 +900,6 @@ void find_path(struct event *event, struct simulation* simulation, struct networ
       // Update root payment shard count
       root_payment->shard_count += shard_count;
       
-      // Record in parent's shards (only first 2 for compatibility, but we track all via shard_count)
-      if(shard_count >= 1) payment->shards_id[0] = first_shard_id;
-      if(shard_count >= 2) payment->shards_id[1] = first_shard_id + 1;
-      
       // Record split in attempt history (using first two shard ids for compatibility)
       add_split_history(payment, simulation->current_time, 
                         first_shard_id, 
@@ -907,8 +944,8 @@ void find_path(struct event *event, struct simulation* simulation, struct networ
     *payments = array_insert(*payments, shard2);
     
     // Update parent payment (note: is_shard is already set correctly on shards via create_payment_shard)
-    payment->shards_id[0] = shard1_id;
-    payment->shards_id[1] = shard2_id;
+    add_shard(*payments, payment, shard1);
+    add_shard(*payments, payment, shard2);
     
     // Update root payment shard count
     root_payment->shard_count += 2;
@@ -920,8 +957,8 @@ void find_path(struct event *event, struct simulation* simulation, struct networ
            payment->id, payment->amount, shard1_id, shard1_amount, shard2_id, shard2_amount, root_payment->shard_count);
     
     // Schedule FINDPATH events for both shards
-    struct event* shard1_event = new_event(simulation->current_time, FINDPATH, shard1->sender, shard1);
-    struct event* shard2_event = new_event(simulation->current_time, FINDPATH, shard2->sender, shard2);
+    struct event* shard1_event = new_event(simulation->current_time, FINDPATH, shard1->sender, -1, shard1);
+    struct event* shard2_event = new_event(simulation->current_time, FINDPATH, shard2->sender, -1, shard2);
     simulation->events = heap_insert(simulation->events, shard1_event, compare_event);
     simulation->events = heap_insert(simulation->events, shard2_event, compare_event);
     
@@ -949,24 +986,38 @@ void send_payment(struct event* event, struct simulation* simulation, struct net
   payment = event->payment;
   route = payment->route;
   node = array_get(network->nodes, event->node_id);
-  first_route_hop = array_get(route->route_hops, 0);
+  first_route_hop = &(route->hops[0]);
   next_edge = array_get(network->edges, first_route_hop->edge_id);
 
-  if(!is_present(next_edge->id, node->open_edges)) {
+#if CLOTH_VALIDATION_LEVEL >= 1
+  if(next_edge->from_node_id != node->id) {
     printf("ERROR (send_payment): edge %ld is not an edge of node %ld \n", next_edge->id, node->id);
     exit(-1);
   }
+#endif
 
   first_route_hop->edges_lock_start_time = simulation->current_time;
 
+  /* the channel was closed after the route was found: fail as an unknown next peer */
+  if(next_edge->is_closed) {
+    payment->error.type = OFFLINENODE;
+    payment->error.hop = first_route_hop;
+    next_event = new_event(simulation->current_time, RECEIVEFAIL, event->node_id, 0, event->payment);
+    simulation->events = heap_insert(simulation->events, next_event, compare_event);
+    return;
+  }
+
   /* simulate the case that the next node in the route is offline */
-  is_next_node_offline = gsl_ran_discrete(simulation->random_generator, network->faulty_node_prob);
+  if(network->has_availability)
+    is_next_node_offline = is_node_offline(array_get(network->nodes, first_route_hop->to_node_id), simulation->current_time);
+  else
+    is_next_node_offline = gsl_ran_discrete(simulation->random_generator, network->faulty_node_prob);
   if(is_next_node_offline){
     payment->offline_node_count += 1;
     payment->error.type = OFFLINENODE;
     payment->error.hop = first_route_hop;
     next_event_time = simulation->current_time + OFFLINELATENCY;
-    next_event = new_event(next_event_time, RECEIVEFAIL, event->node_id, event->payment);
+    next_event = new_event(next_event_time, RECEIVEFAIL, event->node_id, 0, event->payment);
     simulation->events = heap_insert(simulation->events, next_event, compare_event);
     return;
   }
@@ -977,7 +1028,7 @@ void send_payment(struct event* event, struct simulation* simulation, struct net
     payment->error.hop = first_route_hop;
     payment->no_balance_count += 1;
     next_event_time = simulation->current_time;
-    next_event = new_event(next_event_time, RECEIVEFAIL, event->node_id, event->payment);
+    next_event = new_event(next_event_time, RECEIVEFAIL, event->node_id, 0, event->payment);
     simulation->events = heap_insert(simulation->events, next_event, compare_event);
     return;
   }
@@ -985,20 +1036,20 @@ void send_payment(struct event* event, struct simulation* simulation, struct net
   // update balance
   uint64_t prev_balance = next_edge->balance;
   next_edge->balance -= first_route_hop->amount_to_forward;
+  trace_edge_update(next_edge);
 
   next_edge->tot_flows += 1;
 
   // success sending
   event_type = first_route_hop->to_node_id == payment->receiver ? RECEIVEPAYMENT : FORWARDPAYMENT;
   next_event_time = simulation->current_time + net_params.average_payment_forward_interval + (long)(fabs(net_params.variance_payment_forward_interval * gsl_ran_ugaussian(simulation->random_generator)));
-  next_event = new_event(next_event_time, event_type, first_route_hop->to_node_id, event->payment);
+  next_event = new_event(next_event_time, event_type, first_route_hop->to_node_id, 1, event->payment);
   simulation->events = heap_insert(simulation->events, next_event, compare_event);
 }
 
 /* forward an HTLC for the payment (behavior of an intermediate hop node in a route) */
 void forward_payment(struct event* event, struct simulation* simulation, struct network* network, struct network_params net_params){
   struct payment* payment;
-  struct route* route;
   struct route_hop* next_route_hop, *previous_route_hop;
   long  prev_node_id;
   enum event_type event_type;
@@ -1011,19 +1062,36 @@ void forward_payment(struct event* event, struct simulation* simulation, struct
 
   payment = event->payment;
   node = array_get(network->nodes, event->node_id);
-  route = payment->route;
-  next_route_hop=get_route_hop(node->id, route->route_hops, 1);
-  previous_route_hop = get_route_hop(node->id, route->route_hops, 0);
+  next_route_hop = get_event_route_hop(event, 1);
+  previous_route_hop = get_event_route_hop(event, 0);
   is_last_hop = next_route_hop->to_node_id == payment->receiver;
     next_route_hop->edges_lock_start_time = simulation->current_time;
 
-  if(!is_present(next_route_hop->edge_id, node->open_edges)) {
+  next_edge = array_get(network->edges, next_route_hop->edge_id);
+#if CLOTH_VALIDATION_LEVEL >= 1
+  if(next_edge->from_node_id != node->id) {
     printf("ERROR (forward_payment): edge %ld is not an edge of node %ld \n", next_route_hop->edge_id, node->id);
     exit(-1);
   }
+#endif
+
+  /* the channel was closed after the route was found: fail as an unknown next peer */
+  if(next_edge->is_closed) {
+    payment->error.type = OFFLINENODE;
+    payment->error.hop = next_route_hop;
+    prev_node_id = previous_route_hop->from_node_id;
+    event_type = prev_node_id == payment->sender ? RECEIVEFAIL : FORWARDFAIL;
+    next_event_time = simulation->current_time + net_params.average_payment_forward_interval + (long)(fabs(net_params.variance_payment_forward_interval * gsl_ran_ugaussian(simulation->random_generator)));
+    next_event = new_event(next_event_time, event_type, prev_node_id, event->hop_index - 1, event->payment);
+    simulation->events = heap_insert(simulation->events, next_event, compare_event);
+    return;
+  }
 
   /* simulate the case that the next node in the route is offline */
-  is_next_node_offline = gsl_ran_discrete(simulation->random_generator, network->faulty_node_prob);
+  if(network->has_availability)
+    is_next_node_offline = is_node_offline(array_get(network->nodes, next_route_hop->to_node_id), simulation->current_time);
+  else
+    is_next_node_offline = gsl_ran_discrete(simulation->random_generator, network->faulty_node_prob);
   if(is_next_node_offline && !is_last_hop){ //assume that the receiver node is always online
     payment->offline_node_count += 1;
     payment->error.type = OFFLINENODE;
@@ -1031,7 +1099,7 @@ void forward_payment(struct event* event, struct simulation* simulation, struct
     prev_node_id = previous_route_hop->from_node_id;
     event_type = prev_node_id == payment->sender ? RECEIVEFAIL : FORWARDFAIL;
     next_event_time = simulation->current_time + net_params.average_payment_forward_interval + (long)(fabs(net_params.variance_payment_forward_interval * gsl_ran_ugaussian(simulation->random_generator))) + OFFLINELATENCY;
-    next_event = new_event(next_event_time, event_type, prev_node_id, event->payment);
+    next_event = new_event(next_event_time, event_type, prev_node_id, event->hop_index - 1, event->payment);
     simulation->events = heap_insert(simulation->events, next_event, compare_event);
     return;
   }
@@ -1076,7 +1144,7 @@ void forward_payment(struct event* event, struct simulation* simulation, struct
     prev_node_id = previous_route_hop->from_node_id;
     event_type = prev_node_id == payment->sender ? RECEIVEFAIL : FORWARDFAIL;
     next_event_time = simulation->current_time + net_params.average_payment_forward_interval + (long)(fabs(net_params.variance_payment_forward_interval * gsl_ran_ugaussian(simulation->random_generator)));//prev_channel->latency;
-    next_event = new_event(next_event_time, event_type, prev_node_id, event->payment);
+    next_event = new_event(next_event_time, event_type, prev_node_id, event->hop_index - 1, event->payment);
     simulation->events = heap_insert(simulation->events, next_event, compare_event);
     return;
   }
@@ -1084,6 +1152,7 @@ void forward_payment(struct event* event, struct simulation* simulation, struct
   // update balance
   uint64_t prev_balance = next_edge->balance;
   next_edge->balance -= next_route_hop->amount_to_forward;
+  trace_edge_update(next_edge);
 
   next_edge->tot_flows += 1;
 
@@ -1091,7 +1160,7 @@ void forward_payment(struct event* event, struct simulation* simulation, struct
   event_type = is_last_hop  ? RECEIVEPAYMENT : FORWARDPAYMENT;
   // interval for forwarding payment
   next_event_time = simulation->current_time + net_params.average_payment_forward_interval + (long)(fabs(net_params.variance_payment_forward_interval * gsl_ran_ugaussian(simulation->random_generator)));//next_channel->latency;
-  next_event = new_event(next_event_time, event_type, next_route_hop->to_node_id, event->payment);
+  next_event = new_event(next_event_time, event_type, next_route_hop->to_node_id, event->hop_index + 1, event->payment);
   simulation->events = heap_insert(simulation->events, next_event, compare_event);
 }
 
@@ -1111,26 +1180,29 @@ void receive_payment(struct event* event, struct simulation* simulation, struct
   route = payment->route;
   node = array_get(network->nodes, event->node_id);
 
-  last_route_hop = array_get(route->route_hops, array_len(route->route_hops) - 1);
+  last_route_hop = get_event_route_hop(event, 0);
   forward_edge = array_get(network->edges, last_route_hop->edge_id);
   backward_edge = array_get(network->edges, forward_edge->counter_edge_id);
 
   last_route_hop->edges_lock_end_time = simulation->current_time;
 
-  if(!is_present(backward_edge->id, node->open_edges)) {
+#if CLOTH_VALIDATION_LEVEL >= 1
+  if(last_route_hop != &(route->hops[route->n_hops - 1]) || backward_edge->from_node_id != node->id) {
     printf("ERROR (receive_payment): edge %ld is not an edge of node %ld \n", backward_edge->id, node->id);
     exit(-1);
   }
+#endif
 
   // update balance
   backward_edge->balance += last_route_hop->amount_to_forward;
+  trace_edge_update(backward_edge);
 
   payment->is_success = 1;
 
   prev_node_id = last_route_hop->from_node_id;
   event_type = prev_node_id == payment->sender ? RECEIVESUCCESS : FORWARDSUCCESS;
   next_event_time = simulation->current_time + net_params.average_payment_forward_interval + (long)(fabs(net_params.variance_payment_forward_interval * gsl_ran_ugaussian(simulation->random_generator)));//channel->latency;
-  next_event = new_event(next_event_time, event_type, prev_node_id, event->payment);
+  next_event = new_event(next_event_time, event_type, prev_node_id, event->hop_index - 1, event->payment);
   simulation->events = heap_insert(simulation->events, next_event, compare_event);
 }
 
@@ -1146,24 +1218,27 @@ void forward_success(struct event* event, struct simulation* simulation, struct
   uint64_t next_event_time;
 
   payment = event->payment;
-  prev_hop = get_route_hop(event->node_id, payment->route->route_hops, 0);
+  prev_hop = get_event_route_hop(event, 0);
   forward_edge = array_get(network->edges, prev_hop->edge_id);
   backward_edge = array_get(network->edges, forward_edge->counter_edge_id);
   node = array_get(network->nodes, event->node_id);
   prev_hop->edges_lock_end_time = simulation->current_time;
 
-  if(!is_present(backward_edge->id, node->open_edges)) {
+#if CLOTH_VALIDATION_LEVEL >= 1
+  if(backward_edge->from_node_id != node->id) {
     printf("ERROR (forward_success): edge %ld is not an edge of node %ld \n", backward_edge->id, node->id);
     exit(-1);
   }
+#endif
 
   // update balance
   backward_edge->balance += prev_hop->amount_to_forward;
+  trace_edge_update(backward_edge);
 
   prev_node_id = prev_hop->from_node_id;
   event_type = prev_node_id == payment->sender ? RECEIVESUCCESS : FORWARDSUCCESS;
   next_event_time = simulation->current_time + net_params.average_payment_forward_interval + (long)(fabs(net_params.variance_payment_forward_interval * gsl_ran_ugaussian(simulation->random_generator)));//prev_channel->latency;
-  next_event = new_event(next_event_time, event_type, prev_node_id, event->payment);
+  next_event = new_event(next_event_time, event_type, prev_node_id, event->hop_index - 1, event->payment);
   simulation->events = heap_insert(simulation->events, next_event, compare_event);
 }
 
@@ -1195,12 +1270,12 @@ void receive_success(struct event* event, struct simulation* simulation, struct
 
     // request_group_update event
     if (net_params.routing_method == GROUP_ROUTING) {
-        struct event *next_event = new_event(next_event_time, UPDATEGROUP, event->node_id, event->payment);
+        struct event *next_event = new_event(next_event_time, UPDATEGROUP, event->node_id, -1, event->payment);
         simulation->events = heap_insert(simulation->events, next_event, compare_event);
     }
 
     // channel update broadcast event
-    struct event *channel_update_event = new_event(next_event_time, CHANNELUPDATESUCCESS, node->id, payment);
+    struct event *channel_update_event = new_event(next_event_time, CHANNELUPDATESUCCESS, node->id, -1, payment);
     simulation->events = heap_insert(simulation->events, channel_update_event, compare_event);
 }
 
@@ -1217,25 +1292,28 @@ void forward_fail(struct event* event, struct simulation* simulation, struct net
 
   node = array_get(network->nodes, event->node_id);
   payment = event->payment;
-  next_hop = get_route_hop(event->node_id, payment->route->route_hops, 1);
+  next_hop = get_event_route_hop(event, 1);
   next_edge = array_get(network->edges, next_hop->edge_id);
 
-  if(!is_present(next_edge->id, node->open_edges)) {
+#if CLOTH_VALIDATION_LEVEL >= 1
+  if(next_edge->from_node_id != node->id) {
     printf("ERROR (forward_fail): edge %ld is not an edge of node %ld \n", next_edge->id, node->id);
     exit(-1);
   }
+#endif
 
   next_hop->edges_lock_end_time = simulation->current_time;
 
   /* since the payment failed, the balance must be brought back to the state before the payment occurred */
   uint64_t prev_balance = next_edge->balance;
   next_edge->balance += next_hop->amount_to_forward;
+  trace_edge_update(next_edge);
 
-  prev_hop = get_route_hop(event->node_id, payment->route->route_hops, 0);
+  prev_hop = get_event_route_hop(event, 0);
   prev_node_id = prev_hop->from_node_id;
   event_type = prev_node_id == payment->sender ? RECEIVEFAIL : FORWARDFAIL;
   next_event_time = simulation->current_time + net_params.average_payment_forward_interval + (long)(fabs(net_params.variance_payment_forward_interval * gsl_ran_ugaussian(simulation->random_generator)));//prev_channel->latency;
-  next_event = new_event(next_event_time, event_type, prev_node_id, event->payment);
+  next_event = new_event(next_event_time, event_type, prev_node_id, event->hop_index - 1, event->payment);
   simulation->events = heap_insert(simulation->events, next_event, compare_event);
 }
 
@@ -1254,23 +1332,26 @@ void receive_fail(struct event* event, struct simulation* simulation, struct net
   error_hop = payment->error.hop;
   error_edge = array_get(network->edges, error_hop->edge_id);
   if(error_hop->from_node_id != payment->sender){ // if the error occurred in the first hop, the balance hasn't to be updated, since it was not decreased
-    first_hop = array_get(payment->route->route_hops, 0);
+    first_hop = &(payment->route->hops[0]);
     next_edge = array_get(network->edges, first_hop->edge_id);
-    if(!is_present(next_edge->id, node->open_edges)) {
+#if CLOTH_VALIDATION_LEVEL >= 1
+    if(next_edge->from_node_id != node->id) {
       printf("ERROR (receive_fail): edge %ld is not an edge of node %ld \n", next_edge->id, node->id);
       exit(-1);
     }
+#endif
 
     uint64_t prev_balance = next_edge->balance;
     next_edge->balance += first_hop->amount_to_forward;
+    trace_edge_update(next_edge);
   }
 
 /* print FAIL_NO_BALANCE error
     struct channel* channel = array_get(network->channels, error_edge->channel_id);
     printf("\n\tERROR : RECEIVE_FAIL on sending payment(id=%ld, amount=%lu) at edge(id=%ld, balance=%lu, htlc_max_msat=%lu, channel_capacity=%lu) ", payment->id, payment->amount, error_edge->id, error_edge->balance, ((struct channel_update*)(error_edge->channel_updates->data))->htlc_maximum_msat, channel->capacity);
     printf("\n\tPATH  : ");
-    for(int i = 0; i < array_len(payment->route->route_hops); i++){
-        struct route_hop* hop = array_get(payment->route->route_hops, i);
+    for(int i = 0; i < payment->route->n_hops; i++){
+        struct route_hop* hop = &(payment->route->hops[i]);
         struct edge* edge = array_get(network->edges, hop->edge_id);
         printf("(edge_id=%ld,edge_balance=%lu,", edge->id, edge->balance);
         if(edge->group != NULL) {
@@ -1278,40 +1359,37 @@ void receive_fail(struct event* event, struct simulation* simulation, struct net
         }else{
             printf("group_id=NULL,group_cap=NULL)");
         }
-        if (i != array_len(payment->route->route_hops) - 1) printf("-");
+        if (i != payment->route->n_hops - 1) printf("-");
     }
     printf("\n");
 */
 
     // record channel_update
-    struct channel_update *channel_update = malloc(sizeof(struct channel_update));
-    channel_update->htlc_maximum_msat = payment->amount;
-    channel_update->edge_id = error_edge->id;
-    channel_update->time = simulation->current_time;
-    error_edge->channel_updates = push(error_edge->channel_updates, channel_update);
+    struct channel_update *channel_update = new_channel_update(network, error_edge->id, simulation->current_time, payment->amount);
+    error_edge->channel_updates = push_network_list(network, error_edge->channel_updates, channel_update);
 
   add_attempt_history(payment, network, simulation->current_time, 0);
 
   next_event_time = simulation->current_time;
-  next_event = new_event(next_event_time, FINDPATH, payment->sender, payment);
+  next_event = new_event(next_event_time, FINDPATH, payment->sender, -1, payment);
   simulation->events = heap_insert(simulation->events, next_event, compare_event);
 
     // channel update broadcast event
-    struct event *channel_update_event = new_event(simulation->current_time + net_params.group_broadcast_delay, CHANNELUPDATEFAIL, node->id, payment);
+    struct event *channel_update_event = new_event(simulation->current_time + net_params.group_broadcast_delay, CHANNELUPDATEFAIL, node->id, -1, payment);
     simulation->events = heap_insert(simulation->events, channel_update_event, compare_event);
 }
 
 // 送金に使用された全てのedgeのグループ更新を行う
 struct element* request_group_update(struct event* event, struct simulation* simulation, struct network* network, struct network_params net_params, struct element* group_add_queue){
 
-    for(long i = 0; i < array_len(event->payment->route->route_hops); i++){
-        struct route_hop* hop = array_get(event->payment->route->route_hops, i);
+    for(long i = 0; i < event->payment->route->n_hops; i++){
+        struct route_hop* hop = &(event->payment->route->hops[i]);
         struct edge* edge = array_get(network->edges, hop->edge_id);
         struct edge* counter_edge = array_get(network->edges, edge->counter_edge_id);
 
         if(edge->group != NULL) {
             struct group* group = edge->group;
-            int close_flg = update_group(edge->group, net_params, simulation->current_time, simulation->random_generator, net_params.enable_fake_balance_update, edge);
+            int close_flg = update_group(network, edge->group, net_params, simulation->current_time, simulation->random_generator, net_params.enable_fake_balance_update, edge);
 
             if(close_flg){
                 group->is_closed = simulation->current_time;
@@ -1325,14 +1403,14 @@ struct element* request_group_update(struct event* event, struct simulation* sim
 
                 // construct_groups event
                 uint64_t next_event_time = simulation->current_time;
-                struct event* next_event = new_event(next_event_time, CONSTRUCTGROUPS, event->node_id, event->payment);
+                struct event* next_event = new_event(next_event_time, CONSTRUCTGROUPS, event->node_id, -1, event->payment);
                 simulation->events = heap_insert(simulation->events, next_event, compare_event);
             }
         }
 
         if(counter_edge->group != NULL) {
             struct group* group = counter_edge->group;
-            int close_flg = update_group(counter_edge->group, net_params, simulation->current_time, simulation->random_generator, net_params.enable_fake_balance_update, counter_edge);
+            int close_flg = update_group(network, counter_edge->group, net_params, simulation->current_time, simulation->random_generator, net_params.enable_fake_balance_update, counter_edge);
 
             if(close_flg){
                 group->is_closed = simulation->current_time;
@@ -1346,7 +1424,7 @@ struct element* request_group_update(struct event* event, struct simulation* sim
 
                 // construct_groups event
                 uint64_t next_event_time = simulation->current_time;
-                struct event* next_event = new_event(next_event_time, CONSTRUCTGROUPS, event->node_id, event->payment);
+                struct event* next_event = new_event(next_event_time, CONSTRUCTGROUPS, event->node_id, -1, event->payment);
                 simulation->events = heap_insert(simulation->events, next_event, compare_event);
             }
         }
@@ -1399,10 +1477,24 @@ int can_join_group(struct group* group, struct edge* edge, enum routing_method r
     }
 }
 
+/* construct the groups at the beginning of the simulation; it returns the queue of the edges that are not a member of any group */
+struct element* initialize_groups(struct simulation* simulation, struct network* network, struct network_params net_params){
+    struct element* group_add_queue = NULL;
+    if(net_params.routing_method == GROUP_ROUTING || net_params.routing_method == GROUP_ROUTING_CUL) {
+        for (int i = 0; i < array_len(network->edges); i++) {
+            group_add_queue = list_insert_sorted_position(group_add_queue, array_get(network->edges, i), (long (*)(void *)) get_edge_balance);
+        }
+        group_add_queue = construct_groups(simulation, group_add_queue, network, net_params);
+    }
+    return group_add_queue;
+}
+
 struct element* construct_groups(struct simulation* simulation, struct element* group_add_queue, struct network *network, struct network_params net_params){
 
     if(group_add_queue == NULL) return group_add_queue;
 
+    telemetry->group_constructions++;
+
     for(struct element* iterator = group_add_queue; iterator != NULL; iterator = iterator->next){
 
         struct edge* requesting_edge = iterator->data;
@@ -1463,7 +1555,7 @@ struct element* construct_groups(struct simulation* simulation, struct element*
             // register group
             if(array_len(group->edges) == net_params.group_size){
                 // init group_cap
-                update_group(group, net_params, simulation->current_time, simulation->random_generator, net_params.enable_fake_balance_update, NULL);
+                update_group(network, group, net_params, simulation->current_time, simulation->random_generator, net_params.enable_fake_balance_update, NULL);
                 network->groups = array_insert(network->groups, group);
                 for(int i = 0; i < array_len(group->edges); i++){
                     struct edge* group_member_edge = array_get(group->edges, i);
@@ -1530,7 +1622,7 @@ struct element* construct_groups(struct simulation* simulation, struct element*
             // register group
             if(array_len(group->edges) == net_params.group_size){
                 // init group_cap
-                update_group(group, net_params, simulation->current_time, simulation->random_generator, net_params.enable_fake_balance_update, NULL);
+                update_group(network, group, net_params, simulation->current_time, simulation->random_generator, net_params.enable_fake_balance_update, NULL);
                 network->groups = array_insert(network->groups, group);
                 for(int i = 0; i < array_len(group->edges); i++){
                     struct edge* group_member_edge = array_get(group->edges, i);
@@ -1549,10 +1641,10 @@ struct element* construct_groups(struct simulation* simulation, struct element*
 
 void channel_update_success(struct event* event, struct simulation* simulation, struct network* network){
     struct node* node = array_get(network->nodes, event->node_id);
-    process_success_result(node, event->payment, simulation->current_time);
+    process_success_result(network, node, event->payment, simulation->current_time);
 }
 
 void channel_update_fail(struct event* event, struct simulation* simulation, struct network* network){
     struct node* node = array_get(network->nodes, event->node_id);
-    process_fail_result(node, event->payment, simulation->current_time);
+    process_fail_result(network, node, event->payment, simulation->current_time);
 }
\ No newline at end of file
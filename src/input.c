@@ -0,0 +1,496 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "../include/input.h"
+#include "../include/workload.h"
+
+/* Functions in this file read the input parameters of the simulation from "cloth_input.txt" and check them */
+
+
+void initialize_input_parameters(struct network_params *net_params, struct payments_params *pay_params, struct simulation_params *sim_params) {
+  net_params->n_nodes = net_params->n_channels = net_params->capacity_per_channel = 0;
+  net_params->faulty_node_prob = 0.0;
+  net_params->network_from_file = 0;
+  strcpy(net_params->nodes_filename, "\0");
+  strcpy(net_params->channels_filename, "\0");
+  strcpy(net_params->edges_filename, "\0");
+  strcpy(net_params->network_snapshot_filename, "\0");
+  net_params->network_ordering = ORIGINAL_ORDERING;
+  strcpy(net_params->topology_changes_filename, "\0");
+  net_params->channel_open_rate = net_params->channel_close_rate = 0.0;
+  strcpy(net_params->node_availability_filename, "\0");
+  net_params->average_node_online_time = net_params->average_node_offline_time = 0.0;
+  net_params->routing_skip_offline_nodes = 0;
+  net_params->routing_prune_leaf_trees = 0;
+  pay_params->inverse_payment_rate = pay_params->amount_mu = 0.0;
+  pay_params->n_payments = 0;
+  pay_params->payments_from_file = 0;
+  strcpy(pay_params->payments_filename, "\0");
+  pay_params->mpp = 0;
+  pay_params->max_shard_count = 16; // default max shard count
+  pay_params->mpp_path_handoff = 0;
+  pay_params->stream_payments = 0;
+  pay_params->retire_payments = 0;
+  strcpy(pay_params->workload, "uniform");
+  pay_params->workload_zipf_exponent = 1.0;
+  pay_params->workload_locality_hops = 3.0;
+  pay_params->workload_amount_sigma = 1.0;
+  pay_params->workload_pareto_alpha = 1.5;
+  pay_params->workload_burst_factor = 10.0;
+  pay_params->workload_burst_duration = 10.0;
+  pay_params->workload_diurnal_period = 86400.0;
+  pay_params->workload_repeat_probability = 0.5;
+  pay_params->ramp_mode = 0;
+  pay_params->ramp_initial_rate = 1.0;
+  pay_params->ramp_rate_factor = 2.0;
+  pay_params->ramp_stage_duration = 60.0;
+  pay_params->ramp_min_success_rate = 0.9;
+  pay_params->ramp_max_latency = 0;
+  pay_params->ramp_tolerance = 0.05;
+  pay_params->ramp_max_stages = 20;
+  sim_params->telemetry_flush_interval = 1000;
+  sim_params->event_profiler = 0;
+  sim_params->attempts_history = ATTEMPT_LOG_FULL;
+  strcpy(sim_params->checkpoint_filename, "\0");
+  sim_params->checkpoint_time = 0;
+  sim_params->checkpoint_interval = 0;
+  strcpy(sim_params->restore_filename, "\0");
+  sim_params->branch_time = 0;
+  strcpy(sim_params->branch_variants_filename, "\0");
+  strcpy(sim_params->event_trace_filename, "\0");
+}
+
+
+/* set the input parameter `parameter` to `value`; `input_filename` is only used in error messages */
+void set_input_parameter(struct network_params* net_params, struct payments_params* pay_params, struct simulation_params* sim_params, char* parameter, char* value, char input_filename[]){
+  if(strcmp(parameter, "generate_network_from_file")==0){
+    if(strcmp(value, "true")==0)
+      net_params->network_from_file=1;
+    else if(strcmp(value, "false")==0)
+      net_params->network_from_file=0;
+    else{
+      fprintf(stderr, "ERROR: wrong value of parameter <%s> in <%s>. Possible values are <true> or <false>\n", parameter, input_filename);
+      exit(-1);
+    }
+  }
+  else if(strcmp(parameter, "nodes_filename")==0){
+    strcpy(net_params->nodes_filename, value);
+  }
+  else if(strcmp(parameter, "channels_filename")==0){
+    strcpy(net_params->channels_filename, value);
+  }
+  else if(strcmp(parameter, "edges_filename")==0){
+    strcpy(net_params->edges_filename, value);
+  }
+  else if(strcmp(parameter, "network_snapshot_filename")==0){
+    strcpy(net_params->network_snapshot_filename, value);
+  }
+  else if(strcmp(parameter, "network_ordering")==0){
+    if(strcmp(value, "none")==0)
+      net_params->network_ordering=ORIGINAL_ORDERING;
+    else if(strcmp(value, "rcm")==0)
+      net_params->network_ordering=RCM_ORDERING;
+    else if(strcmp(value, "hub_bfs")==0)
+      net_params->network_ordering=HUB_BFS_ORDERING;
+    else{
+      fprintf(stderr, "ERROR: wrong value of parameter <%s> in <%s>. Possible values are [\"none\", \"rcm\", \"hub_bfs\"]\n", parameter, input_filename);
+      exit(-1);
+    }
+  }
+  else if(strcmp(parameter, "topology_changes_filename")==0){
+    strcpy(net_params->topology_changes_filename, value);
+  }
+  else if(strcmp(parameter, "channel_open_rate")==0){
+    net_params->channel_open_rate = strtod(value, NULL);
+  }
+  else if(strcmp(parameter, "channel_close_rate")==0){
+    net_params->channel_close_rate = strtod(value, NULL);
+  }
+  else if(strcmp(parameter, "node_availability_filename")==0){
+    strcpy(net_params->node_availability_filename, value);
+  }
+  else if(strcmp(parameter, "average_node_online_time")==0){
+    net_params->average_node_online_time = strtod(value, NULL);
+  }
+  else if(strcmp(parameter, "average_node_offline_time")==0){
+    net_params->average_node_offline_time = strtod(value, NULL);
+  }
+  else if(strcmp(parameter, "routing_skip_offline_nodes")==0){
+    if(strcmp(value, "true")==0)
+      net_params->routing_skip_offline_nodes=1;
+    else if(strcmp(value, "false")==0)
+      net_params->routing_skip_offline_nodes=0;
+    else{
+      fprintf(stderr, "ERROR: wrong value of parameter <%s> in <%s>. Possible values are <true> or <false>\n", parameter, input_filename);
+      exit(-1);
+    }
+  }
+  else if(strcmp(parameter, "routing_prune_leaf_trees")==0){
+    if(strcmp(value, "true")==0)
+      net_params->routing_prune_leaf_trees=1;
+    else if(strcmp(value, "false")==0)
+      net_params->routing_prune_leaf_trees=0;
+    else{
+      fprintf(stderr, "ERROR: wrong value of parameter <%s> in <%s>. Possible values are <true> or <false>\n", parameter, input_filename);
+      exit(-1);
+    }
+  }
+  else if(strcmp(parameter, "n_additional_nodes")==0){
+    net_params->n_nodes = strtol(value, NULL, 10);
+  }
+  else if(strcmp(parameter, "n_channels_per_node")==0){
+    net_params->n_channels = strtol(value, NULL, 10);
+  }
+  else if(strcmp(parameter, "capacity_per_channel")==0){
+    net_params->capacity_per_channel = strtol(value, NULL, 10);
+  }
+  else if(strcmp(parameter, "faulty_node_probability")==0){
+    net_params->faulty_node_prob = strtod(value, NULL);
+  }
+  else if(strcmp(parameter, "generate_payments_from_file")==0){
+    if(strcmp(value, "true")==0)
+      pay_params->payments_from_file=1;
+    else if(strcmp(value, "false")==0)
+      pay_params->payments_from_file=0;
+    else{
+      fprintf(stderr, "ERROR: wrong value of parameter <%s> in <%s>. Possible values are <true> or <false>\n", parameter, input_filename);
+      exit(-1);
+    }
+  }
+  else if(strcmp(parameter, "enable_fake_balance_update")==0){
+    if(strcmp(value, "true")==0)
+      net_params->enable_fake_balance_update = 1;
+    else if(strcmp(value, "false")==0)
+      net_params->enable_fake_balance_update = 0;
+    else{
+      fprintf(stderr, "ERROR: wrong value of parameter <%s> in <%s>. Possible values are <true> or <false>\n", parameter, input_filename);
+      exit(-1);
+    }
+  }
+  else if(strcmp(parameter, "payment_timeout")==0) {
+      net_params->payment_timeout=strtol(value, NULL, 10);
+  }
+  else if(strcmp(parameter, "average_payment_forward_interval")==0) {
+      net_params->average_payment_forward_interval=strtol(value, NULL, 10);
+  }
+  else if(strcmp(parameter, "variance_payment_forward_interval")==0) {
+      net_params->variance_payment_forward_interval=strtol(value, NULL, 10);
+  }
+  else if(strcmp(parameter, "group_broadcast_delay")==0) {
+      net_params->group_broadcast_delay=strtol(value, NULL, 10);
+  }
+  else if(strcmp(parameter, "routing_method")==0){
+    if(strcmp(value, "cloth_original")==0)
+      net_params->routing_method=CLOTH_ORIGINAL;
+    else if(strcmp(value, "channel_update")==0)
+      net_params->routing_method=CHANNEL_UPDATE;
+    else if(strcmp(value, "group_routing_cul")==0)
+      net_params->routing_method=GROUP_ROUTING_CUL;
+    else if(strcmp(value, "group_routing")==0)
+      net_params->routing_method=GROUP_ROUTING;
+    else if(strcmp(value, "ideal")==0)
+      net_params->routing_method=IDEAL;
+    else{
+      fprintf(stderr, "ERROR: wrong value of parameter <%s> in <%s>. Possible values are [\"cloth_original\", \"channel_update\", \"group_routing\", \"ideal\"]\n", parameter, input_filename);
+      exit(-1);
+    }
+  }
+  else if(strcmp(parameter, "group_cap_update")==0){
+    if(strcmp(value, "true")==0)
+      net_params->group_cap_update=1;
+    else if(strcmp(value, "false")==0)
+      net_params->group_cap_update=0;
+    else
+      net_params->group_cap_update=-1;
+  }
+  else if(strcmp(parameter, "group_size")==0){
+      if(strcmp(value, "")==0) net_params->group_size = -1;
+      else net_params->group_size = strtol(value, NULL, 10);
+  }
+  else if(strcmp(parameter, "group_limit_rate")==0){
+      if(strcmp(value, "")==0) net_params->group_limit_rate = -1;
+      else net_params->group_limit_rate = strtof(value, NULL);
+  }
+  else if(strcmp(parameter, "cul_threshold_dist_alpha")==0){
+      if(strcmp(value, "")==0) net_params->cul_threshold_dist_alpha = -1;
+      else net_params->cul_threshold_dist_alpha = strtof(value, NULL);
+  }
+  else if(strcmp(parameter, "cul_threshold_dist_beta")==0){
+      if(strcmp(value, "")==0) net_params->cul_threshold_dist_beta = -1;
+      else net_params->cul_threshold_dist_beta = strtof(value, NULL);
+  }
+  else if(strcmp(parameter, "payments_filename")==0){
+    strcpy(pay_params->payments_filename, value);
+  }
+  else if(strcmp(parameter, "payment_rate")==0){
+    pay_params->inverse_payment_rate = 1.0/strtod(value, NULL);
+  }
+  else if(strcmp(parameter, "n_payments")==0){
+    pay_params->n_payments = strtol(value, NULL, 10);
+  }
+  else if(strcmp(parameter, "average_payment_amount")==0){
+    pay_params->amount_mu = strtod(value, NULL);
+  }
+  else if(strcmp(parameter, "variance_payment_amount")==0){
+    pay_params->amount_sigma = strtod(value, NULL);
+  }
+  else if(strcmp(parameter, "mpp")==0){
+    pay_params->mpp = strtoul(value, NULL, 10);
+  }
+  else if(strcmp(parameter, "average_max_fee_limit")==0){
+      pay_params->max_fee_limit_mu = strtod(value, NULL);
+  }
+  else if(strcmp(parameter, "variance_max_fee_limit")==0){
+      pay_params->max_fee_limit_sigma = strtod(value, NULL);
+  }
+  else if(strcmp(parameter, "max_shard_count")==0){
+      pay_params->max_shard_count = strtol(value, NULL, 10);
+  }
+  else if(strcmp(parameter, "mpp_path_handoff")==0){
+    if(strcmp(value, "true")==0)
+      pay_params->mpp_path_handoff=1;
+    else if(strcmp(value, "false")==0)
+      pay_params->mpp_path_handoff=0;
+    else{
+      fprintf(stderr, "ERROR: wrong value of parameter <%s> in <%s>. Possible values are <true> or <false>\n", parameter, input_filename);
+      exit(-1);
+    }
+  }
+  else if(strcmp(parameter, "stream_payments")==0){
+    if(strcmp(value, "true")==0)
+      pay_params->stream_payments=1;
+    else if(strcmp(value, "false")==0)
+      pay_params->stream_payments=0;
+    else{
+      fprintf(stderr, "ERROR: wrong value of parameter <%s> in <%s>. Possible values are <true> or <false>\n", parameter, input_filename);
+      exit(-1);
+    }
+  }
+  else if(strcmp(parameter, "payment_workload")==0){
+    if(get_workload_family(value) == NULL || strlen(value) >= sizeof(pay_params->workload)){
+      fprintf(stderr, "ERROR: wrong value of parameter <%s> in <%s>. Possible values are [\"uniform\", \"merchants\", \"local\", \"heavy_tailed\", \"bursty\", \"diurnal\", \"repeat\"]\n", parameter, input_filename);
+      exit(-1);
+    }
+    strcpy(pay_params->workload, value);
+  }
+  else if(strcmp(parameter, "workload_zipf_exponent")==0){
+    pay_params->workload_zipf_exponent = strtod(value, NULL);
+  }
+  else if(strcmp(parameter, "workload_locality_hops")==0){
+    pay_params->workload_locality_hops = strtod(value, NULL);
+  }
+  else if(strcmp(parameter, "workload_amount_sigma")==0){
+    pay_params->workload_amount_sigma = strtod(value, NULL);
+  }
+  else if(strcmp(parameter, "workload_pareto_alpha")==0){
+    pay_params->workload_pareto_alpha = strtod(value, NULL);
+  }
+  else if(strcmp(parameter, "workload_burst_factor")==0){
+    pay_params->workload_burst_factor = strtod(value, NULL);
+  }
+  else if(strcmp(parameter, "workload_burst_duration")==0){
+    pay_params->workload_burst_duration = strtod(value, NULL);
+  }
+  else if(strcmp(parameter, "workload_diurnal_period")==0){
+    pay_params->workload_diurnal_period = strtod(value, NULL);
+  }
+  else if(strcmp(parameter, "workload_repeat_probability")==0){
+    pay_params->workload_repeat_probability = strtod(value, NULL);
+  }
+  else if(strcmp(parameter, "ramp_mode")==0){
+    if(strcmp(value, "true")==0)
+      pay_params->ramp_mode=1;
+    else if(strcmp(value, "false")==0)
+      pay_params->ramp_mode=0;
+    else{
+      fprintf(stderr, "ERROR: wrong value of parameter <%s> in <%s>. Possible values are <true> or <false>\n", parameter, input_filename);
+      exit(-1);
+    }
+  }
+  else if(strcmp(parameter, "ramp_initial_rate")==0){
+    pay_params->ramp_initial_rate = strtod(value, NULL);
+  }
+  else if(strcmp(parameter, "ramp_rate_factor")==0){
+    pay_params->ramp_rate_factor = strtod(value, NULL);
+  }
+  else if(strcmp(parameter, "ramp_stage_duration")==0){
+    pay_params->ramp_stage_duration = strtod(value, NULL);
+  }
+  else if(strcmp(parameter, "ramp_min_success_rate")==0){
+    pay_params->ramp_min_success_rate = strtod(value, NULL);
+  }
+  else if(strcmp(parameter, "ramp_max_latency")==0){
+    pay_params->ramp_max_latency = strtoull(value, NULL, 10);
+  }
+  else if(strcmp(parameter, "ramp_tolerance")==0){
+    pay_params->ramp_tolerance = strtod(value, NULL);
+  }
+  else if(strcmp(parameter, "ramp_max_stages")==0){
+    pay_params->ramp_max_stages = strtol(value, NULL, 10);
+  }
+  else if(strcmp(parameter, "retire_payments")==0){
+    if(strcmp(value, "true")==0)
+      pay_params->retire_payments=1;
+    else if(strcmp(value, "false")==0)
+      pay_params->retire_payments=0;
+    else{
+      fprintf(stderr, "ERROR: wrong value of parameter <%s> in <%s>. Possible values are <true> or <false>\n", parameter, input_filename);
+      exit(-1);
+    }
+  }
+  else if(strcmp(parameter, "attempts_history")==0){
+    if(strcmp(value, "off")==0)
+      sim_params->attempts_history=ATTEMPT_LOG_OFF;
+    else if(strcmp(value, "summary")==0)
+      sim_params->attempts_history=ATTEMPT_LOG_SUMMARY;
+    else if(strcmp(value, "full")==0)
+      sim_params->attempts_history=ATTEMPT_LOG_FULL;
+    else{
+      fprintf(stderr, "ERROR: wrong value of parameter <%s> in <%s>. Possible values are [\"off\", \"summary\", \"full\"]\n", parameter, input_filename);
+      exit(-1);
+    }
+  }
+  else if(strcmp(parameter, "event_profiler")==0){
+    if(strcmp(value, "true")==0)
+      sim_params->event_profiler=1;
+    else if(strcmp(value, "false")==0)
+      sim_params->event_profiler=0;
+    else{
+      fprintf(stderr, "ERROR: wrong value of parameter <%s> in <%s>. Possible values are <true> or <false>\n", parameter, input_filename);
+      exit(-1);
+    }
+  }
+  else if(strcmp(parameter, "telemetry_flush_interval")==0){
+      sim_params->telemetry_flush_interval = strtoull(value, NULL, 10);
+  }
+  else if(strcmp(parameter, "checkpoint_filename")==0){
+    strcpy(sim_params->checkpoint_filename, value);
+  }
+  else if(strcmp(parameter, "checkpoint_time")==0){
+      sim_params->checkpoint_time = strtoull(value, NULL, 10);
+  }
+  else if(strcmp(parameter, "checkpoint_interval")==0){
+      sim_params->checkpoint_interval = strtoull(value, NULL, 10);
+  }
+  else if(strcmp(parameter, "restore_filename")==0){
+    strcpy(sim_params->restore_filename, value);
+  }
+  else if(strcmp(parameter, "branch_time")==0){
+      sim_params->branch_time = strtoull(value, NULL, 10);
+  }
+  else if(strcmp(parameter, "branch_variants_filename")==0){
+    strcpy(sim_params->branch_variants_filename, value);
+  }
+  else if(strcmp(parameter, "event_trace_filename")==0){
+    strcpy(sim_params->event_trace_filename, value);
+  }
+  else{
+    fprintf(stderr, "ERROR: unknown parameter <%s>\n", parameter);
+    exit(-1);
+  }
+}
+
+
+/* check the consistency of the input parameters */
+void check_input_parameters(struct network_params* net_params, struct payments_params* pay_params, struct simulation_params* sim_params){
+  // check invalid group settings
+  if(net_params->routing_method == GROUP_ROUTING){
+      if(net_params->group_limit_rate < 0 || net_params->group_limit_rate > 1){
+          fprintf(stderr, "ERROR: wrong value of parameter <group_limit_rate> in <cloth_input.txt>.\n");
+          exit(-1);
+      }
+      if(net_params->group_size < 0){
+          fprintf(stderr, "ERROR: wrong value of parameter <group_size> in <cloth_input.txt>.\n");
+          exit(-1);
+      }
+      if(net_params->group_cap_update == (unsigned int)-1){
+          fprintf(stderr, "ERROR: wrong value of parameter <group_cap_update> in <cloth_input.txt>.\n");
+          exit(-1);
+      }
+  }
+  if((sim_params->checkpoint_time != 0 || sim_params->checkpoint_interval != 0) && strcmp(sim_params->checkpoint_filename, "")==0){
+      fprintf(stderr, "ERROR: parameter <checkpoint_filename> must be set when <checkpoint_time> or <checkpoint_interval> are set in <cloth_input.txt>.\n");
+      exit(-1);
+  }
+  if(sim_params->branch_time != 0 && strcmp(sim_params->branch_variants_filename, "")==0){
+      fprintf(stderr, "ERROR: parameter <branch_variants_filename> must be set when <branch_time> is set in <cloth_input.txt>.\n");
+      exit(-1);
+  }
+  // retired payments are not in the state of the simulation anymore
+  if(pay_params->retire_payments && (strcmp(sim_params->checkpoint_filename, "")!=0 || sim_params->branch_time != 0)){
+      fprintf(stderr, "ERROR: parameter <retire_payments> cannot be set with <checkpoint_filename> or <branch_time> in <cloth_input.txt>.\n");
+      exit(-1);
+  }
+  if(pay_params->workload_zipf_exponent < 0 || pay_params->workload_locality_hops < 1 || pay_params->workload_amount_sigma < 0 || pay_params->workload_pareto_alpha <= 1 ||
+     pay_params->workload_burst_factor < 1 || pay_params->workload_burst_duration <= 0 || pay_params->workload_diurnal_period <= 0 ||
+     pay_params->workload_repeat_probability < 0 || pay_params->workload_repeat_probability > 1){
+      fprintf(stderr, "ERROR: wrong value of a <workload_*> parameter in <cloth_input.txt>: zipf_exponent >= 0, locality_hops >= 1, amount_sigma >= 0, pareto_alpha > 1, burst_factor >= 1, burst_duration > 0, diurnal_period > 0, 0 <= repeat_probability <= 1.\n");
+      exit(-1);
+  }
+  // the stages of the ramp draw uniform random payments as they arrive; the state of the ramp is not in the checkpoints
+  if(pay_params->ramp_mode){
+    if(!pay_params->stream_payments || pay_params->payments_from_file || strcmp(pay_params->workload, "uniform")!=0 ||
+       strcmp(sim_params->checkpoint_filename, "")!=0 || strcmp(sim_params->restore_filename, "")!=0 || sim_params->branch_time != 0){
+      fprintf(stderr, "ERROR: parameter <ramp_mode> requires <stream_payments=true> and random payments of the <uniform> workload, without <checkpoint_filename>, <restore_filename> or <branch_time> in <cloth_input.txt>.\n");
+      exit(-1);
+    }
+    if(pay_params->ramp_initial_rate <= 0 || pay_params->ramp_rate_factor <= 1 || pay_params->ramp_stage_duration <= 0 || pay_params->ramp_min_success_rate < 0 ||
+       pay_params->ramp_min_success_rate > 1 || pay_params->ramp_tolerance <= 0 || pay_params->ramp_max_stages < 1){
+      fprintf(stderr, "ERROR: wrong value of a <ramp_*> parameter in <cloth_input.txt>: initial_rate > 0, rate_factor > 1, stage_duration > 0, 0 <= min_success_rate <= 1, tolerance > 0, max_stages >= 1.\n");
+      exit(-1);
+    }
+  }
+}
+
+
+/* parse the input parameters in "cloth_input.txt" */
+void read_input(struct network_params* net_params, struct payments_params* pay_params, struct simulation_params* sim_params){
+  FILE* input_file;
+  char *parameter, *value, line[1024];
+
+  initialize_input_parameters(net_params, pay_params, sim_params);
+
+  input_file = fopen("cloth_input.txt","r");
+
+  if(input_file==NULL){
+    fprintf(stderr, "ERROR: cannot open file <cloth_input.txt> in current directory.\n");
+    exit(-1);
+  }
+
+  while(fgets(line, 1024, input_file)){
+
+    parameter = strtok(line, "=");
+    value = strtok(NULL, "=");
+    if(parameter==NULL || value==NULL){
+      fprintf(stderr, "ERROR: wrong format in file <cloth_input.txt>\n");
+      fclose(input_file);
+      exit(-1);
+    }
+
+    if(value[0]==' ' || parameter[strlen(parameter)-1]==' '){
+      fprintf(stderr, "ERROR: no space allowed after/before <=> character in <cloth_input.txt>. Space detected in parameter <%s>\n", parameter);
+      fclose(input_file);
+      exit(-1);
+    }
+
+    value[strlen(value)-1] = '\0';
+
+    set_input_parameter(net_params, pay_params, sim_params, parameter, value, "cloth_input.txt");
+  }
+  fclose(input_file);
+  check_input_parameters(net_params, pay_params, sim_params);
+}
+
+
+/* a relative output filename is taken relative to the output directory */
+void resolve_output_filename(char filename[256], char output_dir_name[]){
+  char resolved_filename[256];
+  if(strcmp(filename, "")==0 || filename[0] == '/') return;
+  if(snprintf(resolved_filename, sizeof(resolved_filename), "%s%s", output_dir_name, filename) >= (int)sizeof(resolved_filename)) {
+    fprintf(stderr, "ERROR: filename <%s%s> too long\n", output_dir_name, filename);
+    exit(-1);
+  }
+  strcpy(filename, resolved_filename);
+}
@@ -1,28 +1,65 @@
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 #include <gsl/gsl_math.h>
 #include <gsl/gsl_rng.h>
 #include "../include/network.h"
 #include "../include/array.h"
 #include "../include/utils.h"
+#include "../include/network_snapshot.h"
+#include "../include/csv.h"
+#include "../include/network_ordering.h"
+#include "../include/network_core.h"
+#include "../include/capacity_oracle.h"
 
 
 /* Functions in this file generate a payment-channel network where to simulate the execution of payments */
 
 
-struct node* new_node(long id) {
+#define NETWORK_ARENA_CHUNK_SIZE (1<<20)
+
+
+/* an empty network, with room for the given number of nodes and channels */
+struct network* new_network(long n_nodes, long n_channels) {
+  struct network* network;
+  network = (struct network*) malloc(sizeof(struct network));
+  network->nodes = array_initialize(n_nodes > 0 ? n_nodes : 1);
+  network->channels = array_initialize(n_channels > 0 ? n_channels : 1);
+  network->edges = array_initialize(n_channels > 0 ? 2*n_channels : 1);
+  network->groups = NULL;
+  network->faulty_node_prob = NULL;
+  network->has_availability = network->skip_offline_nodes = 0;
+  network->node_arena = arena_initialize(NETWORK_ARENA_CHUNK_SIZE);
+  network->channel_arena = arena_initialize(NETWORK_ARENA_CHUNK_SIZE);
+  network->edge_arena = arena_initialize(NETWORK_ARENA_CHUNK_SIZE);
+  network->data_arena = arena_initialize(NETWORK_ARENA_CHUNK_SIZE);
+  network->node_map = network->channel_map = network->edge_map = NULL;
+  network->core = NULL;
+  network->capacity_oracle = NULL;
+  return network;
+}
+
+
+struct node* new_node(struct network* network, long id) {
   struct node* node;
-  node = malloc(sizeof(struct node));
+  node = arena_alloc(network->node_arena, sizeof(struct node));
   node->id=id;
-  node->open_edges = array_initialize(10);
+  node->open_edges = NULL;
+  node->n_open_edges = 0;
+  node->open_edges_size = 0;
+  node->n_closed_edges = 0;
+  node->offline_intervals = NULL;
+  node->n_offline_intervals = 0;
   node->results = NULL;
   node->explored = 0;
   return node;
 }
 
 
-struct channel* new_channel(long id, long direction1, long direction2, long node1, long node2, uint64_t capacity) {
+struct channel* new_channel(struct network* network, long id, long direction1, long direction2, long node1, long node2, uint64_t capacity) {
   struct channel* channel;
-  channel = malloc(sizeof(struct channel));
+  channel = arena_alloc(network->channel_arena, sizeof(struct channel));
   channel->id = id;
   channel->edge1 = direction1;
   channel->edge2 = direction2;
@@ -37,9 +74,9 @@ struct channel* new_channel(long id, long direction1, long direction2, long node
 
 
 //struct edge* new_edge(long id, long channel_id, long counter_edge_id, long from_node_id, long to_node_id, uint64_t balance, struct policy policy, uint64_t channel_capacity){
-struct edge* new_edge(long id, long channel_id, long counter_edge_id, long from_node_id, long to_node_id, uint64_t balance, struct policy policy, uint64_t channel_capacity){
+struct edge* new_edge(struct network* network, long id, long channel_id, long counter_edge_id, long from_node_id, long to_node_id, uint64_t balance, struct policy policy, uint64_t channel_capacity){
   struct edge* edge;
-  edge = malloc(sizeof(struct edge));
+  edge = arena_alloc(network->edge_arena, sizeof(struct edge));
   edge->id = id;
   edge->channel_id = channel_id;
   edge->from_node_id = from_node_id;
@@ -50,15 +87,102 @@ struct edge* new_edge(long id, long channel_id, long counter_edge_id, long from_
   edge->is_closed = 0;
   edge->tot_flows = 0;
   edge->group = NULL;
-  struct channel_update* channel_update = malloc(sizeof(struct channel_update));
-  channel_update->htlc_maximum_msat = channel_capacity;
-  channel_update->edge_id = edge->id;
-  channel_update->time = 0;
-  edge->channel_updates = push(NULL, channel_update);
+  edge->channel_updates = push_network_list(network, NULL, new_channel_update(network, edge->id, 0, channel_capacity));
   return edge;
 }
 
 
+/* channel updates live as long as the network: they are allocated in its arena */
+struct channel_update* new_channel_update(struct network* network, long edge_id, uint64_t time, uint64_t htlc_maximum_msat){
+  struct channel_update* channel_update;
+  channel_update = arena_alloc(network->data_arena, sizeof(struct channel_update));
+  channel_update->edge_id = edge_id;
+  channel_update->time = time;
+  channel_update->htlc_maximum_msat = htlc_maximum_msat;
+  return channel_update;
+}
+
+
+/* push `data` on a list that lives as long as the network: the element is allocated in its data arena, so it must not be popped or deleted */
+struct element* push_network_list(struct network* network, struct element* head, void* data){
+  struct element* element;
+  element = arena_alloc(network->data_arena, sizeof(struct element));
+  element->data = data;
+  element->next = head;
+  element->prev = NULL;
+  if(head != NULL) head->prev = element;
+  return element;
+}
+
+
+/* remove the CLOSED_EDGE entries from the open edges of a node, keeping the order of the others */
+static void compact_open_edges(struct node* node){
+  uint32_t i, n = 0;
+  for(i = 0; i < node->n_open_edges; i++)
+    if(node->open_edges[i] != CLOSED_EDGE)
+      node->open_edges[n++] = node->open_edges[i];
+  node->n_open_edges = n;
+  node->n_closed_edges = 0;
+}
+
+
+/* add an edge to the edges leaving a node; when the edge ids of the node are full, the closed edges are removed or,
+   if there are none, the edge ids are copied in a new space of double size in the arena */
+void add_open_edge(struct network* network, struct node* node, long edge_id){
+  uint32_t* open_edges;
+  if(edge_id < 0 || edge_id >= CLOSED_EDGE) {
+    fprintf(stderr, "ERROR: edge id <%ld> cannot be stored in 32 bits\n", edge_id);
+    exit(-1);
+  }
+  if(node->n_open_edges == node->open_edges_size && node->n_closed_edges > 0)
+    compact_open_edges(node);
+  if(node->n_open_edges == node->open_edges_size) {
+    node->open_edges_size = node->open_edges_size > 0 ? 2*node->open_edges_size : 4;
+    open_edges = arena_alloc(network->data_arena, node->open_edges_size*sizeof(uint32_t));
+    if(node->n_open_edges > 0)
+      memcpy(open_edges, node->open_edges, node->n_open_edges*sizeof(uint32_t));
+    node->open_edges = open_edges;
+  }
+  node->open_edges[node->n_open_edges++] = edge_id;
+}
+
+
+/* replace a closed edge with a CLOSED_EDGE entry; the entries are removed when they are half of the open edges of the node */
+void close_open_edge(struct node* node, long edge_id){
+  uint32_t i;
+  for(i = 0; i < node->n_open_edges; i++) {
+    if(node->open_edges[i] != edge_id) continue;
+    node->open_edges[i] = CLOSED_EDGE;
+    node->n_closed_edges++;
+    if(2*node->n_closed_edges >= node->n_open_edges)
+      compact_open_edges(node);
+    return;
+  }
+}
+
+
+int has_open_edge(struct node* node, long edge_id){
+  uint32_t i;
+  for(i = 0; i < node->n_open_edges; i++)
+    if(node->open_edges[i] == edge_id) return 1;
+  return 0;
+}
+
+
+/* the input id of an id of the network; negative ids (no node or edge) and the ids of channels and edges opened during the simulation are not mapped */
+long get_original_id(struct id_map* map, long id){
+  if(map == NULL || id < 0 || id >= map->n) return id;
+  return map->original_ids[id];
+}
+
+
+/* the id in the network of an input id */
+long get_renumbered_id(struct id_map* map, long original_id){
+  if(map == NULL || original_id < 0 || original_id >= map->n) return original_id;
+  return map->ids[original_id];
+}
+
+
 /* after generating a network, write it in csv files "nodes.csv" "edges.csv" "channels.csv" */
 void write_network_files(struct network* network){
   FILE* nodes_output_file, *edges_output_file, *channels_output_file;
@@ -110,26 +234,50 @@ void write_network_files(struct network* network){
 }
 
 
-void update_probability_per_node(double *probability_per_node, int *channels_per_node, long n_nodes, long node1_id, long node2_id, long tot_channels){
-  long i;
-  channels_per_node[node1_id] += 1;
-  channels_per_node[node2_id] += 1;
-  for(i=0; i<n_nodes; i++)
-    probability_per_node[i] = ((double)channels_per_node[i])/tot_channels;
+/* sample one of the first `n_candidates` nodes with probability proportional to the number of channels it has,
+   given the Fenwick tree of the channels per node */
+long sample_node_by_channels(uint64_t* tree, long n, long n_candidates, gsl_rng* random_generator){
+  uint64_t tot_channels, target;
+  tot_channels = fenwick_prefix_sum(tree, n_candidates);
+  target = gsl_rng_uniform(random_generator)*tot_channels;
+  if(target >= tot_channels) target = tot_channels - 1;
+  return fenwick_find(tree, n, target);
+}
+
+static gsl_ran_discrete_t* min_htlc_discrete;
+static pthread_once_t min_htlc_discrete_once = PTHREAD_ONCE_INIT;
+
+static void initialize_min_htlc_discrete(){
+  double min_htlcP[]={0.7, 0.2, 0.05, 0.05};
+  min_htlc_discrete = gsl_ran_discrete_preproc(4, min_htlcP);
+}
+
+/* generate the random policy of an edge; it can be called by concurrent threads with different random generators */
+struct policy generate_random_policy(gsl_rng* random_generator, double cul_threshold_dist_alpha, double cul_threshold_dist_beta) {
+  struct policy policy;
+
+  // the distribution of min_htlc is the same for all edges: it is preprocessed once
+  pthread_once(&min_htlc_discrete_once, initialize_min_htlc_discrete);
+  policy.fee_base = gsl_rng_uniform_int(random_generator, MAXFEEBASE - MINFEEBASE) + MINFEEBASE;
+  policy.fee_proportional = (gsl_rng_uniform_int(random_generator, MAXFEEPROP-MINFEEPROP)+MINFEEPROP);
+  policy.timelock = gsl_rng_uniform_int(random_generator, MAXTIMELOCK-MINTIMELOCK)+MINTIMELOCK;
+  policy.min_htlc = gsl_pow_int(10, gsl_ran_discrete(random_generator, min_htlc_discrete));
+  policy.min_htlc = policy.min_htlc == 1 ? 0 : policy.min_htlc;
+  policy.cul_threshold = gsl_ran_beta(random_generator, cul_threshold_dist_alpha, cul_threshold_dist_beta);
+  return policy;
 }
 
 /* generate a channel (connecting node1_id and node2_id) with random values */
 void generate_random_channel(struct channel channel_data, uint64_t mean_channel_capacity, struct network* network, gsl_rng*random_generator, double cul_threshold_dist_alpha, double cul_threshold_dist_beta) {
   uint64_t capacity, edge1_balance, edge2_balance;
   struct policy edge1_policy, edge2_policy;
-  double min_htlcP[]={0.7, 0.2, 0.05, 0.05}, fraction_capacity;
-  gsl_ran_discrete_t* min_htlc_discrete;
+  double fraction_capacity;
   struct channel* channel;
   struct edge* edge1, *edge2;
   struct node* node;
 
   capacity = fabs(mean_channel_capacity + gsl_ran_ugaussian(random_generator));
-  channel = new_channel(channel_data.id, channel_data.edge1, channel_data.edge2, channel_data.node1, channel_data.node2, capacity*1000);
+  channel = new_channel(network, channel_data.id, channel_data.edge1, channel_data.edge2, channel_data.node1, channel_data.node2, capacity*1000);
 
   fraction_capacity = gsl_rng_uniform(random_generator);
   edge1_balance = fraction_capacity*((double) capacity);
@@ -138,31 +286,20 @@ void generate_random_channel(struct channel channel_data, uint64_t mean_channel_
   edge1_balance*=1000;
   edge2_balance*=1000;
 
-  min_htlc_discrete = gsl_ran_discrete_preproc(4, min_htlcP);
-  edge1_policy.fee_base = gsl_rng_uniform_int(random_generator, MAXFEEBASE - MINFEEBASE) + MINFEEBASE;
-  edge1_policy.fee_proportional = (gsl_rng_uniform_int(random_generator, MAXFEEPROP-MINFEEPROP)+MINFEEPROP);
-  edge1_policy.timelock = gsl_rng_uniform_int(random_generator, MAXTIMELOCK-MINTIMELOCK)+MINTIMELOCK;
-  edge1_policy.min_htlc = gsl_pow_int(10, gsl_ran_discrete(random_generator, min_htlc_discrete));
-  edge1_policy.min_htlc = edge1_policy.min_htlc == 1 ? 0 : edge1_policy.min_htlc;
-  edge1_policy.cul_threshold = gsl_ran_beta(random_generator, cul_threshold_dist_alpha, cul_threshold_dist_beta);
-  edge2_policy.fee_base = gsl_rng_uniform_int(random_generator, MAXFEEBASE - MINFEEBASE) + MINFEEBASE;
-  edge2_policy.fee_proportional = (gsl_rng_uniform_int(random_generator, MAXFEEPROP-MINFEEPROP)+MINFEEPROP);
-  edge2_policy.timelock = gsl_rng_uniform_int(random_generator, MAXTIMELOCK-MINTIMELOCK)+MINTIMELOCK;
-  edge2_policy.min_htlc = gsl_pow_int(10, gsl_ran_discrete(random_generator, min_htlc_discrete));
-  edge2_policy.min_htlc = edge2_policy.min_htlc == 1 ? 0 : edge2_policy.min_htlc;
-  edge2_policy.cul_threshold = gsl_ran_beta(random_generator, cul_threshold_dist_alpha, cul_threshold_dist_beta);
-
-  edge1 = new_edge(channel_data.edge1, channel_data.id, channel_data.edge2, channel_data.node1, channel_data.node2, edge1_balance, edge1_policy, channel_data.capacity);
-  edge2 = new_edge(channel_data.edge2, channel_data.id, channel_data.edge1, channel_data.node2, channel_data.node1, edge2_balance, edge2_policy, channel_data.capacity);
+  edge1_policy = generate_random_policy(random_generator, cul_threshold_dist_alpha, cul_threshold_dist_beta);
+  edge2_policy = generate_random_policy(random_generator, cul_threshold_dist_alpha, cul_threshold_dist_beta);
+
+  edge1 = new_edge(network, channel_data.edge1, channel_data.id, channel_data.edge2, channel_data.node1, channel_data.node2, edge1_balance, edge1_policy, channel->capacity);
+  edge2 = new_edge(network, channel_data.edge2, channel_data.id, channel_data.edge1, channel_data.node2, channel_data.node1, edge2_balance, edge2_policy, channel->capacity);
 
   network->channels = array_insert(network->channels, channel);
   network->edges = array_insert(network->edges, edge1);
   network->edges = array_insert(network->edges, edge2);
 
   node = array_get(network->nodes, channel_data.node1);
-  node->open_edges = array_insert(node->open_edges, &(edge1->id));
+  add_open_edge(network, node, edge1->id);
   node = array_get(network->nodes, channel_data.node2);
-  node->open_edges = array_insert(node->open_edges, &(edge2->id));
+  add_open_edge(network, node, edge2->id);
 }
 
 
@@ -170,83 +307,68 @@ void generate_random_channel(struct channel channel_data, uint64_t mean_channel_
    the model of the network is a snapshot of the Lightning Network (files "nodes_ln.csv", "channels_ln.csv");
    starting from this network, a random network is generated using the scale-free network model */
 struct network* generate_random_network(struct network_params net_params, gsl_rng* random_generator){
-  FILE* nodes_input_file, *channels_input_file;
-  char row[256];
-  long node_id_counter=0, id, channel_id_counter=0, tot_nodes, i, tot_channels, node_to_connect_id, edge_id_counter=0, j;
-  double *probability_per_node;
-  int *channels_per_node;
+  long node_id_counter=0, channel_id_counter=0, tot_nodes, i, node_to_connect_id, edge_id_counter=0, j;
+  uint64_t *channels_per_node;
   struct network* network;
   struct node* node;
-  gsl_ran_discrete_t* connection_probability;
   struct channel channel;
+  struct csv_table *nodes_table, *channels_table;
+  union csv_value* row;
+  union csv_value channel_defaults[6];
 
-  nodes_input_file = fopen("nodes_ln.csv", "r");
-  if(nodes_input_file==NULL) {
-    fprintf(stderr, "ERROR: cannot open file <%s>\n", "nodes_ln.csv");
+  nodes_table = csv_read("nodes_ln.csv", "i", 1, NULL);
+  // the capacity of the channels of the model is not used
+  memset(channel_defaults, 0, sizeof(channel_defaults));
+  channels_table = csv_read("channels_ln.csv", "iiiiii", 5, channel_defaults);
+
+  tot_nodes = nodes_table->n_rows + net_params.n_nodes;
+  if(tot_nodes == 0){
+    fprintf(stderr, "ERROR: it is not possible to generate a network with 0 nodes\n");
     exit(-1);
   }
-  channels_input_file = fopen("channels_ln.csv", "r");
-  if(channels_input_file==NULL) {
-    fprintf(stderr, "ERROR: cannot open file <%s>\n", "channels_ln.csv");
-    fclose(nodes_input_file);
+  if(channels_table->n_rows == 0){
+    fprintf(stderr, "ERROR: it is not possible to generate a network with 0 channels\n");
     exit(-1);
   }
 
-  network = (struct network*) malloc(sizeof(struct network));
-  network->nodes = array_initialize(1000);
-  network->channels = array_initialize(1000);
-  network->edges = array_initialize(2000);
-
-  fgets(row, 256, nodes_input_file);
-  while(fgets(row, 256, nodes_input_file)!=NULL) {
-    sscanf(row, "%ld,%*d", &id);
-    node = new_node(id);
+  network = new_network(tot_nodes, channels_table->n_rows + net_params.n_nodes*net_params.n_channels);
+
+  for(i = 0; i < nodes_table->n_rows; i++) {
+    node = new_node(network, nodes_table->values[i].integer);
     network->nodes = array_insert(network->nodes, node);
     node_id_counter++;
   }
-  tot_nodes = node_id_counter + net_params.n_nodes;
-  if(tot_nodes == 0){
-    fprintf(stderr, "ERROR: it is not possible to generate a network with 0 nodes\n");
-    fclose(nodes_input_file);
-    fclose(channels_input_file);
-    exit(-1);
-  }
 
-  channels_per_node = malloc(sizeof(int)*(tot_nodes));
-  for(i = 0; i < tot_nodes; i++){
-    channels_per_node[i] = 0;
-  }
-
-  fgets(row, 256, channels_input_file);
-  while(fgets(row, 256, channels_input_file)!=NULL) {
-    sscanf(row, "%ld,%ld,%ld,%ld,%ld,%*d,%*d", &(channel.id), &(channel.edge1), &(channel.edge2), &(channel.node1), &(channel.node2));
+  // Fenwick tree of the number of channels per node
+  channels_per_node = calloc(tot_nodes + 1, sizeof(uint64_t));
+
+  for(i = 0; i < channels_table->n_rows; i++) {
+    row = channels_table->values + i*channels_table->n_columns;
+    channel.id = row[0].integer;
+    channel.edge1 = row[1].integer;
+    channel.edge2 = row[2].integer;
+    channel.node1 = row[3].integer;
+    channel.node2 = row[4].integer;
+    if(channel.node1 < 0 || channel.node1 >= node_id_counter || channel.node2 < 0 || channel.node2 >= node_id_counter) {
+      fprintf(stderr, "ERROR: channel <%ld> in <channels_ln.csv> connects a node that does not exist\n", channel.id);
+      exit(-1);
+    }
     generate_random_channel(channel, net_params.capacity_per_channel, network, random_generator, net_params.cul_threshold_dist_alpha, net_params.cul_threshold_dist_beta);
-    channels_per_node[channel.node1] += 1;
-    channels_per_node[channel.node2] += 1;
+    fenwick_add(channels_per_node, tot_nodes, channel.node1, 1);
+    fenwick_add(channels_per_node, tot_nodes, channel.node2, 1);
     ++channel_id_counter;
     edge_id_counter+=2;
   }
-  tot_channels = channel_id_counter;
-  if(tot_channels == 0){
-    fprintf(stderr, "ERROR: it is not possible to generate a network with 0 channels\n");
-    fclose(nodes_input_file);
-    fclose(channels_input_file);
-    exit(-1);
-  }
-
-  probability_per_node = malloc(sizeof(double)*tot_nodes);
-  for(i=0; i<tot_nodes; i++){
-    probability_per_node[i] = ((double)channels_per_node[i])/tot_channels;
-  }
+  csv_free(nodes_table);
+  csv_free(channels_table);
 
   /* scale-free algorithm that creates a network starting from an existing network;
      the probability of connecting nodes is directly proprotional to the number of channels that a node has already open */
   for(i=0; i<net_params.n_nodes; i++){
-    node = new_node(node_id_counter);
+    node = new_node(network, node_id_counter);
     network->nodes = array_insert(network->nodes, node);
     for(j=0; j<net_params.n_channels; j++){
-      connection_probability = gsl_ran_discrete_preproc(node_id_counter, probability_per_node);
-      node_to_connect_id = gsl_ran_discrete(random_generator, connection_probability);
+      node_to_connect_id = sample_node_by_channels(channels_per_node, tot_nodes, node_id_counter, random_generator);
       channel.id = channel_id_counter;
       channel.edge1 = edge_id_counter;
       channel.edge2 = edge_id_counter + 1;
@@ -255,15 +377,13 @@ struct network* generate_random_network(struct network_params net_params, gsl_rn
       generate_random_channel(channel, net_params.capacity_per_channel, network, random_generator, net_params.cul_threshold_dist_alpha, net_params.cul_threshold_dist_beta);
       channel_id_counter++;
       edge_id_counter += 2;
-      update_probability_per_node(probability_per_node, channels_per_node, tot_nodes, node->id, node_to_connect_id, channel_id_counter);
+      fenwick_add(channels_per_node, tot_nodes, node->id, 1);
+      fenwick_add(channels_per_node, tot_nodes, node_to_connect_id, 1);
     }
     ++node_id_counter;
   }
 
-  fclose(nodes_input_file);
-  fclose(channels_input_file);
   free(channels_per_node);
-  free(probability_per_node);
 
   write_network_files(network);
 
@@ -273,67 +393,61 @@ struct network* generate_random_network(struct network_params net_params, gsl_rn
 
 /* generate a payment-channel network from input files */
 struct network* generate_network_from_files(char nodes_filename[256], char channels_filename[256], char edges_filename[256]) {
-  char row[2048];
   struct node* node;
-  long id, direction1, direction2, node_id1, node_id2, channel_id, other_direction;
+  long i, id, channel_id, node_id1, node_id2;
   struct policy policy;
-  uint64_t capacity, balance;
   struct channel* channel;
   struct edge* edge;
   struct network* network;
-  FILE *nodes_file, *channels_file, *edges_file;
+  struct csv_table *nodes_table, *channels_table, *edges_table;
+  union csv_value* row;
+  union csv_value edge_defaults[11];
 
-  nodes_file = fopen(nodes_filename, "r");
-  if(nodes_file==NULL) {
-    fprintf(stderr, "ERROR: cannot open file <%s>\n", nodes_filename);
-    exit(-1);
-  }
-  channels_file = fopen(channels_filename, "r");
-  if(channels_file==NULL) {
-    fprintf(stderr, "ERROR: cannot open file <%s>\n", channels_filename);
-    fclose(nodes_file);
-    exit(-1);
-  }
-  edges_file = fopen(edges_filename, "r");
-  if(edges_file==NULL) {
-    fprintf(stderr, "ERROR: cannot open file <%s>\n", edges_filename);
-    fclose(nodes_file);
-    fclose(channels_file);
-    exit(-1);
-  }
+  nodes_table = csv_read(nodes_filename, "i", 1, NULL);
+  channels_table = csv_read(channels_filename, "iiiiii", 6, NULL);
+  // the cul threshold may be missing (e.g., in edges_template.csv)
+  memset(edge_defaults, 0, sizeof(edge_defaults));
+  edges_table = csv_read(edges_filename, "iiiiiiiiiif", 10, edge_defaults);
 
-  network = (struct network*) malloc(sizeof(struct network));
-  network->nodes = array_initialize(1000);
-  network->channels = array_initialize(1000);
-  network->edges = array_initialize(2000);
-
-  fgets(row, 2048, nodes_file);
-  while(fgets(row, 2048, nodes_file)!=NULL) {
-    sscanf(row, "%ld", &id);
-    node = new_node(id);
+  network = new_network(nodes_table->n_rows, channels_table->n_rows);
+
+  for(i = 0; i < nodes_table->n_rows; i++) {
+    id = nodes_table->values[i].integer;
+    node = new_node(network, id);
     network->nodes = array_insert(network->nodes, node);
   }
-  fclose(nodes_file);
 
-  fgets(row, 2048, channels_file);
-  while(fgets(row, 2048, channels_file)!=NULL) {
-    sscanf(row, "%ld,%ld,%ld,%ld,%ld,%ld", &id, &direction1, &direction2, &node_id1, &node_id2, &capacity);
-    channel = new_channel(id, direction1, direction2, node_id1, node_id2, capacity);
+  for(i = 0; i < channels_table->n_rows; i++) {
+    row = channels_table->values + i*channels_table->n_columns;
+    channel = new_channel(network, row[0].integer, row[1].integer, row[2].integer, row[3].integer, row[4].integer, row[5].integer);
     network->channels = array_insert(network->channels, channel);
   }
-  fclose(channels_file);
-
 
-  fgets(row, 2048, edges_file);
-  while(fgets(row, 2048, edges_file)!=NULL) {
-    sscanf(row, "%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%d,%lf", &id, &channel_id, &other_direction, &node_id1, &node_id2, &balance, &policy.fee_base, &policy.fee_proportional, &policy.min_htlc, &policy.timelock, &policy.cul_threshold);
+  for(i = 0; i < edges_table->n_rows; i++) {
+    row = edges_table->values + i*edges_table->n_columns;
+    id = row[0].integer;
+    channel_id = row[1].integer;
+    node_id1 = row[3].integer;
+    node_id2 = row[4].integer;
+    if(channel_id < 0 || channel_id >= array_len(network->channels) || node_id1 < 0 || node_id1 >= array_len(network->nodes) || node_id2 < 0 || node_id2 >= array_len(network->nodes)) {
+      fprintf(stderr, "ERROR: edge <%ld> in <%s> refers to a channel or a node that does not exist\n", id, edges_filename);
+      exit(-1);
+    }
+    policy.fee_base = row[6].integer;
+    policy.fee_proportional = row[7].integer;
+    policy.min_htlc = row[8].integer;
+    policy.timelock = row[9].integer;
+    policy.cul_threshold = row[10].real;
     channel = array_get(network->channels, channel_id);
-    edge = new_edge(id, channel_id, other_direction, node_id1, node_id2, balance, policy, channel->capacity);
+    edge = new_edge(network, id, channel_id, row[2].integer, node_id1, node_id2, row[5].integer, policy, channel->capacity);
     network->edges = array_insert(network->edges, edge);
     node = array_get(network->nodes, node_id1);
-    node->open_edges = array_insert(node->open_edges, &(edge->id));
+    add_open_edge(network, node, edge->id);
   }
-  fclose(edges_file);
+
+  csv_free(nodes_table);
+  csv_free(channels_table);
+  csv_free(edges_table);
 
   return network;
 }
@@ -347,7 +461,10 @@ struct network* initialize_network(struct network_params net_params, gsl_rng* ra
   struct node* node;
 
   if(net_params.network_from_file) {
-      network = generate_network_from_files(net_params.nodes_filename, net_params.channels_filename,net_params.edges_filename);
+      if(strcmp(net_params.network_snapshot_filename, "") != 0)
+        network = generate_network_from_snapshot(net_params.network_snapshot_filename);
+      else
+        network = generate_network_from_files(net_params.nodes_filename, net_params.channels_filename,net_params.edges_filename);
 
       // override the cul_threshold if cul_threshold is set in cloth_input.txt
       if(net_params.cul_threshold_dist_alpha != -1 && net_params.cul_threshold_dist_beta != -1) {
@@ -360,6 +477,11 @@ struct network* initialize_network(struct network_params net_params, gsl_rng* ra
       network = generate_random_network(net_params, random_generator);
   }
 
+  network = renumber_network(network, net_params.network_ordering);
+  if(net_params.routing_prune_leaf_trees)
+    network->core = new_network_core(network);
+  network->capacity_oracle = new_capacity_oracle(network);
+
   faulty_prob[0] = 1-net_params.faulty_node_prob;
   faulty_prob[1] = net_params.faulty_node_prob;
   network->faulty_node_prob = gsl_ran_discrete_preproc(2, faulty_prob);
@@ -367,7 +489,7 @@ struct network* initialize_network(struct network_params net_params, gsl_rng* ra
   n_nodes = array_len(network->nodes);
   for(i=0; i<n_nodes; i++){
     node = array_get(network->nodes, i);
-    node->results = (struct element**) malloc(n_nodes*sizeof(struct element*));
+    node->results = (struct element**) arena_alloc(network->data_arena, n_nodes*sizeof(struct element*));
     for(j=0; j<n_nodes; j++)
       node->results[j] = NULL;
   }
@@ -377,22 +499,46 @@ struct network* initialize_network(struct network_params net_params, gsl_rng* ra
   return  network;
 }
 
-/* open a new channel during the simulation */
-/* currenlty NOT USED */
-void open_channel(struct network* network, gsl_rng* random_generator, struct network_params net_params) {
-  struct channel channel;
-  channel.id = array_len(network->channels);
-  channel.edge1 = array_len(network->edges);
-  channel.edge2 = array_len(network->edges) + 1;
-  channel.node1 = gsl_rng_uniform_int(random_generator, array_len(network->nodes));
-  do{
-    channel.node2 = gsl_rng_uniform_int(random_generator, array_len(network->nodes));
-  } while(channel.node2==channel.node1);
-  generate_random_channel(channel, 1000, network, random_generator, net_params.cul_threshold_dist_alpha, net_params.cul_threshold_dist_beta);
+/* add a channel opened during the simulation, with the next channel and edge ids; `edge1_balance` is the balance of node1 */
+struct channel* add_channel(struct network* network, long node1, long node2, uint64_t capacity, uint64_t edge1_balance, struct policy edge1_policy, struct policy edge2_policy) {
+  long channel_id, edge1_id, edge2_id;
+  struct channel* channel;
+  struct edge* edge1, *edge2;
+
+  channel_id = array_len(network->channels);
+  edge1_id = array_len(network->edges);
+  edge2_id = edge1_id + 1;
+  channel = new_channel(network, channel_id, edge1_id, edge2_id, node1, node2, capacity);
+  edge1 = new_edge(network, edge1_id, channel_id, edge2_id, node1, node2, edge1_balance, edge1_policy, capacity);
+  edge2 = new_edge(network, edge2_id, channel_id, edge1_id, node2, node1, capacity - edge1_balance, edge2_policy, capacity);
+
+  network->channels = array_insert(network->channels, channel);
+  network->edges = array_insert(network->edges, edge1);
+  network->edges = array_insert(network->edges, edge2);
+  add_open_edge(network, array_get(network->nodes, node1), edge1_id);
+  add_open_edge(network, array_get(network->nodes, node2), edge2_id);
+  return channel;
+}
+
+
+/* close a channel: its edges are removed from the open edges of their nodes, so that they are no more used by path finding;
+   the edges keep their balances for the htlcs that are still settling on them */
+void mark_channel_closed(struct network* network, long channel_id) {
+  struct channel* channel;
+  struct edge* edge1, *edge2;
+
+  channel = array_get(network->channels, channel_id);
+  if(channel->is_closed) return;
+  channel->is_closed = 1;
+  edge1 = array_get(network->edges, channel->edge1);
+  edge2 = array_get(network->edges, channel->edge2);
+  edge1->is_closed = edge2->is_closed = 1;
+  close_open_edge(array_get(network->nodes, edge1->from_node_id), edge1->id);
+  close_open_edge(array_get(network->nodes, edge2->from_node_id), edge2->id);
 }
 
 // if triggered_edge is NULL, it means that this function is called by construct_groups()
-int update_group(struct group* group, struct network_params net_params, uint64_t current_time, gsl_rng* random_generator, int enable_fake_balance_update, struct edge* triggered_edge) {
+int update_group(struct network* network, struct group* group, struct network_params net_params, uint64_t current_time, gsl_rng* random_generator, int enable_fake_balance_update, struct edge* triggered_edge) {
     int close_flg = 0;
 
     // update group cap
@@ -445,7 +591,7 @@ int update_group(struct group* group, struct network_params net_params, uint64_t
     }
 
     // record group_update history
-    struct group_update* group_update = malloc(sizeof(struct group_update));
+    struct group_update* group_update = arena_alloc(network->data_arena, sizeof(struct group_update));
     group_update->group_cap = group->group_cap;
     group_update->time = current_time;
     if(triggered_edge != NULL) {
@@ -453,7 +599,7 @@ int update_group(struct group* group, struct network_params net_params, uint64_t
     }else{
         group_update->triggered_edge_id = -1;
     }
-    group_update->edge_balances = malloc(sizeof(uint64_t) * array_len(group->edges));
+    group_update->edge_balances = arena_alloc(network->data_arena, sizeof(uint64_t) * array_len(group->edges));
     for (int i = 0; i < array_len(group->edges); i++) {
         struct edge* edge = array_get(group->edges, i);
         if(fake_value_edge != NULL){
@@ -473,7 +619,7 @@ int update_group(struct group* group, struct network_params net_params, uint64_t
         group_update->fake_balance_updated_edge_id = -1;
         group_update->fake_balance_updated_edge_actual_balance = 0;
     }
-    group->history = push(group->history, group_update);
+    group->history = push_network_list(network, group->history, group_update);
 
     return close_flg;
 }
@@ -482,8 +628,7 @@ long get_edge_balance(struct edge* e){
     return e->balance;
 }
 
-struct edge_snapshot* take_edge_snapshot(struct edge* e, uint64_t sent_amt, short is_in_group, uint64_t group_cap) {
-    struct edge_snapshot* snapshot = malloc(sizeof(struct edge_snapshot));
+void take_edge_snapshot(struct edge_snapshot* snapshot, struct edge* e, uint64_t sent_amt, short is_in_group, uint64_t group_cap) {
     snapshot->id = e->id;
     snapshot->balance = e->balance;
     snapshot->sent_amt = sent_amt;
@@ -497,34 +642,36 @@ struct edge_snapshot* take_edge_snapshot(struct edge* e, uint64_t sent_amt, shor
         snapshot->does_channel_update_exist = 0;
         snapshot->last_channle_update_value = 0;
     }
-    return snapshot;
 }
 
+/* free a network: the nodes, channels, edges and the lists built during the simulation (results of the nodes,
+   channel updates of the edges, histories of the groups) are freed at once with their arenas; only the groups are freed one by one */
 void free_network(struct network* network){
-    for(uint64_t i = 0; array_len(network->nodes); i++){
-        struct node* n = array_get(network->nodes, i);
-        if(n == NULL) continue;
-        array_free(n->open_edges);
-        for(struct element* iterator = (struct element *) n->results; iterator != NULL; iterator = iterator->next){
-            list_free(iterator->data);
-        }
-        free(n);
-    }
-    for(uint64_t i = 0; array_len(network->edges); i++){
-        struct edge* e = array_get(network->edges, i);
-        if(e == NULL) continue;
-        list_free(e->channel_updates);
-        free(e);
-    }
-    for(uint64_t i = 0; array_len(network->channels); i++){
-        struct channel* c = array_get(network->channels, i);
-        if(c == NULL) continue;
-        free(c);
-    }
-    for(uint64_t i = 0; array_len(network->groups); i++){
-        struct group* g = array_get(network->groups, i);
-        if(g == NULL) continue;
-        list_free(g->history);
-        free(g);
+  long i;
+  struct group* group;
+
+  if(network->groups != NULL) {
+    for(i = 0; i < array_len(network->groups); i++){
+      group = array_get(network->groups, i);
+      array_free(group->edges);
+      free(group);
     }
+    array_free(network->groups);
+  }
+  if(network->faulty_node_prob != NULL)
+    gsl_ran_discrete_free(network->faulty_node_prob);
+
+  array_free(network->nodes);
+  array_free(network->channels);
+  array_free(network->edges);
+  arena_free(network->node_arena);
+  arena_free(network->channel_arena);
+  arena_free(network->edge_arena);
+  arena_free(network->data_arena);
+  free_id_map(network->node_map);
+  free_id_map(network->channel_map);
+  free_id_map(network->edge_map);
+  free_network_core(network->core);
+  free_capacity_oracle(network->capacity_oracle);
+  free(network);
 }
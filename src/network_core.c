@@ -0,0 +1,231 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "../include/array.h"
+#include "../include/network.h"
+#include "../include/network_core.h"
+
+/* Functions in this file compute the 2-core of a network (the largest subnetwork where every node has at least two neighbours)
+   and number the trees attached to it (see network_core.h). Most nodes of the Lightning Network have a single neighbour:
+   path finding does not use the nodes of a tree unless the source or the target of the path is in their subtree.
+   Parallel channels between two nodes count as one neighbour, and closed edges are ignored */
+
+
+/* the neighbour of a node that is not removed, -1 if there is none (a removed node has at most one such neighbour) */
+static long get_remaining_neighbour(struct network* network, long node_id, uint8_t* is_removed) {
+  struct node* node;
+  struct edge* edge;
+  uint32_t i;
+  node = array_get(network->nodes, node_id);
+  for(i = 0; i < node->n_open_edges; i++) {
+    if(node->open_edges[i] == CLOSED_EDGE) continue;
+    edge = array_get(network->edges, node->open_edges[i]);
+    if(!is_removed[edge->to_node_id]) return edge->to_node_id;
+  }
+  return -1;
+}
+
+
+/* remove the nodes with less than two neighbours until there are none: the remaining nodes are the 2-core */
+static void compute_core_nodes(struct network* network, struct network_core* core) {
+  long n_nodes, i, head, tail, neighbour, *queue, *last_seen;
+  uint32_t j, *degree;
+  uint8_t* is_removed;
+  struct node* node;
+  struct edge* edge;
+
+  n_nodes = array_len(network->nodes);
+  degree = malloc(sizeof(uint32_t)*n_nodes);
+  last_seen = malloc(sizeof(long)*n_nodes);
+  queue = malloc(sizeof(long)*n_nodes);
+  is_removed = calloc(n_nodes, sizeof(uint8_t));
+  for(i = 0; i < n_nodes; i++)
+    last_seen[i] = -1;
+
+  head = tail = 0;
+  for(i = 0; i < n_nodes; i++) {
+    node = array_get(network->nodes, i);
+    degree[i] = 0;
+    for(j = 0; j < node->n_open_edges; j++) {
+      if(node->open_edges[j] == CLOSED_EDGE) continue;
+      edge = array_get(network->edges, node->open_edges[j]);
+      if(edge->to_node_id == i || last_seen[edge->to_node_id] == i) continue;
+      last_seen[edge->to_node_id] = i;
+      degree[i]++;
+    }
+    if(degree[i] < 2) {
+      is_removed[i] = 1;
+      queue[tail++] = i;
+    }
+  }
+
+  while(head < tail) {
+    neighbour = get_remaining_neighbour(network, queue[head++], is_removed);
+    if(neighbour == -1) continue;
+    degree[neighbour]--;
+    if(degree[neighbour] < 2) {
+      is_removed[neighbour] = 1;
+      queue[tail++] = neighbour;
+    }
+  }
+
+  for(i = 0; i < n_nodes; i++)
+    core->is_core[i] = !is_removed[i];
+  core->n_core_nodes = n_nodes - tail;
+
+  free(degree);
+  free(last_seen);
+  free(queue);
+  free(is_removed);
+}
+
+
+/* depth-first visit of the tree of `root`, not entering the core; `stack` and `next_edge` have room for all the nodes */
+static void number_tree(struct network* network, struct network_core* core, long root, uint32_t* time, long* stack, uint32_t* next_edge) {
+  long top, node_id, to_node_id;
+  struct node* node;
+  struct edge* edge;
+
+  top = 0;
+  stack[0] = root;
+  next_edge[0] = 0;
+  core->tree_in[root] = (*time)++;
+  while(top >= 0) {
+    node_id = stack[top];
+    node = array_get(network->nodes, node_id);
+    to_node_id = -1;
+    while(next_edge[top] < node->n_open_edges) {
+      if(node->open_edges[next_edge[top]] == CLOSED_EDGE) {
+        next_edge[top]++;
+        continue;
+      }
+      edge = array_get(network->edges, node->open_edges[next_edge[top]++]);
+      if(core->is_core[edge->to_node_id] || core->tree_in[edge->to_node_id] != UINT32_MAX) continue;
+      to_node_id = edge->to_node_id;
+      break;
+    }
+    if(to_node_id == -1) {
+      core->tree_out[node_id] = *time - 1;
+      top--;
+      continue;
+    }
+    core->tree_in[to_node_id] = (*time)++;
+    top++;
+    stack[top] = to_node_id;
+    next_edge[top] = 0;
+  }
+}
+
+
+/* the trees attached to the core are visited from the core nodes; the components without core are visited from their first node */
+static void number_trees(struct network* network, struct network_core* core) {
+  long n_nodes, i, *stack;
+  uint32_t j, time, *next_edge;
+  struct node* node;
+  struct edge* edge;
+
+  n_nodes = array_len(network->nodes);
+  stack = malloc(sizeof(long)*n_nodes);
+  next_edge = malloc(sizeof(uint32_t)*n_nodes);
+  for(i = 0; i < n_nodes; i++)
+    core->tree_in[i] = core->tree_out[i] = UINT32_MAX;
+
+  time = 0;
+  for(i = 0; i < n_nodes; i++) {
+    if(!core->is_core[i]) continue;
+    node = array_get(network->nodes, i);
+    for(j = 0; j < node->n_open_edges; j++) {
+      if(node->open_edges[j] == CLOSED_EDGE) continue;
+      edge = array_get(network->edges, node->open_edges[j]);
+      if(!core->is_core[edge->to_node_id] && core->tree_in[edge->to_node_id] == UINT32_MAX)
+        number_tree(network, core, edge->to_node_id, &time, stack, next_edge);
+    }
+  }
+  for(i = 0; i < n_nodes; i++)
+    if(!core->is_core[i] && core->tree_in[i] == UINT32_MAX)
+      number_tree(network, core, i, &time, stack, next_edge);
+
+  free(stack);
+  free(next_edge);
+}
+
+
+struct network_core* new_network_core(struct network* network) {
+  struct network_core* core;
+  long n_nodes;
+
+  n_nodes = array_len(network->nodes);
+  core = malloc(sizeof(struct network_core));
+  core->is_core = malloc(sizeof(uint8_t)*(n_nodes > 0 ? n_nodes : 1));
+  core->tree_in = malloc(sizeof(uint32_t)*(n_nodes > 0 ? n_nodes : 1));
+  core->tree_out = malloc(sizeof(uint32_t)*(n_nodes > 0 ? n_nodes : 1));
+  core->is_stale = 0;
+  compute_core_nodes(network, core);
+  number_trees(network, core);
+  return core;
+}
+
+
+/* whether a core node has at least two distinct neighbours in the core */
+static int has_two_core_neighbours(struct network* network, struct network_core* core, long node_id) {
+  struct node* node;
+  struct edge* edge;
+  long neighbour = -1;
+  uint32_t i;
+  node = array_get(network->nodes, node_id);
+  for(i = 0; i < node->n_open_edges; i++) {
+    if(node->open_edges[i] == CLOSED_EDGE) continue;
+    edge = array_get(network->edges, node->open_edges[i]);
+    if(edge->to_node_id == node_id || !core->is_core[edge->to_node_id]) continue;
+    if(neighbour == -1) neighbour = edge->to_node_id;
+    else if(edge->to_node_id != neighbour) return 1;
+  }
+  return 0;
+}
+
+
+/* recompute the core at once (e.g., after a checkpoint is restored, before path finding runs in multiple threads) */
+void update_network_core(struct network* network) {
+  if(network->core == NULL) return;
+  free_network_core(network->core);
+  network->core = new_network_core(network);
+}
+
+
+/* called after the channel between two nodes is opened or closed: the core is recomputed before the next path finding (see refresh_network_core),
+   so that a sequence of changes costs a single computation. A channel between two core nodes leaves the core and the trees unchanged
+   when it is opened, and when it is closed if both nodes keep two neighbours in the core */
+void invalidate_network_core(struct network* network, long node1_id, long node2_id) {
+  struct network_core* core;
+  core = network->core;
+  if(core == NULL || core->is_stale) return;
+  if(core->is_core[node1_id] && core->is_core[node2_id] &&
+     has_two_core_neighbours(network, core, node1_id) && has_two_core_neighbours(network, core, node2_id))
+    return;
+  core->is_stale = 1;
+}
+
+
+/* recompute the core if it is stale. It must be called in a single thread before path finding: by find_path for the payments of the simulation,
+   and by run_dijkstra_jobs before its threads start (the initial paths of a branch are computed after channels may have changed) */
+void refresh_network_core(struct network* network) {
+  if(network->core != NULL && network->core->is_stale)
+    update_network_core(network);
+}
+
+
+/* the core for path finding, NULL if path finding is not pruned; it is up to date after refresh_network_core */
+struct network_core* get_network_core(struct network* network) {
+  return network->core;
+}
+
+
+void free_network_core(struct network_core* core) {
+  if(core == NULL) return;
+  free(core->is_core);
+  free(core->tree_in);
+  free(core->tree_out);
+  free(core);
+}
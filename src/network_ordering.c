@@ -0,0 +1,222 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/array.h"
+#include "../include/network.h"
+#include "../include/network_ordering.h"
+
+/* Functions in this file renumber the nodes, channels and edges of a network so that the records used together by path finding are close in memory.
+   Nodes are ordered by breadth-first visits of the network, so that neighbouring nodes get close ids; channels are numbered in the order
+   they are met from their nodes, and the two edges of a channel get consecutive ids. The network is copied in the new order,
+   and the maps between the new ids and the ids of the input files are kept in the network for the output */
+
+
+struct node_rank {
+  long id;
+  long degree;
+};
+
+
+static int compare_rank_ascending(const void* a, const void* b) {
+  const struct node_rank* x = a, *y = b;
+  if(x->degree != y->degree) return x->degree < y->degree ? -1 : 1;
+  return (x->id > y->id) - (x->id < y->id);
+}
+
+
+static int compare_rank_descending(const void* a, const void* b) {
+  const struct node_rank* x = a, *y = b;
+  if(x->degree != y->degree) return x->degree > y->degree ? -1 : 1;
+  return (x->id > y->id) - (x->id < y->id);
+}
+
+
+static struct id_map* new_id_map(long n) {
+  struct id_map* map;
+  map = malloc(sizeof(struct id_map));
+  map->n = n;
+  map->original_ids = malloc((n > 0 ? n : 1)*sizeof(long));
+  map->ids = malloc((n > 0 ? n : 1)*sizeof(long));
+  return map;
+}
+
+
+void free_id_map(struct id_map* map) {
+  if(map == NULL) return;
+  free(map->original_ids);
+  free(map->ids);
+  free(map);
+}
+
+
+/* order the nodes by breadth-first visits of the components of the network: each visit starts from the first unvisited node
+   in the order given by `compare` (degree, then id), and the unvisited neighbours of a node are queued in the same order.
+   `order[i]` is the node in position i */
+static void bfs_order(struct network* network, long* order, int (*compare)(const void*, const void*)) {
+  long n_nodes, i, k, head, tail, n_neighbours, max_degree;
+  uint32_t j;
+  struct node* node, *neighbour;
+  struct edge* edge;
+  struct node_rank* ranks, *neighbours;
+  char* is_visited;
+
+  n_nodes = array_len(network->nodes);
+  ranks = malloc((n_nodes > 0 ? n_nodes : 1)*sizeof(struct node_rank));
+  max_degree = 1;
+  for(i = 0; i < n_nodes; i++) {
+    node = array_get(network->nodes, i);
+    ranks[i].id = i;
+    ranks[i].degree = node->n_open_edges;
+    if(ranks[i].degree > max_degree) max_degree = ranks[i].degree;
+  }
+  qsort(ranks, n_nodes, sizeof(struct node_rank), compare);
+
+  neighbours = malloc(max_degree*sizeof(struct node_rank));
+  is_visited = calloc(n_nodes > 0 ? n_nodes : 1, sizeof(char));
+  head = tail = 0;
+  for(i = 0; i < n_nodes; i++) {
+    if(is_visited[ranks[i].id]) continue;
+    is_visited[ranks[i].id] = 1;
+    order[tail++] = ranks[i].id;
+    while(head < tail) {
+      node = array_get(network->nodes, order[head++]);
+      n_neighbours = 0;
+      for(j = 0; j < node->n_open_edges; j++) {
+        edge = array_get(network->edges, node->open_edges[j]);
+        if(is_visited[edge->to_node_id]) continue;
+        is_visited[edge->to_node_id] = 1;
+        neighbour = array_get(network->nodes, edge->to_node_id);
+        neighbours[n_neighbours].id = neighbour->id;
+        neighbours[n_neighbours].degree = neighbour->n_open_edges;
+        n_neighbours++;
+      }
+      qsort(neighbours, n_neighbours, sizeof(struct node_rank), compare);
+      for(k = 0; k < n_neighbours; k++)
+        order[tail++] = neighbours[k].id;
+    }
+  }
+
+  free(ranks);
+  free(neighbours);
+  free(is_visited);
+}
+
+
+/* reverse Cuthill-McKee: visits start from the nodes with fewest edges (an approximation of peripheral nodes), neighbours are queued
+   from the one with fewest edges, and the resulting order is reversed */
+static void rcm_order(struct network* network, long* order) {
+  long i, n_nodes, tmp;
+  n_nodes = array_len(network->nodes);
+  bfs_order(network, order, compare_rank_ascending);
+  for(i = 0; i < n_nodes/2; i++) {
+    tmp = order[i];
+    order[i] = order[n_nodes - 1 - i];
+    order[n_nodes - 1 - i] = tmp;
+  }
+}
+
+
+/* hubs first: visits start from the nodes with most edges, which are the most used by the paths */
+static void hub_bfs_order(struct network* network, long* order) {
+  bfs_order(network, order, compare_rank_descending);
+}
+
+
+static void map_id(struct id_map* map, long original_id, long* n_mapped) {
+  if(map->ids[original_id] != -1) return;
+  map->ids[original_id] = *n_mapped;
+  map->original_ids[*n_mapped] = original_id;
+  (*n_mapped)++;
+}
+
+
+/* renumber a network just loaded (the edges have only their initial channel update and there are no groups yet);
+   the input network is freed and the renumbered one is returned */
+struct network* renumber_network(struct network* network, enum network_ordering ordering) {
+  struct network* renumbered;
+  struct id_map* node_map, *channel_map, *edge_map;
+  long n_nodes, n_channels, n_edges, n_mapped, n_adjacent_edges, i;
+  uint32_t j, *open_edges;
+  struct node* node, *node_copy;
+  struct channel* channel, *channel_copy;
+  struct edge* edge, *edge_copy;
+
+  if(ordering == ORIGINAL_ORDERING) return network;
+
+  n_nodes = array_len(network->nodes);
+  n_channels = array_len(network->channels);
+  n_edges = array_len(network->edges);
+  node_map = new_id_map(n_nodes);
+  channel_map = new_id_map(n_channels);
+  edge_map = new_id_map(n_edges);
+
+  if(ordering == RCM_ORDERING)
+    rcm_order(network, node_map->original_ids);
+  else
+    hub_bfs_order(network, node_map->original_ids);
+  for(i = 0; i < n_nodes; i++)
+    node_map->ids[node_map->original_ids[i]] = i;
+
+  // channels in the order they are met from the nodes in the new order; channels without edges keep their relative order at the end
+  for(i = 0; i < n_channels; i++)
+    channel_map->ids[i] = -1;
+  n_mapped = 0;
+  n_adjacent_edges = 0;
+  for(i = 0; i < n_nodes; i++) {
+    node = array_get(network->nodes, node_map->original_ids[i]);
+    n_adjacent_edges += node->n_open_edges;
+    for(j = 0; j < node->n_open_edges; j++) {
+      edge = array_get(network->edges, node->open_edges[j]);
+      map_id(channel_map, edge->channel_id, &n_mapped);
+    }
+  }
+  for(i = 0; i < n_channels; i++)
+    map_id(channel_map, i, &n_mapped);
+
+  for(i = 0; i < n_edges; i++)
+    edge_map->ids[i] = -1;
+  n_mapped = 0;
+  for(i = 0; i < n_channels; i++) {
+    channel = array_get(network->channels, channel_map->original_ids[i]);
+    map_id(edge_map, channel->edge1, &n_mapped);
+    map_id(edge_map, channel->edge2, &n_mapped);
+  }
+  for(i = 0; i < n_edges; i++)
+    map_id(edge_map, i, &n_mapped);
+
+  // the records are copied in the new order, so that they are in the same order in the arenas
+  renumbered = new_network(n_nodes, n_channels);
+  open_edges = arena_alloc(renumbered->data_arena, (n_adjacent_edges > 0 ? n_adjacent_edges : 1)*sizeof(uint32_t));
+  for(i = 0; i < n_nodes; i++) {
+    node = array_get(network->nodes, node_map->original_ids[i]);
+    node_copy = new_node(renumbered, i);
+    node_copy->open_edges = open_edges;
+    node_copy->n_open_edges = node_copy->open_edges_size = node->n_open_edges;
+    for(j = 0; j < node->n_open_edges; j++)
+      node_copy->open_edges[j] = edge_map->ids[node->open_edges[j]];
+    open_edges += node->n_open_edges;
+    renumbered->nodes = array_insert(renumbered->nodes, node_copy);
+  }
+  for(i = 0; i < n_channels; i++) {
+    channel = array_get(network->channels, channel_map->original_ids[i]);
+    channel_copy = new_channel(renumbered, i, edge_map->ids[channel->edge1], edge_map->ids[channel->edge2], node_map->ids[channel->node1], node_map->ids[channel->node2], channel->capacity);
+    channel_copy->is_closed = channel->is_closed;
+    renumbered->channels = array_insert(renumbered->channels, channel_copy);
+  }
+  for(i = 0; i < n_edges; i++) {
+    edge = array_get(network->edges, edge_map->original_ids[i]);
+    channel = array_get(network->channels, edge->channel_id);
+    edge_copy = new_edge(renumbered, i, channel_map->ids[edge->channel_id], edge_map->ids[edge->counter_edge_id], node_map->ids[edge->from_node_id], node_map->ids[edge->to_node_id], edge->balance, edge->policy, channel->capacity);
+    edge_copy->is_closed = edge->is_closed;
+    edge_copy->tot_flows = edge->tot_flows;
+    renumbered->edges = array_insert(renumbered->edges, edge_copy);
+  }
+
+  renumbered->node_map = node_map;
+  renumbered->channel_map = channel_map;
+  renumbered->edge_map = edge_map;
+  free_network(network);
+
+  return renumbered;
+}
@@ -0,0 +1,268 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../include/network_snapshot.h"
+#include "../include/array.h"
+#include "../include/list.h"
+
+/* Functions in this file write a network in a binary snapshot (see `include/network_snapshot.h`) and load a network from it.
+   A snapshot is mapped in memory and its fixed-size records are copied in contiguous blocks of nodes, channels and edges, with no parsing;
+   it is produced from the csv files of a network by the tool `cloth_network_snapshot` (see `tools/network_snapshot.c`) */
+
+
+static void write_section(FILE* file, char filename[], const void* data, size_t size) {
+  if(size > 0 && fwrite(data, size, 1, file) != 1) {
+    fprintf(stderr, "ERROR: cannot write network snapshot <%s>\n", filename);
+    exit(-1);
+  }
+}
+
+
+void write_network_snapshot(char filename[], struct network* network) {
+  FILE* file;
+  struct network_snapshot_header header;
+  struct network_snapshot_node* node_records;
+  struct network_snapshot_channel* channel_records;
+  struct network_snapshot_edge* edge_records;
+  uint64_t* adjacency_offsets, *adjacency;
+  double* cul_thresholds;
+  long i, j, k, n_nodes, n_channels, n_edges;
+  struct node* node;
+  struct channel* channel;
+  struct edge* edge;
+
+  n_nodes = array_len(network->nodes);
+  n_channels = array_len(network->channels);
+  n_edges = array_len(network->edges);
+
+  node_records = calloc(n_nodes, sizeof(struct network_snapshot_node));
+  adjacency_offsets = malloc((n_nodes + 1)*sizeof(uint64_t));
+  adjacency = malloc(n_edges*sizeof(uint64_t));
+  adjacency_offsets[0] = 0;
+  for(i = 0; i < n_nodes; i++) {
+    node = array_get(network->nodes, i);
+    if(node->id != i) {
+      fprintf(stderr, "ERROR: node <%ld> is in position <%ld>: the ids of the nodes must be consecutive starting from 0\n", node->id, i);
+      exit(-1);
+    }
+    node_records[i].id = node->id;
+    adjacency_offsets[i+1] = adjacency_offsets[i] + node->n_open_edges - node->n_closed_edges;
+    if(adjacency_offsets[i+1] > (uint64_t)n_edges) {
+      fprintf(stderr, "ERROR: node <%ld> has more open edges than the edges of the network\n", node->id);
+      exit(-1);
+    }
+    for(j = 0, k = adjacency_offsets[i]; j < node->n_open_edges; j++)
+      if(node->open_edges[j] != CLOSED_EDGE)
+        adjacency[k++] = node->open_edges[j];
+  }
+
+  channel_records = calloc(n_channels, sizeof(struct network_snapshot_channel));
+  for(i = 0; i < n_channels; i++) {
+    channel = array_get(network->channels, i);
+    if(channel->id != i) {
+      fprintf(stderr, "ERROR: channel <%ld> is in position <%ld>: the ids of the channels must be consecutive starting from 0\n", channel->id, i);
+      exit(-1);
+    }
+    channel_records[i].id = channel->id;
+    channel_records[i].edge1 = channel->edge1;
+    channel_records[i].edge2 = channel->edge2;
+    channel_records[i].node1 = channel->node1;
+    channel_records[i].node2 = channel->node2;
+    channel_records[i].capacity = channel->capacity;
+  }
+
+  edge_records = calloc(n_edges, sizeof(struct network_snapshot_edge));
+  cul_thresholds = malloc(n_edges*sizeof(double));
+  for(i = 0; i < n_edges; i++) {
+    edge = array_get(network->edges, i);
+    if(edge->id != i) {
+      fprintf(stderr, "ERROR: edge <%ld> is in position <%ld>: the ids of the edges must be consecutive starting from 0\n", edge->id, i);
+      exit(-1);
+    }
+    edge_records[i].id = edge->id;
+    edge_records[i].channel_id = edge->channel_id;
+    edge_records[i].counter_edge_id = edge->counter_edge_id;
+    edge_records[i].from_node_id = edge->from_node_id;
+    edge_records[i].to_node_id = edge->to_node_id;
+    edge_records[i].balance = edge->balance;
+    edge_records[i].fee_base = edge->policy.fee_base;
+    edge_records[i].fee_proportional = edge->policy.fee_proportional;
+    edge_records[i].min_htlc = edge->policy.min_htlc;
+    edge_records[i].timelock = edge->policy.timelock;
+    cul_thresholds[i] = edge->policy.cul_threshold;
+  }
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, NETWORK_SNAPSHOT_MAGIC, sizeof(header.magic));
+  header.version = NETWORK_SNAPSHOT_VERSION;
+  header.header_size = sizeof(header);
+  header.n_nodes = n_nodes;
+  header.n_channels = n_channels;
+  header.n_edges = n_edges;
+
+  file = fopen(filename, "wb");
+  if(file == NULL) {
+    fprintf(stderr, "ERROR: cannot open file <%s>\n", filename);
+    exit(-1);
+  }
+  write_section(file, filename, &header, sizeof(header));
+  write_section(file, filename, node_records, n_nodes*sizeof(struct network_snapshot_node));
+  write_section(file, filename, channel_records, n_channels*sizeof(struct network_snapshot_channel));
+  write_section(file, filename, edge_records, n_edges*sizeof(struct network_snapshot_edge));
+  write_section(file, filename, adjacency_offsets, (n_nodes + 1)*sizeof(uint64_t));
+  write_section(file, filename, adjacency, adjacency_offsets[n_nodes]*sizeof(uint64_t));
+  write_section(file, filename, cul_thresholds, n_edges*sizeof(double));
+  if(fclose(file) != 0) {
+    fprintf(stderr, "ERROR: cannot write network snapshot <%s>\n", filename);
+    exit(-1);
+  }
+
+  free(node_records);
+  free(channel_records);
+  free(edge_records);
+  free(adjacency_offsets);
+  free(adjacency);
+  free(cul_thresholds);
+}
+
+
+static void snapshot_error(char filename[], const char* error) {
+  fprintf(stderr, "ERROR: network snapshot <%s> %s\n", filename, error);
+  exit(-1);
+}
+
+
+/* load a network from a snapshot; nodes, channels, edges and their initial channel updates are allocated in one block each */
+struct network* generate_network_from_snapshot(char filename[]) {
+  int fd;
+  struct stat file_stat;
+  char* mapping;
+  struct network_snapshot_header* header;
+  struct network_snapshot_node* node_records;
+  struct network_snapshot_channel* channel_records;
+  struct network_snapshot_edge* edge_records;
+  uint64_t* adjacency_offsets, *adjacency;
+  double* cul_thresholds;
+  size_t expected_size;
+  long i, n_nodes, n_channels, n_edges, n_adjacent_edges;
+  uint64_t j;
+  struct network* network;
+  struct node* nodes;
+  struct channel* channels;
+  struct edge* edges, *edge;
+  struct channel_update* channel_updates;
+  uint32_t* open_edges;
+
+  fd = open(filename, O_RDONLY);
+  if(fd == -1 || fstat(fd, &file_stat) != 0) {
+    fprintf(stderr, "ERROR: cannot open file <%s>\n", filename);
+    exit(-1);
+  }
+  if((size_t)file_stat.st_size < sizeof(struct network_snapshot_header))
+    snapshot_error(filename, "is truncated");
+  mapping = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(mapping == MAP_FAILED) {
+    fprintf(stderr, "ERROR: cannot map file <%s>\n", filename);
+    exit(-1);
+  }
+
+  header = (struct network_snapshot_header*) mapping;
+  if(memcmp(header->magic, NETWORK_SNAPSHOT_MAGIC, sizeof(header->magic)) != 0 || header->version != NETWORK_SNAPSHOT_VERSION || header->header_size != sizeof(struct network_snapshot_header))
+    snapshot_error(filename, "is not a network snapshot of this version");
+  n_nodes = header->n_nodes;
+  n_channels = header->n_channels;
+  n_edges = header->n_edges;
+  if(n_nodes == 0 || n_channels == 0 || n_edges != 2*n_channels)
+    snapshot_error(filename, "has an inconsistent number of nodes, channels or edges");
+
+  node_records = (struct network_snapshot_node*) (header + 1);
+  channel_records = (struct network_snapshot_channel*) (node_records + n_nodes);
+  edge_records = (struct network_snapshot_edge*) (channel_records + n_channels);
+  adjacency_offsets = (uint64_t*) (edge_records + n_edges);
+  expected_size = (char*) (adjacency_offsets + n_nodes + 1) - mapping;
+  if((size_t)file_stat.st_size < expected_size)
+    snapshot_error(filename, "is truncated");
+  n_adjacent_edges = adjacency_offsets[n_nodes];
+  adjacency = adjacency_offsets + n_nodes + 1;
+  cul_thresholds = (double*) (adjacency + n_adjacent_edges);
+  expected_size = (char*) (cul_thresholds + n_edges) - mapping;
+  if((size_t)file_stat.st_size != expected_size)
+    snapshot_error(filename, "has a wrong size");
+
+  // the records of each type are allocated at once in the arena of the type
+  network = new_network(n_nodes, n_channels);
+
+  channels = arena_alloc(network->channel_arena, n_channels*sizeof(struct channel));
+  for(i = 0; i < n_channels; i++) {
+    if(channel_records[i].id != i || channel_records[i].edge1 < 0 || channel_records[i].edge1 >= n_edges || channel_records[i].edge2 < 0 || channel_records[i].edge2 >= n_edges)
+      snapshot_error(filename, "has an invalid channel");
+    channels[i].id = channel_records[i].id;
+    channels[i].edge1 = channel_records[i].edge1;
+    channels[i].edge2 = channel_records[i].edge2;
+    channels[i].node1 = channel_records[i].node1;
+    channels[i].node2 = channel_records[i].node2;
+    channels[i].capacity = channel_records[i].capacity;
+    channels[i].is_closed = 0;
+    network->channels = array_insert(network->channels, &(channels[i]));
+  }
+
+  edges = arena_alloc(network->edge_arena, n_edges*sizeof(struct edge));
+  channel_updates = arena_alloc(network->data_arena, n_edges*sizeof(struct channel_update));
+  for(i = 0; i < n_edges; i++) {
+    if(edge_records[i].id != i || edge_records[i].channel_id < 0 || edge_records[i].channel_id >= n_channels ||
+       edge_records[i].from_node_id < 0 || edge_records[i].from_node_id >= n_nodes || edge_records[i].to_node_id < 0 || edge_records[i].to_node_id >= n_nodes)
+      snapshot_error(filename, "has an invalid edge");
+    edge = &(edges[i]);
+    edge->id = edge_records[i].id;
+    edge->channel_id = edge_records[i].channel_id;
+    edge->from_node_id = edge_records[i].from_node_id;
+    edge->to_node_id = edge_records[i].to_node_id;
+    edge->counter_edge_id = edge_records[i].counter_edge_id;
+    edge->policy.fee_base = edge_records[i].fee_base;
+    edge->policy.fee_proportional = edge_records[i].fee_proportional;
+    edge->policy.min_htlc = edge_records[i].min_htlc;
+    edge->policy.timelock = edge_records[i].timelock;
+    edge->policy.cul_threshold = cul_thresholds[i];
+    edge->balance = edge_records[i].balance;
+    edge->is_closed = 0;
+    edge->tot_flows = 0;
+    edge->group = NULL;
+    channel_updates[i].htlc_maximum_msat = channels[edge->channel_id].capacity;
+    channel_updates[i].edge_id = edge->id;
+    channel_updates[i].time = 0;
+    edge->channel_updates = push_network_list(network, NULL, &(channel_updates[i]));
+    network->edges = array_insert(network->edges, edge);
+  }
+
+  nodes = arena_alloc(network->node_arena, n_nodes*sizeof(struct node));
+  if(n_adjacent_edges > UINT32_MAX)
+    snapshot_error(filename, "has too many edges");
+  open_edges = arena_alloc(network->data_arena, n_adjacent_edges*sizeof(uint32_t));
+  for(i = 0; i < n_nodes; i++) {
+    if(node_records[i].id != i || adjacency_offsets[i] > adjacency_offsets[i+1] || adjacency_offsets[i+1] > (uint64_t)n_adjacent_edges)
+      snapshot_error(filename, "has an invalid node");
+    nodes[i].id = node_records[i].id;
+    nodes[i].results = NULL;
+    nodes[i].explored = 0;
+    // the open edges of all the nodes are in one block, each node has exactly the space of its edges
+    nodes[i].open_edges = open_edges + adjacency_offsets[i];
+    nodes[i].n_open_edges = nodes[i].open_edges_size = adjacency_offsets[i+1] - adjacency_offsets[i];
+    for(j = adjacency_offsets[i]; j < adjacency_offsets[i+1]; j++) {
+      if(adjacency[j] >= (uint64_t)n_edges)
+        snapshot_error(filename, "has an invalid adjacency");
+      open_edges[j] = adjacency[j];
+    }
+    network->nodes = array_insert(network->nodes, &(nodes[i]));
+  }
+
+  munmap(mapping, file_stat.st_size);
+
+  return network;
+}
@@ -0,0 +1,178 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../include/payment_trace.h"
+
+/* Functions in this file write payments in a binary payment trace (see `include/payment_trace.h`) and read them back.
+   A trace is mapped in memory and its records are decoded one after the other, with no parsing and no limit on their number;
+   it is produced from a payments file by the tool `cloth_payment_trace` (see `tools/payment_trace.c`) */
+
+
+static void trace_error(char filename[], const char* error) {
+  fprintf(stderr, "ERROR: payment trace <%s> %s\n", filename, error);
+  exit(-1);
+}
+
+
+/* a varint takes at most 10 bytes */
+static size_t encode_varint(unsigned char* buffer, uint64_t value) {
+  size_t n_bytes = 0;
+  while(value >= 0x80) {
+    buffer[n_bytes++] = (unsigned char) (value | 0x80);
+    value >>= 7;
+  }
+  buffer[n_bytes++] = (unsigned char) value;
+  return n_bytes;
+}
+
+
+static uint64_t decode_varint(struct payment_trace* trace) {
+  uint64_t value = 0;
+  unsigned char byte;
+  int shift;
+
+  for(shift = 0; shift < 64; shift += 7) {
+    if(trace->offset >= trace->mapping_size)
+      trace_error(trace->filename, "is truncated");
+    byte = trace->mapping[trace->offset++];
+    value |= (uint64_t) (byte & 0x7F) << shift;
+    if(!(byte & 0x80)) return value;
+  }
+  trace_error(trace->filename, "has a malformed record");
+  return 0;
+}
+
+
+/* the payments file can be either a csv file or a trace */
+unsigned int is_payment_trace(char filename[]) {
+  FILE* file;
+  char magic[8];
+  unsigned int is_trace;
+
+  file = fopen(filename, "rb");
+  if(file == NULL) return 0;
+  is_trace = fread(magic, sizeof(magic), 1, file) == 1 && memcmp(magic, PAYMENT_TRACE_MAGIC, sizeof(magic)) == 0;
+  fclose(file);
+  return is_trace;
+}
+
+
+/* `arrivals` must be sorted by start time */
+void write_payment_trace(char filename[], struct payment_arrival* arrivals, long n_payments) {
+  FILE* file;
+  struct payment_trace_header header;
+  unsigned char record[50];
+  size_t record_size;
+  uint64_t start_time;
+  long i;
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, PAYMENT_TRACE_MAGIC, sizeof(header.magic));
+  header.version = PAYMENT_TRACE_VERSION;
+  header.header_size = sizeof(header);
+  header.n_payments = n_payments;
+  header.first_start_time = n_payments > 0 ? arrivals[0].start_time : 0;
+  header.last_start_time = n_payments > 0 ? arrivals[n_payments - 1].start_time : 0;
+
+  file = fopen(filename, "wb");
+  if(file == NULL) {
+    fprintf(stderr, "ERROR: cannot open file <%s>\n", filename);
+    exit(-1);
+  }
+  // the header is written again at the end, with the size of the records
+  if(fwrite(&header, sizeof(header), 1, file) != 1)
+    trace_error(filename, "cannot be written");
+  start_time = header.first_start_time;
+  for(i = 0; i < n_payments; i++) {
+    if(arrivals[i].start_time < start_time) {
+      fprintf(stderr, "ERROR: payment <%ld> starts before the previous one: the payments of a trace must be sorted by start time\n", i);
+      exit(-1);
+    }
+    record_size = encode_varint(record, arrivals[i].start_time - start_time);
+    record_size += encode_varint(record + record_size, arrivals[i].sender);
+    record_size += encode_varint(record + record_size, arrivals[i].receiver);
+    record_size += encode_varint(record + record_size, arrivals[i].amount);
+    record_size += encode_varint(record + record_size, arrivals[i].max_fee_limit == UINT64_MAX ? 0 : arrivals[i].max_fee_limit + 1);
+    if(fwrite(record, record_size, 1, file) != 1)
+      trace_error(filename, "cannot be written");
+    header.records_size += record_size;
+    start_time = arrivals[i].start_time;
+  }
+  if(fseek(file, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, file) != 1 || fclose(file) != 0)
+    trace_error(filename, "cannot be written");
+}
+
+
+struct payment_trace* open_payment_trace(char filename[]) {
+  int fd;
+  struct stat file_stat;
+  struct payment_trace* trace;
+
+  fd = open(filename, O_RDONLY);
+  if(fd == -1 || fstat(fd, &file_stat) != 0) {
+    fprintf(stderr, "ERROR: cannot open file <%s>\n", filename);
+    exit(-1);
+  }
+  if((size_t)file_stat.st_size < sizeof(struct payment_trace_header))
+    trace_error(filename, "is truncated");
+
+  trace = malloc(sizeof(struct payment_trace));
+  snprintf(trace->filename, sizeof(trace->filename), "%s", filename);
+  trace->mapping_size = file_stat.st_size;
+  trace->mapping = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(trace->mapping == MAP_FAILED) {
+    fprintf(stderr, "ERROR: cannot map file <%s>\n", filename);
+    exit(-1);
+  }
+  // the records are read once, in order
+  madvise(trace->mapping, trace->mapping_size, MADV_SEQUENTIAL);
+
+  trace->header = (struct payment_trace_header*) trace->mapping;
+  if(memcmp(trace->header->magic, PAYMENT_TRACE_MAGIC, sizeof(trace->header->magic)) != 0 || trace->header->version != PAYMENT_TRACE_VERSION || trace->header->header_size != sizeof(struct payment_trace_header))
+    trace_error(filename, "is not a payment trace of this version");
+  if(trace->header->records_size != trace->mapping_size - sizeof(struct payment_trace_header))
+    trace_error(filename, "has a wrong size");
+  seek_payment_trace(trace, sizeof(struct payment_trace_header), trace->header->first_start_time, 0);
+  return trace;
+}
+
+
+/* it returns 0 after the last payment */
+int read_payment_trace(struct payment_trace* trace, struct payment_arrival* arrival) {
+  uint64_t max_fee_limit;
+
+  if(trace->n_read >= (long) trace->header->n_payments) return 0;
+  trace->start_time += decode_varint(trace);
+  arrival->start_time = trace->start_time;
+  arrival->sender = decode_varint(trace);
+  arrival->receiver = decode_varint(trace);
+  arrival->amount = decode_varint(trace);
+  max_fee_limit = decode_varint(trace);
+  arrival->max_fee_limit = max_fee_limit == 0 ? UINT64_MAX : max_fee_limit - 1;
+  trace->n_read++;
+  return 1;
+}
+
+
+/* restore a position of the cursor (see checkpoint.c): the offset of the next record, the start time of the payment before it and the payments read */
+void seek_payment_trace(struct payment_trace* trace, size_t offset, uint64_t start_time, long n_read) {
+  if(offset < sizeof(struct payment_trace_header) || offset > trace->mapping_size || n_read < 0 || n_read > (long) trace->header->n_payments)
+    trace_error(trace->filename, "has no such position");
+  trace->offset = offset;
+  trace->start_time = start_time;
+  trace->n_read = n_read;
+}
+
+
+void close_payment_trace(struct payment_trace* trace) {
+  if(trace == NULL) return;
+  munmap(trace->mapping, trace->mapping_size);
+  free(trace);
+}
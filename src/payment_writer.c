@@ -0,0 +1,238 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "../include/array.h"
+#include "../include/heap.h"
+#include "../include/network.h"
+#include "../include/payments.h"
+#include "../include/attempt_log.h"
+#include "../include/routing.h"
+#include "../include/payment_writer.h"
+
+/* Functions in this file write the rows of `payments_output.csv`: at the end of the simulation (see write_output in cloth.c), or,
+   with `retire_payments`, when a payment and all its shards are final, so that memory holds only the payments in flight
+   and the output is written by a background thread while the simulation runs (see payment_writer.h) */
+
+
+void write_payments_header(FILE* file) {
+  fprintf(file, "id,sender_id,receiver_id,amount,start_time,max_fee_limit,end_time,mpp,is_shard,parent_payment_id,shards,is_success,no_balance_count,offline_node_count,timeout_exp,attempts,route,total_fee,attempts_history\n");
+}
+
+
+/* a row of `payments_output.csv`; the shards of the payment must not be retired yet */
+void write_payment(FILE* file, struct payment* payment, struct array* payments, struct network* network) {
+  struct id_map* node_map = network->node_map, *edge_map = network->edge_map;
+  struct route* route;
+  struct route_hop* hop;
+  struct edge* edge;
+  struct channel* channel;
+  long j;
+
+  // Output all payments including shards
+  fprintf(file, "%ld,%ld,%ld,%ld,%ld,%ld,%ld,%u,%u,%ld,",
+          payment->id, get_original_id(node_map, payment->sender), get_original_id(node_map, payment->receiver), payment->amount,
+          payment->start_time, payment->max_fee_limit, payment->end_time,
+          payment->mpp_triggered, payment->is_shard, payment->parent_id);
+  // Output shards array - the direct child shards of the payment
+  for(j = payment->first_shard_id; j != -1; j = ((struct payment*) array_get(payments, j))->next_shard_id)
+    fprintf(file, j == payment->first_shard_id ? "%ld" : "-%ld", j);
+  fprintf(file, ",");
+  fprintf(file, "%u,%d,%d,%u,%d,",
+          payment->is_success, payment->no_balance_count, payment->offline_node_count,
+          payment->is_timeout, payment->attempts);
+  route = payment->route;
+  if(route==NULL)
+    fprintf(file, ",,");
+  else {
+    for(j=0; j<route->n_hops; j++) {
+      hop = &(route->hops[j]);
+      if(j==route->n_hops-1)
+        fprintf(file,"%ld,",get_original_id(edge_map, hop->edge_id));
+      else
+        fprintf(file,"%ld-",get_original_id(edge_map, hop->edge_id));
+    }
+    fprintf(file, "%ld,",route->total_fee);
+  }
+  // build attempts history json
+  if(payment->last_attempt != -1 && get_attempt_log_level() != ATTEMPT_LOG_OFF) {
+      fprintf(file, "\"[");
+      for (long index = payment->last_attempt; index != -1; index = get_attempt(index)->previous) {
+          struct attempt *attempt = get_attempt(index);
+          if(attempt->is_split) {
+              // Split event
+              fprintf(file, "{\"\"attempts\"\":%d,\"\"is_split\"\":true,\"\"end_time\"\":%llu,\"\"shard1_id\"\":%ld,\"\"shard2_id\"\":%ld}",
+                      attempt->attempts, attempt->end_time, attempt->shard1_id, attempt->shard2_id);
+          } else {
+              // Normal attempt (success or failure)
+              fprintf(file, "{\"\"attempts\"\":%d,\"\"is_succeeded\"\":%d,\"\"end_time\"\":%llu,\"\"error_edge\"\":%ld,\"\"error_type\"\":%d,\"\"route\"\":[",
+                      attempt->attempts, attempt->is_succeeded, attempt->end_time, attempt->error_type == NOERROR ? attempt->error_edge_id : get_original_id(edge_map, attempt->error_edge_id), attempt->error_type);
+              for (j = 0; j < attempt->n_hops; j++) {
+                  struct edge_snapshot* edge_snapshot = get_attempt_hop(attempt, j);
+                  edge = array_get(network->edges, edge_snapshot->id);
+                  channel = array_get(network->channels, edge->channel_id);
+                  fprintf(file,"{\"\"edge_id\"\":%ld,\"\"from_node_id\"\":%ld,\"\"to_node_id\"\":%ld,\"\"sent_amt\"\":%llu,\"\"edge_cap\"\":%llu,\"\"channel_cap\"\":%llu,",
+                          get_original_id(edge_map, edge_snapshot->id), get_original_id(node_map, edge->from_node_id), get_original_id(node_map, edge->to_node_id), edge_snapshot->sent_amt, edge_snapshot->balance, channel->capacity);
+                  if(edge_snapshot->is_in_group) fprintf(file, "\"\"group_cap\"\":%llu,", edge_snapshot->group_cap);
+                  else fprintf(file,"\"\"group_cap\"\":null,");
+                  if(edge_snapshot->does_channel_update_exist) fprintf(file,"\"\"channel_update\"\":%llu}", edge_snapshot->last_channle_update_value);
+                  else fprintf(file,"\"\"channel_update\"\":null}");
+                  if (j != attempt->n_hops - 1) fprintf(file, ",");
+              }
+              fprintf(file, "]}");
+          }
+          if (attempt->previous != -1) fprintf(file, ",");
+          else fprintf(file, "]");
+      }
+      fprintf(file, "\"");
+  }
+  fprintf(file, "\n");
+}
+
+
+static int compare_payment_row(struct payment_row* row1, struct payment_row* row2) {
+  if(row1->id == row2->id) return 0;
+  return row1->id < row2->id ? -1 : 1;
+}
+
+
+/* executed by the background thread: it writes the queued rows until the writer is closed */
+static void* write_rows(void* arg) {
+  struct payment_writer* writer = arg;
+  struct payment_row* row, *next_row;
+
+  pthread_mutex_lock(&(writer->mutex));
+  while(1) {
+    while(writer->first_row == NULL && !writer->is_closed)
+      pthread_cond_wait(&(writer->has_rows), &(writer->mutex));
+    if(writer->first_row == NULL) break;
+    row = writer->first_row;
+    writer->first_row = writer->last_row = NULL;
+    pthread_mutex_unlock(&(writer->mutex));
+    for(; row != NULL; row = next_row) {
+      if(fwrite(row->text, 1, row->length, writer->file) != row->length) {
+        fprintf(stderr, "ERROR: cannot write payments_output.csv\n");
+        exit(-1);
+      }
+      next_row = row->next;
+      free(row->text);
+      free(row);
+    }
+    pthread_mutex_lock(&(writer->mutex));
+  }
+  pthread_mutex_unlock(&(writer->mutex));
+  return NULL;
+}
+
+
+/* pass to the thread the retired rows that follow the last written one (all of them if `is_closing`) */
+static void queue_rows(struct payment_writer* writer, unsigned int is_closing) {
+  struct payment_row* row, *first_row = NULL, *last_row = NULL;
+
+  while(heap_len(writer->retired_rows) != 0) {
+    row = heap_peek(writer->retired_rows);
+    if(row->id != writer->next_id && !is_closing) break;
+    heap_pop(writer->retired_rows, compare_payment_row);
+    row->next = NULL;
+    if(last_row == NULL) first_row = row;
+    else last_row->next = row;
+    last_row = row;
+    writer->next_id = row->id + 1;
+  }
+  if(first_row == NULL) return;
+
+  pthread_mutex_lock(&(writer->mutex));
+  if(writer->last_row == NULL) writer->first_row = first_row;
+  else writer->last_row->next = first_row;
+  writer->last_row = last_row;
+  pthread_cond_signal(&(writer->has_rows));
+  pthread_mutex_unlock(&(writer->mutex));
+}
+
+
+struct payment_writer* open_payment_writer(char output_dir_name[]) {
+  struct payment_writer* writer;
+  char output_filename[512];
+
+  writer = malloc(sizeof(struct payment_writer));
+  snprintf(output_filename, sizeof(output_filename), "%spayments_output.csv", output_dir_name);
+  writer->file = fopen(output_filename, "w");
+  if(writer->file == NULL) {
+    fprintf(stderr, "ERROR: cannot open file <%s>\n", output_filename);
+    exit(-1);
+  }
+  write_payments_header(writer->file);
+  writer->first_row = writer->last_row = NULL;
+  writer->is_closed = 0;
+  writer->retired_rows = heap_initialize(1024);
+  writer->next_id = 0;
+  pthread_mutex_init(&(writer->mutex), NULL);
+  pthread_cond_init(&(writer->has_rows), NULL);
+  if(pthread_create(&(writer->thread), NULL, write_rows, writer) != 0) {
+    fprintf(stderr, "ERROR: cannot start the thread writing payments_output.csv\n");
+    exit(-1);
+  }
+  return writer;
+}
+
+
+/* a payment is final when neither it nor its shards have events in the queue */
+unsigned int is_payment_final(struct array* payments, struct payment* payment) {
+  struct payment* shard;
+  long id;
+  if(payment->n_events != 0) return 0;
+  for(id = payment->first_shard_id; id != -1; id = shard->next_shard_id) {
+    shard = array_get(payments, id);
+    if(!is_payment_final(payments, shard)) return 0;
+  }
+  return 1;
+}
+
+
+static void retire_shards(struct payment_writer* writer, struct array* payments, struct payment* payment, struct network* network) {
+  struct payment_row* row;
+  FILE* stream;
+  struct payment* shard;
+  long id, next_id;
+
+  row = malloc(sizeof(struct payment_row));
+  row->id = payment->id;
+  stream = open_memstream(&(row->text), &(row->length));
+  write_payment(stream, payment, payments, network);
+  fclose(stream);
+  writer->retired_rows = heap_insert(writer->retired_rows, row, compare_payment_row);
+
+  for(id = payment->first_shard_id; id != -1; id = next_id) {
+    shard = array_get(payments, id);
+    next_id = shard->next_shard_id;
+    retire_shards(writer, payments, shard, network);
+  }
+  payments->element[payment->id] = NULL;
+  free_payment(payment);
+}
+
+
+/* write the rows of a final root payment and of its shards, and free them: their slots in `payments` become NULL */
+void retire_payment(struct payment_writer* writer, struct array* payments, struct payment* payment, struct network* network) {
+  retire_shards(writer, payments, payment, network);
+  queue_rows(writer, 0);
+}
+
+
+/* the rows still waiting for a lower id are written anyway, then the thread is stopped */
+void close_payment_writer(struct payment_writer* writer) {
+  if(writer == NULL) return;
+  queue_rows(writer, 1);
+  pthread_mutex_lock(&(writer->mutex));
+  writer->is_closed = 1;
+  pthread_cond_signal(&(writer->has_rows));
+  pthread_mutex_unlock(&(writer->mutex));
+  pthread_join(writer->thread, NULL);
+  fclose(writer->file);
+  heap_free(writer->retired_rows);
+  pthread_mutex_destroy(&(writer->mutex));
+  pthread_cond_destroy(&(writer->has_rows));
+  free(writer);
+}
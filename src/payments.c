@@ -12,6 +12,13 @@
 #include "../include/htlc.h"
 #include "../include/payments.h"
 #include "../include/network.h"
+#include "../include/telemetry.h"
+#include "../include/csv.h"
+#include "../include/payment_trace.h"
+#include "../include/ramp.h"
+#include "../include/event.h"
+#include "../include/routing.h"
+#include "../include/attempt_log.h"
 
 /* Functions in this file generate the payments that are exchanged in the payment-channel network during the simulation */
 
@@ -25,6 +32,7 @@ struct payment* new_payment(long id, long sender, long receiver, uint64_t amount
   p->amount = amount;
   p->start_time = start_time;
   p->route = NULL;
+  p->reserved_path = NULL;
   p->is_success = 0;
   p->offline_node_count = 0;
   p->no_balance_count = 0;
@@ -35,24 +43,53 @@ struct payment* new_payment(long id, long sender, long receiver, uint64_t amount
   p->error.type = NOERROR;
   p->error.hop = NULL;
   p->is_shard = 0;
-  p->shards_id[0] = p->shards_id[1] = -1;
   p->parent_id = -1;
+  p->first_shard_id = p->last_shard_id = p->next_shard_id = -1;
+  p->n_shards = 0;
   p->root_payment_id = id;  // initially points to itself
   p->shard_count = 0;
   p->completed_shard_count = 0;
   p->successful_shard_count = 0;
   p->mpp_triggered = 0;
-  p->history = NULL;
+  p->last_attempt = -1;
+  p->n_events = 0;
   p->max_fee_limit = max_fee_limit;
   return p;
 }
 
 
+/* draw the maximum fee of a payment from the distribution in `pay_params` (no limit if the distribution is not set) */
+uint64_t generate_max_fee_limit(struct payments_params pay_params, gsl_rng* random_generator) {
+  if(pay_params.max_fee_limit_sigma != -1 && pay_params.max_fee_limit_mu != -1)
+    return fabs(pay_params.max_fee_limit_mu + gsl_ran_ugaussian(random_generator) * pay_params.max_fee_limit_sigma)*1000.0; // convert satoshi to millisatoshi
+  return UINT64_MAX;
+}
+
+
+/* draw a random payment starting after `payment_time`, which is advanced to its start time */
+static void draw_random_payment(struct payments_params pay_params, long n_nodes, gsl_rng* random_generator, uint64_t* payment_time, struct payment_arrival* arrival) {
+  uint64_t next_payment_interval;
+  do{
+    arrival->sender = gsl_rng_uniform_int(random_generator,n_nodes);
+    arrival->receiver = gsl_rng_uniform_int(random_generator, n_nodes);
+  } while(arrival->sender==arrival->receiver);
+  arrival->amount = fabs(pay_params.amount_mu + gsl_ran_ugaussian(random_generator) * pay_params.amount_sigma)*1000.0; // convert satoshi to millisatoshi
+  /* payment interarrival time is an exponential (Poisson process) whose mean is the inverse of payment rate
+     (expressed in payments per second, then multiplied to convert in milliseconds)
+   */
+  next_payment_interval = 1000*gsl_ran_exponential(random_generator, pay_params.inverse_payment_rate);
+  *payment_time += next_payment_interval;
+  arrival->start_time = *payment_time;
+  arrival->max_fee_limit = generate_max_fee_limit(pay_params, random_generator);
+}
+
+
 /* generate random payments and store them in "payments.csv" */
 void generate_random_payments(struct payments_params pay_params, long n_nodes, gsl_rng * random_generator) {
-  long i, sender_id, receiver_id;
-  uint64_t  payment_amount=0, payment_time=1, next_payment_interval, max_fee_limit=UINT64_MAX;
+  long i;
+  uint64_t payment_time=1;
   long payment_idIndex=0;
+  struct payment_arrival arrival;
   FILE* payments_file;
 
   payments_file = fopen("payments.csv", "w");
@@ -63,54 +100,58 @@ void generate_random_payments(struct payments_params pay_params, long n_nodes, g
   fprintf(payments_file, "id,sender_id,receiver_id,amount,start_time,max_fee_limit\n");
 
   for(i=0;i<pay_params.n_payments;i++) {
-    do{
-      sender_id = gsl_rng_uniform_int(random_generator,n_nodes);
-      receiver_id = gsl_rng_uniform_int(random_generator, n_nodes);
-    } while(sender_id==receiver_id);
-    payment_amount = fabs(pay_params.amount_mu + gsl_ran_ugaussian(random_generator) * pay_params.amount_sigma)*1000.0; // convert satoshi to millisatoshi
-    /* payment interarrival time is an exponential (Poisson process) whose mean is the inverse of payment rate
-       (expressed in payments per second, then multiplied to convert in milliseconds)
-     */
-    next_payment_interval = 1000*gsl_ran_exponential(random_generator, pay_params.inverse_payment_rate);
-    payment_time += next_payment_interval;
-    if(pay_params.max_fee_limit_sigma != -1 && pay_params.max_fee_limit_mu != -1) {
-        max_fee_limit = fabs(pay_params.max_fee_limit_mu + gsl_ran_ugaussian(random_generator) * pay_params.max_fee_limit_sigma)*1000.0; // convert satoshi to millisatoshi
-    }
-    fprintf(payments_file, "%ld,%ld,%ld,%ld,%ld,%ld\n", payment_idIndex++, sender_id, receiver_id, payment_amount, payment_time, max_fee_limit);
+    draw_random_payment(pay_params, n_nodes, random_generator, &payment_time, &arrival);
+    fprintf(payments_file, "%ld,%ld,%ld,%ld,%ld,%ld\n", payment_idIndex++, arrival.sender, arrival.receiver, arrival.amount, arrival.start_time, arrival.max_fee_limit);
   }
 
   fclose(payments_file);
 }
 
-/* generate payments from file */
+/* generate payments from a payment trace, where the id of a payment is its position */
+static struct array* generate_payments_from_trace(char payments_filename[]) {
+  struct payment_trace* trace;
+  struct payment_arrival arrival;
+  struct array* payments;
+  long id;
+
+  trace = open_payment_trace(payments_filename);
+  payments = array_initialize(trace->header->n_payments > 0 ? trace->header->n_payments : 1);
+  for(id = 0; read_payment_trace(trace, &arrival); id++)
+    payments = array_insert(payments, new_payment(id, arrival.sender, arrival.receiver, arrival.amount, arrival.start_time, arrival.max_fee_limit));
+  close_payment_trace(trace);
+  return payments;
+}
+
+
+/* generate payments from file (a csv file or a payment trace) */
 struct array* generate_payments(struct payments_params pay_params) {
   struct payment* payment;
-  char row[256], payments_filename[256];
-  long id, sender, receiver;
-  uint64_t amount, time, max_fee_limit;
+  char payments_filename[256];
+  long i;
   struct array* payments;
-  FILE* payments_file;
+  struct csv_table* payments_table;
+  union csv_value* row;
+  union csv_value payment_defaults[6];
 
   if(!(pay_params.payments_from_file))
     strcpy(payments_filename, "payments.csv");
   else
     strcpy(payments_filename, pay_params.payments_filename);
+  if(is_payment_trace(payments_filename))
+    return generate_payments_from_trace(payments_filename);
 
-  payments_file = fopen(payments_filename, "r");
-  if(payments_file==NULL) {
-    printf("ERROR: cannot open file <%s>\n", payments_filename);
-    exit(-1);
-  }
+  // the max fee limit may be missing (e.g., in payments_template.csv): no limit
+  memset(payment_defaults, 0, sizeof(payment_defaults));
+  payment_defaults[5].integer = (int64_t)UINT64_MAX;
+  payments_table = csv_read(payments_filename, "iiiiii", 5, payment_defaults);
 
-  payments = array_initialize(1000);
-
-  fgets(row, 256, payments_file);
-  while(fgets(row, 256, payments_file) != NULL) {
-    sscanf(row, "%ld,%ld,%ld,%"SCNu64",%"SCNu64",%"SCNu64"", &id, &sender, &receiver, &amount, &time, &max_fee_limit);
-    payment = new_payment(id, sender, receiver, amount, time, max_fee_limit);
+  payments = array_initialize(payments_table->n_rows > 0 ? payments_table->n_rows : 1);
+  for(i = 0; i < payments_table->n_rows; i++) {
+    row = payments_table->values + i*payments_table->n_columns;
+    payment = new_payment(row[0].integer, row[1].integer, row[2].integer, row[3].integer, row[4].integer, row[5].integer);
     payments = array_insert(payments, payment);
   }
-  fclose(payments_file);
+  csv_free(payments_table);
 
   return payments;
 }
@@ -122,45 +163,290 @@ struct array* initialize_payments(struct payments_params pay_params, long n_node
   return generate_payments(pay_params);
 }
 
-void add_attempt_history(struct payment* pmt, struct network* network, uint64_t time, short is_succeeded){
-  struct attempt* attempt = malloc(sizeof(struct attempt));
-  attempt->attempts = pmt->attempts;
-  attempt->end_time = time;
-  if(is_succeeded){
-    attempt->error_edge_id = 0;
-    attempt->error_type = NOERROR;
-  }else{
-    attempt->error_edge_id = pmt->error.hop->edge_id;
-    attempt->error_type = pmt->error.type;
+/* read the next row `id,sender_id,receiver_id,amount,start_time[,max_fee_limit]` of a payments file (the id is not used), with the same
+   rules as the loader of the payments (see csv.c); lines have no length limit. It returns 0 at the end of the file */
+static int read_payment_arrival(struct payment_source* source, struct payment_arrival* arrival) {
+  union csv_value payment_defaults[6], values[6];
+  ssize_t length;
+  long error_column;
+  const char* error;
+
+  memset(payment_defaults, 0, sizeof(payment_defaults));
+  payment_defaults[5].integer = (int64_t)UINT64_MAX;
+  while((length = getline(&(source->row), &(source->row_size), source->file)) != -1) {
+    source->line++;
+    if(length > 0 && source->row[length-1] == '\n') length--;
+    if(length > 0 && source->row[length-1] == '\r') length--;
+    if(length == 0) continue;
+    error = csv_parse_row(source->row, source->row + length, "iiiiii", 6, 5, payment_defaults, values, &error_column);
+    if(error != NULL) {
+      fprintf(stderr, "ERROR: malformed row in <%s> at line %ld, column %ld: %s (expected 6 columns)\n", source->filename, source->line, error_column, error);
+      exit(-1);
+    }
+    arrival->sender = values[1].integer;
+    arrival->receiver = values[2].integer;
+    arrival->amount = values[3].integer;
+    arrival->start_time = values[4].integer;
+    arrival->max_fee_limit = values[5].integer;
+    return 1;
+  }
+  return 0;
+}
+
+
+static void advance_payment_source(struct payment_source* source) {
+  // the payments of a stage of the ramp arrive until the end of the stage
+  if(source->ramp != NULL) {
+    draw_random_payment(source->pay_params, source->n_nodes, source->random_generator, &(source->payment_time), &(source->next));
+    source->has_next = source->next.start_time <= source->ramp->stage.end_time;
+    if(source->has_next) source->n_drawn++;
+    else end_ramp_arrivals(source->ramp, source);
+    return;
+  }
+  source->has_next = source->n_drawn < source->n_payments;
+  if(!source->has_next) return;
+  if(source->trace != NULL)
+    read_payment_trace(source->trace, &(source->next));
+  else if(source->file != NULL)
+    read_payment_arrival(source, &(source->next));
+  else
+    draw_random_payment(source->pay_params, source->n_nodes, source->random_generator, &(source->payment_time), &(source->next));
+  source->n_drawn++;
+}
+
+
+/* the payments file is read once to count the payments and to check that they are sorted by start time (a payment trace is sorted,
+   and its header has the count); random payments are drawn once from the generator of the simulation, which is left in the same state
+   as when the payments are not streamed */
+struct payment_source* new_payment_source(struct payments_params pay_params, long n_nodes, gsl_rng* random_generator) {
+  struct payment_source* source;
+  struct payment_arrival arrival;
+  uint64_t payment_time;
+  long i;
+
+  source = malloc(sizeof(struct payment_source));
+  source->pay_params = pay_params;
+  source->n_nodes = n_nodes;
+  source->n_payments = source->n_drawn = 0;
+  source->last_start_time = 0;
+  source->resample_max_fee_limit = 0;
+  source->ramp = NULL;
+  source->file = NULL;
+  source->trace = NULL;
+  source->random_generator = NULL;
+  source->payment_time = 1;
+  source->line = 1;
+  source->row = NULL;
+  source->row_size = 0;
+
+  if(pay_params.payments_from_file && is_payment_trace(pay_params.payments_filename)) {
+    strcpy(source->filename, pay_params.payments_filename);
+    source->trace = open_payment_trace(source->filename);
+    source->n_payments = source->trace->header->n_payments;
+    source->last_start_time = source->trace->header->last_start_time;
+  }
+  else if(pay_params.payments_from_file) {
+    strcpy(source->filename, pay_params.payments_filename);
+    source->file = fopen(source->filename, "r");
+    if(source->file == NULL || getline(&(source->row), &(source->row_size), source->file) == -1) {
+      fprintf(stderr, "ERROR: cannot open file <%s>\n", source->filename);
+      exit(-1);
+    }
+    while(read_payment_arrival(source, &arrival)) {
+      if(arrival.start_time < source->last_start_time) {
+        fprintf(stderr, "ERROR: payments in <%s> are not sorted by start time (line %ld): they cannot be streamed\n", source->filename, source->line);
+        exit(-1);
+      }
+      source->last_start_time = arrival.start_time;
+      source->n_payments++;
+    }
+    rewind(source->file);
+    if(getline(&(source->row), &(source->row_size), source->file) == -1) {
+      fprintf(stderr, "ERROR: cannot read file <%s>\n", source->filename);
+      exit(-1);
+    }
+    source->line = 1;
+  }
+  else if(pay_params.ramp_mode) {
+    // the payments are drawn when the stages of the ramp start (see start_ramp_stage); their number is not known in advance
+    strcpy(source->filename, "");
+    source->random_generator = gsl_rng_clone(random_generator);
+    source->last_start_time = pay_params.ramp_max_stages*pay_params.ramp_stage_duration*1000;
+    source->has_next = 0;
+    return source;
+  }
+  else {
+    strcpy(source->filename, "");
+    source->random_generator = gsl_rng_clone(random_generator);
+    source->n_payments = pay_params.n_payments;
+    payment_time = 1;
+    for(i = 0; i < pay_params.n_payments; i++)
+      draw_random_payment(pay_params, n_nodes, random_generator, &payment_time, &arrival);
+    source->last_start_time = pay_params.n_payments > 0 ? payment_time : 0;
+  }
+
+  advance_payment_source(source);
+  return source;
+}
+
+
+/* with `ramp_mode`, the random payments arrive from `time` at `rate` payments per second, until the end of the stage (see ramp.c) */
+void resume_payment_source(struct payment_source* source, uint64_t time, double rate) {
+  source->pay_params.inverse_payment_rate = 1.0/rate;
+  source->payment_time = time;
+  advance_payment_source(source);
+}
+
+
+/* the position of the next line of the payments file, -1 if payments are not read from a csv file */
+long get_payment_source_offset(struct payment_source* source) {
+  if(source == NULL || source->file == NULL) return -1;
+  return ftell(source->file);
+}
+
+
+/* processes created by fork() share the open file of the payments, whose offset is moved by the reads of each of them: after a fork,
+   every process reads the file from its own descriptor, at the position `offset` taken before the fork */
+void reopen_payment_source(struct payment_source* source, long offset) {
+  FILE* file;
+  if(source == NULL || source->file == NULL) return;
+  file = fopen(source->filename, "r");
+  if(file == NULL || fseek(file, offset, SEEK_SET) != 0) {
+    fprintf(stderr, "ERROR: cannot reopen file <%s>\n", source->filename);
+    exit(-1);
+  }
+  fclose(source->file);
+  source->file = file;
+}
+
+
+/* UINT64_MAX if there is no payment left (or if payments are not streamed) */
+uint64_t get_next_arrival_time(struct payment_source* source) {
+  if(source == NULL || !source->has_next) return UINT64_MAX;
+  return source->next.start_time;
+}
+
+
+/* create the payments starting not after `time` and schedule their FINDPATH events; payments and shards are numbered in order of creation */
+void schedule_payment_arrivals(struct payment_source* source, struct simulation* simulation, struct network* network, struct array** payments, uint64_t time) {
+  struct payment* payment;
+  struct event* event;
+  uint64_t max_fee_limit;
+
+  if(source == NULL) return;
+  while(source->has_next && source->next.start_time <= time) {
+    max_fee_limit = source->resample_max_fee_limit ? generate_max_fee_limit(source->pay_params, simulation->random_generator) : source->next.max_fee_limit;
+    // senders and receivers of the payments are ids of the input network
+    payment = new_payment(array_len(*payments), get_renumbered_id(network->node_map, source->next.sender), get_renumbered_id(network->node_map, source->next.receiver),
+                          source->next.amount, source->next.start_time, max_fee_limit);
+    *payments = array_insert(*payments, payment);
+    event = new_event(payment->start_time, FINDPATH, payment->sender, -1, payment);
+    simulation->events = heap_insert(simulation->events, event, compare_event);
+    if(source->ramp != NULL) add_ramp_payment(source->ramp);
+    advance_payment_source(source);
   }
-  attempt->is_succeeded = is_succeeded;
-  attempt->is_split = 0;
-  attempt->shard1_id = -1;
-  attempt->shard2_id = -1;
-  long route_len = array_len(pmt->route->route_hops);
-  attempt->route = array_initialize(route_len);
-
-  for(int i = 0; i < route_len; i++){
-    struct route_hop* route_hop = array_get(pmt->route->route_hops, i);
-    struct edge* edge = array_get(network->edges, route_hop->edge_id);
-    short is_in_group = 0;
-    if(edge->group != NULL) is_in_group = 1;
-    attempt->route = array_insert(attempt->route, take_edge_snapshot(edge, route_hop->amount_to_forward, is_in_group, route_hop->group_cap));
+}
+
+
+/* the start time of the last payment (shards excluded) */
+uint64_t get_last_payment_time(struct array* payments, struct payment_source* source) {
+  struct payment* payment;
+  uint64_t last_payment_time = 0;
+  long i;
+  if(source != NULL) return source->last_start_time;
+  for(i = 0; i < array_len(payments); i++) {
+    payment = array_get(payments, i);
+    if(!payment->is_shard && payment->start_time > last_payment_time) last_payment_time = payment->start_time;
   }
+  return last_payment_time;
+}
+
 
-  pmt->history = push(pmt->history, attempt);
-}
-
-void add_split_history(struct payment* pmt, uint64_t time, long shard1_id, long shard2_id){
-  struct attempt* attempt = malloc(sizeof(struct attempt));
-  attempt->attempts = pmt->attempts;
-  attempt->end_time = time;
-  attempt->error_edge_id = 0;
-  attempt->error_type = NOERROR;
-  attempt->is_succeeded = 0;
-  attempt->is_split = 1;
-  attempt->shard1_id = shard1_id;
-  attempt->shard2_id = shard2_id;
-  attempt->route = NULL;
-  pmt->history = push(pmt->history, attempt);
-}
\ No newline at end of file
+void free_payment_source(struct payment_source* source) {
+  if(source == NULL) return;
+  if(source->file != NULL) fclose(source->file);
+  free(source->row);
+  close_payment_trace(source->trace);
+  if(source->random_generator != NULL) gsl_rng_free(source->random_generator);
+  free(source);
+}
+
+
+/* free a payment with its route; its attempts are released from the attempt log */
+void free_payment(struct payment* payment) {
+  if(payment->route != NULL) free_route(payment->route);
+  free_path(payment->reserved_path);
+  release_attempts(payment);
+  free(payment);
+}
+
+
+unsigned int has_shards(struct payment* payment){
+  return payment->first_shard_id != -1;
+}
+
+
+/* append `shard` to the children of `payment` in the shard tree */
+void add_shard(struct array* payments, struct payment* payment, struct payment* shard){
+  struct payment* last_shard;
+  shard->parent_id = payment->id;
+  shard->next_shard_id = -1;
+  if(payment->first_shard_id == -1)
+    payment->first_shard_id = shard->id;
+  else {
+    last_shard = array_get(payments, payment->last_shard_id);
+    last_shard->next_shard_id = shard->id;
+  }
+  payment->last_shard_id = shard->id;
+  payment->n_shards++;
+}
+
+
+/* Recursively collect stats from a shard and its children */
+static void collect_shard_stats(struct array* payments, struct payment* shard, 
+                                uint64_t* max_end_time, int* all_success, 
+                                int* no_balance_count, int* offline_node_count,
+                                int* any_timeout, int* total_attempts, uint64_t* total_fee) {
+  if(shard == NULL) return;
+  
+  // If this shard has children, process them recursively
+  if(has_shards(shard)) {
+    for(long id = shard->first_shard_id; id != -1; id = ((struct payment*) array_get(payments, id))->next_shard_id)
+      collect_shard_stats(payments, array_get(payments, id), max_end_time, all_success, no_balance_count,
+                          offline_node_count, any_timeout, total_attempts, total_fee);
+  } else {
+    // Leaf shard - collect stats
+    if(shard->end_time > *max_end_time) *max_end_time = shard->end_time;
+    if(!shard->is_success) *all_success = 0;
+    *no_balance_count += shard->no_balance_count;
+    *offline_node_count += shard->offline_node_count;
+    if(shard->is_timeout) *any_timeout = 1;
+    *total_attempts += shard->attempts;
+    if(shard->route != NULL) *total_fee += shard->route->total_fee;
+  }
+}
+
+
+/* set the stats of a root payment that was split (mpp payment) from the ones of its shards */
+void aggregate_shard_stats(struct array* payments, struct payment* payment){
+  uint64_t max_end_time = 0;
+  int all_success = 1;
+  int no_balance_count = 0;
+  int offline_node_count = 0;
+  int any_timeout = 0;
+  int total_attempts = 0;
+  uint64_t total_fee = 0;
+
+  collect_shard_stats(payments, payment, &max_end_time, &all_success, &no_balance_count,
+                      &offline_node_count, &any_timeout, &total_attempts, &total_fee);
+
+  payment->end_time = max_end_time;
+  payment->is_success = all_success;
+  payment->no_balance_count = no_balance_count;
+  payment->offline_node_count = offline_node_count;
+  payment->is_timeout = any_timeout;
+  payment->attempts = total_attempts;
+
+  // Note: We don't set a route on the parent for MPP payments
+  // Each shard has its own route in the output
+}
@@ -0,0 +1,83 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "../include/profiler.h"
+#include "../include/event.h"
+
+/* Functions in this file collect, for each event type, the number of executions, the cumulative wall time
+   and a log2-bucketed histogram of the durations of the event handlers executed in the main loop */
+
+unsigned int profiler_enabled = 0;
+static struct event_profile profiles[N_EVENT_TYPES];
+static uint64_t initial_dijkstra_ns;
+
+
+void profiler_initialize(unsigned int enabled) {
+  profiler_enabled = enabled;
+  memset(profiles, 0, sizeof(profiles));
+  initial_dijkstra_ns = 0;
+}
+
+
+void profiler_record(enum event_type type, uint64_t elapsed_ns) {
+  struct event_profile* profile;
+  int bucket;
+
+  profile = &profiles[type];
+  profile->count++;
+  profile->total_ns += elapsed_ns;
+  if(elapsed_ns > profile->max_ns)
+    profile->max_ns = elapsed_ns;
+  bucket = 63 - __builtin_clzll(elapsed_ns | 1);
+  if(bucket >= PROFILER_N_BUCKETS)
+    bucket = PROFILER_N_BUCKETS - 1;
+  profile->histogram[bucket]++;
+}
+
+
+void profiler_set_initial_dijkstra_time(uint64_t elapsed_ns) {
+  initial_dijkstra_ns = elapsed_ns;
+}
+
+
+/* write the profile in `<output_dir>/event_profile.json`; histogram buckets are reported only when not empty */
+void profiler_write(char output_dir_name[]) {
+  FILE* profile_file;
+  char profile_filename[512];
+  int i, b, first_bucket;
+  uint64_t total_ns = 0;
+  struct event_profile* profile;
+
+  if(!profiler_enabled) return;
+
+  snprintf(profile_filename, sizeof(profile_filename), "%s%s", output_dir_name, PROFILER_FILENAME);
+  profile_file = fopen(profile_filename, "w");
+  if(profile_file == NULL) {
+    printf("ERROR cannot open %s\n", PROFILER_FILENAME);
+    return;
+  }
+
+  for(i = 0; i < N_EVENT_TYPES; i++)
+    total_ns += profiles[i].total_ns;
+
+  fprintf(profile_file, "{\n  \"clock\": \"CLOCK_MONOTONIC\",\n");
+  fprintf(profile_file, "  \"initial_dijkstra_ns\": %lu,\n", initial_dijkstra_ns);
+  fprintf(profile_file, "  \"events_total_ns\": %lu,\n", total_ns);
+  fprintf(profile_file, "  \"events\": {");
+  for(i = 0; i < N_EVENT_TYPES; i++) {
+    profile = &profiles[i];
+    fprintf(profile_file, "%s\n    \"%s\": {\"count\": %lu, \"total_ns\": %lu, \"mean_ns\": %lu, \"max_ns\": %lu, \"histogram\": [",
+            i == 0 ? "" : ",", get_event_type_name(i), profile->count, profile->total_ns,
+            profile->count == 0 ? 0 : profile->total_ns / profile->count, profile->max_ns);
+    first_bucket = 1;
+    for(b = 0; b < PROFILER_N_BUCKETS; b++) {
+      if(profile->histogram[b] == 0) continue;
+      fprintf(profile_file, "%s{\"min_ns\": %lu, \"max_ns\": %lu, \"count\": %lu}", first_bucket ? "" : ", ", b == 0 ? 0 : 1UL << b, (2UL << b) - 1, profile->histogram[b]);
+      first_bucket = 0;
+    }
+    fprintf(profile_file, "]}");
+  }
+  fprintf(profile_file, "\n  }\n}\n");
+  fclose(profile_file);
+}
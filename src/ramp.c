@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+#include "../include/ramp.h"
+#include "../include/payments.h"
+
+/* Functions in this file control the load ramp (`ramp_mode`), which finds the highest payment rate that the network and the routing
+   method sustain within a single simulation. The random payments of a stream (see payments.c) arrive in stages of increasing rate;
+   after the arrivals of a stage, the simulation drains its payments on the same network, whose state is kept from a stage to the next,
+   and the stage is sustainable if the success rate and the average latency of its payments are within the limits.
+   Each stage is written as a row of `ramp.csv` */
+
+
+struct ramp* new_ramp(struct payments_params pay_params, char output_dir_name[]) {
+  struct ramp* ramp;
+  char output_filename[512];
+
+  ramp = malloc(sizeof(struct ramp));
+  memset(ramp, 0, sizeof(struct ramp));
+  ramp->pay_params = pay_params;
+  ramp->stage.index = -1;
+  snprintf(output_filename, sizeof(output_filename), "%sramp.csv", output_dir_name);
+  ramp->output = fopen(output_filename, "w");
+  if(ramp->output == NULL) {
+    fprintf(stderr, "ERROR: cannot open file <%s>\n", output_filename);
+    exit(-1);
+  }
+  fprintf(ramp->output, "stage,rate,start_time,end_time,drained_time,payments,succeeded,success_rate,average_latency,max_latency,throughput,is_sustainable\n");
+  return ramp;
+}
+
+
+/* the payments of the stage arrive from `time` at the rate of the stage */
+void start_ramp_stage(struct ramp* ramp, struct payment_source* source, uint64_t time) {
+  struct ramp_stage* stage;
+
+  stage = &(ramp->stage);
+  if(stage->index == -1)
+    stage->rate = ramp->pay_params.ramp_initial_rate;
+  else if(ramp->unsustainable_rate == 0)
+    stage->rate = ramp->sustainable_rate*ramp->pay_params.ramp_rate_factor;
+  else
+    stage->rate = (ramp->sustainable_rate + ramp->unsustainable_rate)/2;
+  stage->index++;
+  stage->start_time = time;
+  stage->end_time = time + ramp->pay_params.ramp_stage_duration*1000;
+  stage->drained_time = 0;
+  stage->n_payments = stage->n_final = stage->n_succeeded = 0;
+  stage->total_latency = stage->max_latency = 0;
+  ramp->is_arriving = 1;
+  printf("RAMP STAGE %d: %.3f payments/s from time %"PRIu64" ms\n", stage->index, stage->rate, time);
+  resume_payment_source(source, time, stage->rate);
+}
+
+
+static unsigned int is_stage_sustainable(struct ramp* ramp) {
+  struct ramp_stage* stage;
+  stage = &(ramp->stage);
+  if(stage->n_payments == 0) return 1;
+  if((double) stage->n_succeeded/stage->n_payments < ramp->pay_params.ramp_min_success_rate) return 0;
+  return ramp->pay_params.ramp_max_latency == 0 || stage->n_succeeded == 0 || stage->total_latency/stage->n_succeeded <= ramp->pay_params.ramp_max_latency;
+}
+
+
+/* write the stage and choose the rate of the next one; the ramp ends when the bisection interval is within `ramp_tolerance`
+   of the sustainable rate, or after `ramp_max_stages` stages */
+static void end_ramp_stage(struct ramp* ramp, struct payment_source* source) {
+  struct ramp_stage* stage;
+  unsigned int is_sustainable;
+
+  stage = &(ramp->stage);
+  if(stage->drained_time < stage->end_time) stage->drained_time = stage->end_time;
+  is_sustainable = is_stage_sustainable(ramp);
+  fprintf(ramp->output, "%d,%f,%"PRIu64",%"PRIu64",%"PRIu64",%ld,%ld,%f,%f,%"PRIu64",%f,%u\n",
+          stage->index, stage->rate, stage->start_time, stage->end_time, stage->drained_time, stage->n_payments, stage->n_succeeded,
+          stage->n_payments > 0 ? (double) stage->n_succeeded/stage->n_payments : 0.0,
+          stage->n_succeeded > 0 ? (double) stage->total_latency/stage->n_succeeded : 0.0, stage->max_latency,
+          stage->n_succeeded*1000.0/(stage->end_time - stage->start_time), is_sustainable);
+  fflush(ramp->output);
+
+  if(is_sustainable) {
+    if(stage->rate > ramp->sustainable_rate) ramp->sustainable_rate = stage->rate;
+  }
+  else if(ramp->unsustainable_rate == 0 || stage->rate < ramp->unsustainable_rate)
+    ramp->unsustainable_rate = stage->rate;
+
+  if(stage->index + 1 >= ramp->pay_params.ramp_max_stages ||
+     (ramp->unsustainable_rate != 0 && ramp->unsustainable_rate - ramp->sustainable_rate <= ramp->pay_params.ramp_tolerance*ramp->unsustainable_rate)) {
+    ramp->is_finished = 1;
+    printf("RAMP: maximum sustainable payment rate %.3f payments/s", ramp->sustainable_rate);
+    if(ramp->unsustainable_rate != 0) printf(" (unsustainable at %.3f payments/s)\n", ramp->unsustainable_rate);
+    else printf(" (no unsustainable rate found)\n");
+    return;
+  }
+  start_ramp_stage(ramp, source, stage->drained_time);
+}
+
+
+/* called by the payment source after the last payment of the stage; the stage ends at once if its payments are already final */
+void end_ramp_arrivals(struct ramp* ramp, struct payment_source* source) {
+  ramp->is_arriving = 0;
+  if(ramp->stage.n_final == ramp->stage.n_payments)
+    end_ramp_stage(ramp, source);
+}
+
+
+void add_ramp_payment(struct ramp* ramp) {
+  ramp->stage.n_payments++;
+}
+
+
+/* called once for each root payment, when it and its shards are final (they have no event left) */
+void record_ramp_payment(struct ramp* ramp, struct payment_source* source, struct payment* payment, uint64_t time) {
+  struct ramp_stage* stage;
+  uint64_t latency;
+
+  stage = &(ramp->stage);
+  stage->n_final++;
+  if(payment->is_success) {
+    latency = payment->end_time - payment->start_time;
+    stage->n_succeeded++;
+    stage->total_latency += latency;
+    if(latency > stage->max_latency) stage->max_latency = latency;
+  }
+  if(time > stage->drained_time) stage->drained_time = time;
+  if(!ramp->is_arriving && stage->n_final == stage->n_payments)
+    end_ramp_stage(ramp, source);
+}
+
+
+void free_ramp(struct ramp* ramp) {
+  if(ramp == NULL) return;
+  fclose(ramp->output);
+  free(ramp);
+}
@@ -11,6 +11,10 @@
 #include "../include/routing.h"
 #include "../include/network.h"
 #include "../include/utils.h"
+#include "../include/telemetry.h"
+#include "../include/availability.h"
+#include "../include/network_core.h"
+#include "../include/capacity_oracle.h"
 
 /* Functions in this file simulate the path finding implemented in Lightning Network to find a path between the payment sender and the payment receiver.
    They are a (high-level) copy of functions lnd-v0.10.0-beta (see files `routing/pathfind.go`, `routing/payment_session.go` */
@@ -26,20 +30,36 @@
 #define PREVSUCCESSPROBABILITY 0.95
 #define PENALTYHALFLIFE 1
 #define MAXMILLISATOSHI UINT64_MAX
+#define ROUTING_POOL_SIZE 256 // freed paths (and routes) kept for reuse by each thread, for each number of hops
 
 
 struct distance **distance;
 struct heap** distance_heap;
 pthread_mutex_t data_mutex;
 pthread_mutex_t jobs_mutex;
-struct array** paths;
+struct path** paths;
 struct element* jobs=NULL;
 
+/* freed paths and routes of up to HOPSLIMIT hops are kept in free lists of the thread that freed them (by number of hops),
+   and reused by its next allocations; the dijkstra threads only allocate, the main loop allocates and frees */
+struct pooled_block {
+  struct pooled_block* next;
+};
 
-/* intialize the data structures of dijkstra and the jobs to be executed by the dijkstra threads */
+struct routing_pool {
+  struct pooled_block* paths[HOPSLIMIT+1];
+  struct pooled_block* routes[HOPSLIMIT+1];
+  int n_paths[HOPSLIMIT+1];
+  int n_routes[HOPSLIMIT+1];
+};
+
+static __thread struct routing_pool routing_pool;
+
+
+/* intialize the data structures of dijkstra; `paths` may have been already allocated when restoring a checkpoint,
+   and it is not allocated if `payments` is NULL (streamed payments have no initial path) */
 void initialize_dijkstra(long n_nodes, long n_edges, struct array* payments) {
   int i;
-  struct payment *payment;
 
   distance = malloc(sizeof(struct distance*)*N_THREADS);
   distance_heap = malloc(sizeof(struct heap*)*N_THREADS);
@@ -51,19 +71,17 @@ void initialize_dijkstra(long n_nodes, long n_edges, struct array* payments) {
   pthread_mutex_init(&data_mutex, NULL);
   pthread_mutex_init(&jobs_mutex, NULL);
 
-  paths = malloc(sizeof(struct array*)*array_len(payments));
-  for(i=0; i<array_len(payments) ;i++){
-    paths[i] = NULL;
-    payment = array_get(payments, i);
-    jobs = push(jobs, &(payment->id));
+  if(paths == NULL && payments != NULL) {
+    paths = malloc(sizeof(struct path*)*array_len(payments));
+    for(i=0; i<array_len(payments) ;i++)
+      paths[i] = NULL;
   }
-
 }
 
 /* a dijkstra thread finds a path for a payment by calling dijkstra */
 void* dijkstra_thread(void*arg) {
   struct payment * payment;
-  struct array* hops;
+  struct path* path;
   void *data;
   long payment_id;
   struct thread_args *thread_args;
@@ -71,16 +89,19 @@ void* dijkstra_thread(void*arg) {
   thread_args = (struct thread_args*) arg;
 
   while(1) {
-    if(jobs == NULL) return NULL;
     pthread_mutex_lock(&jobs_mutex);
+    if(jobs == NULL) {
+      pthread_mutex_unlock(&jobs_mutex);
+      return NULL;
+    }
     jobs = pop(jobs, &data);
     payment_id =  *((long*)data);
     pthread_mutex_unlock(&jobs_mutex);
     pthread_mutex_lock(&data_mutex);
     payment = array_get(thread_args->payments, payment_id);
     pthread_mutex_unlock(&data_mutex);
-    hops = dijkstra(payment->sender, payment->receiver, payment->amount, thread_args->network, thread_args->current_time, thread_args->data_index, &error, thread_args->routing_method, NULL, payment->max_fee_limit);
-    paths[payment->id] = hops;
+    path = dijkstra(payment->sender, payment->receiver, payment->amount, thread_args->network, thread_args->current_time, thread_args->data_index, &error, thread_args->routing_method, NULL, payment->max_fee_limit);
+    paths[payment->id] = path;
   }
 
   return NULL;
@@ -89,10 +110,27 @@ void* dijkstra_thread(void*arg) {
 
 /* run dijkstra threads to find the initial paths of the payments (before the simulation starts) */
 void run_dijkstra_threads(struct network*  network, struct array* payments, uint64_t current_time, enum routing_method routing_method) {
+  long i;
+  struct payment *payment;
+
+  for(i=0; i<array_len(payments); i++){
+    payment = array_get(payments, i);
+    jobs = push(jobs, &(payment->id));
+  }
+  run_dijkstra_jobs(network, payments, current_time, routing_method);
+}
+
+
+/* run dijkstra threads to find the paths of the payments whose ids are in `jobs` */
+void run_dijkstra_jobs(struct network*  network, struct array* payments, uint64_t current_time, enum routing_method routing_method) {
   long i;
   pthread_t tid[N_THREADS];
   struct thread_args *thread_args;
 
+  // the threads only read the core and the capacity oracle: they are rebuilt here if channels changed since they were computed
+  refresh_network_core(network);
+  refresh_capacity_oracle(network);
+
   for(i=0; i<N_THREADS; i++) {
     thread_args = (struct thread_args*) malloc(sizeof(struct thread_args));
     thread_args->network = network;
@@ -234,14 +272,15 @@ int compare_distance(struct distance* a, struct distance* b) {
 }
 
 /* get maximum and total balance of the edges of a node */
-void get_balance(struct node* node, uint64_t *max_balance, uint64_t *total_balance){
-  int i;
+void get_balance(struct node* node, struct network* network, uint64_t *max_balance, uint64_t *total_balance){
+  uint32_t i;
   struct edge* edge;
 
   *total_balance = 0;
   *max_balance = 0;
-  for(i=0; i<array_len(node->open_edges); i++){
-    edge = array_get(node->open_edges, i);
+  for(i=0; i<node->n_open_edges; i++){
+    if(node->open_edges[i] == CLOSED_EDGE) continue;
+    edge = array_get(network->edges, node->open_edges[i]);
     *total_balance += edge->balance;
     if(edge->balance > *max_balance)
       *max_balance = edge->balance;
@@ -253,7 +292,7 @@ void get_balance(struct node* node, uint64_t *max_balance, uint64_t *total_balan
 struct array* get_best_edges(long to_node_id, uint64_t amount, long source_node_id, struct network* network){
   struct array* best_edges;
   struct element* explored_nodes = NULL;
-  int i, j;
+  uint32_t i, j;
   struct node* to_node;
   struct edge* edge, *best_edge = NULL, *new_best_edge;
   struct channel* channel;
@@ -266,8 +305,9 @@ struct array* get_best_edges(long to_node_id, uint64_t amount, long source_node_
   to_node = array_get(network->nodes, to_node_id);
   best_edges = array_initialize(5);
 
-  for(i=0; i<array_len(to_node->open_edges); i++){
-    edge = array_get(to_node->open_edges, i);
+  for(i=0; i<to_node->n_open_edges; i++){
+    if(to_node->open_edges[i] == CLOSED_EDGE) continue;
+    edge = array_get(network->edges, to_node->open_edges[i]);
     if(is_in_list(explored_nodes, &(edge->to_node_id), is_equal_long))
       continue;
     explored_nodes = push(explored_nodes, &(edge->to_node_id));
@@ -278,8 +318,9 @@ struct array* get_best_edges(long to_node_id, uint64_t amount, long source_node_
     max_timelock = 0;
     best_edge = NULL;
     local_node = source_node_id == from_node_id;
-    for(j=0; j<array_len(to_node->open_edges); j++){
-      edge = array_get(to_node->open_edges, j);
+    for(j=0; j<to_node->n_open_edges; j++){
+      if(to_node->open_edges[j] == CLOSED_EDGE) continue;
+      edge = array_get(network->edges, to_node->open_edges[j]);
       if(edge->to_node_id != from_node_id)
         continue;
       counter_edge_id = edge->counter_edge_id;
@@ -310,7 +351,7 @@ struct array* get_best_edges(long to_node_id, uint64_t amount, long source_node_
     if(!local_node){
       modified_policy = best_edge->policy;
       modified_policy.timelock = max_timelock;
-      new_best_edge = new_edge(best_edge->id, best_edge->channel_id, best_edge->counter_edge_id, best_edge->from_node_id, best_edge->to_node_id, best_edge->balance, modified_policy, channel->capacity);
+      new_best_edge = new_edge(network, best_edge->id, best_edge->channel_id, best_edge->counter_edge_id, best_edge->from_node_id, best_edge->to_node_id, best_edge->balance, modified_policy, channel->capacity);
     }
     else {
       new_best_edge = best_edge;
@@ -389,19 +430,21 @@ uint64_t estimate_capacity(struct edge* edge, struct network* network, enum rout
 }
 
 /* a modified version of dijkstra to find a path connecting the source (payment sender) to the target (payment receiver) */
-struct array* dijkstra(long source, long target, uint64_t amount, struct network* network, uint64_t current_time, long p, enum pathfind_error *error, enum routing_method routing_method, struct element* exclude_edges, uint64_t max_fee_limit) {
+struct path* dijkstra(long source, long target, uint64_t amount, struct network* network, uint64_t current_time, long p, enum pathfind_error *error, enum routing_method routing_method, struct element* exclude_edges, uint64_t max_fee_limit) {
   struct distance *d=NULL, to_node_dist;
-  long i, best_node_id, j, from_node_id, curr;
+  long i, best_node_id, j, from_node_id, curr, n_hops;
   struct node *source_node, *best_node;
   struct edge* edge=NULL;
   uint64_t edge_timelock, tmp_timelock;
   uint64_t  amt_to_send, edge_fee, tmp_dist, amt_to_receive, total_balance, max_balance, current_dist;
-  struct array* hops=NULL; // *best_edges = NULL;
-  struct path_hop* hop=NULL;
+  struct path* path;
   struct channel* channel;
+  struct network_core* core;
+
+  __atomic_fetch_add(&telemetry->dijkstra_calls, 1, __ATOMIC_RELAXED); // dijkstra is also executed by the initial dijkstra threads
 
   source_node = array_get(network->nodes, source);
-  get_balance(source_node, &max_balance, &total_balance);
+  get_balance(source_node, network, &max_balance, &total_balance);
   if(amount > total_balance){
     *error = NOLOCALBALANCE;
     return NULL;
@@ -411,6 +454,14 @@ struct array* dijkstra(long source, long target, uint64_t amount, struct network
     return NULL;
   }
 
+  // each hop needs a channel capacity of at least the amount: no path exists if the target cannot be reached with it
+  if((routing_method == CLOTH_ORIGINAL || routing_method == IDEAL) && !has_capacity_path(network, source, target, amount)){
+    *error = NOPATH;
+    return NULL;
+  }
+
+  core = get_network_core(network);
+
   while(heap_len(distance_heap[p])!=0)
     heap_pop(distance_heap[p], compare_distance);
 
@@ -444,10 +495,19 @@ struct array* dijkstra(long source, long target, uint64_t amount, struct network
     best_node = array_get(network->nodes, best_node_id);
     /* best_edges = get_best_edges(best_node_id, amt_to_send, source, network); */
 
-    for(j=0; j<array_len(best_node->open_edges); j++) {
-      edge = array_get(best_node->open_edges, j);
+    for(j=0; j<best_node->n_open_edges; j++) {
+      // closed edges are skipped by their id, without reading the edge
+      if(best_node->open_edges[j] == CLOSED_EDGE) continue;
+      edge = array_get(network->edges, best_node->open_edges[j]);
       edge = array_get(network->edges, edge->counter_edge_id);
 
+      if(network->skip_offline_nodes && edge->from_node_id != source && is_node_offline(array_get(network->nodes, edge->from_node_id), current_time))
+        continue;
+
+      // nodes of the trees attached to the 2-core can be hops only of paths starting or ending in their subtree
+      if(core != NULL && !is_transit_node(core, edge->from_node_id, source, target))
+        continue;
+
       if(routing_method == CLOTH_ORIGINAL){
           double edge_probability, tmp_probability, edge_weight, tmp_weight, current_prob;
           from_node_id = edge->from_node_id;
@@ -561,39 +621,76 @@ struct array* dijkstra(long source, long target, uint64_t amount, struct network
     }
   }
 
-  hops = array_initialize(5);
-  curr = source;
-  while(curr!=target) {
-    if(distance[p][curr].next_edge == -1) {
+  // the hops are counted first, so that the path is allocated once
+  n_hops = 0;
+  for(curr = source; curr != target; curr = edge->to_node_id) {
+    if(distance[p][curr].next_edge == -1 || n_hops == HOPSLIMIT) {
       *error = NOPATH;
-      for(int k = 0; k < array_len(hops); k++) free(array_get(hops, k));
-      array_free(hops);
       return NULL;
     }
-    hop = malloc(sizeof(struct path_hop));
-    hop->sender = curr;
-    hop->edge = distance[p][curr].next_edge;
     edge = array_get(network->edges, distance[p][curr].next_edge);
-    hop->receiver = edge->to_node_id;
-    hops=array_insert(hops, hop);
+    n_hops++;
+  }
+
+  path = path_initialize(n_hops);
+  curr = source;
+  for(i = 0; i < n_hops; i++) {
+    edge = array_get(network->edges, distance[p][curr].next_edge);
+    path->hops[i].sender = curr;
+    path->hops[i].receiver = edge->to_node_id;
+    path->hops[i].edge = edge->id;
     curr = edge->to_node_id;
   }
 
-  if(array_len(hops) > HOPSLIMIT){
-    *error = NOPATH;
-    for(int k = 0; k < array_len(hops); k++) free(array_get(hops, k));
-    array_free(hops);
-    return NULL;
+  return path;
+}
+
+
+static void* pool_alloc(struct pooled_block** free_list, int* n_free, size_t size) {
+  struct pooled_block* block;
+  if(*free_list == NULL) return malloc(size);
+  block = *free_list;
+  *free_list = block->next;
+  (*n_free)--;
+  return block;
+}
+
+
+static void pool_free(struct pooled_block** free_list, int* n_free, void* data) {
+  struct pooled_block* block;
+  if(*n_free >= ROUTING_POOL_SIZE) {
+    free(data);
+    return;
   }
+  block = data;
+  block->next = *free_list;
+  *free_list = block;
+  (*n_free)++;
+}
 
-  return hops;
+
+/* the hops are not initialized */
+struct path* path_initialize(long n_hops) {
+  struct path* path;
+  size_t size = sizeof(struct path) + n_hops*sizeof(struct path_hop);
+  if(n_hops <= HOPSLIMIT)
+    path = pool_alloc(&(routing_pool.paths[n_hops]), &(routing_pool.n_paths[n_hops]), size);
+  else
+    path = malloc(size);
+  path->n_hops = n_hops;
+  return path;
 }
 
 
+/* the hops are not initialized */
 struct route* route_initialize(long n_hops) {
   struct route* r;
-  r = malloc(sizeof(struct route));
-  r->route_hops = array_initialize(n_hops);
+  size_t size = sizeof(struct route) + n_hops*sizeof(struct route_hop);
+  if(n_hops <= HOPSLIMIT)
+    r = pool_alloc(&(routing_pool.routes[n_hops]), &(routing_pool.n_routes[n_hops]), size);
+  else
+    r = malloc(size);
+  r->n_hops = n_hops;
   r->total_amount = 0;
   r->total_timelock = 0;
   r->total_fee = 0;
@@ -603,7 +700,7 @@ struct route* route_initialize(long n_hops) {
 
 /* transform a path into a route by computing fees and timelocks required at each hop in the path */
 /* slightly differet w.r.t. `newRoute` in lnd because `newRoute` aims to produce the payloads for each node from the second in the path to the last node */
-struct route* transform_path_into_route(struct array* path_hops, uint64_t destination_amt, struct network* network, uint64_t time) {
+struct route* transform_path_into_route(struct path* path, uint64_t destination_amt, struct network* network, uint64_t time) {
   struct path_hop *path_hop;
   struct route_hop *route_hop, *next_route_hop;
   struct route *route;
@@ -612,16 +709,16 @@ struct route* transform_path_into_route(struct array* path_hops, uint64_t destin
   struct edge* edge;
   struct policy current_edge_policy, next_edge_policy;
 
-  n_hops = array_len(path_hops);
+  n_hops = path->n_hops;
   route = route_initialize(n_hops);
 
   for(i=n_hops-1; i>=0; i--) {
-    path_hop = array_get(path_hops, i);
+    path_hop = &(path->hops[i]);
 
     edge = array_get(network->edges, path_hop->edge);
     current_edge_policy = edge->policy;
 
-    route_hop = malloc(sizeof(struct route_hop));
+    route_hop = &(route->hops[i]);
     route_hop->from_node_id = path_hop->sender;
     route_hop->to_node_id = path_hop->receiver;
     route_hop->edge_id = path_hop->edge;
@@ -654,21 +751,61 @@ struct route* transform_path_into_route(struct array* path_hops, uint64_t destin
       /* route_hop->timelock = route->total_timelock; */
       /* route->total_timelock += next_edge_policy.timelock; */
     }
-    route->route_hops = array_insert(route->route_hops, route_hop);
 
     next_edge_policy = current_edge_policy;
     next_route_hop = route_hop;
      }
 
-  array_reverse(route->route_hops);
-
   return route;
 }
 
+/* the total fee and timelock of the route of a path, as computed by transform_path_into_route, without building the route */
+void compute_route_totals(struct path* path, uint64_t destination_amt, struct network* network, uint64_t* total_fee, uint64_t* total_timelock) {
+  long i;
+  uint64_t amount_to_forward, fee;
+  struct edge *edge, *next_edge;
+
+  *total_fee = 0;
+  *total_timelock = path->n_hops > 0 ? FINALTIMELOCK : 0;
+  amount_to_forward = destination_amt;
+  for(i = path->n_hops-1; i > 0; i--) {
+    next_edge = array_get(network->edges, path->hops[i].edge);
+    edge = array_get(network->edges, path->hops[i-1].edge);
+    fee = compute_fee(amount_to_forward, next_edge->policy);
+    amount_to_forward += fee;
+    *total_fee += fee;
+    *total_timelock += edge->policy.timelock;
+  }
+}
+
+void free_path(struct path* path) {
+  if(path == NULL) return;
+  if(path->n_hops <= HOPSLIMIT)
+    pool_free(&(routing_pool.paths[path->n_hops]), &(routing_pool.n_paths[path->n_hops]), path);
+  else
+    free(path);
+}
+
 void free_route(struct route* route){
-    for(int i = 0; i < array_len(route->route_hops); i++){
-        free(array_get(route->route_hops, i));
-    }
-    array_free(route->route_hops);
+  if(route->n_hops <= HOPSLIMIT)
+    pool_free(&(routing_pool.routes[route->n_hops]), &(routing_pool.n_routes[route->n_hops]), route);
+  else
     free(route);
 }
+
+/* free the paths and routes kept for reuse by the calling thread */
+void free_routing_pool() {
+  struct pooled_block* block;
+  long i;
+  for(i = 0; i <= HOPSLIMIT; i++) {
+    while((block = routing_pool.paths[i]) != NULL) {
+      routing_pool.paths[i] = block->next;
+      free(block);
+    }
+    while((block = routing_pool.routes[i]) != NULL) {
+      routing_pool.routes[i] = block->next;
+      free(block);
+    }
+    routing_pool.n_paths[i] = routing_pool.n_routes[i] = 0;
+  }
+}
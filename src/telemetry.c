@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "../include/telemetry.h"
+
+/* Functions in this file publish the status of the running simulation in a memory-mapped file.
+   Counters are updated with plain stores; the file is flushed (and the derived values are recomputed) at most every `flush_interval` milliseconds */
+
+static struct telemetry_block private_block;
+struct telemetry_block* telemetry = &private_block;
+
+static int telemetry_fd = -1;
+static uint64_t flush_interval_ms = 1000;
+static uint64_t start_ms, last_flush_ms, last_flush_events;
+static long ticks_since_check;
+
+
+static uint64_t get_monotonic_ms(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec*1000 + ts.tv_nsec/1000000;
+}
+
+
+static uint64_t get_rss_bytes(){
+  FILE* statm;
+  long size, resident;
+  statm = fopen("/proc/self/statm", "r");
+  if(statm == NULL) return 0;
+  if(fscanf(statm, "%ld %ld", &size, &resident) != 2) resident = 0;
+  fclose(statm);
+  return (uint64_t)resident * sysconf(_SC_PAGESIZE);
+}
+
+
+/* map `<output_dir>/telemetry.bin`; if the file cannot be mapped the counters are kept in a private block and nothing is published */
+void telemetry_open(char output_dir_name[], uint64_t flush_interval) {
+  char telemetry_filename[512];
+  void* mapping;
+
+  memset(&private_block, 0, sizeof(struct telemetry_block));
+  telemetry = &private_block;
+  flush_interval_ms = flush_interval;
+  start_ms = last_flush_ms = get_monotonic_ms();
+  last_flush_events = 0;
+  ticks_since_check = 0;
+
+  if(flush_interval != 0) {
+    snprintf(telemetry_filename, sizeof(telemetry_filename), "%s%s", output_dir_name, TELEMETRY_FILENAME);
+    telemetry_fd = open(telemetry_filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(telemetry_fd == -1) {
+      fprintf(stderr, "WARNING: cannot open <%s>, telemetry is disabled\n", telemetry_filename);
+    }
+    else if(ftruncate(telemetry_fd, sizeof(struct telemetry_block)) != 0) {
+      fprintf(stderr, "WARNING: cannot resize <%s>, telemetry is disabled\n", telemetry_filename);
+      close(telemetry_fd);
+      telemetry_fd = -1;
+    }
+    else {
+      mapping = mmap(NULL, sizeof(struct telemetry_block), PROT_READ | PROT_WRITE, MAP_SHARED, telemetry_fd, 0);
+      if(mapping == MAP_FAILED) {
+        fprintf(stderr, "WARNING: cannot map <%s>, telemetry is disabled\n", telemetry_filename);
+        close(telemetry_fd);
+        telemetry_fd = -1;
+      }
+      else {
+        telemetry = mapping;
+        memset(telemetry, 0, sizeof(struct telemetry_block));
+      }
+    }
+  }
+
+  telemetry->magic = TELEMETRY_MAGIC;
+  telemetry->version = TELEMETRY_VERSION;
+  telemetry->state = TELEMETRY_INITIALIZING;
+  telemetry->pid = getpid();
+}
+
+
+/* called after every event of the simulation: it costs a few stores, the clock is read only once every TELEMETRY_CHECK_PERIOD events */
+void telemetry_tick(uint64_t current_time, long heap_depth) {
+  telemetry->processed_events++;
+  telemetry->current_time = current_time;
+  telemetry->heap_depth = heap_depth;
+  if(telemetry->heap_depth > telemetry->max_heap_depth) telemetry->max_heap_depth = telemetry->heap_depth;
+
+  if(++ticks_since_check < TELEMETRY_CHECK_PERIOD) return;
+  ticks_since_check = 0;
+  if(get_monotonic_ms() - last_flush_ms >= flush_interval_ms)
+    telemetry_flush();
+}
+
+
+void telemetry_flush() {
+  uint64_t now_ms, elapsed_ms;
+
+  now_ms = get_monotonic_ms();
+  elapsed_ms = now_ms - last_flush_ms;
+  if(elapsed_ms > 0)
+    telemetry->events_per_second = (double)(telemetry->processed_events - last_flush_events) * 1000.0 / (double)elapsed_ms;
+  telemetry->wall_time = now_ms - start_ms;
+  telemetry->rss_bytes = get_rss_bytes();
+  telemetry->flush_sequence++;
+  last_flush_ms = now_ms;
+  last_flush_events = telemetry->processed_events;
+
+  if(telemetry_fd != -1)
+    msync(telemetry, sizeof(struct telemetry_block), MS_ASYNC);
+}
+
+
+/* called in a child process created by fork(): it leaves the block of the parent untouched and publishes the inherited counters in `<output_dir>/telemetry.bin` */
+void telemetry_fork(char output_dir_name[], uint64_t flush_interval) {
+  struct telemetry_block inherited;
+
+  inherited = *telemetry;
+  if(telemetry_fd != -1) {
+    munmap(telemetry, sizeof(struct telemetry_block));
+    close(telemetry_fd);
+    telemetry_fd = -1;
+  }
+  telemetry_open(output_dir_name, flush_interval);
+  telemetry->state = inherited.state;
+  telemetry->total_payments = inherited.total_payments;
+  telemetry->completed_payments = inherited.completed_payments;
+  telemetry->processed_events = inherited.processed_events;
+  telemetry->heap_depth = inherited.heap_depth;
+  telemetry->max_heap_depth = inherited.max_heap_depth;
+  telemetry->current_time = inherited.current_time;
+  telemetry->dijkstra_calls = inherited.dijkstra_calls;
+  telemetry->mpp_splits = inherited.mpp_splits;
+  telemetry->group_constructions = inherited.group_constructions;
+  last_flush_events = telemetry->processed_events;
+}
+
+
+void telemetry_close() {
+  telemetry_flush();
+  if(telemetry_fd == -1) return;
+  msync(telemetry, sizeof(struct telemetry_block), MS_SYNC);
+  private_block = *telemetry;
+  munmap(telemetry, sizeof(struct telemetry_block));
+  close(telemetry_fd);
+  telemetry_fd = -1;
+  telemetry = &private_block;
+}
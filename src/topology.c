@@ -0,0 +1,254 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <gsl/gsl_rng.h>
+#include <gsl/gsl_randist.h>
+
+#include "../include/topology.h"
+#include "../include/csv.h"
+#include "../include/heap.h"
+#include "../include/network_core.h"
+#include "../include/capacity_oracle.h"
+#include "../include/payments.h"
+#include "../include/utils.h"
+
+/* Functions in this file change the topology of the network during the simulation: channels are opened and closed at the times
+   of a schedule read from a csv file (`topology_changes_filename`) and/or at random times (Poisson processes with rates
+   `channel_open_rate` and `channel_close_rate`). The edges of a closed channel become CLOSED_EDGE entries in the open edges of their nodes
+   (see network.c), so that path finding skips them; the HTLCs already forwarded on them are still settled.
+   The 2-core of the network (see network_core.c) is invalidated by each change and recomputed by the next path finding.
+   The events of a change of the schedule have the index of the change as `node_id`; random changes have `node_id` -1 */
+
+#define MAX_CLOSE_TRIES 64 // random channels drawn to find an open one, before scanning the channels
+
+static struct topology_change* changes = NULL;
+static long n_changes = 0;
+static uint64_t mean_channel_capacity = 0;
+static uint64_t horizon = 0; // random changes are generated until the start time of the last payment
+
+
+/* read the schedule of the topology changes; the ids of the file are ids of the input network */
+void initialize_topology(struct network* network, struct network_params net_params) {
+  struct csv_table* table;
+  union csv_value* row;
+  union csv_value defaults[5];
+  struct channel* channel;
+  long i, n_channels, n_nodes;
+  uint64_t tot_capacity = 0;
+
+  // the channels opened at random have the mean capacity of the channels of the initial network
+  n_channels = array_len(network->channels);
+  for(i = 0; i < n_channels; i++) {
+    channel = array_get(network->channels, i);
+    tot_capacity += channel->capacity;
+  }
+  mean_channel_capacity = n_channels > 0 ? tot_capacity/n_channels : 0;
+
+  free_topology();
+  if(strcmp(net_params.topology_changes_filename, "") == 0) return;
+
+  // `time,channel_id` for a close, `time,-1,node1_id,node2_id,capacity` for an open
+  memset(defaults, 0, sizeof(defaults));
+  defaults[2].integer = defaults[3].integer = -1;
+  table = csv_read(net_params.topology_changes_filename, "iiiii", 2, defaults);
+  n_nodes = array_len(network->nodes);
+  n_changes = table->n_rows;
+  changes = malloc(sizeof(struct topology_change)*(n_changes > 0 ? n_changes : 1));
+  for(i = 0; i < n_changes; i++) {
+    row = table->values + i*table->n_columns;
+    changes[i].time = row[0].integer;
+    changes[i].capacity = row[4].integer*1000; // satoshi to millisatoshi
+    if(row[1].integer == -1) {
+      if(row[2].integer < 0 || row[2].integer >= n_nodes || row[3].integer < 0 || row[3].integer >= n_nodes || row[2].integer == row[3].integer || row[4].integer <= 0) {
+        fprintf(stderr, "ERROR: wrong channel open in row %ld of <%s>: two different nodes of the network and a positive capacity are required\n", i + 1, net_params.topology_changes_filename);
+        exit(-1);
+      }
+      changes[i].channel_id = -1;
+      changes[i].node1_id = get_renumbered_id(network->node_map, row[2].integer);
+      changes[i].node2_id = get_renumbered_id(network->node_map, row[3].integer);
+    }
+    else if(row[1].integer >= 0) {
+      changes[i].channel_id = get_renumbered_id(network->channel_map, row[1].integer);
+      changes[i].node1_id = changes[i].node2_id = -1;
+    }
+    else {
+      fprintf(stderr, "ERROR: wrong channel id in row %ld of <%s>\n", i + 1, net_params.topology_changes_filename);
+      exit(-1);
+    }
+  }
+  csv_free(table);
+}
+
+
+void set_topology_horizon(uint64_t last_payment_time) {
+  horizon = last_payment_time;
+}
+
+
+/* schedule the next random change of type `type`, unless it would occur after the last payment has started */
+static void schedule_random_change(struct simulation* simulation, enum event_type type, double rate) {
+  uint64_t next_event_time;
+  struct event* next_event;
+  if(rate <= 0) return;
+  next_event_time = simulation->current_time + 1000*gsl_ran_exponential(simulation->random_generator, 1.0/rate);
+  if(next_event_time > horizon) return;
+  next_event = new_event(next_event_time, type, -1, -1, NULL);
+  simulation->events = heap_insert(simulation->events, next_event, compare_event);
+}
+
+
+/* schedule the changes read from the file and the first random changes (not called when the simulation is restored from a checkpoint) */
+void schedule_topology_changes(struct simulation* simulation, uint64_t last_payment_time, struct network_params net_params) {
+  long i;
+  struct event* event;
+
+  set_topology_horizon(last_payment_time);
+  for(i = 0; i < n_changes; i++) {
+    event = new_event(changes[i].time, changes[i].channel_id == -1 ? OPENCHANNEL : CLOSECHANNEL, i, -1, NULL);
+    simulation->events = heap_insert(simulation->events, event, compare_event);
+  }
+  schedule_random_change(simulation, OPENCHANNEL, net_params.channel_open_rate);
+  schedule_random_change(simulation, CLOSECHANNEL, net_params.channel_close_rate);
+}
+
+
+static unsigned int is_group_routing(struct network_params net_params) {
+  return net_params.routing_method == GROUP_ROUTING || net_params.routing_method == GROUP_ROUTING_CUL;
+}
+
+
+static void schedule_group_construction(struct simulation* simulation) {
+  struct event* next_event;
+  next_event = new_event(simulation->current_time, CONSTRUCTGROUPS, -1, -1, NULL);
+  simulation->events = heap_insert(simulation->events, next_event, compare_event);
+}
+
+
+/* open a channel of the schedule or, for a random change, between two random nodes; the new edges wait for a group in the group_add_queue */
+struct element* open_channel(struct event* event, struct simulation* simulation, struct network* network, struct network_params net_params, struct element* group_add_queue) {
+  long node1_id, node2_id, n_nodes;
+  uint64_t capacity, edge1_balance;
+  struct policy edge1_policy, edge2_policy;
+  struct channel* channel;
+  struct topology_change* change;
+
+  if(event->node_id == -1) {
+    schedule_random_change(simulation, OPENCHANNEL, net_params.channel_open_rate);
+    n_nodes = array_len(network->nodes);
+    if(n_nodes < 2) return group_add_queue;
+    node1_id = gsl_rng_uniform_int(simulation->random_generator, n_nodes);
+    do {
+      node2_id = gsl_rng_uniform_int(simulation->random_generator, n_nodes);
+    } while(node2_id == node1_id);
+    capacity = mean_channel_capacity;
+    edge1_balance = gsl_rng_uniform(simulation->random_generator)*capacity;
+  }
+  else {
+    // the funder of a channel of the schedule holds the whole capacity
+    change = &(changes[event->node_id]);
+    node1_id = change->node1_id;
+    node2_id = change->node2_id;
+    capacity = edge1_balance = change->capacity;
+  }
+
+  edge1_policy = generate_random_policy(simulation->random_generator, net_params.cul_threshold_dist_alpha, net_params.cul_threshold_dist_beta);
+  edge2_policy = generate_random_policy(simulation->random_generator, net_params.cul_threshold_dist_alpha, net_params.cul_threshold_dist_beta);
+  channel = add_channel(network, node1_id, node2_id, capacity, edge1_balance, edge1_policy, edge2_policy);
+  invalidate_network_core(network, node1_id, node2_id);
+  invalidate_capacity_oracle(network);
+
+  if(is_group_routing(net_params)) {
+    group_add_queue = list_insert_sorted_position(group_add_queue, array_get(network->edges, channel->edge1), (long (*)(void *)) get_edge_balance);
+    group_add_queue = list_insert_sorted_position(group_add_queue, array_get(network->edges, channel->edge2), (long (*)(void *)) get_edge_balance);
+    schedule_group_construction(simulation);
+  }
+
+  return group_add_queue;
+}
+
+
+/* a random open channel, -1 if all channels are closed */
+static long get_random_open_channel(struct network* network, gsl_rng* random_generator) {
+  long i, channel_id, n_channels;
+  struct channel* channel;
+
+  n_channels = array_len(network->channels);
+  if(n_channels == 0) return -1;
+  for(i = 0; i < MAX_CLOSE_TRIES; i++) {
+    channel_id = gsl_rng_uniform_int(random_generator, n_channels);
+    channel = array_get(network->channels, channel_id);
+    if(!channel->is_closed) return channel_id;
+  }
+  channel_id = gsl_rng_uniform_int(random_generator, n_channels);
+  for(i = 0; i < n_channels; i++, channel_id = (channel_id + 1) % n_channels) {
+    channel = array_get(network->channels, channel_id);
+    if(!channel->is_closed) return channel_id;
+  }
+  return -1;
+}
+
+
+/* the group of a closed edge is closed: its open members go back to the group_add_queue */
+static struct element* remove_from_groups(struct edge* edge, uint64_t current_time, struct element* group_add_queue) {
+  struct group* group;
+  struct edge* member;
+  long i;
+
+  group_add_queue = list_delete(group_add_queue, NULL, edge, (int (*)(void *, void *)) is_equal_edge);
+  if(edge->group == NULL) return group_add_queue;
+
+  group = edge->group;
+  group->is_closed = current_time;
+  for(i = 0; i < array_len(group->edges); i++) {
+    member = array_get(group->edges, i);
+    member->group = NULL;
+    if(!member->is_closed)
+      group_add_queue = list_insert_sorted_position(group_add_queue, member, (long (*)(void *)) get_edge_balance);
+  }
+  return group_add_queue;
+}
+
+
+/* close a channel of the schedule or, for a random change, a random open channel */
+struct element* close_channel(struct event* event, struct simulation* simulation, struct network* network, struct network_params net_params, struct element* group_add_queue) {
+  long channel_id;
+  struct channel* channel;
+  struct edge* edge1, *edge2;
+
+  if(event->node_id == -1) {
+    schedule_random_change(simulation, CLOSECHANNEL, net_params.channel_close_rate);
+    channel_id = get_random_open_channel(network, simulation->random_generator);
+    if(channel_id == -1) return group_add_queue;
+  }
+  else {
+    channel_id = changes[event->node_id].channel_id;
+    if(channel_id >= array_len(network->channels)) {
+      fprintf(stderr, "ERROR: channel <%ld> closed at time %"PRIu64" in <%s> does not exist\n", get_original_id(network->channel_map, channel_id), simulation->current_time, net_params.topology_changes_filename);
+      exit(-1);
+    }
+  }
+
+  channel = array_get(network->channels, channel_id);
+  if(channel->is_closed) return group_add_queue;
+  mark_channel_closed(network, channel_id);
+  invalidate_network_core(network, channel->node1, channel->node2);
+
+  if(is_group_routing(net_params)) {
+    edge1 = array_get(network->edges, channel->edge1);
+    edge2 = array_get(network->edges, channel->edge2);
+    group_add_queue = remove_from_groups(edge1, simulation->current_time, group_add_queue);
+    group_add_queue = remove_from_groups(edge2, simulation->current_time, group_add_queue);
+    schedule_group_construction(simulation);
+  }
+
+  return group_add_queue;
+}
+
+
+void free_topology() {
+  free(changes);
+  changes = NULL;
+  n_changes = 0;
+}
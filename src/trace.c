@@ -0,0 +1,185 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../include/trace.h"
+#include "../include/array.h"
+#include "../include/routing.h"
+
+/* Functions in this file record the events executed by the simulation in a binary trace, and map a trace in memory to read it back
+   (see `tools/replay.c`). When tracing is disabled, the hooks called by the simulation return immediately */
+
+static FILE* trace_file = NULL;
+static char trace_basename[256];
+static struct trace_header trace_header;
+static long updated_edge_id = -1;
+static uint64_t updated_edge_balance;
+
+
+static void write_trace(void* data, size_t size) {
+  if(fwrite(data, size, 1, trace_file) != 1) {
+    fprintf(stderr, "ERROR: cannot write event trace\n");
+    exit(-1);
+  }
+}
+
+
+void trace_open(char filename[], struct network* network) {
+  char* slash;
+
+  trace_file = fopen(filename, "wb");
+  if(trace_file == NULL) {
+    fprintf(stderr, "ERROR: cannot open file <%s>\n", filename);
+    exit(-1);
+  }
+  slash = strrchr(filename, '/');
+  strcpy(trace_basename, slash != NULL ? slash + 1 : filename);
+
+  memset(&trace_header, 0, sizeof(trace_header));
+  memcpy(trace_header.magic, TRACE_MAGIC, sizeof(trace_header.magic));
+  trace_header.version = TRACE_VERSION;
+  trace_header.record_size = sizeof(struct trace_record);
+  trace_header.n_nodes = array_len(network->nodes);
+  trace_header.n_edges = array_len(network->edges);
+  write_trace(&trace_header, sizeof(trace_header));
+}
+
+
+/* called by the event handlers when they change the balance of an edge (at most one edge per event) */
+void trace_edge_update(struct edge* edge) {
+  if(trace_file == NULL) return;
+  updated_edge_id = edge->id;
+  updated_edge_balance = edge->balance;
+}
+
+
+/* called when a new route is assigned to a payment */
+void trace_route(struct payment* payment) {
+  struct trace_record record;
+  struct route_hop* hop;
+  long i, n_hops;
+
+  if(trace_file == NULL) return;
+  n_hops = payment->route->n_hops;
+  for(i = 0; i < n_hops; i++) {
+    hop = &(payment->route->hops[i]);
+    memset(&record, 0, sizeof(record));
+    record.type = TRACE_ROUTE_HOP;
+    record.payment_id = payment->id;
+    record.node_id = hop->from_node_id;
+    record.edge_id = hop->edge_id;
+    record.edge_balance = hop->amount_to_forward;
+    record.attempts = i;
+    record.error_type = n_hops;
+    write_trace(&record, sizeof(record));
+  }
+}
+
+
+/* called by the main loop after the execution of an event */
+void trace_event(struct event* event) {
+  struct trace_record record;
+  struct payment* payment;
+
+  if(trace_file == NULL) return;
+  memset(&record, 0, sizeof(record));
+  record.time = event->time;
+  record.type = event->type;
+  record.node_id = event->node_id;
+  record.edge_id = updated_edge_id;
+  record.edge_balance = updated_edge_id != -1 ? updated_edge_balance : 0;
+  payment = event->payment;
+  if(payment != NULL) {
+    record.payment_id = payment->id;
+    record.error_type = payment->error.type;
+    record.attempts = payment->attempts > UINT8_MAX ? UINT8_MAX : payment->attempts;
+    if(payment->end_time != 0) record.flags |= TRACE_PAYMENT_COMPLETED;
+    if(payment->is_success) record.flags |= TRACE_PAYMENT_SUCCESS;
+    if(payment->is_timeout) record.flags |= TRACE_PAYMENT_TIMEOUT;
+    if(payment->is_shard) record.flags |= TRACE_PAYMENT_SHARD;
+  }
+  else
+    record.payment_id = UINT32_MAX;
+  write_trace(&record, sizeof(record));
+  updated_edge_id = -1;
+}
+
+
+/* called in a child process created by fork(): the trace of the parent (flushed before the fork) is left untouched and the child
+   records its own events in a new trace with the same name in `output_dir_name` */
+void trace_fork(char output_dir_name[]) {
+  char filename[512];
+
+  if(trace_file == NULL) return;
+  fclose(trace_file);
+  snprintf(filename, sizeof(filename), "%s%s", output_dir_name, trace_basename);
+  trace_file = fopen(filename, "wb");
+  if(trace_file == NULL) {
+    fprintf(stderr, "ERROR: cannot open file <%s>\n", filename);
+    exit(-1);
+  }
+  write_trace(&trace_header, sizeof(trace_header));
+}
+
+
+void trace_close() {
+  if(trace_file == NULL) return;
+  if(fclose(trace_file) != 0) {
+    fprintf(stderr, "ERROR: cannot write event trace\n");
+    exit(-1);
+  }
+  trace_file = NULL;
+}
+
+
+struct trace* trace_map(char filename[]) {
+  struct trace* trace;
+  struct stat file_stat;
+  int fd;
+  void* mapping;
+
+  fd = open(filename, O_RDONLY);
+  if(fd == -1 || fstat(fd, &file_stat) != 0) {
+    fprintf(stderr, "ERROR: cannot open file <%s>\n", filename);
+    exit(-1);
+  }
+  if((size_t)file_stat.st_size < sizeof(struct trace_header)) {
+    fprintf(stderr, "ERROR: <%s> is not an event trace\n", filename);
+    exit(-1);
+  }
+  mapping = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(mapping == MAP_FAILED) {
+    fprintf(stderr, "ERROR: cannot map file <%s>\n", filename);
+    exit(-1);
+  }
+
+  trace = malloc(sizeof(struct trace));
+  trace->header = mapping;
+  trace->size = file_stat.st_size;
+  if(memcmp(trace->header->magic, TRACE_MAGIC, sizeof(trace->header->magic)) != 0 || trace->header->version != TRACE_VERSION || trace->header->record_size != sizeof(struct trace_record)) {
+    fprintf(stderr, "ERROR: <%s> is not an event trace of version %d\n", filename, TRACE_VERSION);
+    exit(-1);
+  }
+  trace->records = (struct trace_record*) (trace->header + 1);
+  trace->n_records = (trace->size - sizeof(struct trace_header)) / sizeof(struct trace_record);
+  return trace;
+}
+
+
+void trace_unmap(struct trace* trace) {
+  munmap(trace->header, trace->size);
+  free(trace);
+}
+
+
+char* get_trace_record_type_name(uint8_t type) {
+  if(type == TRACE_ROUTE_HOP) return "ROUTEHOP";
+  if(type < N_EVENT_TYPES) return get_event_type_name(type);
+  return "UNKNOWN";
+}
@@ -1,4 +1,6 @@
 #include <stdlib.h>
+#include <stdint.h>
+#include <gsl/gsl_rng.h>
 #include "../include/utils.h"
 #include "../include/routing.h"
 
@@ -34,3 +36,49 @@ int is_present(long element, struct array* long_array) {
 
   return 0;
 }
+
+
+/* Fenwick tree (1-based) of `n` non-negative counts: prefix sums, updates and searches in O(log n) */
+void fenwick_add(uint64_t* tree, long n, long index, uint64_t value){
+  for(index++; index <= n; index += index & -index)
+    tree[index] += value;
+}
+
+uint64_t fenwick_prefix_sum(uint64_t* tree, long n_elements){
+  uint64_t sum = 0;
+  for(; n_elements > 0; n_elements -= n_elements & -n_elements)
+    sum += tree[n_elements];
+  return sum;
+}
+
+/* return the smallest index whose cumulative count is greater than `target` */
+long fenwick_find(uint64_t* tree, long n, uint64_t target){
+  long position = 0, step;
+  for(step = 1; step*2 <= n; step *= 2);
+  for(; step > 0; step /= 2) {
+    if(position + step <= n && tree[position + step] <= target) {
+      position += step;
+      target -= tree[position];
+    }
+  }
+  return position;
+}
+
+
+/* seed of the random generator of substream `stream` (splitmix64 of the seed), so that the substreams are independent */
+static unsigned long get_substream_seed(unsigned long seed, uint64_t stream){
+  uint64_t z;
+  z = seed + (stream + 1)*0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30))*0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27))*0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+
+/* a random generator for substream `stream` of `seed` */
+gsl_rng* new_substream(unsigned long seed, uint64_t stream){
+  gsl_rng* random_generator;
+  random_generator = gsl_rng_alloc(gsl_rng_default);
+  gsl_rng_set(random_generator, get_substream_seed(seed, stream));
+  return random_generator;
+}
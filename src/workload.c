@@ -0,0 +1,264 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <gsl/gsl_rng.h>
+#include <gsl/gsl_randist.h>
+
+#include "../include/workload.h"
+#include "../include/payments.h"
+#include "../include/payment_trace.h"
+#include "../include/utils.h"
+
+/* Functions in this file generate the payments of a workload family (`payment_workload`) in a payment trace, which is then read as the
+   payments file of the simulation. The families combine a model of the sender-receiver pairs, of the amounts and of the arrivals.
+   The arrivals are drawn sequentially in substream 1 of the seed of the simulation; the pairs, amounts and maximum fees of the payments
+   are drawn in blocks of WORKLOAD_BLOCK_SIZE payments, block `i` in substream `i+2`, generated in parallel, so the workload is the same
+   for any number of threads. Substream 0 ranks the merchants of the Zipf pairs */
+
+static const struct workload_family workload_families[] = {
+  {"uniform", 1, UNIFORM_PAIRS, GAUSSIAN_AMOUNTS, POISSON_ARRIVALS}, // the random payments of payments.c, not generated here
+  {"merchants", 1, ZIPF_PAIRS, LOGNORMAL_AMOUNTS, POISSON_ARRIVALS},
+  {"local", 1, LOCAL_PAIRS, LOGNORMAL_AMOUNTS, POISSON_ARRIVALS},
+  {"heavy_tailed", 1, UNIFORM_PAIRS, PARETO_AMOUNTS, POISSON_ARRIVALS},
+  {"bursty", 1, UNIFORM_PAIRS, LOGNORMAL_AMOUNTS, BURSTY_ARRIVALS},
+  {"diurnal", 1, UNIFORM_PAIRS, LOGNORMAL_AMOUNTS, DIURNAL_ARRIVALS},
+  {"repeat", 1, REPEAT_PAIRS, LOGNORMAL_AMOUNTS, POISSON_ARRIVALS},
+};
+
+struct workload_generator {
+  const struct workload_family* family;
+  struct payments_params pay_params;
+  struct network* network;
+  long n_nodes;
+  unsigned long seed;
+  gsl_ran_discrete_t* merchant_distribution; // the probability of each rank of the Zipf pairs
+  long* merchants; // the node of each rank
+  struct payment_arrival* arrivals;
+  long n_blocks;
+  long next_block;
+};
+
+
+/* NULL if there is no family with this name */
+const struct workload_family* get_workload_family(char name[]) {
+  long i;
+  for(i = 0; i < (long)(sizeof(workload_families)/sizeof(workload_families[0])); i++)
+    if(strcmp(name, workload_families[i].name) == 0) return &(workload_families[i]);
+  return NULL;
+}
+
+
+/* the start times of the payments, in milliseconds from time 1 as the random payments of payments.c; the average rate is `payment_rate` */
+static void draw_arrivals(struct workload_generator* generator) {
+  gsl_rng* random_generator;
+  struct payments_params* pay_params;
+  uint64_t time, next_time, state_end;
+  double rate, calm_rate, max_rate, period;
+  unsigned int is_burst;
+  long i;
+
+  pay_params = &(generator->pay_params);
+  random_generator = new_substream(generator->seed, 1);
+  rate = 1.0/pay_params->inverse_payment_rate; // payments per second
+  // the calm and burst periods alternate with exponential durations, and the average rate is the one of the Poisson arrivals
+  calm_rate = rate*(WORKLOAD_CALM_TO_BURST_RATIO + 1)/(WORKLOAD_CALM_TO_BURST_RATIO + pay_params->workload_burst_factor);
+  max_rate = rate*(1 + WORKLOAD_DIURNAL_AMPLITUDE);
+  period = pay_params->workload_diurnal_period*1000;
+  is_burst = 0;
+  state_end = 1 + 1000*gsl_ran_exponential(random_generator, WORKLOAD_CALM_TO_BURST_RATIO*pay_params->workload_burst_duration);
+  time = 1;
+  for(i = 0; i < pay_params->n_payments; i++) {
+    switch(generator->family->arrivals) {
+    case POISSON_ARRIVALS:
+      time += 1000*gsl_ran_exponential(random_generator, pay_params->inverse_payment_rate);
+      break;
+    case BURSTY_ARRIVALS:
+      // the interarrival time is memoryless: when a period ends before the next payment, the payment is drawn again at the rate of the next period
+      while((next_time = time + 1000*gsl_ran_exponential(random_generator, 1.0/(is_burst ? calm_rate*pay_params->workload_burst_factor : calm_rate))) > state_end) {
+        time = state_end;
+        is_burst = !is_burst;
+        state_end = time + 1000*gsl_ran_exponential(random_generator, (is_burst ? 1 : WORKLOAD_CALM_TO_BURST_RATIO)*pay_params->workload_burst_duration);
+      }
+      time = next_time;
+      break;
+    case DIURNAL_ARRIVALS:
+      // thinning of a Poisson process at the maximum rate
+      do {
+        time += 1000*gsl_ran_exponential(random_generator, 1.0/max_rate);
+      } while(gsl_rng_uniform(random_generator)*max_rate > rate*(1 + WORKLOAD_DIURNAL_AMPLITUDE*sin(2*M_PI*time/period)));
+      break;
+    }
+    generator->arrivals[i].start_time = time;
+  }
+  gsl_rng_free(random_generator);
+}
+
+
+/* the merchants are ranked by a random permutation of the nodes, so that the most paid nodes do not depend on the ids */
+static void initialize_merchants(struct workload_generator* generator) {
+  gsl_rng* random_generator;
+  double* probabilities;
+  long i, j, merchant;
+
+  random_generator = new_substream(generator->seed, 0);
+  generator->merchants = malloc(sizeof(long)*generator->n_nodes);
+  for(i = 0; i < generator->n_nodes; i++)
+    generator->merchants[i] = i;
+  // Fisher-Yates shuffle
+  for(i = generator->n_nodes - 1; i > 0; i--) {
+    j = gsl_rng_uniform_int(random_generator, i + 1);
+    merchant = generator->merchants[i];
+    generator->merchants[i] = generator->merchants[j];
+    generator->merchants[j] = merchant;
+  }
+  probabilities = malloc(sizeof(double)*generator->n_nodes);
+  for(i = 0; i < generator->n_nodes; i++)
+    probabilities[i] = pow(i + 1, -generator->pay_params.workload_zipf_exponent);
+  generator->merchant_distribution = gsl_ran_discrete_preproc(generator->n_nodes, probabilities);
+  free(probabilities);
+  gsl_rng_free(random_generator);
+}
+
+
+/* the end of a random walk with a geometric number of hops (average `workload_locality_hops`) on the open channels of the network;
+   it returns -1 if the walk ends at the sender */
+static long draw_local_receiver(struct workload_generator* generator, long sender, gsl_rng* random_generator) {
+  struct node* node;
+  struct edge* edge;
+  long node_id, n_hops, i;
+  uint32_t edge_id;
+
+  node_id = get_renumbered_id(generator->network->node_map, sender);
+  // geometric number of hops (at least 1) by inversion
+  n_hops = 1;
+  if(generator->pay_params.workload_locality_hops > 1)
+    n_hops += floor(log(1 - gsl_rng_uniform(random_generator))/log(1 - 1.0/generator->pay_params.workload_locality_hops));
+  for(i = 0; i < n_hops; i++) {
+    node = array_get(generator->network->nodes, node_id);
+    if(node->n_open_edges == 0) break;
+    edge_id = node->open_edges[gsl_rng_uniform_int(random_generator, node->n_open_edges)];
+    if(edge_id == CLOSED_EDGE) continue;
+    edge = array_get(generator->network->edges, edge_id);
+    node_id = edge->to_node_id;
+  }
+  node_id = get_original_id(generator->network->node_map, node_id);
+  return node_id != sender ? node_id : -1;
+}
+
+
+/* senders and receivers are ids of the input network, as in a payments file */
+static void draw_pair(struct workload_generator* generator, long index, long block_start, gsl_rng* random_generator, struct payment_arrival* arrival) {
+  struct payment_arrival* repeated;
+
+  if(generator->family->pairs == REPEAT_PAIRS && index > block_start && gsl_rng_uniform(random_generator) < generator->pay_params.workload_repeat_probability) {
+    // a pair of a previous payment of the same block, which does not depend on the other blocks
+    repeated = &(generator->arrivals[block_start + gsl_rng_uniform_int(random_generator, index - block_start)]);
+    arrival->sender = repeated->sender;
+    arrival->receiver = repeated->receiver;
+    return;
+  }
+  do {
+    arrival->sender = gsl_rng_uniform_int(random_generator, generator->n_nodes);
+    switch(generator->family->pairs) {
+    case ZIPF_PAIRS:
+      arrival->receiver = generator->merchants[gsl_ran_discrete(random_generator, generator->merchant_distribution)];
+      break;
+    case LOCAL_PAIRS:
+      arrival->receiver = draw_local_receiver(generator, arrival->sender, random_generator);
+      break;
+    default:
+      arrival->receiver = gsl_rng_uniform_int(random_generator, generator->n_nodes);
+      break;
+    }
+  } while(arrival->receiver == -1 || arrival->sender == arrival->receiver);
+}
+
+
+/* the average amount is `average_payment_amount` (in satoshi) for all the models */
+static uint64_t draw_amount(struct workload_generator* generator, gsl_rng* random_generator) {
+  struct payments_params* pay_params;
+  double sigma, alpha;
+
+  pay_params = &(generator->pay_params);
+  switch(generator->family->amounts) {
+  case LOGNORMAL_AMOUNTS:
+    sigma = pay_params->workload_amount_sigma;
+    return gsl_ran_lognormal(random_generator, log(pay_params->amount_mu) - sigma*sigma/2, sigma)*1000.0; // convert satoshi to millisatoshi
+  case PARETO_AMOUNTS:
+    alpha = pay_params->workload_pareto_alpha;
+    return gsl_ran_pareto(random_generator, alpha, pay_params->amount_mu*(alpha - 1)/alpha)*1000.0;
+  default:
+    return fabs(pay_params->amount_mu + gsl_ran_ugaussian(random_generator) * pay_params->amount_sigma)*1000.0;
+  }
+}
+
+
+/* a generator thread takes the next block of payments until all blocks are generated; block `i` uses substream `i+2` */
+static void* workload_thread(void* arg) {
+  struct workload_generator* generator;
+  struct payment_arrival* arrival;
+  gsl_rng* random_generator;
+  long block, i, start, end;
+
+  generator = (struct workload_generator*) arg;
+  while((block = __atomic_fetch_add(&(generator->next_block), 1, __ATOMIC_RELAXED)) < generator->n_blocks) {
+    random_generator = new_substream(generator->seed, block + 2);
+    start = block*WORKLOAD_BLOCK_SIZE;
+    end = start + WORKLOAD_BLOCK_SIZE < generator->pay_params.n_payments ? start + WORKLOAD_BLOCK_SIZE : generator->pay_params.n_payments;
+    for(i = start; i < end; i++) {
+      arrival = &(generator->arrivals[i]);
+      draw_pair(generator, i, start, random_generator, arrival);
+      arrival->amount = draw_amount(generator, random_generator);
+      arrival->max_fee_limit = generate_max_fee_limit(generator->pay_params, random_generator);
+    }
+    gsl_rng_free(random_generator);
+  }
+  return NULL;
+}
+
+
+/* generate the payments of the workload `payment_workload` in the payment trace `filename` */
+void generate_workload(struct payments_params pay_params, struct network* network, char filename[]) {
+  struct workload_generator generator;
+  pthread_t* tid;
+  long i, n_threads;
+
+  memset(&generator, 0, sizeof(generator));
+  generator.family = get_workload_family(pay_params.workload);
+  generator.pay_params = pay_params;
+  generator.network = network;
+  generator.n_nodes = array_len(network->nodes);
+  generator.seed = gsl_rng_default_seed;
+  generator.arrivals = malloc(sizeof(struct payment_arrival)*(pay_params.n_payments > 0 ? pay_params.n_payments : 1));
+  printf("WORKLOAD %s VERSION %d (seed %lu)\n", generator.family->name, generator.family->version, generator.seed);
+
+  if(generator.n_nodes < 2) {
+    fprintf(stderr, "ERROR: a workload needs at least 2 nodes\n");
+    exit(-1);
+  }
+  if(generator.family->pairs == ZIPF_PAIRS)
+    initialize_merchants(&generator);
+  draw_arrivals(&generator);
+
+  generator.n_blocks = (pay_params.n_payments + WORKLOAD_BLOCK_SIZE - 1)/WORKLOAD_BLOCK_SIZE;
+  n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+  if(n_threads > generator.n_blocks) n_threads = generator.n_blocks;
+  tid = malloc(sizeof(pthread_t)*(n_threads > 0 ? n_threads : 1));
+  for(i = 0; i < n_threads; i++)
+    pthread_create(&(tid[i]), NULL, workload_thread, &generator);
+  for(i = 0; i < n_threads; i++)
+    pthread_join(tid[i], NULL);
+  free(tid);
+
+  write_payment_trace(filename, generator.arrivals, pay_params.n_payments);
+
+  free(generator.arrivals);
+  if(generator.merchant_distribution != NULL) {
+    gsl_ran_discrete_free(generator.merchant_distribution);
+    free(generator.merchants);
+  }
+}
@@ -0,0 +1,475 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <gsl/gsl_rng.h>
+#include <gsl/gsl_randist.h>
+
+#include "../include/network.h"
+#include "../include/network_snapshot.h"
+#include "../include/csv.h"
+#include "../include/utils.h"
+
+/* Generator of large synthetic networks, written directly in the binary snapshot format loaded by the simulator (parameter `network_snapshot_filename`).
+   The snapshot is mapped in memory and filled in place, so the memory used by the generator depends on the number of nodes, not on the number of channels.
+   Channels are generated in blocks, each one with its own random generator seeded from GSL_RNG_SEED and the index of the block:
+   blocks are generated in parallel and the snapshot is the same for any number of threads.
+   Models:
+   - ba: Barabasi-Albert; starting from a clique of n_channels_per_node+1 nodes, every new node opens n_channels_per_node channels
+     to nodes chosen with probability proportional to their channels (the topology is generated sequentially, the channels in parallel);
+   - ln: degrees and capacities sampled from the Lightning Network snapshot (ln_channels_filename); the channels connect nodes chosen
+     with probability proportional to their degree (Chung-Lu model);
+   - hub: n_hubs hubs connected in a ring of n_channels_per_node neighbours, and every other node opens n_channels_per_node channels
+     to hubs chosen uniformly */
+
+#define CHANNELS_PER_BLOCK 65536
+
+enum network_model {
+  BARABASI_ALBERT,
+  LN_CALIBRATED,
+  HUB_AND_SPOKE
+};
+
+struct generator_params {
+  enum network_model model;
+  long n_nodes;
+  long n_channels_per_node;
+  long capacity_per_channel;
+  long n_hubs;
+  char ln_channels_filename[256];
+  double cul_threshold_dist_alpha;
+  double cul_threshold_dist_beta;
+  long n_threads;
+  unsigned long seed;
+};
+
+/* the sections of the snapshot being generated, mapped in memory */
+struct snapshot_sections {
+  char* mapping;
+  size_t size;
+  struct network_snapshot_header* header;
+  struct network_snapshot_node* nodes;
+  struct network_snapshot_channel* channels;
+  struct network_snapshot_edge* edges;
+  uint64_t* adjacency_offsets;
+  uint64_t* adjacency;
+  double* cul_thresholds;
+};
+
+struct generator {
+  struct generator_params params;
+  struct snapshot_sections snapshot;
+  long n_channels;
+  long n_hub_channels;
+  long n_hub_neighbours; // hub
+  long n_blocks;
+  long next_block;
+  gsl_ran_discrete_t* node_weights; // ln
+  uint64_t* ln_capacities; // ln
+  long n_ln_capacities;
+};
+
+
+
+static double get_elapsed_s(struct timespec start){
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec)/1E9;
+}
+
+
+static void map_snapshot(char filename[], struct snapshot_sections* snapshot, long n_nodes, long n_channels){
+  int fd;
+  long n_edges;
+
+  n_edges = 2*n_channels;
+  snapshot->size = sizeof(struct network_snapshot_header) + n_nodes*sizeof(struct network_snapshot_node) + n_channels*sizeof(struct network_snapshot_channel) +
+    n_edges*sizeof(struct network_snapshot_edge) + (n_nodes + 1)*sizeof(uint64_t) + n_edges*sizeof(uint64_t) + n_edges*sizeof(double);
+
+  fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if(fd == -1) {
+    fprintf(stderr, "ERROR: cannot open file <%s>\n", filename);
+    exit(-1);
+  }
+  if(ftruncate(fd, snapshot->size) != 0) {
+    fprintf(stderr, "ERROR: cannot allocate %zu bytes for <%s>\n", snapshot->size, filename);
+    exit(-1);
+  }
+  snapshot->mapping = mmap(NULL, snapshot->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if(snapshot->mapping == MAP_FAILED) {
+    fprintf(stderr, "ERROR: cannot map file <%s>\n", filename);
+    exit(-1);
+  }
+
+  snapshot->header = (struct network_snapshot_header*) snapshot->mapping;
+  snapshot->nodes = (struct network_snapshot_node*) (snapshot->header + 1);
+  snapshot->channels = (struct network_snapshot_channel*) (snapshot->nodes + n_nodes);
+  snapshot->edges = (struct network_snapshot_edge*) (snapshot->channels + n_channels);
+  snapshot->adjacency_offsets = (uint64_t*) (snapshot->edges + n_edges);
+  snapshot->adjacency = snapshot->adjacency_offsets + n_nodes + 1;
+  snapshot->cul_thresholds = (double*) (snapshot->adjacency + n_edges);
+
+  memcpy(snapshot->header->magic, NETWORK_SNAPSHOT_MAGIC, sizeof(snapshot->header->magic));
+  snapshot->header->version = NETWORK_SNAPSHOT_VERSION;
+  snapshot->header->header_size = sizeof(struct network_snapshot_header);
+  snapshot->header->n_nodes = n_nodes;
+  snapshot->header->n_channels = n_channels;
+  snapshot->header->n_edges = n_edges;
+}
+
+
+/* TOPOLOGY */
+
+/* Barabasi-Albert topology, generated sequentially in substream 0 (each node depends on the channels of the previous ones) */
+static void generate_barabasi_albert_topology(struct generator* generator){
+  struct network_snapshot_channel* channels;
+  uint64_t* channels_per_node;
+  long n_nodes, m, n_clique_nodes, i, j, node, channel_id = 0, node_to_connect_id;
+  gsl_rng* random_generator;
+
+  n_nodes = generator->params.n_nodes;
+  m = generator->params.n_channels_per_node;
+  n_clique_nodes = m + 1;
+  channels = generator->snapshot.channels;
+  channels_per_node = calloc(n_nodes + 1, sizeof(uint64_t));
+  random_generator = new_substream(generator->params.seed, 0);
+
+  for(i = 0; i < n_clique_nodes; i++) {
+    for(j = i + 1; j < n_clique_nodes; j++) {
+      channels[channel_id].node1 = i;
+      channels[channel_id].node2 = j;
+      channel_id++;
+    }
+    fenwick_add(channels_per_node, n_nodes, i, n_clique_nodes - 1);
+  }
+  for(node = n_clique_nodes; node < n_nodes; node++) {
+    for(j = 0; j < m; j++) {
+      node_to_connect_id = sample_node_by_channels(channels_per_node, n_nodes, node, random_generator);
+      channels[channel_id].node1 = node;
+      channels[channel_id].node2 = node_to_connect_id;
+      channel_id++;
+      fenwick_add(channels_per_node, n_nodes, node, 1);
+      fenwick_add(channels_per_node, n_nodes, node_to_connect_id, 1);
+    }
+  }
+
+  gsl_rng_free(random_generator);
+  free(channels_per_node);
+}
+
+
+/* weights of the nodes for the ln model: every node takes the degree of a random node of the Lightning Network snapshot */
+static void initialize_ln_model(struct generator* generator){
+  struct csv_table* channels_table;
+  union csv_value* row;
+  union csv_value channel_defaults[6];
+  long i, n_ln_nodes = 0, n_ln_degrees = 0;
+  uint64_t* ln_degrees_per_node, *ln_degrees;
+  double* weights, tot_weight = 0;
+  gsl_rng* random_generator;
+
+  memset(channel_defaults, 0, sizeof(channel_defaults));
+  channels_table = csv_read(generator->params.ln_channels_filename, "iiiiii", 6, channel_defaults);
+  if(channels_table->n_rows == 0) {
+    fprintf(stderr, "ERROR: <%s> has no channels\n", generator->params.ln_channels_filename);
+    exit(-1);
+  }
+  for(i = 0; i < channels_table->n_rows; i++) {
+    row = channels_table->values + i*channels_table->n_columns;
+    if(row[3].integer < 0 || row[4].integer < 0) {
+      fprintf(stderr, "ERROR: channel <%ld> in <%s> has a negative node id\n", (long)row[0].integer, generator->params.ln_channels_filename);
+      exit(-1);
+    }
+    if(row[3].integer + 1 > n_ln_nodes) n_ln_nodes = row[3].integer + 1;
+    if(row[4].integer + 1 > n_ln_nodes) n_ln_nodes = row[4].integer + 1;
+  }
+
+  ln_degrees_per_node = calloc(n_ln_nodes, sizeof(uint64_t));
+  generator->ln_capacities = malloc(channels_table->n_rows*sizeof(uint64_t));
+  generator->n_ln_capacities = channels_table->n_rows;
+  for(i = 0; i < channels_table->n_rows; i++) {
+    row = channels_table->values + i*channels_table->n_columns;
+    ln_degrees_per_node[row[3].integer]++;
+    ln_degrees_per_node[row[4].integer]++;
+    generator->ln_capacities[i] = row[5].integer;
+  }
+  ln_degrees = malloc(n_ln_nodes*sizeof(uint64_t));
+  for(i = 0; i < n_ln_nodes; i++)
+    if(ln_degrees_per_node[i] > 0) ln_degrees[n_ln_degrees++] = ln_degrees_per_node[i];
+
+  random_generator = new_substream(generator->params.seed, 0);
+  weights = malloc(generator->params.n_nodes*sizeof(double));
+  for(i = 0; i < generator->params.n_nodes; i++) {
+    weights[i] = ln_degrees[gsl_rng_uniform_int(random_generator, n_ln_degrees)];
+    tot_weight += weights[i];
+  }
+  generator->node_weights = gsl_ran_discrete_preproc(generator->params.n_nodes, weights);
+  // the expected degree of a node is its weight
+  generator->n_channels = llround(tot_weight/2);
+  if(generator->n_channels == 0) generator->n_channels = 1;
+
+  gsl_rng_free(random_generator);
+  free(weights);
+  free(ln_degrees);
+  free(ln_degrees_per_node);
+  csv_free(channels_table);
+}
+
+
+/* CHANNELS */
+
+static void generate_channel(struct generator* generator, long channel_id, gsl_rng* random_generator){
+  struct network_snapshot_channel* channel;
+  struct network_snapshot_edge* edge1, *edge2;
+  struct policy edge1_policy, edge2_policy;
+  long m, spoke_channel;
+  uint64_t capacity, edge1_balance;
+  double fraction_capacity;
+
+  channel = &(generator->snapshot.channels[channel_id]);
+  m = generator->params.n_channels_per_node;
+  switch(generator->params.model) {
+  case LN_CALIBRATED:
+    channel->node1 = gsl_ran_discrete(random_generator, generator->node_weights);
+    do {
+      channel->node2 = gsl_ran_discrete(random_generator, generator->node_weights);
+    } while(channel->node2 == channel->node1);
+    break;
+  case HUB_AND_SPOKE:
+    if(channel_id < generator->n_hub_channels) {
+      channel->node1 = channel_id / generator->n_hub_neighbours;
+      channel->node2 = (channel->node1 + 1 + channel_id % generator->n_hub_neighbours) % generator->params.n_hubs;
+    }
+    else {
+      spoke_channel = channel_id - generator->n_hub_channels;
+      channel->node1 = generator->params.n_hubs + spoke_channel / m;
+      channel->node2 = gsl_rng_uniform_int(random_generator, generator->params.n_hubs);
+    }
+    break;
+  case BARABASI_ALBERT:
+    break;
+  }
+
+  if(generator->params.model == LN_CALIBRATED)
+    capacity = generator->ln_capacities[gsl_rng_uniform_int(random_generator, generator->n_ln_capacities)];
+  else
+    capacity = fabs(generator->params.capacity_per_channel + gsl_ran_ugaussian(random_generator))*1000; // convert satoshi to millisatoshi
+  fraction_capacity = gsl_rng_uniform(random_generator);
+  edge1_balance = fraction_capacity*((double) capacity);
+  edge1_policy = generate_random_policy(random_generator, generator->params.cul_threshold_dist_alpha, generator->params.cul_threshold_dist_beta);
+  edge2_policy = generate_random_policy(random_generator, generator->params.cul_threshold_dist_alpha, generator->params.cul_threshold_dist_beta);
+
+  channel->id = channel_id;
+  channel->edge1 = 2*channel_id;
+  channel->edge2 = 2*channel_id + 1;
+  channel->capacity = capacity;
+
+  edge1 = &(generator->snapshot.edges[channel->edge1]);
+  edge2 = &(generator->snapshot.edges[channel->edge2]);
+  memset(edge1, 0, sizeof(struct network_snapshot_edge));
+  memset(edge2, 0, sizeof(struct network_snapshot_edge));
+  edge1->id = channel->edge1;
+  edge1->channel_id = channel_id;
+  edge1->counter_edge_id = channel->edge2;
+  edge1->from_node_id = channel->node1;
+  edge1->to_node_id = channel->node2;
+  edge1->balance = edge1_balance;
+  edge1->fee_base = edge1_policy.fee_base;
+  edge1->fee_proportional = edge1_policy.fee_proportional;
+  edge1->min_htlc = edge1_policy.min_htlc;
+  edge1->timelock = edge1_policy.timelock;
+  edge2->id = channel->edge2;
+  edge2->channel_id = channel_id;
+  edge2->counter_edge_id = channel->edge1;
+  edge2->from_node_id = channel->node2;
+  edge2->to_node_id = channel->node1;
+  edge2->balance = capacity - edge1_balance;
+  edge2->fee_base = edge2_policy.fee_base;
+  edge2->fee_proportional = edge2_policy.fee_proportional;
+  edge2->min_htlc = edge2_policy.min_htlc;
+  edge2->timelock = edge2_policy.timelock;
+  generator->snapshot.cul_thresholds[channel->edge1] = edge1_policy.cul_threshold;
+  generator->snapshot.cul_thresholds[channel->edge2] = edge2_policy.cul_threshold;
+}
+
+
+/* a generator thread takes the next block of channels until all blocks are generated; block `i` uses substream `i+1` */
+static void* generator_thread(void* arg){
+  struct generator* generator;
+  long block, channel_id, end;
+  gsl_rng* random_generator;
+
+  generator = (struct generator*) arg;
+  while((block = __atomic_fetch_add(&(generator->next_block), 1, __ATOMIC_RELAXED)) < generator->n_blocks) {
+    random_generator = new_substream(generator->params.seed, block + 1);
+    end = (block + 1)*CHANNELS_PER_BLOCK < generator->n_channels ? (block + 1)*CHANNELS_PER_BLOCK : generator->n_channels;
+    for(channel_id = block*CHANNELS_PER_BLOCK; channel_id < end; channel_id++)
+      generate_channel(generator, channel_id, random_generator);
+    gsl_rng_free(random_generator);
+  }
+  return NULL;
+}
+
+
+/* nodes and adjacency: the edges leaving a node are listed in order of id, as when the network is loaded from csv files */
+static void generate_adjacency(struct generator* generator){
+  struct snapshot_sections* snapshot;
+  uint64_t* next_position;
+  long i, n_nodes, edge_id;
+
+  snapshot = &(generator->snapshot);
+  n_nodes = generator->params.n_nodes;
+  for(i = 0; i < n_nodes; i++)
+    snapshot->nodes[i].id = i;
+
+  memset(snapshot->adjacency_offsets, 0, (n_nodes + 1)*sizeof(uint64_t));
+  for(edge_id = 0; edge_id < 2*generator->n_channels; edge_id++)
+    snapshot->adjacency_offsets[snapshot->edges[edge_id].from_node_id + 1]++;
+  for(i = 0; i < n_nodes; i++)
+    snapshot->adjacency_offsets[i+1] += snapshot->adjacency_offsets[i];
+
+  next_position = malloc(n_nodes*sizeof(uint64_t));
+  memcpy(next_position, snapshot->adjacency_offsets, n_nodes*sizeof(uint64_t));
+  for(edge_id = 0; edge_id < 2*generator->n_channels; edge_id++)
+    snapshot->adjacency[next_position[snapshot->edges[edge_id].from_node_id]++] = edge_id;
+  free(next_position);
+}
+
+
+static void read_generator_param(struct generator_params* params, char* option){
+  char* value;
+
+  value = strchr(option, '=');
+  if(value == NULL) {
+    fprintf(stderr, "ERROR: wrong option <%s>: options are <key>=<value>\n", option);
+    exit(-1);
+  }
+  *(value++) = '\0';
+  if(strcmp(option, "n_channels_per_node")==0)
+    params->n_channels_per_node = strtol(value, NULL, 10);
+  else if(strcmp(option, "capacity_per_channel")==0)
+    params->capacity_per_channel = strtol(value, NULL, 10);
+  else if(strcmp(option, "n_hubs")==0)
+    params->n_hubs = strtol(value, NULL, 10);
+  else if(strcmp(option, "ln_channels_filename")==0)
+    strcpy(params->ln_channels_filename, value);
+  else if(strcmp(option, "cul_threshold_dist_alpha")==0)
+    params->cul_threshold_dist_alpha = strtod(value, NULL);
+  else if(strcmp(option, "cul_threshold_dist_beta")==0)
+    params->cul_threshold_dist_beta = strtod(value, NULL);
+  else if(strcmp(option, "threads")==0)
+    params->n_threads = strtol(value, NULL, 10);
+  else {
+    fprintf(stderr, "ERROR: unknown option <%s>\n", option);
+    exit(-1);
+  }
+}
+
+
+int main(int argc, char *argv[]) {
+  struct generator generator;
+  struct generator_params* params;
+  char tmp_filename[512];
+  pthread_t* tid;
+  struct timespec start;
+  long i, m;
+
+  if(argc < 4) {
+    fprintf(stderr, "usage: %s <ba|ln|hub> <n_nodes> <output snapshot> [<key>=<value> ...]\n", argv[0]);
+    fprintf(stderr, "keys: n_channels_per_node (default 5), capacity_per_channel (satoshi, default 1000000; ba and hub), n_hubs (default n_nodes/1000; hub),\n");
+    fprintf(stderr, "      ln_channels_filename (default channels_ln.csv; ln), cul_threshold_dist_alpha (default 2), cul_threshold_dist_beta (default 10), threads\n");
+    return -1;
+  }
+
+  memset(&generator, 0, sizeof(generator));
+  params = &(generator.params);
+  if(strcmp(argv[1], "ba")==0) params->model = BARABASI_ALBERT;
+  else if(strcmp(argv[1], "ln")==0) params->model = LN_CALIBRATED;
+  else if(strcmp(argv[1], "hub")==0) params->model = HUB_AND_SPOKE;
+  else {
+    fprintf(stderr, "ERROR: unknown model <%s>. Possible models are <ba>, <ln>, <hub>\n", argv[1]);
+    return -1;
+  }
+  params->n_nodes = strtol(argv[2], NULL, 10);
+  params->n_channels_per_node = 5;
+  params->capacity_per_channel = 1000000;
+  params->n_hubs = params->n_nodes/1000;
+  strcpy(params->ln_channels_filename, "channels_ln.csv");
+  params->cul_threshold_dist_alpha = 2;
+  params->cul_threshold_dist_beta = 10;
+  params->n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+  for(i = 4; i < argc; i++)
+    read_generator_param(params, argv[i]);
+  gsl_rng_env_setup();
+  params->seed = gsl_rng_default_seed;
+
+  m = params->n_channels_per_node;
+  if(m < 1 || params->n_threads < 1) {
+    fprintf(stderr, "ERROR: n_channels_per_node and threads must be positive\n");
+    return -1;
+  }
+  switch(params->model) {
+  case BARABASI_ALBERT:
+    if(params->n_nodes < m + 1) {
+      fprintf(stderr, "ERROR: the ba model needs at least n_channels_per_node+1 nodes\n");
+      return -1;
+    }
+    generator.n_channels = (m + 1)*m/2 + (params->n_nodes - m - 1)*m;
+    break;
+  case LN_CALIBRATED:
+    if(params->n_nodes < 2) {
+      fprintf(stderr, "ERROR: the ln model needs at least 2 nodes\n");
+      return -1;
+    }
+    initialize_ln_model(&generator);
+    break;
+  case HUB_AND_SPOKE:
+    if(params->n_hubs < 2) params->n_hubs = 2;
+    if(params->n_nodes <= params->n_hubs) {
+      fprintf(stderr, "ERROR: the hub model needs more nodes than hubs\n");
+      return -1;
+    }
+    // each hub is connected to the next k hubs of the ring, with no duplicate channels
+    generator.n_hub_neighbours = m < (params->n_hubs - 1)/2 ? m : (params->n_hubs - 1)/2;
+    generator.n_hub_channels = params->n_hubs*generator.n_hub_neighbours;
+    generator.n_channels = generator.n_hub_channels + (params->n_nodes - params->n_hubs)*m;
+    break;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  snprintf(tmp_filename, sizeof(tmp_filename), "%s.tmp", argv[3]);
+  map_snapshot(tmp_filename, &(generator.snapshot), params->n_nodes, generator.n_channels);
+
+  if(params->model == BARABASI_ALBERT)
+    generate_barabasi_albert_topology(&generator);
+
+  generator.n_blocks = (generator.n_channels + CHANNELS_PER_BLOCK - 1) / CHANNELS_PER_BLOCK;
+  tid = malloc(params->n_threads*sizeof(pthread_t));
+  for(i = 0; i < params->n_threads; i++)
+    pthread_create(&(tid[i]), NULL, generator_thread, &generator);
+  for(i = 0; i < params->n_threads; i++)
+    pthread_join(tid[i], NULL);
+  free(tid);
+
+  generate_adjacency(&generator);
+
+  if(msync(generator.snapshot.mapping, generator.snapshot.size, MS_SYNC) != 0 || munmap(generator.snapshot.mapping, generator.snapshot.size) != 0) {
+    fprintf(stderr, "ERROR: cannot write network snapshot <%s>\n", tmp_filename);
+    return -1;
+  }
+  if(rename(tmp_filename, argv[3]) != 0) {
+    fprintf(stderr, "ERROR: cannot rename <%s> to <%s>\n", tmp_filename, argv[3]);
+    return -1;
+  }
+
+  printf("nodes=%ld channels=%ld edges=%ld (%.3f s, %ld threads)\n", params->n_nodes, generator.n_channels, 2*generator.n_channels, get_elapsed_s(start), params->n_threads);
+  return 0;
+}
@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "../include/array.h"
+#include "../include/network.h"
+#include "../include/network_snapshot.h"
+
+/* Converter from the csv files of a network (nodes, channels, edges) to a binary network snapshot, loaded by the simulator with
+   the parameter `network_snapshot_filename`. After writing the snapshot, it loads it back and checks that it describes the same network */
+
+
+static double get_elapsed_ms(struct timespec start){
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  return (end.tv_sec - start.tv_sec)*1E3 + (end.tv_nsec - start.tv_nsec)/1E6;
+}
+
+
+static void check_equal(long id, const char* what, int is_equal){
+  if(!is_equal) {
+    fprintf(stderr, "ERROR: %s <%ld> differs in the snapshot\n", what, id);
+    exit(-1);
+  }
+}
+
+
+/* check that the network loaded from the snapshot is the same as the one loaded from the csv files */
+static void check_snapshot(struct network* network, struct network* loaded){
+  long i, j;
+  struct node* node, *loaded_node;
+  struct channel* channel, *loaded_channel;
+  struct edge* edge, *loaded_edge;
+
+  if(array_len(network->nodes) != array_len(loaded->nodes) || array_len(network->channels) != array_len(loaded->channels) || array_len(network->edges) != array_len(loaded->edges)) {
+    fprintf(stderr, "ERROR: the snapshot has a different number of nodes, channels or edges\n");
+    exit(-1);
+  }
+  for(i = 0; i < array_len(network->nodes); i++) {
+    node = array_get(network->nodes, i);
+    loaded_node = array_get(loaded->nodes, i);
+    check_equal(i, "node", node->id == loaded_node->id && node->n_open_edges == loaded_node->n_open_edges);
+    for(j = 0; j < node->n_open_edges; j++)
+      check_equal(i, "node", node->open_edges[j] == loaded_node->open_edges[j]);
+  }
+  for(i = 0; i < array_len(network->channels); i++) {
+    channel = array_get(network->channels, i);
+    loaded_channel = array_get(loaded->channels, i);
+    check_equal(i, "channel", channel->id == loaded_channel->id && channel->edge1 == loaded_channel->edge1 && channel->edge2 == loaded_channel->edge2 &&
+                channel->node1 == loaded_channel->node1 && channel->node2 == loaded_channel->node2 && channel->capacity == loaded_channel->capacity);
+  }
+  for(i = 0; i < array_len(network->edges); i++) {
+    edge = array_get(network->edges, i);
+    loaded_edge = array_get(loaded->edges, i);
+    check_equal(i, "edge", edge->id == loaded_edge->id && edge->channel_id == loaded_edge->channel_id && edge->counter_edge_id == loaded_edge->counter_edge_id &&
+                edge->from_node_id == loaded_edge->from_node_id && edge->to_node_id == loaded_edge->to_node_id && edge->balance == loaded_edge->balance &&
+                edge->policy.fee_base == loaded_edge->policy.fee_base && edge->policy.fee_proportional == loaded_edge->policy.fee_proportional &&
+                edge->policy.min_htlc == loaded_edge->policy.min_htlc && edge->policy.timelock == loaded_edge->policy.timelock &&
+                memcmp(&(edge->policy.cul_threshold), &(loaded_edge->policy.cul_threshold), sizeof(double)) == 0);
+  }
+}
+
+
+int main(int argc, char *argv[]) {
+  struct network* network, *loaded;
+  struct timespec start;
+  double csv_ms, snapshot_ms;
+
+  if(argc != 5) {
+    fprintf(stderr, "usage: %s <nodes.csv> <channels.csv> <edges.csv> <output snapshot>\n", argv[0]);
+    return -1;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  network = generate_network_from_files(argv[1], argv[2], argv[3]);
+  csv_ms = get_elapsed_ms(start);
+
+  write_network_snapshot(argv[4], network);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  loaded = generate_network_from_snapshot(argv[4]);
+  snapshot_ms = get_elapsed_ms(start);
+  check_snapshot(network, loaded);
+
+  printf("nodes=%ld channels=%ld edges=%ld\n", array_len(network->nodes), array_len(network->channels), array_len(network->edges));
+  printf("load from csv files: %.3f ms, load from snapshot: %.3f ms\n", csv_ms, snapshot_ms);
+  return 0;
+}
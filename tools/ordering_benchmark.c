@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include <gsl/gsl_rng.h>
+
+#include "../include/array.h"
+#include "../include/cloth.h"
+#include "../include/network.h"
+#include "../include/routing.h"
+#include "../include/input.h"
+#include "../include/telemetry.h"
+
+/* Benchmark of the orderings of a network (parameter `network_ordering`): the network is loaded from csv files with each ordering,
+   and the same path finding queries (pairs of input node ids) are executed on it, measuring wall time and, where the
+   hardware counters are available, cache misses */
+
+
+#define N_ORDERINGS 3
+
+static const char* ordering_names[N_ORDERINGS] = {"none", "rcm", "hub_bfs"};
+
+
+/* open a hardware counter of this thread; -1 if counters are not available (e.g. in a container) */
+static int open_counter(uint32_t type, uint64_t config){
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(struct perf_event_attr));
+  attr.size = sizeof(struct perf_event_attr);
+  attr.type = type;
+  attr.config = config;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+
+static void start_counter(int fd){
+  if(fd == -1) return;
+  ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+  ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+}
+
+
+static void print_counter(const char* name, int fd){
+  uint64_t value;
+  if(fd == -1 || read(fd, &value, sizeof(uint64_t)) != sizeof(uint64_t)) {
+    printf(" %s=n/a", name);
+    return;
+  }
+  printf(" %s=%lu", name, value);
+}
+
+
+static double get_elapsed_ms(struct timespec start){
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  return (end.tv_sec - start.tv_sec)*1E3 + (end.tv_nsec - start.tv_nsec)/1E6;
+}
+
+
+/* execute the queries on the network loaded with `ordering` and print the measures */
+static void run_benchmark(struct network_params net_params, enum network_ordering ordering, long* queries, long n_queries, uint64_t amount){
+  struct network* network;
+  struct array* payments;
+  struct path* path;
+  gsl_rng* random_generator;
+  struct timespec start;
+  enum pathfind_error error;
+  long i, n_paths = 0, n_hops = 0, sender, receiver;
+  int cache_misses, l1d_misses;
+  double load_ms, query_ms;
+
+  random_generator = gsl_rng_alloc(gsl_rng_default);
+  net_params.network_ordering = ordering;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  network = initialize_network(net_params, random_generator);
+  load_ms = get_elapsed_ms(start);
+
+  payments = array_initialize(1);
+  initialize_dijkstra(array_len(network->nodes), array_len(network->edges), payments);
+
+  cache_misses = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+  l1d_misses = open_counter(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+  start_counter(cache_misses);
+  start_counter(l1d_misses);
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for(i = 0; i < n_queries; i++) {
+    sender = get_renumbered_id(network->node_map, queries[2*i]);
+    receiver = get_renumbered_id(network->node_map, queries[2*i+1]);
+    path = dijkstra(sender, receiver, amount, network, 0, 0, &error, net_params.routing_method, NULL, UINT64_MAX);
+    if(path == NULL) continue;
+    n_paths++;
+    n_hops += path->n_hops;
+    free_path(path);
+  }
+  query_ms = get_elapsed_ms(start);
+
+  printf("%-8s load=%.1fms queries=%.1fms (%.3fms/query) paths=%ld hops=%ld", ordering_names[ordering], load_ms, query_ms, query_ms/n_queries, n_paths, n_hops);
+  print_counter("cache_misses", cache_misses);
+  print_counter("l1d_read_misses", l1d_misses);
+  printf("\n");
+
+  if(cache_misses != -1) close(cache_misses);
+  if(l1d_misses != -1) close(l1d_misses);
+  array_free(payments);
+  free_network(network);
+  gsl_rng_free(random_generator);
+}
+
+
+int main(int argc, char *argv[]) {
+  struct network_params net_params;
+  struct payments_params pay_params;
+  struct simulation_params sim_params;
+  struct network* network;
+  gsl_rng* random_generator;
+  long i, n_queries, n_nodes, *queries;
+  uint64_t amount;
+  int ordering;
+
+  if(argc < 4 || argc > 6) {
+    fprintf(stderr, "usage: %s <nodes.csv> <channels.csv> <edges.csv> [n_queries (default 1000)] [amount in satoshi (default 10000)]\n", argv[0]);
+    return -1;
+  }
+  n_queries = argc > 4 ? strtol(argv[4], NULL, 10) : 1000;
+  amount = (argc > 5 ? strtoull(argv[5], NULL, 10) : 10000)*1000;
+  if(n_queries <= 0) {
+    fprintf(stderr, "ERROR: the number of queries must be positive\n");
+    return -1;
+  }
+
+  initialize_input_parameters(&net_params, &pay_params, &sim_params);
+  net_params.network_from_file = 1;
+  strcpy(net_params.nodes_filename, argv[1]);
+  strcpy(net_params.channels_filename, argv[2]);
+  strcpy(net_params.edges_filename, argv[3]);
+  net_params.cul_threshold_dist_alpha = net_params.cul_threshold_dist_beta = -1;
+  net_params.routing_method = CLOTH_ORIGINAL;
+  telemetry_open("", 0);
+  gsl_rng_env_setup();
+
+  // the queries are pairs of input node ids, the same for all the orderings
+  network = generate_network_from_files(argv[1], argv[2], argv[3]);
+  n_nodes = array_len(network->nodes);
+  free_network(network);
+  if(n_nodes < 2) {
+    fprintf(stderr, "ERROR: the network has less than two nodes\n");
+    return -1;
+  }
+  random_generator = gsl_rng_alloc(gsl_rng_default);
+  queries = malloc(2*n_queries*sizeof(long));
+  for(i = 0; i < n_queries; i++) {
+    do {
+      queries[2*i] = gsl_rng_uniform_int(random_generator, n_nodes);
+      queries[2*i+1] = gsl_rng_uniform_int(random_generator, n_nodes);
+    } while(queries[2*i] == queries[2*i+1]);
+  }
+  gsl_rng_free(random_generator);
+
+  printf("nodes=%ld queries=%ld amount=%lu msat\n", n_nodes, n_queries, amount);
+  for(ordering = 0; ordering < N_ORDERINGS; ordering++)
+    run_benchmark(net_params, ordering, queries, n_queries, amount);
+
+  free(queries);
+  return 0;
+}
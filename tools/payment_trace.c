@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "../include/csv.h"
+#include "../include/payments.h"
+#include "../include/payment_trace.h"
+
+/* Converter from a payments file (`id,sender_id,receiver_id,amount,start_time[,max_fee_limit]`, as `payments_template.csv`) to a binary
+   payment trace, read by the simulator when it is given as `payments_filename`. The payments are sorted by start time; after writing the
+   trace, it reads it back and checks that it has the same payments */
+
+
+struct indexed_arrival {
+  struct payment_arrival arrival;
+  long id;
+  long index; // the position in the file
+};
+
+
+static double get_elapsed_ms(struct timespec start){
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  return (end.tv_sec - start.tv_sec)*1E3 + (end.tv_nsec - start.tv_nsec)/1E6;
+}
+
+
+/* payments with the same start time keep the order of the file */
+static int compare_arrivals(const void* a, const void* b){
+  const struct indexed_arrival* arrival1 = a, *arrival2 = b;
+  if(arrival1->arrival.start_time != arrival2->arrival.start_time)
+    return arrival1->arrival.start_time < arrival2->arrival.start_time ? -1 : 1;
+  return arrival1->index < arrival2->index ? -1 : (arrival1->index > arrival2->index);
+}
+
+
+/* check that the trace has the same payments, in the same order */
+static void check_trace(char filename[], struct payment_arrival* arrivals, long n_payments){
+  struct payment_trace* trace;
+  struct payment_arrival arrival;
+  long i;
+
+  trace = open_payment_trace(filename);
+  for(i = 0; read_payment_trace(trace, &arrival); i++) {
+    if(i >= n_payments || arrival.sender != arrivals[i].sender || arrival.receiver != arrivals[i].receiver || arrival.amount != arrivals[i].amount ||
+       arrival.start_time != arrivals[i].start_time || arrival.max_fee_limit != arrivals[i].max_fee_limit) {
+      fprintf(stderr, "ERROR: payment <%ld> differs in the trace\n", i);
+      exit(-1);
+    }
+  }
+  if(i != n_payments) {
+    fprintf(stderr, "ERROR: the trace has %ld payments instead of %ld\n", i, n_payments);
+    exit(-1);
+  }
+  close_payment_trace(trace);
+}
+
+
+int main(int argc, char *argv[]) {
+  struct csv_table* payments_table;
+  union csv_value payment_defaults[6], *row;
+  struct indexed_arrival* indexed_arrivals;
+  struct payment_arrival* arrivals;
+  struct timespec start;
+  double csv_ms, trace_ms;
+  long i, n_payments, n_moved;
+
+  if(argc != 3) {
+    fprintf(stderr, "usage: %s <payments.csv> <output trace>\n", argv[0]);
+    return -1;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  // the max fee limit may be missing (e.g., in payments_template.csv): no limit
+  memset(payment_defaults, 0, sizeof(payment_defaults));
+  payment_defaults[5].integer = (int64_t)UINT64_MAX;
+  payments_table = csv_read(argv[1], "iiiiii", 5, payment_defaults);
+  csv_ms = get_elapsed_ms(start);
+
+  n_payments = payments_table->n_rows;
+  indexed_arrivals = malloc(sizeof(struct indexed_arrival)*(n_payments > 0 ? n_payments : 1));
+  for(i = 0; i < n_payments; i++) {
+    row = payments_table->values + i*payments_table->n_columns;
+    indexed_arrivals[i].arrival.sender = row[1].integer;
+    indexed_arrivals[i].arrival.receiver = row[2].integer;
+    indexed_arrivals[i].arrival.amount = row[3].integer;
+    indexed_arrivals[i].arrival.start_time = row[4].integer;
+    indexed_arrivals[i].arrival.max_fee_limit = row[5].integer;
+    indexed_arrivals[i].id = row[0].integer;
+    indexed_arrivals[i].index = i;
+  }
+  csv_free(payments_table);
+  qsort(indexed_arrivals, n_payments, sizeof(struct indexed_arrival), compare_arrivals);
+
+  arrivals = malloc(sizeof(struct payment_arrival)*(n_payments > 0 ? n_payments : 1));
+  n_moved = 0;
+  for(i = 0; i < n_payments; i++) {
+    arrivals[i] = indexed_arrivals[i].arrival;
+    if(indexed_arrivals[i].id != i) n_moved++;
+  }
+  free(indexed_arrivals);
+  if(n_moved > 0)
+    fprintf(stderr, "WARNING: the ids of %ld payments are not their position after sorting by start time: the payments of the trace are numbered by position\n", n_moved);
+
+  write_payment_trace(argv[2], arrivals, n_payments);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  check_trace(argv[2], arrivals, n_payments);
+  trace_ms = get_elapsed_ms(start);
+
+  printf("payments=%ld\n", n_payments);
+  printf("load from csv file: %.3f ms, load from trace: %.3f ms\n", csv_ms, trace_ms);
+  free(arrivals);
+  return 0;
+}
@@ -0,0 +1,276 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <time.h>
+
+#include <gsl/gsl_rng.h>
+
+#include "../include/array.h"
+#include "../include/heap.h"
+#include "../include/list.h"
+#include "../include/cloth.h"
+#include "../include/network.h"
+#include "../include/payments.h"
+#include "../include/routing.h"
+#include "../include/htlc.h"
+#include "../include/event.h"
+#include "../include/input.h"
+#include "../include/trace.h"
+
+/* Replay harness of the event traces written by the simulator (parameter `event_trace_filename`).
+   It prints statistics of a trace, finds the first divergence between the traces of two runs,
+   and feeds a trace through a single subsystem of the simulator to benchmark it in isolation on a realistic event stream */
+
+
+static uint64_t get_time_ns(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec*1000000000ULL + ts.tv_nsec;
+}
+
+
+static void print_record(long index, struct trace_record* record){
+  printf("#%ld time=%"PRIu64" type=%s node=%"PRIu32" payment=%"PRId64" edge=%"PRId32" balance=%"PRIu64" error=%u attempts=%u flags=0x%x\n",
+         index, record->time, get_trace_record_type_name(record->type), record->node_id,
+         record->payment_id == UINT32_MAX ? (int64_t)-1 : (int64_t)record->payment_id,
+         record->edge_id, record->edge_balance, record->error_type, record->attempts, record->flags);
+}
+
+
+int print_stats(char trace_filename[]){
+  struct trace* trace;
+  struct trace_record* record;
+  long i, counts[N_EVENT_TYPES], n_route_hops = 0, n_balance_updates = 0, n_completed = 0;
+
+  trace = trace_map(trace_filename);
+  memset(counts, 0, sizeof(counts));
+  for(i = 0; i < trace->n_records; i++) {
+    record = &(trace->records[i]);
+    if(record->type == TRACE_ROUTE_HOP) {
+      n_route_hops++;
+      continue;
+    }
+    if(record->type < N_EVENT_TYPES) counts[record->type]++;
+    if(record->edge_id != -1) n_balance_updates++;
+    if(record->type == RECEIVESUCCESS || record->type == RECEIVEFAIL)
+      if(record->flags & TRACE_PAYMENT_COMPLETED) n_completed++;
+  }
+
+  printf("nodes=%"PRIu64" edges=%"PRIu64" records=%ld\n", trace->header->n_nodes, trace->header->n_edges, trace->n_records);
+  if(trace->n_records > 0)
+    printf("first_time=%"PRIu64" last_time=%"PRIu64"\n", trace->records[0].time, trace->records[trace->n_records-1].time);
+  for(i = 0; i < N_EVENT_TYPES; i++)
+    printf("%-22s %ld\n", get_event_type_name(i), counts[i]);
+  printf("%-22s %ld\n", "ROUTEHOP", n_route_hops);
+  printf("balance_updates=%ld completed_payments=%ld\n", n_balance_updates, n_completed);
+
+  trace_unmap(trace);
+  return 0;
+}
+
+
+/* print the first record that differs between two traces, with the preceding one for context */
+int diff_traces(char trace_filename1[], char trace_filename2[]){
+  struct trace* trace1, *trace2;
+  long i, n_records;
+  int result = 0;
+
+  trace1 = trace_map(trace_filename1);
+  trace2 = trace_map(trace_filename2);
+  if(trace1->header->n_nodes != trace2->header->n_nodes || trace1->header->n_edges != trace2->header->n_edges)
+    printf("WARNING: the traces were recorded on different networks\n");
+
+  n_records = trace1->n_records < trace2->n_records ? trace1->n_records : trace2->n_records;
+  for(i = 0; i < n_records; i++)
+    if(memcmp(&(trace1->records[i]), &(trace2->records[i]), sizeof(struct trace_record)) != 0) break;
+
+  if(i < n_records) {
+    printf("first divergence at record %ld\n", i);
+    if(i > 0) {
+      printf("last common record:\n");
+      print_record(i-1, &(trace1->records[i-1]));
+    }
+    printf("<%s>:\n", trace_filename1);
+    print_record(i, &(trace1->records[i]));
+    printf("<%s>:\n", trace_filename2);
+    print_record(i, &(trace2->records[i]));
+    result = 1;
+  }
+  else if(trace1->n_records != trace2->n_records) {
+    printf("the traces are equal up to record %ld; <%s> has %ld records, <%s> has %ld records\n", n_records, trace_filename1, trace1->n_records, trace_filename2, trace2->n_records);
+    result = 1;
+  }
+  else
+    printf("the traces are equal (%ld records)\n", n_records);
+
+  trace_unmap(trace1);
+  trace_unmap(trace2);
+  return result;
+}
+
+
+int dump_trace(char trace_filename[], long from, long count){
+  struct trace* trace;
+  long i;
+
+  trace = trace_map(trace_filename);
+  for(i = from; i < trace->n_records && i < from + count; i++)
+    print_record(i, &(trace->records[i]));
+  trace_unmap(trace);
+  return 0;
+}
+
+
+/* payments of the replay: only the id and the current route (rebuilt from the TRACE_ROUTE_HOP records) are known */
+static struct payment* get_replay_payment(struct array** payments, long id){
+  struct payment* payment;
+  while(array_len(*payments) <= id)
+    *payments = array_insert(*payments, NULL);
+  payment = array_get(*payments, id);
+  if(payment == NULL) {
+    payment = new_payment(id, 0, 0, 0, 0, 0);
+    (*payments)->element[id] = payment;
+  }
+  return payment;
+}
+
+
+/* replay the trace through the group manager: edge balances are set as recorded, routes are rebuilt from the route records,
+   and group updates and group constructions are executed as in the main loop of the simulator.
+   The network and the initial groups are built from `cloth_input.txt` (and GSL_RNG_SEED), as in the recorded run */
+int replay_groups(char trace_filename[]){
+  struct trace* trace;
+  struct trace_record* record;
+  struct network_params net_params;
+  struct payments_params pay_params;
+  struct simulation_params sim_params;
+  struct simulation* simulation;
+  struct network* network;
+  struct array* payments;
+  struct payment* payment;
+  struct route_hop* hop;
+  struct edge* edge;
+  struct event event, *generated_event;
+  struct element* group_add_queue;
+  uint64_t start, update_ns = 0, construct_ns = 0;
+  long i, n_updates = 0, n_constructions = 0, n_closed_groups = 0;
+
+  trace = trace_map(trace_filename);
+  read_input(&net_params, &pay_params, &sim_params);
+  if(net_params.routing_method != GROUP_ROUTING && net_params.routing_method != GROUP_ROUTING_CUL) {
+    fprintf(stderr, "ERROR: the routing method in <cloth_input.txt> does not use groups\n");
+    return -1;
+  }
+
+  simulation = malloc(sizeof(struct simulation));
+  simulation->current_time = 0;
+  gsl_rng_env_setup();
+  simulation->random_generator = gsl_rng_alloc(gsl_rng_default);
+  simulation->events = heap_initialize(1000);
+  network = initialize_network(net_params, simulation->random_generator);
+  if(array_len(network->nodes) != (long)trace->header->n_nodes || array_len(network->edges) != (long)trace->header->n_edges) {
+    fprintf(stderr, "ERROR: the trace was recorded on a different network than the one of <cloth_input.txt>\n");
+    return -1;
+  }
+
+  start = get_time_ns();
+  group_add_queue = initialize_groups(simulation, network, net_params);
+  printf("initial groups: %ld (%.3f ms)\n", array_len(network->groups), (get_time_ns() - start)/1E6);
+
+  payments = array_initialize(1000);
+  for(i = 0; i < trace->n_records; i++) {
+    record = &(trace->records[i]);
+
+    if(record->type == TRACE_ROUTE_HOP) {
+      payment = get_replay_payment(&payments, record->payment_id);
+      if(record->attempts == 0) {
+        if(payment->route != NULL) free_route(payment->route);
+        payment->route = route_initialize(record->error_type);
+      }
+      edge = array_get(network->edges, record->edge_id);
+      // the hops of a route are traced in order, after the number of hops
+      hop = &(payment->route->hops[record->attempts]);
+      memset(hop, 0, sizeof(struct route_hop));
+      hop->from_node_id = record->node_id;
+      hop->to_node_id = edge->to_node_id;
+      hop->edge_id = record->edge_id;
+      hop->amount_to_forward = record->edge_balance;
+      continue;
+    }
+
+    // the groups of the trace were built on a network that changed
+    if(record->type == OPENCHANNEL || record->type == CLOSECHANNEL) {
+      fprintf(stderr, "ERROR: the trace contains channel opens or closes, which cannot be replayed\n");
+      return -1;
+    }
+
+    simulation->current_time = record->time;
+    if(record->edge_id != -1) {
+      edge = array_get(network->edges, record->edge_id);
+      edge->balance = record->edge_balance;
+    }
+
+    switch(record->type) {
+    case CHANNELUPDATEFAIL:
+    case CHANNELUPDATESUCCESS:
+    case UPDATEGROUP:
+      payment = get_replay_payment(&payments, record->payment_id);
+      if(payment->route == NULL) break;
+      event.time = record->time;
+      event.type = record->type;
+      event.node_id = record->node_id;
+      event.hop_index = -1;
+      event.payment = payment;
+      start = get_time_ns();
+      group_add_queue = request_group_update(&event, simulation, network, net_params, group_add_queue);
+      update_ns += get_time_ns() - start;
+      n_updates++;
+      break;
+    case CONSTRUCTGROUPS:
+      start = get_time_ns();
+      group_add_queue = construct_groups(simulation, group_add_queue, network, net_params);
+      construct_ns += get_time_ns() - start;
+      n_constructions++;
+      break;
+    default:
+      break;
+    }
+
+    /* the events generated by the group manager are already in the trace */
+    while(heap_len(simulation->events) != 0) {
+      generated_event = heap_pop(simulation->events, compare_event);
+      free(generated_event);
+    }
+  }
+
+  for(i = 0; i < array_len(network->groups); i++)
+    if(((struct group*) array_get(network->groups, i))->is_closed) n_closed_groups++;
+
+  printf("group updates: %ld in %.3f ms (%.0f ns/update)\n", n_updates, update_ns/1E6, n_updates ? (double)update_ns/n_updates : 0.0);
+  printf("group constructions: %ld in %.3f ms (%.0f ns/construction)\n", n_constructions, construct_ns/1E6, n_constructions ? (double)construct_ns/n_constructions : 0.0);
+  printf("groups: %ld (closed: %ld), edges waiting for a group: %ld\n", array_len(network->groups), n_closed_groups, list_len(group_add_queue));
+
+  trace_unmap(trace);
+  return 0;
+}
+
+
+int main(int argc, char *argv[]) {
+  if(argc == 3 && strcmp(argv[1], "stats")==0)
+    return print_stats(argv[2]);
+  if(argc == 4 && strcmp(argv[1], "diff")==0)
+    return diff_traces(argv[2], argv[3]);
+  if((argc == 3 || argc == 5) && strcmp(argv[1], "dump")==0)
+    return dump_trace(argv[2], argc == 5 ? strtol(argv[3], NULL, 10) : 0, argc == 5 ? strtol(argv[4], NULL, 10) : LONG_MAX);
+  if(argc == 3 && strcmp(argv[1], "groups")==0)
+    return replay_groups(argv[2]);
+
+  fprintf(stderr, "usage: %s stats <trace>\n", argv[0]);
+  fprintf(stderr, "       %s diff <trace1> <trace2>\n", argv[0]);
+  fprintf(stderr, "       %s dump <trace> [<from> <count>]\n", argv[0]);
+  fprintf(stderr, "       %s groups <trace>   (reads cloth_input.txt of the recorded run)\n", argv[0]);
+  return -1;
+}